@@ -12,3 +12,6 @@ else()
 endif()
 
 message(STATUS "Laura++: Using ROOT installation from: ${ROOT_DIR}")
+
+# The simultaneous fit coordinator can run its tasks in separate threads
+find_package(Threads REQUIRED)
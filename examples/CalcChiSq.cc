@@ -36,6 +36,8 @@ int main(const int argc, const char** argv)
 	LauCalcChiSq a(inputFile);
 
 	//a.setVerbose(kTRUE);
+	//a.setOutputBinning("chiSqBinning.txt");
+	//a.setInputBinning("chiSqBinning.txt");
 	a.run();
 
 	return 0;
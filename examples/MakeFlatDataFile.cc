@@ -0,0 +1,51 @@
+
+/*
+Copyright 2026 University of Warwick
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+Laura++ package authors:
+John Back
+Paul Harrison
+Thomas Latham
+*/
+
+#include <cstdlib>
+#include <iostream>
+
+#include "TString.h"
+
+#include "LauFitDataTree.hh"
+
+int main(const int argc, const char** argv)
+{
+	if (argc < 4) {
+		std::cerr<<"Usage: "<<argv[0]<<" <inputFileName> <treeName> <outputFileName>"<<std::endl;
+		return EXIT_FAILURE;
+	}
+
+	TString inputFileName(argv[1]);
+	TString treeName(argv[2]);
+	TString outputFileName(argv[3]);
+
+	LauFitDataTree inputData(inputFileName, treeName);
+	if ( ! inputData.findBranches() ) {
+		return EXIT_FAILURE;
+	}
+
+	Bool_t ok = inputData.writeFlatFile(outputFileName);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
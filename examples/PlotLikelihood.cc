@@ -170,21 +170,12 @@ int main( /*int argc, char** argv*/ )
 	const Double_t xMax{28.0};
 	const Double_t yMin{0.0};
 	const Double_t yMax{28.0};
-	TH2* signalLike = new TH2D( "signalLike", "Signal Likelihood", nBins, xMin, xMax, nBins, yMin, yMax );
-	TH2* qqbarLike  = new TH2D( "qqbarLike",  "qqbar Likelihood",  nBins, xMin, xMax, nBins, yMin, yMax );
+	TH2D likeBinning( "like", "Likelihood", nBins, xMin, xMax, nBins, yMin, yMax );
+	likeBinning.SetDirectory(0);
 
-	for ( Int_t iX{1}; iX < nBins; ++iX ) {
-
-		const Double_t m13Sq { signalLike->GetXaxis()->GetBinCenter( iX ) };
-
-		for ( Int_t iY{1}; iY < nBins; ++iY ) {
-			const Double_t m23Sq { signalLike->GetYaxis()->GetBinCenter( iY ) };
-
-			const auto likelihoods { fitModel->getDPLikelihoods( m13Sq, m23Sq ) };
-
-			signalLike->SetBinContent( iX, iY, likelihoods.at("signal") );
-			qqbarLike ->SetBinContent( iX, iY, likelihoods.at("qqbar") );
-		}
+	const auto likelihoods { fitModel->getDPLikelihoodHists( &likeBinning ) };
+	for ( const auto& [ name, hist ] : likelihoods ) {
+		hist->SetDirectory( histFile.get() );
 	}
 
 	histFile->Write();
@@ -76,6 +76,12 @@ class Lau2DAbsHistDP : public Lau2DAbsDP {
 		*/
 		virtual Bool_t usingSquareDP() const { return squareDP_; };
 
+		//! Determine whether the histogram only describes the upper half of a symmetric DP
+		/*
+		    \return kTRUE if only the upper half is being used, kFALSE otherwise
+		*/
+		virtual Bool_t usingUpperHalf() const { return upperHalf_; };
+
 	protected:
 		//! Fluctuate the contents of each histogram bin independently, in accordance with their errors
 		/*!
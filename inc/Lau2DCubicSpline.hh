@@ -85,6 +85,23 @@ class Lau2DCubicSpline
 	*/
 	virtual Double_t evaluate(Double_t x, Double_t y) const;
 
+	//! Evaluate the product of this function and others with the same knots at given point
+	/*!
+	    The cell lookup and the monomials are shared between all of the splines.
+
+	    \param [in] x the x co-ordinate
+	    \param [in] y the y co-ordinate
+	    \param [in] others the other splines, which must have the same knots (see sameKnots)
+	*/
+	Double_t evaluateProduct(Double_t x, Double_t y, const std::vector<Lau2DCubicSpline*>& others) const;
+
+	//! Determine whether another spline has the same knots
+	/*!
+	    \param [in] other the other spline
+	    \return kTRUE if the binning and ranges agree, kFALSE otherwise
+	*/
+	Bool_t sameKnots(const Lau2DCubicSpline& other) const;
+
 	//! Evaluate analytical integral in x, y, or x and y
 	/*!
 	    \param [in] x1 the lower x limit
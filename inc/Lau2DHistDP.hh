@@ -39,6 +39,8 @@ Thomas Latham
 #ifndef LAU_2DHIST_DP
 #define LAU_2DHIST_DP
 
+#include <vector>
+
 #include "Lau2DAbsHistDP.hh"
 
 class TH2;
@@ -95,15 +97,53 @@ class Lau2DHistDP : public Lau2DAbsHistDP {
 		*/
 		Double_t interpolateXY(Double_t x, Double_t y) const;
 
+		//! Determine whether linear interpolation between bins is being used
+		/*!
+		    \return kTRUE if interpolation is being used, kFALSE if the raw bin values are used
+		*/
+		Bool_t usingInterpolation() const { return useInterpolation_; }
+
+		//! Determine whether another histogram has the same binning, co-ordinates and interpolation settings
+		/*!
+		    \param [in] other the other histogram
+		    \return kTRUE if the bin lattices are compatible, kFALSE otherwise
+		*/
+		Bool_t sameLattice(const Lau2DHistDP& other) const;
+
+		//! Multiply the bin contents by those of another histogram with the same lattice
+		/*!
+		    When the raw bin values are used the contents are multiplied bin by bin.
+		    When interpolation is used the other contents are stored as additional layers of each bin,
+		    so that the neighbouring bins and weights are found once and the product of the per-layer
+		    interpolations is formed.
+		    In both cases the result of interpolateXY is exactly the product of the two original results.
+
+		    \param [in] other the other histogram
+		    \return kTRUE if the bins were combined, kFALSE if the histograms are not compatible
+		*/
+		Bool_t multiplyBins(const Lau2DHistDP& other);
+
 	protected:
 		//! Get the raw bin content from the histogram
 		/*!
 		    \param [in] xBinNo the x-axis bin number
 		    \param [in] yBinNo the y-axis bin number
-		    \return the bin conent
+		    \return the bin conent (the product over all layers)
 		*/
 		Double_t getBinHistValue(Int_t xBinNo, Int_t yBinNo) const;
 
+		//! Get the raw bin content of a single layer
+		/*!
+		    \param [in] xBinNo the x-axis bin number
+		    \param [in] yBinNo the y-axis bin number
+		    \param [in] layer the layer index
+		    \return the bin conent
+		*/
+		Double_t getBinLayerValue(Int_t xBinNo, Int_t yBinNo, UInt_t layer) const;
+
+		//! Copy the bin contents into the flat lattice and determine which bin centres are within the DP
+		void fillLattice();
+
 	private:
 		//! Copy constructor - not implemented
 		Lau2DHistDP( const Lau2DHistDP& rhs );
@@ -144,6 +184,14 @@ class Lau2DHistDP : public Lau2DAbsHistDP {
 		//! Control boolean for using the linear interpolation
 		Bool_t useInterpolation_;
 
+		//! The number of histograms combined into each bin of an interpolated lattice
+		UInt_t nLayers_;
+
+		//! The bin contents, stored contiguously (x-major, then layer) for fast lookup
+		std::vector<Double_t> binContents_;
+		//! Whether each bin centre lies within the kinematic boundary (one entry per bin, same bin ordering as binContents_)
+		std::vector<Char_t> binCentreInDP_;
+
 		ClassDef(Lau2DHistDP,0) // 2D Histogram utility class for DP analyses
 };
 
@@ -39,6 +39,8 @@ Thomas Latham
 #ifndef LAU_2DSPLINE_DP
 #define LAU_2DSPLINE_DP
 
+#include <vector>
+
 #include "Lau2DAbsHistDP.hh"
 
 class TH2;
@@ -94,6 +96,17 @@ class Lau2DSplineDP : public Lau2DAbsHistDP {
 		*/
 		Double_t interpolateXY(Double_t x, Double_t y) const;
 
+		//! Multiply by another spline with the same knots and co-ordinates
+		/*!
+		    The splines of the other object are taken over and evaluated together with this one,
+		    so that the result of interpolateXY is exactly the product of the two original results
+		    while the cell lookup is only done once.
+
+		    \param [in] other the other spline, which is left empty if the splines are combined
+		    \return kTRUE if the splines were combined, kFALSE if they are not compatible
+		*/
+		Bool_t multiplySpline(Lau2DSplineDP& other);
+
 	private:
 		//! Copy constructor - not implemented
 		Lau2DSplineDP( const Lau2DSplineDP& rhs );
@@ -103,6 +116,9 @@ class Lau2DSplineDP : public Lau2DAbsHistDP {
 
 		//! A 2D cubic spline generated from the histogram
 		Lau2DCubicSpline* spline_;
+
+		//! Further splines with the same knots by which spline_ is multiplied
+		std::vector<Lau2DCubicSpline*> factors_;
 	
 		ClassDef(Lau2DSplineDP,0) // 2D Spline utility class for DP analyses
 };
@@ -67,13 +67,17 @@ Thomas Latham
 #include "TString.h"
 #include "TStopwatch.h"
 
+#include <functional>
 #include <iosfwd>
+#include <map>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "LauComplex.hh"
 #include "LauFitObject.hh"
 #include "LauFormulaPar.hh"
+#include "LauGenNtuple.hh"
 #include "LauSimFitTask.hh"
 // LauSPlot included to get LauSPlot::NameSet typedef
 #include "LauSPlot.hh"
@@ -81,9 +85,11 @@ Thomas Latham
 class LauAbsCoeffSet;
 class LauAbsPdf;
 class LauFitDataTree;
-class LauGenNtuple;
+class LauIsobarDynamics;
+class LauKinematics;
 class LauAbsRValue;
 class LauParameter;
+class TH2;
 
 class LauAbsFitModel : public LauSimFitTask {
 
@@ -140,6 +146,93 @@ class LauAbsFitModel : public LauSimFitTask {
 		*/
 	        void enableEmbedding(Bool_t enable) {enableEmbedding_ = enable;}
 
+		//! Fill the generated ntuple from a background thread, so that writing it overlaps with the generation
+		/*!
+			\param [in] queueSize the maximum number of generated events waiting to be written (a value of 0 fills the ntuple directly)
+		*/
+		void asyncGenNtupleFill(UInt_t queueSize) {genNtupleQueueSize_ = queueSize;}
+
+		//! Set the number of events that are read, weighted and written at a time when weighting events
+		/*!
+			\param [in] chunkSize the number of events in each chunk
+		*/
+		void setWeightingChunkSize(UInt_t chunkSize) {weightChunkSize_ = ( chunkSize > 0 ) ? chunkSize : 1;}
+
+		//! Set the number of threads used when weighting events
+		/*!
+			Each DP model is evaluated in its own thread, with models that share the same kinematics object evaluated in turn.
+			The models must not share other mutable state, such as K-matrix propagators of the same name.
+
+			\param [in] nThreads the number of threads
+		*/
+		void setWeightingThreads(UInt_t nThreads) {weightThreads_ = ( nThreads > 0 ) ? nThreads : 1;}
+
+		//! Scan the profile likelihood in one parameter after the fit to each experiment
+		/*!
+			At each point of the scan the parameter is fixed to the scan value and the other floating parameters are refitted,
+			starting from the minimum found at the nearest point already completed, using the data already cached for the experiment.
+			The difference of the NLL from that of the nominal fit and the values of all the fit parameters at each point are stored in an ntuple.
+
+			\param [in] parName the name of the parameter to scan
+			\param [in] nPoints the number of points in the scan
+			\param [in] minVal the value of the parameter at the first point
+			\param [in] maxVal the value of the parameter at the last point
+			\param [in] fileName the name of the file for the scan ntuple
+			\param [in] treeName the name of the tree for the scan ntuple
+		*/
+		void setProfileScan(const TString& parName, const UInt_t nPoints, const Double_t minVal, const Double_t maxVal,
+				const TString& fileName, const TString& treeName = "profileScan");
+
+		//! Scan the profile likelihood in two parameters after the fit to each experiment
+		/*!
+			As for the one-dimensional scan, over all combinations of the values of the two parameters.
+
+			\param [in] parName1 the name of the first parameter to scan
+			\param [in] nPoints1 the number of points in the first parameter
+			\param [in] minVal1 the value of the first parameter at its first point
+			\param [in] maxVal1 the value of the first parameter at its last point
+			\param [in] parName2 the name of the second parameter to scan
+			\param [in] nPoints2 the number of points in the second parameter
+			\param [in] minVal2 the value of the second parameter at its first point
+			\param [in] maxVal2 the value of the second parameter at its last point
+			\param [in] fileName the name of the file for the scan ntuple
+			\param [in] treeName the name of the tree for the scan ntuple
+		*/
+		void setProfileScan(const TString& parName1, const UInt_t nPoints1, const Double_t minVal1, const Double_t maxVal1,
+				const TString& parName2, const UInt_t nPoints2, const Double_t minVal2, const Double_t maxVal2,
+				const TString& fileName, const TString& treeName = "profileScan");
+
+		//! Set the number of processes used for the profile likelihood scan
+		/*!
+			With more than one process, the scan points are shared out between forked copies of the fit in sectors running outwards from the nominal minimum,
+			each of which starts its points from its own completed neighbours, and the results are gathered and stored in this process.
+			A one-dimensional scan uses at most two processes, one either side of the minimum.
+
+			\param [in] nProcesses the number of processes
+		*/
+		void setProfileScanProcesses(UInt_t nProcesses) {scanProcesses_ = ( nProcesses > 0 ) ? nProcesses : 1;}
+
+		//! Turn on checkpointing of the fit, so that an interrupted job can be resumed
+		/*!
+			The index of the experiment being fitted, and the best parameter values and the current
+			step sizes of the fit in progress, are written periodically to the checkpoint file.
+			The amplitudes on the integration grids of the signal Dalitz plot models at those values
+			are written alongside it, to files named after it.
+			The fit results, sPlot and profile scan ntuples are saved to disk after each experiment.
+
+			If the checkpoint file already exists when the fit is started, the job resumes from it:
+			the experiments already completed are skipped, their results are kept in the ntuples,
+			and the fit to the interrupted experiment starts from the checkpointed parameter
+			values and step sizes, with the integration grid amplitudes read back rather than
+			evaluated again.
+			The MINUIT covariance matrix is not saved, so the minimiser has to rebuild it.
+			The checkpoint files are removed once all experiments have been fitted.
+
+			\param [in] fileName the name of the checkpoint file
+			\param [in] nCalls the number of likelihood evaluations between checkpoints
+		*/
+		void useCheckpointing(const TString& fileName, const UInt_t nCalls = 1000);
+
 		//! Determine whether writing out of the latex table is enabled
 		Bool_t writeLatexTable() const {return writeLatexTable_;}
 
@@ -170,6 +263,12 @@ class LauAbsFitModel : public LauSimFitTask {
 		//! Determine whether the sPlot data is to be written out
 		Bool_t writeSPlotData() const {return writeSPlotData_;}
 
+		//! Calculate the sWeights reading the sPlot ntuple in chunks, rather than holding all events in memory
+		/*!
+			\param [in] chunkSize the number of events in each chunk (a value of 0 turns off streaming)
+		*/
+		void sPlotStreaming(Int_t chunkSize) {sPlotChunkSize_ = chunkSize;}
+
 		//! Determine whether the efficiency information should be stored in the sPlot ntuple
 		Bool_t storeDPEff() const {return storeDPEff_;}
 
@@ -313,6 +412,36 @@ class LauAbsFitModel : public LauSimFitTask {
                  */
                 virtual std::map<TString, Double_t> getDPLikelihoods( const Double_t m13Sq, const Double_t m23Sq ) = 0;
 
+		//! Calculate the DP amplitude(s) for many DP positions
+		/*!
+			If not already done, this function will initialise the DP models.
+			The amplitude of each coherent component of each signal model is also provided, labelled by the signal label followed by "_" and the resonance name.
+			Models with their own kinematics are evaluated in parallel, using the weighting threads (see setWeightingThreads).
+
+			\param [in] m13Sq the invariant mass squared of children 1 and 3 for each point
+			\param [in] m23Sq the invariant mass squared of children 2 and 3 for each point
+			\return a container of the complex amplitudes at each point, labelled as for the single point version
+		*/
+		virtual std::map< TString, std::vector<LauComplex> > getDPAmps( const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq ) = 0;
+
+		//! Calculate the DP likelihood(s) for many DP positions
+		/*!
+			If not already done, this function will initialise the DP models.
+			Models with their own kinematics are evaluated in parallel, using the weighting threads (see setWeightingThreads).
+
+			\param [in] m13Sq the invariant mass squared of children 1 and 3 for each point
+			\param [in] m23Sq the invariant mass squared of children 2 and 3 for each point
+			\return a container of the likelihood values at each point, labelled as for the single point version
+		*/
+		virtual std::map< TString, std::vector<Double_t> > getDPLikelihoods( const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq ) = 0;
+
+		//! Calculate the DP likelihood(s) at the centres of the bins of a histogram in m13Sq vs m23Sq
+		/*!
+			\param [in] binning the histogram defining the bins
+			\return a histogram of the likelihood values for each component, named after the binning histogram followed by "_" and the component label (owned by the caller and not attached to any directory)
+		*/
+		std::map<TString, TH2*> getDPLikelihoodHists( const TH2* binning );
+
 	protected:
 
 		// Some typedefs
@@ -336,6 +465,29 @@ class LauAbsFitModel : public LauSimFitTask {
 		//! Clear the vectors containing extra ntuple variables
 		void clearExtraVarVectors();
 
+		//! A task for the event weighting, together with the kinematics object that it updates
+		typedef std::pair< const LauKinematics*, std::function<void()> > LauWeightingTask;
+
+		//! Run the event weighting tasks, sharing them out between the weighting threads
+		/*!
+			Tasks that update the same kinematics object are run in turn in the same thread.
+
+			\param [in] tasks the tasks to run
+		*/
+		void runWeightingTasks(const std::vector<LauWeightingTask>& tasks) const;
+
+		//! Read the values of the given variables for a range of events in the current experiment
+		/*!
+			\param [in] names the names of the variables
+			\param [in] firstEvt the first event to read
+			\param [in] nEvts the number of events to read
+			\param [out] columns the values of each variable for each event
+		*/
+		void readDataColumns(const std::vector<TString>& names, const UInt_t firstEvt, const UInt_t nEvts, std::vector< std::vector<Double_t> >& columns) const;
+
+		//! Retrieve the number of events that are read, weighted and written at a time when weighting events
+		UInt_t weightingChunkSize() const {return weightChunkSize_;}
+
 		//! Weighting - allows e.g. MC events to be weighted by the DP model
 		/*!
 			\param [in] dataFileName the name of the data file
@@ -370,6 +522,41 @@ class LauAbsFitModel : public LauSimFitTask {
 		//! Routine to perform the actual fit for a given experiment
 		void fitExpt();
 
+		//! Routine to perform the profile likelihood scan for a given experiment, following the nominal fit
+		void runProfileScan();
+
+		//! Read the checkpoint file, if there is one
+		/*!
+			\return true if a valid checkpoint was read, false otherwise
+		*/
+		Bool_t readCheckpoint();
+
+		//! Write the checkpoint file
+		/*!
+			\param [in] iExpt the experiment at which to resume
+			\param [in] withPars whether to include the best parameter values found so far in the fit to that experiment
+		*/
+		void writeCheckpoint(const UInt_t iExpt, const Bool_t withPars) const;
+
+		//! Record the point just evaluated in the fit and write a checkpoint if it is due
+		/*!
+			\param [in] negLogLike the negative log-likelihood at the point
+		*/
+		void updateCheckpoint(const Double_t negLogLike);
+
+		//! The name of the file holding the integration grid of one of the signal Dalitz plot models with the checkpoint
+		/*!
+			\param [in] iModel the index of the model in the list returned by checkpointDPModels
+			\return the name of the file
+		*/
+		TString checkpointGridFileName(const UInt_t iModel) const;
+
+		//! The signal Dalitz plot models whose integration grids are saved with the checkpoint
+		/*!
+			\return the models (none by default)
+		*/
+		virtual std::vector<LauIsobarDynamics*> checkpointDPModels() const {return std::vector<LauIsobarDynamics*>();}
+
 		//! Routine to perform the minimisation
 		/*!
 			\return the success/failure flag of the fit
@@ -439,6 +626,16 @@ class LauAbsFitModel : public LauSimFitTask {
 		//! Calculate the penalty terms to the log likelihood from Gaussian constraints
 		Double_t getLogLikelihoodPenalty();
 
+		//! Determine whether the binned approximation of the likelihood is used in place of the sum over events
+		virtual Bool_t binnedLikelihood() const {return kFALSE;}
+
+		//! Calculate the binned approximation of the log-likelihood
+		/*!
+			Only called if binnedLikelihood returns kTRUE.
+			Should include everything that getLogLikelihood would otherwise provide.
+		*/
+		virtual Double_t getBinnedLogLikelihood() {return 0.0;}
+
 		//! Calculates the likelihood for a given event
 		/*!
 			\param [in] iEvt the event number
@@ -467,6 +664,12 @@ class LauAbsFitModel : public LauSimFitTask {
 		*/
 		virtual void setupResultsOutputs( const TString& histFileName, const TString& tableFileName );
 
+		//! Determine whether the fit results should be added to those already in the output file
+		/*!
+			\return true when resuming from a checkpoint
+		*/
+		virtual Bool_t appendFitResults() const {return resumedFromCheckpoint_;}
+
 		//! Package the initial fit parameters for transmission to the coordinator
 		/*!
 			\param [out] array the array to be filled with the LauParameter objects
@@ -573,6 +776,34 @@ class LauAbsFitModel : public LauSimFitTask {
 		*/
 		virtual void setGenNtupleDoubleBranchValue(const TString& name, Double_t value);
 
+		//! Get the handle to an integer branch in the gen tree
+		/*!
+			\param [in] name the name of the branch
+			\return the handle to the branch (null if there is no such branch)
+		*/
+		LauGenNtuple::IntegerBranchHandle genNtupleIntegerBranchHandle(const TString& name);
+
+		//! Get the handle to a double branch in the gen tree
+		/*!
+			\param [in] name the name of the branch
+			\return the handle to the branch (null if there is no such branch)
+		*/
+		LauGenNtuple::DoubleBranchHandle genNtupleDoubleBranchHandle(const TString& name);
+
+		//! Set the value of an integer branch in the gen tree
+		/*!
+			\param [in] handle the handle to the branch (nothing is done if it is null)
+			\param [in] value the value to be stored
+		*/
+		void setGenNtupleIntegerBranchValue(LauGenNtuple::IntegerBranchHandle handle, Int_t value) {if (handle) {*handle = value;}}
+
+		//! Set the value of a double branch in the gen tree
+		/*!
+			\param [in] handle the handle to the branch (nothing is done if it is null)
+			\param [in] value the value to be stored
+		*/
+		void setGenNtupleDoubleBranchValue(LauGenNtuple::DoubleBranchHandle handle, Double_t value) {if (handle) {*handle = value;}}
+
 		//! Get the value of an integer branch in the gen tree
 		/*!
 			\param [in] name the name of the branch
@@ -672,6 +903,11 @@ class LauAbsFitModel : public LauSimFitTask {
 
 		//! Calculate the product of the per-event likelihoods of the PDFs in the list
 		/*!
+			When called from within getLogLikelihood, lists whose PDFs all
+			provide a batch kernel (or have cached values) are evaluated for
+			the whole event range in one go and the products are stored,
+			subsequent calls then simply look up the stored value.
+
 			\param [in] pdfList the list of pdfs
 			\param [in] iEvt the event number
 		*/
@@ -817,6 +1053,17 @@ class LauAbsFitModel : public LauSimFitTask {
 		//! The sWeight scaling factor
 		Double_t sWeightScaleFactor_;
 
+		// Batch PDF evaluation related variables
+
+		//! The first event of the range currently being evaluated in getLogLikelihood
+		UInt_t batchStart_;
+		//! One past the last event of the range currently being evaluated in getLogLikelihood
+		UInt_t batchEnd_;
+		//! The stored per-event PDF products for each batched PDF list
+		std::map<const LauPdfList*, std::vector<Double_t>> batchPdfProducts_;
+		//! Scratch space for the likelihoods of a single PDF
+		std::vector<Double_t> batchPdfValues_;
+
 		// Fit timers
 
 		//! The fit timer
@@ -846,6 +1093,62 @@ class LauAbsFitModel : public LauSimFitTask {
 		TString sPlotTreeName_;
 		//! Control the verbosity of the sFit
 		TString sPlotVerbosity_;
+		//! The number of events in each chunk when streaming the sPlot calculation (0 if not streaming)
+		Int_t sPlotChunkSize_;
+
+		//! The maximum number of events queued for writing to the generated ntuple (0 if filled directly)
+		UInt_t genNtupleQueueSize_;
+
+		//! The number of events in each chunk when weighting events
+		UInt_t weightChunkSize_;
+
+		//! The number of threads used when weighting events
+		UInt_t weightThreads_;
+
+		//! The number of processes used for the profile likelihood scan
+		UInt_t scanProcesses_;
+
+		//! The names of the parameters in the profile likelihood scan
+		std::vector<TString> scanParNames_;
+
+		//! The values of each scanned parameter at the points of the scan
+		std::vector< std::vector<Double_t> > scanGrids_;
+
+		//! The name of the file for the profile likelihood scan ntuple
+		TString scanFileName_;
+
+		//! The name of the tree for the profile likelihood scan ntuple
+		TString scanTreeName_;
+
+		//! The profile likelihood scan ntuple
+		LauGenNtuple* scanNtuple_;
+
+		//! The name of the checkpoint file
+		TString checkpointFileName_;
+
+		//! The number of likelihood evaluations between checkpoints
+		UInt_t checkpointInterval_;
+
+		//! The number of likelihood evaluations since the last checkpoint
+		UInt_t checkpointCalls_;
+
+		//! Whether checkpoints are currently being written from the likelihood evaluation
+		Bool_t checkpointActive_;
+
+		//! Whether the current job resumed from a checkpoint
+		Bool_t resumedFromCheckpoint_;
+
+		//! The experiment at which the job resumed
+		UInt_t checkpointExpt_;
+
+		//! The parameter values and step sizes from which to resume the fit to that experiment
+		std::map< TString, std::pair<Double_t,Double_t> > checkpointPars_;
+
+		//! The lowest negative log-likelihood found so far in the current fit
+		Double_t checkpointBestNLL_;
+
+		//! The parameter values at that point
+		std::vector<Double_t> checkpointBestValues_;
 
 		ClassDef(LauAbsFitModel,0) // Abstract interface to fit/toyMC model
 };
@@ -105,6 +105,24 @@ class LauAbsFitter {
 		*/	
 		virtual void useAsymmFitErrors(Bool_t useAsymmErrors) = 0;
 
+		//! Determine whether the NLL gradient is supplied to the fitter
+		virtual Bool_t useBatchedGradient() const = 0;
+
+		//! Turn on or off the supply of the NLL gradient, evaluated in a single batch, to the fitter
+		/*!
+			\param [in] useBatchGrad boolean specifying whether or not the gradient should be supplied
+		*/
+		virtual void useBatchedGradient(Bool_t useBatchGrad) = 0;
+
+		//! Determine the number of processes in which the asymmetric errors are calculated
+		virtual UInt_t minosProcesses() const = 0;
+
+		//! Set the number of processes in which the asymmetric errors are calculated
+		/*!
+			\param [in] nProcesses the number of processes
+		*/
+		virtual void minosProcesses(UInt_t nProcesses) = 0;
+
 		//! Perform the minimisation of the fit function
 		/*!
 		    \return the status code of the fit and the minimised value
@@ -123,6 +141,12 @@ class LauAbsFitter {
 		//! Retrieve the fit covariance matrix
 		virtual const TMatrixD& covarianceMatrix() const = 0;
 
+		//! Retrieve the current step sizes of the parameters, which may be called while the minimisation is in progress
+		/*!
+		    \return the step sizes, in the same order as the parameters given to initialise
+		*/
+		virtual std::vector<Double_t> currentStepSizes() const = 0;
+
 	protected:
 		//! Constructor
 		LauAbsFitter() = default;
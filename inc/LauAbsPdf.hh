@@ -203,6 +203,24 @@ class LauAbsPdf {
 		*/
 		virtual void calcLikelihoodInfo(UInt_t iEvt);
 
+		//! Calculate the normalised likelihoods for a range of the cached events
+		/*!
+		    PDFs that provide a batch kernel (see hasBatchKernel) evaluate all of the events in a single pass over the cached abscissa values.
+		    For all other PDFs this falls back to calling calcLikelihoodInfo and getLikelihood for each event in turn.
+
+		    \param [in] iStart the index of the first event
+		    \param [in] nEvts the number of events
+		    \param [out] likelihoods the normalised likelihood values (must have space for nEvts values)
+		*/
+		virtual void calcLikelihoods(UInt_t iStart, UInt_t nEvts, Double_t* likelihoods);
+
+		//! Specifies whether or not the PDF provides a batch kernel
+		/*!
+		    1D PDFs that override calcUnNormPDFValues with a vectorisable kernel should also override this method.
+		    \return true if the PDF provides a batch kernel, false otherwise (the default)
+		*/
+		virtual Bool_t hasBatchKernel() const {return kFALSE;}
+
 		//! Retrieve the unnormalised likelihood value
 		/*!
 		    \return the unnormalised likelihood value
@@ -240,6 +258,37 @@ class LauAbsPdf {
 		*/
 		virtual LauFitData generate(const LauKinematics* kinematics);
 
+		//! Set whether the generation should use a tabulated envelope
+		/*!
+		    Rather than accept-reject against a flat envelope at the maximum height of the PDF,
+		    the abscissa is drawn (in constant time, using the alias method) from a fine piecewise-constant
+		    envelope that is tabulated once per set of parameter values, followed by an accept-reject
+		    step against that envelope, such that the generated distribution remains exact.
+		    This greatly improves the generation efficiency for sharply peaked PDFs.
+		    For PDFs that depend on the DP a separate table is made for each cell of a grid in the DP.
+
+		    \param [in] useTable whether or not to use the tabulated envelope
+		    \param [in] nBins the number of bins in the envelope
+		    \param [in] nDPCells the number of cells along each DP axis (only used for DP-dependent PDFs)
+		*/
+		virtual void useGenTable(Bool_t useTable, UInt_t nBins = 1000, UInt_t nDPCells = 10);
+
+		//! Retrieve whether the generation uses a tabulated envelope
+		/*!
+		    \return true if the generation uses a tabulated envelope
+		*/
+		virtual Bool_t useGenTable() const {return useGenTable_;}
+
+		//! Check whether the tabulated envelope has held since the last check
+		/*!
+		    If a value of the PDF has been found above the envelope, the envelope has
+		    been raised in that bin, but the values generated since the last check are
+		    biased and the generation should be restarted.
+
+		    \return true if the envelope has held, false if it has been exceeded
+		*/
+		virtual Bool_t checkGenTable();
+
 		//! Set the random function used for toy MC generation
 		/*!
 		    \param [in] randomFun the random function to be used
@@ -265,6 +314,14 @@ class LauAbsPdf {
 		*/
 		virtual void calcNorm();
 
+		//! Update the normalisation factor of the PDF if necessary
+		/*!
+		    Calls calcNorm only if the values of the parameters, or the abscissa range or integration settings,
+		    have changed since the normalisation was last calculated via this method.
+		    This is what should be called when evaluating the PDF for each event in a fit.
+		*/
+		virtual void updateNorm();
+
 		//! Calculate the maximum height of the PDF
 		/*!
 		    \param [in] kinematics used by some PDFs to determine the DP position, on which they have dependence
@@ -299,7 +356,7 @@ class LauAbsPdf {
 		/*!
 		    \param [in] nPoints the number of points
 		*/
-		virtual void nNormPoints(Int_t nPoints) {nNormPoints_ = nPoints;}
+		virtual void nNormPoints(Int_t nPoints) {nNormPoints_ = nPoints; normUpToDate_ = kFALSE;}
 
 		//! Retrieve the integration method used to normalise the PDF
 		/*!
@@ -311,7 +368,7 @@ class LauAbsPdf {
 		/*!
 		    \param [in] method the integration method to be used
 		*/
-		virtual void integMethod(IntMethod method) {integMethod_ = method;}
+		virtual void integMethod(IntMethod method) {integMethod_ = method; normUpToDate_ = kFALSE;}
 
 	protected:
 		//! Set whether the PDF is to be cached
@@ -412,6 +469,25 @@ class LauAbsPdf {
 		*/
 		virtual const std::vector<LauAbscissas>& getAbscissas() const {return abscissas_;}
 
+		//! Calculate the unnormalised likelihoods for many values of the abscissa
+		/*!
+		    Used by calcLikelihoods for 1D PDFs that are not DP dependent and that provide a batch kernel.
+		    Such PDFs should override this with a loop that the compiler can vectorise.
+		    The default implementation calls calcLikelihoodInfo for each value in turn.
+		    N.B. the abscissa values are assumed to have already been range checked.
+
+		    \param [in] nValues the number of values
+		    \param [in] abscissas the values of the abscissa
+		    \param [out] values the unnormalised likelihood values
+		*/
+		virtual void calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values);
+
+		//! Retrieve the cached values of the (primary) abscissa
+		/*!
+		    \return the cached values of the (primary) abscissa for every event
+		*/
+		virtual const std::vector<Double_t>& getAbscissaColumn() const {return abscissaColumn_;}
+
 		//! Retrieve the cached unnormalised likelihood values
 		/*!
 		    \return the cached unnormalised likelihood values
@@ -469,6 +545,42 @@ class LauAbsPdf {
 		//! Calculate the weights and abscissas used for normalisation
 		virtual void getNormWeights();
 
+		/*!
+		  \struct GenTable
+		  \brief Data structure to store the tabulated envelope used for generation
+		*/
+		struct GenTable {
+			//! The envelope height in each bin
+			std::vector<Double_t> heights_;
+			//! The alias method probability for each bin
+			std::vector<Double_t> prob_;
+			//! The alias method alias for each bin
+			std::vector<UInt_t> alias_;
+		};
+
+		//! Tabulate the envelope used for generation
+		/*!
+		    \param [in] kinematics the current DP kinematics (only used for DP-dependent PDFs)
+		    \param [in] iCell the index of the DP cell (only used for DP-dependent PDFs)
+		    \param [out] table the table to be filled
+		    \return true if the table is usable, false otherwise
+		*/
+		virtual Bool_t buildGenTable(const LauKinematics* kinematics, UInt_t iCell, GenTable& table);
+
+		//! Construct the alias method tables from the envelope heights
+		/*!
+		    \param [in,out] table the table to be filled
+		*/
+		void buildGenTableAlias(GenTable& table) const;
+
+		//! Generate an abscissa value using the tabulated envelope
+		/*!
+		    \param [in] kinematics the current DP kinematics (only used for DP-dependent PDFs)
+		    \param [in,out] genAbscissa the generated abscissa (and DP co-ordinates)
+		    \return true if a value has been generated, false if the table cannot be used
+		*/
+		virtual Bool_t generateFromTable(const LauKinematics* kinematics, LauAbscissas& genAbscissa);
+
 		//! Retrieve the abscissa points used for normalisation
 		/*!
 		    \return the abscissa points used for normalisation
@@ -515,6 +627,9 @@ class LauAbsPdf {
 		//! Cached values of the abscissas
 		std::vector<LauAbscissas> abscissas_;
 
+		//! Cached values of the (primary) abscissa, stored contiguously for the batch kernels
+		std::vector<Double_t> abscissaColumn_;
+
 		//! Cached unnormalised likelihood values
 		std::vector<Double_t> unNormPDFValues_;
 
@@ -539,6 +654,33 @@ class LauAbsPdf {
 		
 		//! Whether the normalisation weights have been calculated
 		Bool_t normWeightsDone_;
+
+		//! The previous estimate of the integral from the trapezoid rule, which is refined by each call
+		Double_t trapezoidNorm_;
+
+		//! Whether the normalisation is up to date with respect to the values in normParValues_
+		Bool_t normUpToDate_;
+
+		//! The parameter values used when the normalisation was last updated
+		std::vector<Double_t> normParValues_;
+
+		//! Whether to generate using a tabulated envelope
+		Bool_t useGenTable_;
+
+		//! The number of bins in the generation envelope
+		UInt_t genTableBins_;
+
+		//! The number of cells along each DP axis for the generation envelope
+		UInt_t genTableDPCells_;
+
+		//! The generation envelopes for each DP cell
+		std::map<UInt_t,GenTable> genTables_;
+
+		//! The parameter values (and range) used when the generation envelopes were made
+		std::vector<Double_t> genTableParValues_;
+
+		//! Whether a value of the PDF has been found above the generation envelope since the last check
+		Bool_t genTableExceeded_;
 		
 		//! The normalisation abscissas
 		std::vector<LauAbscissas> normAbscissas_;
@@ -270,6 +270,18 @@ class LauAbsResonance {
 		*/
 		void ignoreBarrierScaling(const Bool_t boolean) {ignoreBarrierScaling_ = boolean;}
 
+		//! Get the spin term used in the most recent amplitude calculation
+		/*!
+			\return the spin term (unity if the spin term is ignored)
+		*/
+		Double_t getSpinTerm() const {return spinTerm_;}
+
+		//! Get the barrier factor scaling applied to the numerator in the most recent amplitude calculation
+		/*!
+			\return the product of the barrier factors (unity if the scaling is ignored), or zero if the lineshape does not report it
+		*/
+		Double_t getBarrierScaling() const {return barrierScaling_;}
+
 		//! Allow the mass, width and spin of the resonance to be changed
 		/*!
 			Negative values wil be ignored, so if, for example, you
@@ -404,6 +416,12 @@ class LauAbsResonance {
 		//! Get the current value of the full spin-dependent covariant factor
 		Double_t getCovFactor() const {return covFactor_;}
 
+		//! Record the barrier factor scaling applied to the numerator of the amplitude
+		/*!
+			\param [in] scaling the product of the barrier factors (unity if the scaling is ignored)
+		*/
+		void setBarrierScaling(const Double_t scaling) {barrierScaling_ = scaling;}
+
 		//! Get the centrifugal barrier for the parent decay
 		LauBlattWeisskopfFactor* getParBWFactor() {return parBWFactor_;}
 		//! Get the centrifugal barrier for the parent decay
@@ -574,6 +592,12 @@ class LauAbsResonance {
 		//! Covariant factor (full spin-dependent expression)
 		Double_t covFactor_{1.0};
 
+		//! The spin term of the most recent amplitude calculation
+		Double_t spinTerm_{1.0};
+
+		//! The barrier factor scaling of the most recent amplitude calculation
+		Double_t barrierScaling_{0.0};
+
 		ClassDef(LauAbsResonance,0) // Abstract resonance class
 
 };
@@ -224,6 +224,20 @@ class LauCPFitModel : public LauAbsFitModel {
 		*/
 		virtual void setAmpCoeffSet(LauAbsCoeffSet* coeffSet);
 
+		//! Add a variant of the signal DP models for which weights are also calculated when weighting events
+		/*!
+			The weights are stored in the branch dpModelWeight_<name>, alongside those of the nominal models, in the same pass over the input.
+			The models are initialised here with the given coefficients.
+			To be weighted in parallel with the nominal models (see LauAbsFitModel::setWeightingThreads) they should be built with their own LauDaughters objects.
+
+			\param [in] name the name of the variant
+			\param [in] negModel the DP model of the variant for the negative charge
+			\param [in] posModel the DP model of the variant for the positive charge
+			\param [in] negCoeffs the amplitude coefficients of the variant for the negative charge, in the order in which the resonances are stored in the model
+			\param [in] posCoeffs the amplitude coefficients of the variant for the positive charge, in the order in which the resonances are stored in the model
+		*/
+		void addWeightVariant(const TString& name, LauIsobarDynamics* negModel, LauIsobarDynamics* posModel, const std::vector<LauComplex>& negCoeffs, const std::vector<LauComplex>& posCoeffs);
+
                 //! Calculate the DP amplitude(s) for a given DP position
                 /*!
                     If not already done, this function will initialise the DP models
@@ -242,6 +256,24 @@ class LauCPFitModel : public LauAbsFitModel {
                 */
                 virtual std::map<TString, Double_t> getDPLikelihoods( const Double_t m13Sq, const Double_t m23Sq );
 
+		//! Calculate the DP amplitude(s) for many DP positions
+		/*!
+			See LauAbsFitModel::getDPAmps
+			\param [in] m13Sq the invariant mass squared of children 1 and 3 for each point
+			\param [in] m23Sq the invariant mass squared of children 2 and 3 for each point
+			\return a container of the complex amplitudes at each point, labelled to indicate to which component they belong
+		*/
+		virtual std::map< TString, std::vector<LauComplex> > getDPAmps( const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq );
+
+		//! Calculate the DP likelihood(s) for many DP positions
+		/*!
+			See LauAbsFitModel::getDPLikelihoods
+			\param [in] m13Sq the invariant mass squared of children 1 and 3 for each point
+			\param [in] m23Sq the invariant mass squared of children 2 and 3 for each point
+			\return a container of the likelihood values at each point, labelled to indicate to which component they belong
+		*/
+		virtual std::map< TString, std::vector<Double_t> > getDPLikelihoods( const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq );
+
 	protected:
 		//! Define a map to be used to store a category name and numbers
 		typedef std::map< std::pair<TString,Int_t>, std::pair<Int_t,Double_t> > LauGenInfo;
@@ -290,6 +322,12 @@ class LauCPFitModel : public LauAbsFitModel {
 		//! Read in the input fit data variables, e.g. m13Sq and m23Sq
 		virtual void cacheInputFitVars();
 
+		//! The signal Dalitz plot models whose integration grids are saved with the checkpoint
+		/*!
+			\return the models
+		*/
+		virtual std::vector<LauIsobarDynamics*> checkpointDPModels() const {return { negSigModel_, posSigModel_ };}
+
 		//! Check the initial fit parameters
 		virtual void checkInitFitParams();
 
@@ -418,8 +456,9 @@ class LauCPFitModel : public LauAbsFitModel {
 		/*!
 			\param [in] extraPdfs the list of extra PDFs
 			\param [in] embeddedData the embedded data sample
+			\return success/failure of the generation
 		*/
-		void generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData);
+		Bool_t generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData);
 
 		//! Store the MC truth info on the TM/SCF nature of the embedded signal event
 		/*!
@@ -725,6 +764,41 @@ class LauCPFitModel : public LauAbsFitModel {
 		//! Total background likelihood(s)
 		std::vector<Double_t> bkgndTotalLike_;
 
+		// Handles to the generated ntuple branches that are set for every event
+
+		//! Handle to the branch for the event number within the experiment
+		LauGenNtuple::IntegerBranchHandle genEvtNumHandle_;
+
+		//! Handle to the branch for the event weight
+		LauGenNtuple::DoubleBranchHandle genEvtWeightHandle_;
+
+		//! Handle to the branch for the efficiency
+		LauGenNtuple::DoubleBranchHandle genEffHandle_;
+
+		//! Handle to the branch flagging signal events
+		LauGenNtuple::IntegerBranchHandle genSigHandle_;
+
+		//! Handle to the branch flagging truth-matched signal events (null if not stored)
+		LauGenNtuple::IntegerBranchHandle genTMSigHandle_;
+
+		//! Handle to the branch flagging self cross feed signal events (null if not stored)
+		LauGenNtuple::IntegerBranchHandle genSCFSigHandle_;
+
+		//! Handles to the branches flagging each background class
+		std::vector<LauGenNtuple::IntegerBranchHandle> genBkgndHandles_;
+
+		//! Handles to the DP branches, in the order m12, m23, m13, m12Sq, m23Sq, m13Sq, cosHel12, cosHel23, cosHel13, mPrime, thPrime
+		std::vector<LauGenNtuple::DoubleBranchHandle> genDPHandles_;
+
+		//! The names of the DP model variants to be weighted
+		std::vector<TString> weightVariantNames_;
+
+		//! The DP model variants to be weighted for the negative charge
+		std::vector<LauIsobarDynamics*> weightVariantNegModels_;
+
+		//! The DP model variants to be weighted for the positive charge
+		std::vector<LauIsobarDynamics*> weightVariantPosModels_;
+
 		ClassDef(LauCPFitModel,0) //  CP fit/ToyMC model
 
 };
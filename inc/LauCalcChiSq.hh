@@ -27,6 +27,8 @@ Thomas Latham
 
 #include <vector>
 
+class TTree;
+
 /*! \file LauCalcChiSq.hh
     \brief File containing declaration of LauCalcChiSq class.
 */
@@ -45,6 +47,10 @@ Thomas Latham
         \<name of file containing data histogram\> \<name of data tree\> \<name of the x axis variable in data\> \<name of the y axis variable in data\><br>
         \<name of file containing toy MC histogram\> \<name of toy MC tree\> \<name of the x axis variable in toy MC\> \<name of the y axis variable in toy MC\><br>
         \<the minimum content for any bin\> \<the number of free parameter in the fit\> \<the scalefactor by which the toy MC bin content should be multiplied\> \<minimum x value\> \<maximum x value\> \<minimum y value\> \<maximum y value\>
+
+    The binning scheme derived from the data can be written to a text file and
+    read back in subsequent runs, so that many toy samples can be compared
+    using identical bins.
 */
 
 class LauCalcChiSq {
@@ -66,6 +72,24 @@ class LauCalcChiSq {
 		*/
 		inline void setVerbose(const Bool_t flag) {verbose_ = flag;}
 
+		//! Set the number of threads used to build the binning and to fill the histograms
+		/*!
+		  \param [in] nThreads the number of threads (the default is the number of hardware threads available)
+		*/
+		inline void setNThreads(const UInt_t nThreads) {nThreads_ = nThreads;}
+
+		//! Read the binning scheme from a file rather than deriving it from the data
+		/*!
+		  \param [in] fileName name of the file written by a previous run (see LauCalcChiSq::setOutputBinning)
+		*/
+		inline void setInputBinning(const TString& fileName) {inputBinningFileName_ = fileName;}
+
+		//! Write the binning scheme to a file so that it can be reused
+		/*!
+		  \param [in] fileName name of the file to be written
+		*/
+		inline void setOutputBinning(const TString& fileName) {outputBinningFileName_ = fileName;}
+
 		//! Run the calculations
 		void run();
 
@@ -73,30 +97,65 @@ class LauCalcChiSq {
 		//! Read the config file, read the data and create histograms
 		void initialiseHistos();
 
+		//! Read the coordinates of all entries in a tree
+		/*!
+		  \param [in] tree the tree
+		  \param [in] xName the name of the x-coordinate leaf
+		  \param [in] yName the name of the y-coordinate leaf
+		  \param [out] xs x coordinates of the entries
+		  \param [out] ys y coordinates of the entries
+		*/
+		void readCoordinates(TTree* tree, const TString& xName, const TString& yName, std::vector<Double_t>& xs, std::vector<Double_t>& ys) const;
+
 		//! Choose the binning scheme
 		/*!
-		  \param [in] xs x coordinates of low statistics sample
-		  \param [in] ys y coordinates of low statistics sample
-		  \param [in] nEntries number of entries in low statistics sample
+		  \param [in] nIn number of entries of low statistics sample within the histogram limits
 		  \param [out] divisions resulting binning scheme
 		*/
-		void pickBinning(const Double_t* xs, const Double_t* ys, const Int_t nEntries, std::vector<Int_t>& divisions);
+		void pickBinning(const Int_t nIn, std::vector<Int_t>& divisions) const;
 
-		//! Create the template histogram based on the binning scheme
+		//! Choose the binning scheme and build the bin boundaries
 		/*!
-		  This function is called recursively to perform subdivisions
+		  The region is successively subdivided, each level splitting every bin
+		  into equally populated slices in x and then each slice into equally
+		  populated bins in y, by partitioning the entries in place around the
+		  required quantiles.  The bins of each level are treated concurrently.
 
-		  \param [in] xMin the minimum x coordinate of the region to be (sub)divided
-		  \param [in] xMax the maximum x coordinate of the region to be (sub)divided
-		  \param [in] yMin the minimum y coordinate of the region to be (sub)divided
-		  \param [in] yMax the maximum y coordinate of the region to be (sub)divided
 		  \param [in] xs x coordinates of low statistics sample
 		  \param [in] ys y coordinates of low statistics sample
-		  \param [in] nEntries number of entries in low statistics sample
-		  \param [in] divisions the binning scheme
-		  \param [in] iter indicates depth of the subdivisions
 		*/
-		void getHisto(const Double_t xMin, const Double_t xMax, const Double_t yMin, const Double_t yMax, const Double_t* xs, const Double_t* ys, const Int_t nEntries, const std::vector<Int_t>& divisions, const UInt_t iter=0);
+		void buildBinning(const std::vector<Double_t>& xs, const std::vector<Double_t>& ys);
+
+		//! Create the template histogram from the bin boundaries
+		void createHisto();
+
+		//! Find the bin containing a given point
+		/*!
+		  \param [in] x the x coordinate
+		  \param [in] y the y coordinate
+		  \return the index of the bin (starting from 0), or -1 if the point is outside the histogram limits
+		*/
+		Int_t findBin(const Double_t x, const Double_t y) const;
+
+		//! Count the number of entries in each bin
+		/*!
+		  \param [in] xs x coordinates of the entries
+		  \param [in] ys y coordinates of the entries
+		  \param [out] counts the number of entries in each bin
+		*/
+		void countEntries(const std::vector<Double_t>& xs, const std::vector<Double_t>& ys, std::vector<Double_t>& counts) const;
+
+		//! Write the binning scheme to a text file
+		/*!
+		  \param [in] fileName the name of the file
+		*/
+		void writeBinning(const TString& fileName) const;
+
+		//! Read the binning scheme from a text file
+		/*!
+		  \param [in] fileName the name of the file
+		*/
+		void readBinning(const TString& fileName);
 
 		//! Calculate the chisq from the data histograms
 		void calculateChiSq();
@@ -156,6 +215,21 @@ class LauCalcChiSq {
 		//! Scalefactor between low and high stats data samples
 		Float_t scaleFactor_;
 
+		//! The number of subdivisions in x and in y at each level of the binning
+		std::vector<Int_t> divisions_;
+		//! The x boundaries of the slices at each level (number of bins in the level x (divisions + 1))
+		std::vector< std::vector<Double_t> > xLimits_;
+		//! The y boundaries of the bins at each level (number of bins in the level x divisions x (divisions + 1))
+		std::vector< std::vector<Double_t> > yLimits_;
+
+		//! Name of the file from which to read the binning scheme
+		TString inputBinningFileName_;
+		//! Name of the file to which to write the binning scheme
+		TString outputBinningFileName_;
+
+		//! Number of threads to use
+		UInt_t nThreads_;
+
 		//! Verbose flag
 		Bool_t verbose_;
 
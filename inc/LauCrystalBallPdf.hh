@@ -93,7 +93,20 @@ class LauCrystalBallPdf : public LauAbsPdf {
 		*/
 		virtual void calcPDFHeight( const LauKinematics* kinematics );
 
+		//! Specifies that the PDF provides a batch kernel
+		/*!
+		    \return true
+		*/
+		virtual Bool_t hasBatchKernel() const {return kTRUE;}
+
 	protected:
+		//! Calculate the unnormalised likelihoods for many values of the abscissa
+		/*!
+		    \param [in] nValues the number of values
+		    \param [in] abscissas the values of the abscissa
+		    \param [out] values the unnormalised likelihood values
+		*/
+		virtual void calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values);
 
 		//! Calculate the approximate error function of argument
 		/*!
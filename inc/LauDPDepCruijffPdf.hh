@@ -180,6 +180,9 @@ class LauDPDepCruijffPdf : public LauAbsPdf {
 		//! The DP axis we depend on
 		DPAxis dpAxis_;
 
+		//! The previous estimate of the integral from the trapezoid rule, which is refined by each call
+		Double_t trapezoidNorm_;
+
 		ClassDef(LauDPDepCruijffPdf,0) // Define the Cruijff PDF
 };
 
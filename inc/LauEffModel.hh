@@ -46,6 +46,8 @@ class LauDaughters;
 class LauKinematics;
 class LauVetoes;
 class Lau2DAbsDP;
+class Lau2DHistDP;
+class Lau2DSplineDP;
 
 
 class LauEffModel : public LauAbsEffModel {
@@ -239,6 +241,22 @@ class LauEffModel : public LauAbsEffModel {
 		//! Copy assignment operator - not implemented
 		LauEffModel& operator=( const LauEffModel& rhs );
 
+		//! Add a histogram component to the efficiency model
+		/*!
+		    If the histogram has the same binning and interpolation setting as an existing component
+		    then it is combined with that component rather than being added separately.
+		    \param [in] histo the histogram component (ownership is taken)
+		*/
+		void addHistComponent(Lau2DHistDP* histo);
+
+		//! Add a spline component to the efficiency model
+		/*!
+		    If the spline has the same knots and co-ordinates as an existing spline component
+		    then it is evaluated together with that component rather than being added separately.
+		    \param [in] spline the spline component (ownership is taken)
+		*/
+		void addSplineComponent(Lau2DSplineDP* spline);
+
 		//! Get the efficiency from a two-dimensional histogram
 		/*!
 		    \param [in] kinematics the object that defines the DP position
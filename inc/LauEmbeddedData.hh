@@ -35,7 +35,7 @@ Thomas Latham
 #ifndef LAU_EMBEDDED_DATA
 #define LAU_EMBEDDED_DATA
 
-#include <set>
+#include <map>
 #include <vector>
 
 #include "LauFitDataTree.hh"
@@ -80,7 +80,7 @@ class LauEmbeddedData {
 		/*!
 		   \return the number of used events
 		*/
-		UInt_t nUsedEvents() const {return usedEvents_.size();}
+		UInt_t nUsedEvents() const {return nUsedEvents_;}
 
 		//! Boolean to determine whether branch exists
 		/*!
@@ -96,7 +96,12 @@ class LauEmbeddedData {
 
 		//! Retrieve an event from the data sample, applying an accept/reject based on the given DP model
 		/*!
+		   The intensity of the model at the true DP co-ordinates of every event is calculated once and cached until the model changes.
+		   When events can be reused they are then sampled directly according to these intensities,
+		   otherwise unused events are visited in random order and accepted according to the ratio of their intensity to the largest in the sample.
+
 		   \param [in] dynamics the amplitude model
+		   \return success/failure flag
 		*/
   	        Bool_t getReweightedEvent(LauIsobarDynamics* dynamics);
 
@@ -115,7 +120,7 @@ class LauEmbeddedData {
 		LauFitData getValues(const std::vector<TString>& names) const;
 
 		//! Clear the list of used events
-		void clearUsedList() {usedEvents_.clear();}
+		void clearUsedList() {nUsedEvents_ = 0;}
 
 	protected:
 		//! Boolean determining whether events should be reused 
@@ -125,6 +130,39 @@ class LauEmbeddedData {
 		Bool_t reuseEvents() const {return reuseEvents_;}
 
 	private:
+		//! The cached intensities of the events for a given amplitude model
+		struct ReweightCache {
+			//! The version of the model for which the intensities were calculated
+			ULong64_t modelVersion_;
+			//! The largest intensity
+			Double_t maxWeight_;
+			//! The intensity of each event (zero for events outside the DP)
+			std::vector<Double_t> weights_;
+			//! The probabilities of the alias table used to sample with reuse
+			std::vector<Double_t> aliasProbs_;
+			//! The aliases of the alias table used to sample with reuse
+			std::vector<UInt_t> aliases_;
+		};
+
+		//! Select an event that has not yet been used
+		/*!
+		   \return the index of the event
+		*/
+		UInt_t drawUnusedEvent();
+
+		//! Retrieve the cached intensities for the given model, calculating them if the model has changed
+		/*!
+		   \param [in] dynamics the amplitude model
+		   \return the cached intensities
+		*/
+		const ReweightCache& getReweightCache(LauIsobarDynamics* dynamics);
+
+		//! Build the alias table for sampling the events according to their intensities
+		/*!
+		   \param [in,out] cache the cached intensities
+		*/
+		void buildAliasTable(ReweightCache& cache) const;
+
 		//! Copy constructor (not implemented)
 		LauEmbeddedData(const LauEmbeddedData& rhs);
 
@@ -137,8 +175,12 @@ class LauEmbeddedData {
 		LauFitData theData_;
 		//! Flag whether events can be reused
 		Bool_t reuseEvents_;
-		//! Used events
-		std::set<UInt_t> usedEvents_;
+		//! The event indices, of which the first nUsedEvents_ have been used
+		std::vector<UInt_t> eventOrder_;
+		//! The number of used events
+		UInt_t nUsedEvents_;
+		//! The cached intensities for each amplitude model
+		std::map<const LauIsobarDynamics*, ReweightCache> reweightCaches_;
 
 		ClassDef(LauEmbeddedData, 0) // a non-persistent bare-bones complex class
 };
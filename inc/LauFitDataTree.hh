@@ -30,6 +30,11 @@ Thomas Latham
     \brief Class to store the input fit variables.
 
     Events are loaded from a tree and fake events may be added manually.
+
+    Alternatively, the events can be exported (once) to a flat binary file,
+    see writeFlatFile, which can then be given to the constructor in place of
+    the ROOT file.  Such a file is memory-mapped rather than read, so no
+    per-event copying or validation is needed when loading each experiment.
 */
 
 #ifndef LAU_FIT_DATA_TREE
@@ -82,6 +87,32 @@ class LauFitDataTree {
 		//! Read all events from the tree
 		void readAllData();
 
+		//! Write all events from the tree to a flat binary file that can be memory-mapped
+		/*!
+		    The file contains one 64-byte aligned column of doubles per branch, with the events grouped by experiment.
+		    Every value is checked for NaN/inf when writing, so that it need not be checked again when reading.
+
+		    \param [in] flatFileName the name of the file to be written
+		    \return true if successful, otherwise returns false and prints an error message
+		*/
+		Bool_t writeFlatFile(const TString& flatFileName) const;
+
+		//! Check whether the data are being read from a memory-mapped flat file
+		/*!
+		    \return true if the data come from a flat file, false if they come from a ROOT tree
+		*/
+		Bool_t isFlatFile() const {return flatBuffer_ != 0;}
+
+		//! Retrieve the values of the named variable for all events in the current experiment
+		/*!
+		    Only available when reading from a flat file, in which case the values are read directly from the mapped memory.
+		    Any fake events are not included, they must be retrieved with getData.
+
+		    \param [in] name the name of the variable
+		    \return pointer to the first value, or a null pointer if the variable is not found or the data do not come from a flat file
+		*/
+		const Double_t* getColumn(const TString& name) const;
+
 		//! Read events only for the given experiment
 		/*!
 		    \param [in] iExpt the experiment to read
@@ -107,13 +138,13 @@ class LauFitDataTree {
 		/*!
 		    \return the number of events in the tree
 		*/
-		UInt_t nTreeEvents() const {return rootTree_ ? static_cast<UInt_t>(rootTree_->GetEntries()) : 0;}
+		UInt_t nTreeEvents() const;
 
 		//! Retrieve the number of events
 		/*!
 		    \return the number of events in the current experiment if one is selected, otherwise the total number of events in the tree
 		*/
-		UInt_t nEvents() const {return eventList_ ? static_cast<UInt_t>(eventList_->GetN()) : this->nTreeEvents();}
+		UInt_t nEvents() const;
 
 		//! Retrieve the number of fake events
 		/*!
@@ -169,6 +200,22 @@ class LauFitDataTree {
 		*/
 		void loadData();
 
+		//! Check whether the named file is a flat file written by writeFlatFile
+		/*!
+		    \param [in] fileName the name of the file
+		    \return true if the file starts with the flat file identifier
+		*/
+		static Bool_t checkFlatFile(const TString& fileName);
+
+		//! Memory-map the flat file and set up the column pointers
+		void openFlatFile();
+
+		//! Find all of the columns in the flat file
+		/*!
+		    \returns true if sucessful, otherwise returns false and prints an error message
+		*/
+		Bool_t findFlatColumns();
+
 	private:
 		//! Copy constructor (not implemented)
 		LauFitDataTree(const LauFitDataTree& rhs);
@@ -218,6 +265,27 @@ class LauFitDataTree {
 		//! The fake events, which are not from the tree
 		std::vector<LauEventData> fakeEvents_;
 
+		//! The start of the memory-mapped flat file (if in use)
+		const char* flatBuffer_;
+
+		//! The size of the memory-mapped flat file
+		ULong64_t flatBufferSize_;
+
+		//! The total number of events in the flat file
+		UInt_t flatNEvents_;
+
+		//! The columns of the flat file, in the same order as the leaves
+		std::vector<const Double_t*> flatColumns_;
+
+		//! The first event and number of events of each experiment in the flat file
+		std::map<UInt_t, std::pair<UInt_t,UInt_t>> flatExpts_;
+
+		//! The index in the flat file of the first event of the current experiment
+		UInt_t flatFirstEvt_;
+
+		//! The number of events in the current experiment of the flat file
+		UInt_t flatNEvts_;
+
 		ClassDef(LauFitDataTree, 0)
 };
 
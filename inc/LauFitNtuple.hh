@@ -62,8 +62,9 @@ class LauFitNtuple {
 		/*!
 		    \param [in] fileName the name for the ntuple
 		    \param [in] storeAsymErrors whether or not to store the asymmetric error variables
+		    \param [in] append whether to add to the results already stored in the file (e.g. when resuming from a checkpoint) rather than overwriting them
 		*/
-		LauFitNtuple(const TString& fileName, Bool_t storeAsymErrors);
+		LauFitNtuple(const TString& fileName, Bool_t storeAsymErrors, Bool_t append = kFALSE);
 		
 		//! Destructor
 		virtual ~LauFitNtuple();
@@ -86,6 +87,18 @@ class LauFitNtuple {
 		//! Update the fit ntuple
 		void updateFitNtuple();
 
+		//! Save the entries stored so far to the file, without closing it
+		void autoSave();
+
+		//! Keep only the stored experiments that pass a selection
+		/*!
+		    This is intended for dropping the results of an interrupted experiment when appending to the ntuple.
+		    It must be called before the first experiment is stored.
+
+		    \param [in] selection the selection the entries to be kept must pass
+		*/
+		void keepEntries(const TString& selection);
+
 		//! Write out fit results
 		void writeOutFitResults();
 
@@ -96,6 +109,14 @@ class LauFitNtuple {
 		//! Copy assignment operator (not implemented)
 		LauFitNtuple& operator=(const LauFitNtuple& rhs);
 
+		//! Create a branch or, if the tree already has it, connect it to the given address
+		/*!
+		    \param [in] name the name of the branch
+		    \param [in] address the address of the variable to be stored
+		    \param [in] leafList the leaf list used when creating the branch
+		*/
+		void defineBranch(const TString& name, void* address, const TString& leafList);
+
 		//! Name of root file
 		TString rootFileName_;
 		//! Root file
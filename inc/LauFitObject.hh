@@ -74,6 +74,32 @@ class LauFitObject : public TObject {
 		//! Report whether the two-stage fit is enabled
 		Bool_t twoStageFit() const {return twoStageFit_;}
 
+		//! Turn on or off the supply of the NLL gradient to the fitter
+		/*!
+			The gradient is determined from central differences, with all
+			the points required being evaluated in a single call to
+			getTotNegLogLikelihoods, rather than the fitter requesting them
+			one at a time.
+
+			\param [in] useBatchGrad boolean specifying whether or not the gradient should be supplied
+		*/
+		void useBatchedGradient(Bool_t useBatchGrad) {useBatchedGradient_ = useBatchGrad;}
+
+		//! Report whether the NLL gradient is supplied to the fitter
+		Bool_t useBatchedGradient() const {return useBatchedGradient_;}
+
+		//! Set the number of processes in which the asymmetric errors are calculated
+		/*!
+			With more than one process, the fit state at the minimum is copied into forked processes,
+			which each calculate the asymmetric errors for a share of the floating parameters.
+
+			\param [in] nProcesses the number of processes
+		*/
+		void minosProcesses(UInt_t nProcesses) {minosProcesses_ = ( nProcesses > 0 ) ? nProcesses : 1;}
+
+		//! Report the number of processes in which the asymmetric errors are calculated
+		UInt_t minosProcesses() const {return minosProcesses_;}
+
 		//! Mark that the fit is calculating asymmetric errors
 		/*!
 			This is called by the fitter interface to mark when
@@ -133,6 +159,21 @@ class LauFitObject : public TObject {
 		*/	
 		virtual Double_t getTotNegLogLikelihood() = 0;
 
+		//! Calculate the negative log likelihood for several sets of parameter values
+		/*!
+			The default implementation simply sets each set of values in turn and calculates the NLL.
+			Derived classes can override this to evaluate the points more efficiently.
+
+			This function has to be public since it is called from the global FCN.
+			It should not be called otherwise!
+
+			\param [in] nPoints the number of sets of parameter values
+			\param [in] pars the parameter values, with all the parameters of the first set followed by those of the second set, etc.
+			\param [in] npar the number of free parameters
+			\param [out] negLogLikes the NLL values for each set
+		*/
+		virtual void getTotNegLogLikelihoods(const UInt_t nPoints, Double_t* pars, const Int_t npar, Double_t* negLogLikes);
+
 		//! Store constraint information for fit parameters
 		/*!
 			\deprecated Renamed to addFormulaConstraint, please switch to use this.  Will be dropped in next major release.
@@ -328,6 +369,12 @@ class LauFitObject : public TObject {
 		//! Option to use asymmetric errors
 		Bool_t useAsymmFitErrors_; 
 
+		//! Option to supply the NLL gradient to the fitter
+		Bool_t useBatchedGradient_;
+
+		//! The number of processes in which the asymmetric errors are calculated
+		UInt_t minosProcesses_;
+
 		//! The number of fit parameters
 		UInt_t nParams_; 
 
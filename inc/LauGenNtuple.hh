@@ -30,12 +30,27 @@ Thomas Latham
     \brief Class to store the results from the toy MC generation into an ntuple
 
     Class to store the results from the toy MC generation into an ntuple
+
+    Branches can be set either by name or, more efficiently, through a handle
+    obtained once after the branch has been added.
+    The filling of the tree can optionally be done by a background thread,
+    which takes the completed rows from a bounded queue, such that the
+    compression and writing of the tree overlaps with the generation.
+    While that thread is active no other I/O may be done on the file of the
+    ntuple: every method of this class that accesses the tree or the file
+    first waits for the queue to be emptied and the thread to finish, and the
+    current directory is moved off the file when the thread is started so
+    that objects created in the meantime are not attached to it.
 */
 
 #ifndef LAU_GEN_NTUPLE
 #define LAU_GEN_NTUPLE
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "TString.h"
 
@@ -50,12 +65,18 @@ class LauGenNtuple {
 		/*!
 		    \param [in] rootFileName the name for the ntuple
 		    \param [in] rootTreeName the name for the tree in the ntuple
+		    \param [in] append whether to add to the tree already stored in the file (e.g. when resuming from a checkpoint) rather than overwriting it
 		*/
-		LauGenNtuple(const TString& rootFileName, const TString& rootTreeName);
+		LauGenNtuple(const TString& rootFileName, const TString& rootTreeName, const Bool_t append = kFALSE);
 		
 		//! Destructor
 		virtual ~LauGenNtuple();
 
+		//! Type of the handle to an integer branch
+		typedef Int_t* IntegerBranchHandle;
+
+		//! Type of the handle to a double branch
+		typedef Double_t* DoubleBranchHandle;
 
 		//! Ntuple file name
 		/*!
@@ -94,6 +115,38 @@ class LauGenNtuple {
 		    \param [in] value the value to set the branch
 		*/
 		void setDoubleBranchValue(const TString& name, Double_t value);
+
+		//! Get the handle to an integer branch
+		/*!
+		    The handle remains valid for the lifetime of this object.
+
+		    \param [in] name the name of the branch
+		    \return the handle to the branch (null if there is no such branch)
+		*/
+		IntegerBranchHandle integerBranchHandle(const TString& name);
+
+		//! Get the handle to a double branch
+		/*!
+		    The handle remains valid for the lifetime of this object.
+
+		    \param [in] name the name of the branch
+		    \return the handle to the branch (null if there is no such branch)
+		*/
+		DoubleBranchHandle doubleBranchHandle(const TString& name);
+
+		//! Set value of an integer branch
+		/*!
+		    \param [in] handle the handle to the branch
+		    \param [in] value the value to set the branch
+		*/
+		void setIntegerBranchValue(IntegerBranchHandle handle, Int_t value) {*handle = value;}
+
+		//! Set value of a double branch
+		/*!
+		    \param [in] handle the handle to the branch
+		    \param [in] value the value to set the branch
+		*/
+		void setDoubleBranchValue(DoubleBranchHandle handle, Double_t value) {*handle = value;}
 		
 		//! Get value of an integer branch
 		/*!
@@ -111,6 +164,29 @@ class LauGenNtuple {
 		
 		//! Fill branches in the ntuple
 		void fillBranches();
+
+		//! Set whether the tree should be filled by a background thread
+		/*!
+		    The file of the ntuple must not be accessed other than through this class while the background thread is active.
+
+		    \param [in] queueSize the maximum number of rows waiting to be filled (0 to fill the tree directly)
+		*/
+		void asyncFill(UInt_t queueSize);
+
+		//! Wait until all queued rows have been filled into the tree
+		void flush();
+
+		//! Write the entries filled so far to the file, so that they survive the job being killed
+		void autoSave();
+
+		//! Keep only the entries of the tree that pass a selection
+		/*!
+		    This is intended for dropping the entries of an interrupted experiment from a tree that is being appended to.
+		    It must be called before the first row is filled.
+
+		    \param [in] selection the selection the entries to be kept must pass
+		*/
+		void keepEntries(const TString& selection);
 		
 		//! Delete and recreate tree
 		void deleteAndRecreateTree();
@@ -153,6 +229,12 @@ class LauGenNtuple {
 		*/
 		void definedBranches(Bool_t defined) {definedBranches_ = defined;}
 
+		//! Start the background thread filling the tree
+		void startWriter();
+
+		//! The loop run by the background thread filling the tree
+		void writerLoop();
+
 	private:
 		//! Copy constructor (not implemented)
 		LauGenNtuple(const LauGenNtuple& rhs);
@@ -168,6 +250,8 @@ class LauGenNtuple {
 		TFile* rootFile_;
 		//! Root tree
 		TTree* rootTree_;
+		//! Flags whether to add to the tree already stored in the file
+		Bool_t append_;
 
 		//! Flags whether branches are defined
 		Bool_t definedBranches_;
@@ -182,6 +266,38 @@ class LauGenNtuple {
 		//! Double variables
 		DoubleVarMap doubleVars_;
 
+		//! The integer variables, in the order of the row buffers
+		std::vector<const Int_t*> intValues_;
+		//! The double variables, in the order of the row buffers
+		std::vector<const Double_t*> doubleValues_;
+
+		//! The integer values of the row being filled into the tree
+		std::vector<Int_t> intRow_;
+		//! The double values of the row being filled into the tree
+		std::vector<Double_t> doubleRow_;
+
+		//! The maximum number of queued rows (0 means that the tree is filled directly)
+		UInt_t queueSize_;
+		//! The integer values of the queued rows
+		std::vector<Int_t> queuedInts_;
+		//! The double values of the queued rows
+		std::vector<Double_t> queuedDoubles_;
+		//! The position of the first queued row
+		UInt_t queueHead_;
+		//! The number of queued rows
+		UInt_t nQueued_;
+
+		//! The background thread filling the tree
+		std::thread writer_;
+		//! Mutex protecting the queue
+		std::mutex queueMutex_;
+		//! Condition variable signalling that a row has been queued
+		std::condition_variable rowQueued_;
+		//! Condition variable signalling that a row has been taken from the queue
+		std::condition_variable rowTaken_;
+		//! Flag to instruct the background thread to stop once the queue is empty
+		Bool_t stopWriter_;
+
 		ClassDef(LauGenNtuple,0) // Generated toyMC ntuple
 
 };
@@ -33,7 +33,10 @@ Thomas Latham
 #ifndef LAU_ISOBAR_DYNAMICS
 #define LAU_ISOBAR_DYNAMICS
 
+#include <deque>
+#include <map>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "TString.h"
@@ -49,6 +52,8 @@ class LauFitDataTree;
 class LauKMatrixPropagator;
 class LauDPPartialIntegralInfo;
 class LauKinematics;
+class TH2;
+class TRandom;
 
 class LauIsobarDynamics {
 
@@ -97,6 +102,29 @@ class LauIsobarDynamics {
 		*/
 		inline void setIntFileName(const TString& fileName) {intFileName_ = fileName;}
 
+		//! Write the amplitudes on the integration grid to a file
+		/*!
+		    The file can be read back with readIntegrationGrid, e.g. by a job resuming an interrupted fit,
+		    so that the amplitudes need not be evaluated again.
+		    It is written in the binary format of the machine and is only meant to be read back there.
+
+		    \param [in] fileName the name of the file
+		    \return whether the file was written successfully
+		*/
+		Bool_t writeIntegrationGrid(const TString& fileName) const;
+
+		//! Read the amplitudes on the integration grid from a file written by writeIntegrationGrid
+		/*!
+		    When the amplitudes on the grid are next to be (re)calculated, those of the components whose
+		    floating parameters have the values they had when the file was written are taken from the file
+		    instead (each of them only once).
+		    The file is checked against the model and the integration scheme at that point.
+
+		    \param [in] fileName the name of the file
+		    \return whether the file was read successfully
+		*/
+		Bool_t readIntegrationGrid(const TString& fileName);
+
 		// Integration
 		//! Set the widths of the bins to use when integrating across the Dalitz plot or square Dalitz plot
 		/*!
@@ -226,6 +254,61 @@ class LauIsobarDynamics {
 		*/
 		inline Double_t getASqMaxVarValue() const { return aSqMaxVar_; }
 
+		//! Retrieve a counter that changes whenever the amplitude coefficients or the normalisation change
+		/*!
+		    Allows quantities derived from the model, such as the event weights, to be cached until the model next changes.
+
+		    \return the current version of the model
+		*/
+		inline ULong64_t getModelVersion() const { return modelVersion_; }
+
+		//! Generate toy MC events from blocks of candidates
+		/*!
+		    Rather than proposing and testing one candidate per call to LauIsobarDynamics::generate, blocks of candidates are proposed at once,
+		    tested in bulk and the accepted events are queued to be returned by subsequent calls.
+		    The candidates are drawn from independent random number streams, each seeded from the global generator, which are shared out between the threads.
+		    |A|^2 is then calculated for the candidates by this model and its evaluation workers (see LauIsobarDynamics::addEvaluationWorker).
+		    The generated events therefore do not depend on the number of threads.
+		    The candidates are drawn either flat in phase space or from the envelope (see LauIsobarDynamics::useGenEnvelope),
+		    the resonance-shaped proposal density is not used with this mode.
+
+		    \param [in] blockSize the number of candidates proposed in each block (0 switches off the block generation)
+		    \param [in] nThreads the number of threads used to propose the candidates
+		*/
+		void useBlockGeneration(const UInt_t blockSize, const UInt_t nThreads = 1);
+
+		//! Discard any events that have been queued by the block generation
+		/*!
+		    Called at the start of each experiment, such that each experiment is generated from its own blocks of candidates.
+		*/
+		inline void clearGenQueue() {genQueue_.clear();}
+
+		//! Generate toy MC events using a piecewise-constant envelope of |A|^2 built from the integration grid
+		/*!
+		    The integration grid points in each region are grouped into cells and the envelope in each cell is set from the largest value of |A|^2
+		    (multiplied by the Jacobian of the grid co-ordinates) found at the points in that cell and its neighbours.
+		    Cells are chosen according to their envelope volume and candidates are generated uniformly within them and accepted against the local envelope,
+		    so there is no need to determine the global maximum of |A|^2.
+		    If a candidate is found to exceed the envelope, the envelope is raised and the generation is restarted.
+		    This takes precedence over LauIsobarDynamics::useGenProposal.
+
+		    \param [in] useEnvelope whether or not to generate using the envelope
+		    \param [in] margin the fractional amount by which the envelope is raised above the largest value found in each cell
+		    \param [in] cellPoints the number of integration grid points along each side of a cell
+		*/
+		void useGenEnvelope(const Bool_t useEnvelope, const Double_t margin = 0.2, const UInt_t cellPoints = 4);
+
+		//! Generate toy MC events from a proposal density shaped by the narrow resonances in the model
+		/*!
+		    Candidate events are drawn from a mixture of flat phase space and Breit-Wigner shapes in the invariant masses of the narrow resonances
+		    (see LauIsobarDynamics::setNarrowResonanceThreshold) and are accepted according to the ratio of |A|^2 to the proposal density.
+		    The generated distribution is therefore unchanged but many fewer candidates are rejected for models dominated by narrow states.
+
+		    \param [in] useProposal whether or not to generate from the proposal density
+		    \param [in] flatFraction the fraction of the proposal density that is flat phase space (must be in the range (0,1])
+		*/
+		void useGenProposal(const Bool_t useProposal, const Double_t flatFraction = 0.3);
+
 		//! Generate a toy MC signal event
 		/*!
 		    \return kTRUE if the event is successfully generated, kFALSE otherwise
@@ -287,6 +370,60 @@ class LauIsobarDynamics {
 		*/
 		Double_t getEventWeight();
 
+		//! Add a copy of this model that is used to evaluate points on another thread
+		/*!
+		    Calculations over many points (see LauIsobarDynamics::calcEventWeights and LauIsobarDynamics::calcDPValues) share the points out between this model
+		    and its workers, each of which evaluates its share on its own thread.
+		    The worker must be configured in exactly the same way as this model (the same resonances, added in the same order,
+		    with the same settings and the same efficiency model) but constructed with its own LauDaughters object, such that
+		    it has its own kinematics.
+		    It should not be initialised itself, that is done by this model, and it remains owned by the caller.
+		    Before each calculation the coefficients, normalisation and resonance parameter values of this model are copied to the workers.
+
+		    \param [in] worker the copy of the model
+		*/
+		void addEvaluationWorker(LauIsobarDynamics* worker);
+
+		//! Retrieve the number of threads used to evaluate many points, see LauIsobarDynamics::addEvaluationWorker
+		/*!
+		    \return the number of threads
+		*/
+		inline UInt_t getnEvaluationThreads() const {return evalWorkers_.size() + 1;}
+
+		//! Calculate the weights of many events, as for LauIsobarDynamics::getEventWeight
+		/*!
+		    The events are shared out between this model and its evaluation workers (see LauIsobarDynamics::addEvaluationWorker).
+
+		    \param [in] nEvents the number of events
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters for each event
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters for each event
+		    \param [out] weights the weight of each event (zero for events outside the DP)
+		    \param [out] jacobians the square DP Jacobian of each event (one for events outside the DP), not calculated if null
+		*/
+		void calcEventWeights(const UInt_t nEvents, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* weights, Double_t* jacobians = 0);
+
+		//! Calculate the likelihood and amplitudes at many DP points, as for LauIsobarDynamics::calcLikelihoodInfo
+		/*!
+		    Points that coincide exactly with points of the integration grid (see LauIsobarDynamics::getIntegrationGridPoints)
+		    use the amplitudes stored on the grid rather than recalculating them.
+		    The points are shared out between this model and its evaluation workers (see LauIsobarDynamics::addEvaluationWorker).
+
+		    \param [in] nPoints the number of points
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters for each point
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters for each point
+		    \param [out] likelihoods the normalised likelihood at each point (zero for points outside the DP)
+		    \param [out] totAmps the total amplitude at each point, not calculated if null
+		    \param [out] resAmps the full amplitude of each coherent component at each point (nPoints x nCohAmp, point-major), not calculated if null
+		*/
+		void calcDPValues(const UInt_t nPoints, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* likelihoods, LauComplex* totAmps = 0, LauComplex* resAmps = 0);
+
+		//! Retrieve the points of the integration grid that lie within the DP
+		/*!
+		    \param [out] m13Sq the invariant mass squared of the first and third daughters for each point
+		    \param [out] m23Sq the invariant mass squared of the second and third daughters for each point
+		*/
+		void getIntegrationGridPoints(std::vector<Double_t>& m13Sq, std::vector<Double_t>& m23Sq);
+
 		//! Retrieve the total amplitude for the current event
 		/*!
 		    \return the total amplitude
@@ -388,6 +525,53 @@ class LauIsobarDynamics {
 		*/
 		void fillDataTree(const LauFitDataTree& fitDataTree);
 
+		//! Set the bins used for the binned approximation of the likelihood
+		/*!
+		    The bins are defined in the same way as for LauScfMap, i.e. in m13Sq vs m23Sq, or in mPrime vs thPrime if the kinematics use the square DP.
+		    The model is integrated over each bin using the points of the integration grid that fall within it,
+		    so the bins should be large compared to the spacing of the integration grid.
+		    Must be called after the model has been initialised.
+
+		    \param [in] binning histogram defining the bins
+		*/
+		void setLikelihoodBinning(const TH2* binning);
+
+		//! Check whether the binned approximation of the likelihood has been set up
+		/*!
+		    \return kTRUE if the bins have been set
+		*/
+		inline Bool_t usingBinnedLikelihood() const {return likeBinning_ != 0;}
+
+		//! Fill the bins of the binned approximation of the likelihood with the data
+		/*!
+		    \param [in] fitDataTree the data source
+		*/
+		void fillBinnedData(const LauFitDataTree& fitDataTree);
+
+		//! Retrieve the number of events in the bins of the binned approximation of the likelihood
+		/*!
+		    \return the sum of the bin contents, excluding any events that are not in a bin
+		*/
+		Double_t getBinnedNEvents() const;
+
+		//! Calculate the binned approximation of the DP log-likelihood of the data
+		/*!
+		    Each bin contributes its number of events multiplied by the log of the mean value of the normalised likelihood within it.
+
+		    \param [out] logLike the log-likelihood
+		    \return kFALSE if an occupied bin has a non-positive likelihood, kTRUE otherwise
+		*/
+		Bool_t calcBinnedLogLikelihood(Double_t& logLike) const;
+
+		//! Estimate the loss of log-likelihood due to the binning
+		/*!
+		    For each bin, the expected difference between the log of the likelihood and the log of its mean over the bin is calculated from the integration grid,
+		    and weighted by the number of events in the bin.
+
+		    \return the estimated difference between the unbinned and binned log-likelihoods
+		*/
+		Double_t calcBinningBias();
+
 		//! Recache the amplitude values for those that have changed
 		void modifyDataTree();
 
@@ -646,6 +830,14 @@ class LauIsobarDynamics {
 		//! Write the results of the integrals (and related information) to a file
 		void writeIntegralsFile();
 
+		//! Take the amplitudes to be recalculated from the integration grid read from file, where possible
+		/*!
+		    The components that were taken from the file are removed from integralsToBeCalculated_.
+
+		    \return the components that were taken from the file
+		*/
+		std::set<UInt_t> restoreIntegrationGrid();
+
 		//! Set the dynamic part of the amplitude for a given amplitude component at the current point in the Dalitz plot
 		/*!
 		    \param [in] index the index of the amplitude component
@@ -703,6 +895,163 @@ class LauIsobarDynamics {
 		*/
 		inline void setASqMaxVarValue(Double_t value) {aSqMaxVar_ = value;}
 
+		//! A candidate event proposed in the block generation
+		struct GenCandidate {
+			//! Whether the candidate lies within the Dalitz plot
+			Bool_t valid_;
+			//! The envelope cell from which the candidate was generated
+			UInt_t iCell_;
+			//! The first co-ordinate of the candidate (m13Sq, or m13 or mPrime for the envelope)
+			Double_t x_;
+			//! The second co-ordinate of the candidate (m23Sq, or m23 or thPrime for the envelope)
+			Double_t y_;
+			//! The Jacobian of the co-ordinates of the candidate
+			Double_t jacobian_;
+			//! The random number used to accept or reject the candidate
+			Double_t randNo_;
+			//! The invariant mass squared of the first and third daughters of the candidate
+			Double_t m13Sq_;
+			//! The invariant mass squared of the second and third daughters of the candidate
+			Double_t m23Sq_;
+			//! The value of |A|^2 (including the efficiency) for the candidate
+			Double_t aSq_;
+		};
+
+		//! Propose a block of candidates, test them and queue those that are accepted
+		/*!
+		    \param [in] useEnvelope whether the candidates should be drawn from the envelope rather than flat in phase space
+		*/
+		void fillGenQueue(const Bool_t useEnvelope);
+
+		//! Propose a range of candidates using the given random number generator
+		/*!
+		    \param [in] useEnvelope whether the candidates should be drawn from the envelope rather than flat in phase space
+		    \param [in] rng the random number generator
+		    \param [in] first the first candidate to propose
+		    \param [in] last one past the last candidate to propose
+		*/
+		void proposeGenCandidates(const Bool_t useEnvelope, TRandom& rng, std::vector<GenCandidate>::iterator first, std::vector<GenCandidate>::iterator last) const;
+
+		//! Calculate |A|^2 for a candidate event and accept or reject it
+		/*!
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters
+		    \param [in] jacobian the Jacobian of the envelope co-ordinates (when using the envelope)
+		    \param [in] iCell the envelope cell (when using the envelope)
+		    \param [in] randNo the random number used to accept or reject the candidate
+		    \param [in] useEnvelope whether the candidate was drawn from the envelope
+		    \param [in] useProposal whether the candidate was drawn from the proposal density
+		    \return kTRUE if the candidate is accepted
+		*/
+		Bool_t testGenCandidate(const Double_t m13Sq, const Double_t m23Sq, const Double_t jacobian, const UInt_t iCell, const Double_t randNo, const Bool_t useEnvelope, const Bool_t useProposal);
+
+		//! Accept or reject a candidate event for which |A|^2 has already been calculated
+		/*!
+		    \param [in] aSq the value of |A|^2 (including the efficiency) for the candidate
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters
+		    \param [in] jacobian the Jacobian of the envelope co-ordinates (when using the envelope)
+		    \param [in] iCell the envelope cell (when using the envelope)
+		    \param [in] randNo the random number used to accept or reject the candidate
+		    \param [in] useEnvelope whether the candidate was drawn from the envelope
+		    \param [in] useProposal whether the candidate was drawn from the proposal density
+		    \return kTRUE if the candidate is accepted
+		*/
+		Bool_t acceptGenCandidate(const Double_t aSq, const Double_t m13Sq, const Double_t m23Sq, const Double_t jacobian, const UInt_t iCell, const Double_t randNo, const Bool_t useEnvelope, const Bool_t useProposal);
+
+		//! Calculate the invariant masses squared and |A|^2 for a range of candidates
+		/*!
+		    \param [in,out] model the model used for the calculation (this model or one of its evaluation workers)
+		    \param [in] useEnvelope whether the candidates were drawn from the envelope
+		    \param [in] first the first candidate
+		    \param [in] last one past the last candidate
+		*/
+		void evalGenCandidates(LauIsobarDynamics& model, const Bool_t useEnvelope, std::vector<GenCandidate>::iterator first, std::vector<GenCandidate>::iterator last) const;
+
+		//! Convert a point generated within an envelope cell to the invariant masses squared
+		/*!
+		    \param [in,out] kinematics the kinematics object used for the conversion
+		    \param [in] iCell the envelope cell
+		    \param [in] x the first co-ordinate of the point
+		    \param [in] y the second co-ordinate of the point
+		    \param [out] m13Sq the invariant mass squared of the first and third daughters
+		    \param [out] m23Sq the invariant mass squared of the second and third daughters
+		*/
+		void calcEnvelopeMassSq(LauKinematics* kinematics, const UInt_t iCell, const Double_t x, const Double_t y, Double_t& m13Sq, Double_t& m23Sq) const;
+
+		//! Build the piecewise-constant envelope used to generate toy MC events from the integration grid
+		void initGenEnvelope();
+
+		//! Check whether events are being generated using the piecewise-constant envelope
+		/*!
+		    \return kTRUE if the envelope is in use
+		*/
+		inline Bool_t usingGenEnvelope() const {return useGenEnvelope_ && ! genEnvCells_.empty();}
+
+		//! Generate a point uniformly within a cell of the envelope chosen according to its volume
+		/*!
+		    \param [in] rng the random number generator
+		    \param [out] iCell the index of the chosen cell
+		    \param [out] x the first co-ordinate of the point (m13 or mPrime)
+		    \param [out] y the second co-ordinate of the point (m23 or thPrime)
+		    \param [out] jacobian the Jacobian of the co-ordinates of the cell at the generated point
+		    \return kFALSE if the generated point lies outside the Dalitz plot, kTRUE otherwise
+		*/
+		Bool_t genFromEnvelope(TRandom& rng, UInt_t& iCell, Double_t& x, Double_t& y, Double_t& jacobian) const;
+
+		//! Calculate the cumulative volumes of the envelope cells
+		void calcEnvelopeVolumes();
+
+		//! Check the status of the toy MC generation using the piecewise-constant envelope
+		/*!
+		    \param [in] printErrorMessages whether error messages should be printed
+		    \param [in] printInfoMessages whether info messages should be printed
+		    \return the status of the toy MC generation
+		*/
+		ToyMCStatus checkEnvelopeToyMC(Bool_t printErrorMessages, Bool_t printInfoMessages);
+
+		//! Build the proposal density used to generate toy MC events and find the accept/reject ceiling to use with it
+		void initGenProposal();
+
+		//! Check whether events are being generated from the proposal density
+		/*!
+		    \return kTRUE if the proposal density is in use
+		*/
+		inline Bool_t usingGenProposal() const {return useGenProposal_ && ! genPropComps_.empty();}
+
+		//! Generate a point in the Dalitz plot from the proposal density
+		/*!
+		    \param [out] m13Sq the invariant mass squared of the first and third daughters
+		    \param [out] m23Sq the invariant mass squared of the second and third daughters
+		*/
+		void genFromProposal(Double_t& m13Sq, Double_t& m23Sq) const;
+
+		//! Calculate the proposal density, relative to flat phase space, at a point in the Dalitz plot
+		/*!
+		    For a symmetrical DP, the density includes the contribution from the reflected point, since generated events are folded into one half of the DP.
+
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters
+		    \return the ratio of the proposal density to the flat phase space density
+		*/
+		Double_t calcProposalRatio(const Double_t m13Sq, const Double_t m23Sq) const;
+
+		//! Calculate the extent of the Dalitz plot along one invariant mass squared for a fixed value of another
+		/*!
+		    \param [in] pair the pair of daughters whose invariant mass squared is fixed (using the numbering of LauAbsResonance::getPairInt)
+		    \param [in] mSq the invariant mass squared of the pair
+		    \return the length of the allowed range of the other invariant masses squared
+		*/
+		Double_t calcDPExtent(const Int_t pair, const Double_t mSq) const;
+
+		//! Check the status of the toy MC generation from the proposal density
+		/*!
+		    \param [in] printErrorMessages whether error messages should be printed
+		    \param [in] printInfoMessages whether info messages should be printed
+		    \return the status of the toy MC generation
+		*/
+		ToyMCStatus checkProposalToyMC(Bool_t printErrorMessages, Bool_t printInfoMessages);
+
 		//! Calculate the normalisation factor for the log-likelihood function
 		/*!
 		    \return the normalisation factor
@@ -962,6 +1311,189 @@ class LauIsobarDynamics {
 		//! Flag to generate aSqMaxSet_ once generate is called
 		Bool_t aSqMaxAuto_{kTRUE};
 
+		//! A cell of the piecewise-constant envelope used in the generation
+		struct GenEnvelopeCell {
+			//! Whether the cell is in the square DP co-ordinates (mPrime, thPrime) rather than (m13, m23)
+			Bool_t squareDP_;
+			//! The lower edge of the cell in m13 (or mPrime)
+			Double_t xMin_;
+			//! The upper edge of the cell in m13 (or mPrime)
+			Double_t xMax_;
+			//! The lower edge of the cell in m23 (or thPrime)
+			Double_t yMin_;
+			//! The upper edge of the cell in m23 (or thPrime)
+			Double_t yMax_;
+			//! The height of the envelope in the cell
+			Double_t height_;
+		};
+
+		//! Calculate the integrals of the amplitude terms over each bin of the binned likelihood
+		void calcBinIntegrals();
+
+		//! Find the bin of the binned likelihood containing the current kinematics
+		/*!
+		    \return the index of the bin, or -1 if the point is not in any bin
+		*/
+		Int_t findLikelihoodBin() const;
+
+		//! The histogram defining the bins of the binned likelihood (null if not in use)
+		TH2* likeBinning_{0};
+
+		//! The index of each used bin, keyed by its global bin number
+		std::map<Int_t,UInt_t> likeBinIndices_;
+
+		//! The bin index of each integration grid point (-1 if not in any bin), for each region
+		std::vector< std::vector<Int_t> > likeGridBins_;
+
+		//! The area of the DP within each bin
+		std::vector<Double_t> likeBinAreas_;
+
+		//! The efficiency-weighted integrals of the coherent amplitude products over each bin
+		std::vector<LauComplex> likeBinFifjEffSums_;
+
+		//! The efficiency-weighted integrals of the incoherent intensities over each bin
+		std::vector<Double_t> likeBinFSqEffSums_;
+
+		//! The number of events in each bin
+		std::vector<Double_t> likeBinCounts_;
+
+		//! The location of a point in the integration grid
+		struct GridPoint {
+			//! The integration region
+			UInt_t region_;
+			//! The index of the point in the first co-ordinate
+			UInt_t m13Point_;
+			//! The index of the point in the second co-ordinate
+			UInt_t m23Point_;
+		};
+
+		//! Check that an evaluation worker matches this model and prepare it for use
+		/*!
+		    \param [in] worker the copy of the model
+		*/
+		void initialiseWorker(LauIsobarDynamics* worker);
+
+		//! Copy the coefficients, normalisation and resonance parameter values to the evaluation workers
+		void syncEvaluationWorkers();
+
+		//! Retrieve the model that evaluates the given share of the points
+		/*!
+		    \param [in] iShare the index of the share of the points
+		    \return this model for the first share, otherwise the corresponding evaluation worker
+		*/
+		inline LauIsobarDynamics* getEvaluationModel(const UInt_t iShare) {return (iShare == 0) ? this : evalWorkers_[iShare-1];}
+
+		//! Calculate the weights of a share of the events, see LauIsobarDynamics::calcEventWeights
+		/*!
+		    \param [in] nEvents the number of events
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters for each event
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters for each event
+		    \param [out] weights the weight of each event
+		    \param [out] jacobians the square DP Jacobian of each event, not calculated if null
+		*/
+		void evalEventWeights(const UInt_t nEvents, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* weights, Double_t* jacobians);
+
+		//! Calculate the likelihood and amplitudes at a share of the points, see LauIsobarDynamics::calcDPValues
+		/*!
+		    \param [in] gridModel the model whose integration grid is used
+		    \param [in] nPoints the number of points
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters for each point
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters for each point
+		    \param [out] likelihoods the normalised likelihood at each point
+		    \param [out] totAmps the total amplitude at each point, not calculated if null
+		    \param [out] resAmps the full amplitude of each coherent component at each point, not calculated if null
+		*/
+		void evalDPValues(const LauIsobarDynamics& gridModel, const UInt_t nPoints, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* likelihoods, LauComplex* totAmps, LauComplex* resAmps);
+
+		//! Index the points of the integration grid by their DP co-ordinates
+		void indexIntegrationGrid();
+
+		//! Set the amplitudes and efficiency from those stored on the integration grid, if the point is on the grid
+		/*!
+		    \param [in] gridModel the model whose integration grid is used (this model, or the model for which this is an evaluation worker)
+		    \param [in] m13Sq the invariant mass squared of the first and third daughters
+		    \param [in] m23Sq the invariant mass squared of the second and third daughters
+		    \return kTRUE if the point is on the grid, kFALSE otherwise
+		*/
+		Bool_t loadGridPoint(const LauIsobarDynamics& gridModel, const Double_t m13Sq, const Double_t m23Sq);
+
+		//! Copies of this model used to evaluate points on other threads
+		std::vector<LauIsobarDynamics*> evalWorkers_;
+
+		//! The points of the integration grid within the DP, keyed by (m13Sq, m23Sq)
+		std::map< std::pair<Double_t,Double_t>, GridPoint > gridPointIndex_;
+
+		//! Counter that is incremented whenever the coefficients or the normalisation change
+		ULong64_t modelVersion_{0};
+
+		//! Flag to generate using the piecewise-constant envelope
+		Bool_t useGenEnvelope_{kFALSE};
+
+		//! Flag to indicate that the envelope has been built
+		Bool_t genEnvInitialised_{kFALSE};
+
+		//! The fractional margin of the envelope above the largest value found in each cell
+		Double_t genEnvMargin_{0.2};
+
+		//! The number of integration grid points along each side of an envelope cell
+		UInt_t genEnvCellPoints_{4};
+
+		//! The cells of the envelope
+		std::vector<GenEnvelopeCell> genEnvCells_;
+
+		//! The cumulative volumes of the envelope cells
+		std::vector<Double_t> genEnvCumVolumes_;
+
+		//! Flag to indicate that a value exceeding the envelope has been found while generating
+		Bool_t genEnvExceeded_{kFALSE};
+
+		//! The number of candidates proposed in each block (0 if not generating in blocks)
+		UInt_t genBlockSize_{0};
+
+		//! The number of threads used to propose the candidates
+		UInt_t genBlockThreads_{1};
+
+		//! The candidates of the current block
+		std::vector<GenCandidate> genCandidates_;
+
+		//! The accepted events (m13Sq, m23Sq) waiting to be returned
+		std::deque< std::pair<Double_t,Double_t> > genQueue_;
+
+		//! A Breit-Wigner component of the proposal density used in the generation
+		struct GenProposalComponent {
+			//! The pair of daughters (using the numbering of LauAbsResonance::getPairInt)
+			Int_t pair_;
+			//! The mass squared of the resonance
+			Double_t mSq_;
+			//! The product of the mass and width of the resonance
+			Double_t mGamma_;
+			//! The lower limit of the arctan of the scaled mass squared
+			Double_t uMin_;
+			//! The range of the arctan of the scaled mass squared
+			Double_t uRange_;
+		};
+
+		//! Flag to generate from the proposal density
+		Bool_t useGenProposal_{kFALSE};
+
+		//! Flag to indicate that the proposal density has been built
+		Bool_t genPropInitialised_{kFALSE};
+
+		//! The fraction of the proposal density that is flat phase space
+		Double_t genPropFlatFrac_{0.3};
+
+		//! The Breit-Wigner components of the proposal density
+		std::vector<GenProposalComponent> genPropComps_;
+
+		//! The area of the Dalitz plot
+		Double_t genPropDPArea_{0.0};
+
+		//! The maximum allowed value of the ratio of A squared to the proposal density
+		Double_t genPropRatioMaxSet_{0.0};
+
+		//! The maximum value of the ratio of A squared to the proposal density that has been seen so far while generating
+		Double_t genPropRatioMaxVar_{0.0};
+
 		//! The helicity flip flag for new amplitude components
 		Bool_t flipHelicity_;
 
@@ -980,6 +1512,24 @@ class LauIsobarDynamics {
 		//! Resonance indices for which the amplitudes and integrals should be recalculated
 		std::set<UInt_t> integralsToBeCalculated_;
 
+		//! Names of the amplitude components of the integration grid read from file
+		std::vector<TString> gridFileAmpNames_;
+
+		//! Names of the floating resonance parameters of the integration grid read from file
+		std::vector<TString> gridFileParNames_;
+
+		//! Values of the floating resonance parameters of the integration grid read from file
+		std::vector<Double_t> gridFileParValues_;
+
+		//! Limits, numbers of points and type of each region of the integration grid read from file
+		std::vector< std::vector<Double_t> > gridFileRegions_;
+
+		//! Amplitudes (real and imaginary parts) and intensities at each point of each region of the integration grid read from file
+		std::vector< std::vector<Double_t> > gridFileValues_;
+
+		//! Components still to be taken from the integration grid read from file
+		std::set<UInt_t> gridFileAmps_;
+
 		//! Whether to calculate separate rho and omega fit fractions from the LauRhoOmegaMix model
 		Bool_t calculateRhoOmegaFitFractions_;
 
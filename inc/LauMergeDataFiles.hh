@@ -23,6 +23,7 @@ Thomas Latham
 */
 
 #include <map>
+#include <vector>
 #include <cstdlib>
 
 #include "TFile.h"
@@ -38,6 +39,10 @@ Thomas Latham
 
   The files are merged such that events for expt 0 from tree 1 will be followed
   by events for expt 0 from tree 2, then expt 1 from tree1, expt 1 from tree 2, etc.
+  Any number of input files can be merged in this way.
+
+  The experiment boundaries are found by reading only the iExpt branch, after
+  which each input tree is read through once, in order.
 */
 
 class LauMergeDataFiles
@@ -51,6 +56,13 @@ class LauMergeDataFiles
 		*/
 		LauMergeDataFiles(const TString& fileName1, const TString& fileName2, const TString& treeName);
 
+		//! Constructor
+		/*!
+		  \param [in] fileNames names of the files to be merged
+		  \param [in] treeName name of the tree to read from the input files
+		*/
+		LauMergeDataFiles(const std::vector<TString>& fileNames, const TString& treeName);
+
 		//! Destructor
 		virtual ~LauMergeDataFiles();
 
@@ -60,6 +72,14 @@ class LauMergeDataFiles
 		*/
 		void process(const TString& fileName);
 
+		//! Set the number of threads used by ROOT to compress the output
+		/*!
+		  Implicit multi-threading is enabled in ROOT for the duration of process() only, and is left untouched if it is already enabled.
+
+		  \param [in] nThreads the number of threads (the default of 0 means that the output is compressed serially)
+		*/
+		void setNThreads(const UInt_t nThreads) {nThreads_ = nThreads;}
+
 	protected:
 		//! Type to relate leaf names with their double-precision value
 		typedef std::map<TString,Double_t> LeafDoubleMap;
@@ -74,9 +94,9 @@ class LauMergeDataFiles
 		void setupInputTrees();
 		//! Create the structure of the output tree
 		void setupOutputTree();
-		//! Determine the experiments stored a given tree
+		//! Determine the experiments stored a given tree (reading only the iExpt branch)
 		void findExperiments(TTree* tree, ExptsMap& exptsMap);
-		//! Check that the experiments in each tree match
+		//! Check that the experiments in each tree match those in the first tree
 		Bool_t checkExperimentMaps() const;
 		//! Read the entries for a given experiment from the given tree and store in the output tree
 		void readExperiment(TTree* tree, const ExptsMap::const_iterator& exptsMap, Int_t offset);
@@ -84,22 +104,15 @@ class LauMergeDataFiles
 		void writeFile();
 
 	private:
-		//! Name of file 1
-		TString fileName1_;
-		//! Name of file 2
-		TString fileName2_;
+		//! Names of the input files
+		std::vector<TString> fileNames_;
 		//! Name of the tree
 		TString treeName_;
 
-		//! Input file 1
-		TFile * inputFile1_;
-		//! Input file 2
-		TFile * inputFile2_;
-
-		//! Input tree 1
-		TTree * inputTree1_;
-		//! Input tree 2
-		TTree * inputTree2_;
+		//! Input files
+		std::vector<TFile*> inputFiles_;
+		//! Input trees
+		std::vector<TTree*> inputTrees_;
 
 		//! Output file
 		TFile * outputFile_;
@@ -117,10 +130,11 @@ class LauMergeDataFiles
 		//! Storage for integer leaves
 		LeafIntegerMap integerVars_;
 
-		//! Experiment -> first and last tree entry for tree 1
-		ExptsMap tree1Expts_;
-		//! Experiment -> first and last tree entry for tree 2
-		ExptsMap tree2Expts_;
+		//! Experiment -> first and last tree entry for each input tree
+		std::vector<ExptsMap> treeExpts_;
+
+		//! Number of threads used to compress the output
+		UInt_t nThreads_;
 
 		ClassDef(LauMergeDataFiles,0)
 };
@@ -41,6 +41,7 @@ Thomas Latham
 #include "Rtypes.h"
 #include "TMatrixD.h"
 
+#include <map>
 #include <utility>
 #include <vector>
 
@@ -95,6 +96,28 @@ class LauMinuit : public LauAbsFitter {
 		*/	
 		virtual void useAsymmFitErrors(Bool_t useAsymmErrors) {useAsymmFitErrors_ = useAsymmErrors;}
 
+		//! Determine whether the NLL gradient is supplied to Minuit
+		virtual Bool_t useBatchedGradient() const {return useBatchedGradient_;}
+
+		//! Turn on or off the supply of the NLL gradient, evaluated in a single batch, to Minuit
+		/*!
+			\param [in] useBatchGrad boolean specifying whether or not the gradient should be supplied
+		*/
+		virtual void useBatchedGradient(Bool_t useBatchGrad) {useBatchedGradient_ = useBatchGrad;}
+
+		//! Determine the number of processes in which MINOS is run
+		virtual UInt_t minosProcesses() const {return minosProcesses_;}
+
+		//! Set the number of processes in which MINOS is run
+		/*!
+			With more than one process, the floating parameters are shared out between forked copies of the fit at the minimum,
+			each of which runs MINOS for its share and sends back the errors.
+			Any new minimum that they find is reported.
+
+			\param [in] nProcesses the number of processes
+		*/
+		virtual void minosProcesses(UInt_t nProcesses) {minosProcesses_ = ( nProcesses > 0 ) ? nProcesses : 1;}
+
 		//! Perform the minimisation of the fit function
 		/*!
 		    \return the status code of the fit and the minimised value
@@ -113,6 +136,12 @@ class LauMinuit : public LauAbsFitter {
 		//! Retrieve the fit covariance matrix
 		virtual const TMatrixD& covarianceMatrix() const { return covMatrix_; }
 
+		//! Retrieve the current step sizes of the parameters, which may be called while the minimisation is in progress
+		/*!
+		    \return the step sizes, in the same order as the parameters given to initialise
+		*/
+		virtual std::vector<Double_t> currentStepSizes() const;
+
 
 	private:
 		//! Allow the factory class to access private methods
@@ -133,6 +162,13 @@ class LauMinuit : public LauAbsFitter {
 		//! Move assignment operator - private and not implemented
 		LauMinuit& operator=( LauMinuit&& ) = delete;
 
+		//! Run MINOS for the floating parameters, shared out between forked processes
+		/*!
+		    \param [in] maxCalls the maximum number of function calls for each parameter
+		    \return the MINOS status code, non-zero if any of the processes failed
+		*/
+		Int_t runParallelMinos( const Double_t maxCalls );
+
 		//! The interface to Minuit
 		TVirtualFitter* minuit_{nullptr};
 
@@ -157,6 +193,15 @@ class LauMinuit : public LauAbsFitter {
 		//! Option to use asymmetric errors
 		Bool_t useAsymmFitErrors_{kFALSE}; 
 
+		//! Option to supply the NLL gradient
+		Bool_t useBatchedGradient_{kFALSE};
+
+		//! The number of processes in which MINOS is run
+		UInt_t minosProcesses_{1};
+
+		//! The asymmetric errors (negative, positive) calculated in the forked processes, keyed by parameter index
+		std::map< UInt_t, std::pair<Double_t,Double_t> > minosErrors_;
+
 		//! The status of the fit 
 		FitStatus fitStatus_{-1,0.0,0.0};
 
@@ -0,0 +1,58 @@
+
+/*
+Copyright 2026 University of Warwick
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+Laura++ package authors:
+John Back
+Paul Harrison
+Thomas Latham
+*/
+
+/*! \file LauParallel.hh
+    \brief File containing LauParallel namespace.
+*/
+
+/*! \namespace LauParallel
+    \brief Namespace for holding functions that share work out between threads.
+*/
+
+#ifndef LAU_PARALLEL
+#define LAU_PARALLEL
+
+#include <functional>
+
+#include "Rtypes.h"
+
+namespace LauParallel {
+
+	//! Run a function over a range of items, split into contiguous sub-ranges that are processed concurrently
+	/*!
+	    The calling thread processes the first sub-range itself.
+	    The sub-ranges are numbered from 0 such that the function can, for example,
+	    accumulate into a per-thread store without locking.
+
+	    \param [in] nItems the number of items
+	    \param [in] nThreads the maximum number of threads to use
+	    \param [in] minItemsPerThread the minimum number of items worth handing to a thread
+	    \param [in] func the function to run, taking the index of the sub-range and its first and one-past-last items
+	    \return the number of sub-ranges that were used
+	*/
+	UInt_t forEachRange(const UInt_t nItems, const UInt_t nThreads, const UInt_t minItemsPerThread, const std::function<void(const UInt_t, const UInt_t, const UInt_t)>& func);
+
+}
+
+#endif
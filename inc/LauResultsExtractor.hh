@@ -68,6 +68,12 @@ class LauResultsExtractor
 		*/
 		void process(const Int_t numExpts);
 
+		//! Set the number of threads used to scan the input files
+		/*!
+		  \param [in] nThreads the number of threads (the default is the number of hardware threads available)
+		*/
+		void setNThreads(const UInt_t nThreads) {nThreads_ = nThreads;}
+
 	protected:
 		//! Create storage for leaves and call SetBranchAddress for each
 		void setupInputTree();
@@ -75,6 +81,15 @@ class LauResultsExtractor
 		void setupOutputTree(TTree * tree);
 		//! Toggle branch status of input tree branches (except iExpt, fitStatus and NLL)
 		void setInputTreeBranchStatus(const Bool_t status);
+		//! Find the best and worst NLL for each experiment, reading only the iExpt, fitStatus and NLL branches
+		/*!
+		  The input files are divided into contiguous blocks, each scanned by a separate thread,
+		  and the results combined in file order, so the selected entries are the same as for a
+		  serial scan of the chain.
+
+		  \param [in] numExpts the number of experiments to process
+		*/
+		void scanInputFiles(const Int_t numExpts);
 		//! Clear all information
 		void clearMaps();
 		//! Write the output file
@@ -99,6 +114,9 @@ class LauResultsExtractor
 		//! Number of entries in the input chain
 		Int_t nEntries_;
 
+		//! Number of threads used to scan the input files
+		UInt_t nThreads_;
+
 		// Tree variables
 		//! Storage for experiment ID variable
 		Int_t iExpt_;
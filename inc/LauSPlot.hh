@@ -53,9 +53,10 @@ Thomas Latham
 #ifndef LAU_SPLOT
 #define LAU_SPLOT
 
-#include <vector>
+#include <functional>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "TMatrixD.h"
 #include "TString.h"
@@ -119,11 +120,52 @@ class LauSPlot : public TObject {
 		//! Save the sWeight results as a friend tree to the input tree (in the same file)
 		void writeOutResults();
 
+		//! Set the number of threads used for the per-event loops
+		/*!
+		    The default is the number of hardware threads available.
+
+		    \param [in] number the number of threads (a value of 0 or 1 runs serially)
+		*/
+		void nThreads(UInt_t number) {nThreads_ = number;}
+
+		//! Turn on the streaming mode, in which the input tree is read in chunks of events
+		/*!
+		    Rather than holding all of the per-event PDF values and sWeights in memory,
+		    the input tree is read in chunks (with the next chunk being read ahead while
+		    the current one is processed), once for each combination of excluded
+		    variables and once more to calculate and store the sWeights.
+		    Only the per-event total PDF values of each species (needed for the fit of
+		    the yields) are kept for the whole experiment.
+
+		    \param [in] chunkSize the number of events in each chunk (a value of 0 turns off streaming)
+		*/
+		void useStreaming(Int_t chunkSize) {chunkSize_ = chunkSize;}
+
+		//! Check whether the streaming mode is in use
+		/*!
+		    \return true/false whether the input tree is read in chunks
+		*/
+		Bool_t useStreaming() const {return chunkSize_ > 0;}
+
 		//! Access the per-event total PDF values for each species
 		/*!
 		    \return the per-event total PDF values
 		*/
-		const std::vector<LauSPlot::NumbMap>& totalPdf() const {return pdfTot_;}
+		std::vector<LauSPlot::NumbMap> totalPdf() const;
+
+		//! Access the per-event total PDF values for each species, as held internally
+		/*!
+		    The values are stored event by event, with the species in the order of LauSPlot::speciesNames
+
+		    \return the per-event total PDF values
+		*/
+		const std::vector<Double_t>& totalPdfValues() const {return pdfTot_;}
+
+		//! Access the names of all species (free + fixed), in the order used in the per-event total PDF values
+		/*!
+		    \return the species names
+		*/
+		const std::vector<TString>& speciesNames() const {return speciesNames_;}
 
 	protected:
 		//! Check whether the input tree has been successfully read
@@ -186,6 +228,32 @@ class LauSPlot : public TObject {
 		//! Check whether the leaf structure makes sense given the PDFs we are expecting
 		Bool_t checkLeaves() const;
 
+		//! Assign integer indices to the species, variables and exclusion combinations and find the leaf for each PDF value
+		void indexInputLeaves();
+
+		//! Find the position of a given species and variable in the per-event PDF values
+		/*!
+		    \param [in] specName the name of the species
+		    \param [in] varName the name of the variable (or concatenated names in the case of a 2D PDF)
+		    \return the offset within the block of PDF values for an event, or -1 if not found
+		*/
+		Int_t pdfColumn(const TString& specName, const TString& varName) const;
+
+		//! Find which PDF values should be multiplied together to form the total PDF for a species
+		/*!
+		    \param [in] specName the name of the species
+		    \param [in] exclName the name of excluded variable (or "none")
+		    \param [out] columns the offsets of the PDF values, in the order in which they should be multiplied
+		*/
+		void pdfColumns(const TString& specName, const TString& exclName, std::vector<Int_t>& columns) const;
+
+		//! Find the index of a given exclusion combination
+		/*!
+		    \param [in] exclName the name of excluded variable (or "none")
+		    \return the index of the exclusion combination
+		*/
+		Int_t exclIndex(const TString& exclName) const;
+
 		//! Create (if not already done) the tree for storing the cN coeffs
 		void createCNTree();
 		//! Create the branches for each cN coefficient
@@ -205,6 +273,23 @@ class LauSPlot : public TObject {
 		//! Reads the values of each PDF likelihood for every event in the experiment
 		void readExpt();
 
+		//! Reads the values of each PDF likelihood for a range of events in the experiment
+		/*!
+		    \param [in] firstEvt the first event to be read
+		    \param [in] nEvt the number of events to be read
+		    \param [out] pdfValues the PDF values for each event (species x variables)
+		    \param [out] scfFracs the SCF fraction for each event
+		*/
+		void readEvents(const Int_t firstEvt, const Int_t nEvt, Double_t* pdfValues, Double_t* scfFracs);
+
+		//! Loop through the experiment in chunks, reading ahead the next chunk while the current one is processed
+		/*!
+		    \param [in] process function to process a chunk, given the first event, the number of events, the PDF values and the SCF fractions
+		    \param [in] output optional function to write out the results of a chunk, which is not run concurrently with the reading
+		*/
+		void streamEvents(const std::function<void(const Int_t, const Int_t, const Double_t*, const Double_t*)>& process,
+				const std::function<void(const Int_t, const Int_t)>& output = std::function<void(const Int_t, const Int_t)>());
+
 		//! Make sure that we're using Minuit
 		void checkFitter() const;
 
@@ -250,6 +335,22 @@ class LauSPlot : public TObject {
 		*/
 		void calcTotPDFValues(const TString& exclName);
 
+		//! Calculate the total likelihood for each species for a range of events
+		/*!
+		    \param [in] exclName the name of excluded variable (or "none")
+		    \param [in] nEvt the number of events
+		    \param [in] pdfValues the PDF values for each event (species x variables)
+		    \param [in] scfFracs the SCF fraction for each event
+		    \param [out] totals the total PDF values for each event (species)
+		*/
+		void calcTotPDFValues(const TString& exclName, const Int_t nEvt, const Double_t* pdfValues, const Double_t* scfFracs, Double_t* totals) const;
+
+		//! Calculate the total likelihood for each species, reading the input tree in chunks
+		/*!
+		    \param [in] exclName the name of excluded variable (or "none")
+		*/
+		void streamTotPDFValues(const TString& exclName);
+
 		//! Computes the cN for the extended sPlots from the covariance matrix
 		/*!
 		    \param [in] exclName the name of excluded variable (or "none")
@@ -264,6 +365,15 @@ class LauSPlot : public TObject {
 		*/
 		void calcSWeights(const TString& exclName, Double_t * covmat = 0);
 
+		//! Computes the sWeights for a range of events, using the yields and covariance matrix stored by LauSPlot::calcSWeights
+		/*!
+		    \param [in] iExcl the index of the combination of excluded variables
+		    \param [in] nEvt the number of events
+		    \param [in] totals the total PDF values for each event (species)
+		    \param [out] weights the sWeights for each event (combinations of excluded vars x free species)
+		*/
+		void calcEventWeights(const Int_t iExcl, const Int_t nEvt, const Double_t* totals, Double_t* weights) const;
+
 		//! Copy the sWeight of a given event into LauSPlot::sWeightsCurrent_, from which they can be stored in the output tree
 		/*!
 		    \param [in] iEvent the requested event
@@ -276,6 +386,9 @@ class LauSPlot : public TObject {
 		//! Fill the sWeights branches
 		void fillSWeightBranches();
 
+		//! Calculate the sWeights and fill the branches, reading the input tree in chunks
+		void streamSWeightBranches();
+
 		//! Add the sWeightTree as a friend tree of the input tree
 		void addFriendTree();
 
@@ -351,20 +464,50 @@ class LauSPlot : public TObject {
 		//! Total number of species (free + fixed)
 		Int_t    nSpecies_;
 
-                //! The per-event values of the total PDF for each species
-		std::vector<NumbMap> pdfTot_;
-		//! The per-event values of the PDFs for each species for each disc variable
-		std::vector<std::map<TString,NumbMap> > discPdf_;
+		//! The names of all species (free + fixed), in the order of the fit parameters
+		std::vector<TString> speciesNames_;
+		//! The indices within LauSPlot::speciesNames_ of the free species
+		std::vector<Int_t> freeIndices_;
+		//! The indices within LauSPlot::speciesNames_ of the fixed species
+		std::vector<Int_t> fixdIndices_;
+		//! The names of the species for which PDF values are read from the input tree
+		std::vector<TString> pdfSpeciesNames_;
+		//! The names of the variables (and combinations of variables for 2D PDFs) for which PDF values are read from the input tree
+		std::vector<TString> pdfVarNames_;
+		//! The leaves for each species and variable PDF value (null where no such PDF exists)
+		std::vector<const TLeaf*> pdfLeaves_;
+		//! The leaf containing the SCF fraction
+		const TLeaf* scfFracLeaf_;
+		//! Number of PDF values per event (species x variables)
+		Int_t    nPdfValues_;
+		//! The names of the excluded variables (including "none")
+		std::vector<TString> excludeNames_;
+
+		//! The number of threads used for the per-event loops
+		UInt_t   nThreads_;
+		//! The number of events in each chunk in streaming mode (0 if not streaming)
+		Int_t    chunkSize_;
+
+		//! The per-event values of the total PDF for each species (events x species)
+		std::vector<Double_t> pdfTot_;
+		//! The per-event values of the PDFs for each species for each disc variable (events x species x variables)
+		std::vector<Double_t> discPdf_;
 		//! The per-event values of the SCF fraction
 		std::vector<Double_t> scfFrac_;
 
 		//! The calculated covariance matrix
 		TMatrixD covMat_;
 
-		//! The per-event values of the computed sWeights (for each species and for each combination of excluded vars)
-		std::vector< std::map<TString,NumbMap> > sWeights_;
-		//! The current-event values of the computed sWeights
-		std::map<TString,NumbMap> sWeightsCurrent_;
+		//! The per-event values of the computed sWeights (events x combinations of excluded vars x free species)
+		std::vector<Double_t> sWeights_;
+		//! The current-event values of the computed sWeights (combinations of excluded vars x free species)
+		std::vector<Double_t> sWeightsCurrent_;
+		//! The fitted yields of the free species (for each combination of excluded vars)
+		std::vector< std::vector<Double_t> > exclFreeYields_;
+		//! The yields of the fixed species (for each combination of excluded vars)
+		std::vector< std::vector<Double_t> > exclFixdYields_;
+		//! The covariance matrix of the free species (for each combination of excluded vars)
+		std::vector< std::vector<Double_t> > exclCovMat_;
 		//! The extended sPlot coefficients (for each species and for each combination of excluded vars)
 		std::map<TString,NumbMap> cN_;
 
@@ -32,12 +32,21 @@ Thomas Latham
     Implementation of the JFit method described in arXiv:1409.5080 [physics.data-an].
 
     This class acts as the interface between the task processes and the minimiser.
+
+    Alternatively, the tasks can be run within the coordinator process, by adding
+    each of them with addLocalTask before calling runSimFit.
+    In this case each task evaluates its likelihood in its own thread and reads the
+    parameter values directly, with no sockets or message serialisation involved.
 */
 
 #ifndef LAU_SIM_FIT_COORDINATOR
 #define LAU_SIM_FIT_COORDINATOR
 
+#include <condition_variable>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "TMatrixD.h"
@@ -48,10 +57,12 @@ Thomas Latham
 
 class TMessage;
 class TMonitor;
+class TObjArray;
 class TSocket;
 class LauAbsRValue;
 class LauParameter;
 class LauFitNtuple;
+class LauSimFitTask;
 
 
 class LauSimFitCoordinator : public LauFitObject {
@@ -67,6 +78,20 @@ class LauSimFitCoordinator : public LauFitObject {
 		//! Destructor
 		virtual ~LauSimFitCoordinator();
 
+		//! Add a task to be run within this process, rather than connecting via a socket
+		/*!
+			Either all or none of the tasks must be added in this way.
+			The task should be configured as it would be before calling LauSimFitTask::runTask.
+			Ownership of the task remains with the caller.
+
+			\param [in] task the task
+			\param [in] dataFileName the name of the input data file
+			\param [in] dataTreeName the name of the tree containing the data
+			\param [in] histFileName the file name for the output histograms
+			\param [in] tableFileName the file name for the latex output file
+		*/
+		void addLocalTask( LauSimFitTask* task, const TString& dataFileName, const TString& dataTreeName, const TString& histFileName, const TString& tableFileName = "" );
+
 		//! Run the fit
 		/*! 
 			\param [in] fitNtupleFileName the file to which the ntuple containing the fit results should be written
@@ -108,6 +133,30 @@ class LauSimFitCoordinator : public LauFitObject {
 		*/	
 		virtual Double_t getTotNegLogLikelihood();
 
+		//! Calculate the negative log likelihood for several sets of parameter values
+		/*!
+			All sets are sent to each task in a single message (or job, for tasks
+			running within this process), which evaluates them back-to-back.
+
+			This function has to be public since it is called from the global FCN.
+			It should not be called otherwise!
+
+			\param [in] nPoints the number of sets of parameter values
+			\param [in] pars the parameter values, with all the parameters of the first set followed by those of the second set, etc.
+			\param [in] npar the number of free parameters
+			\param [out] negLogLikes the NLL values for each set
+		*/
+		virtual void getTotNegLogLikelihoods(const UInt_t nPoints, Double_t* pars, const Int_t npar, Double_t* negLogLikes);
+
+		//! Choose whether to pass the parameter values to the tasks via shared memory
+		/*!
+			Only applies to tasks running on the same host as the coordinator.
+			Any task that cannot attach to the shared memory will instead receive its values via messages.
+
+			\param [in] useShm whether or not to use shared memory
+		*/
+		void useSharedMemory( const Bool_t useShm ) {useSharedMemory_ = useShm;}
+
 	protected:
 		//! Print information on the parameters
 		void printParInfo() const;
@@ -118,6 +167,19 @@ class LauSimFitCoordinator : public LauFitObject {
 		//! Initialise socket connections for the tasks 
 		void initSockets();
 
+		//! Initialise the tasks running within this process and start their worker threads
+		void initLocalTasks();
+
+		//! Check whether the tasks have been initialised
+		Bool_t tasksInitialised() const {return socketMonitor_ != 0 || ! workers_.empty();}
+
+		//! Obtain the parameters from a task
+		/*!
+			\param [in] iTask the index of the task
+			\return an array of the parameters, to be deleted by the caller (null on failure)
+		*/
+		TObjArray* requestParameters( const UInt_t iTask );
+
 		//! Determine/update the parameter initial values from all tasks
 		void getParametersFromTasks();
 
@@ -160,6 +222,30 @@ class LauSimFitCoordinator : public LauFitObject {
 		//! Instruct the tasks to write out the fit results
 		Bool_t writeOutResults();
 
+		//! Send the current parameter values to a task, requesting it to evaluate its NLL
+		/*!
+			\param [in] iTask the index of the task
+		*/
+		void sendParameters( const UInt_t iTask );
+
+		//! Create the shared memory segments and instruct the tasks to attach to them
+		void initSharedMemory();
+
+		//! Run a job concurrently for each of the tasks running within this process and wait for them all to finish
+		/*!
+			\param [in] job the job, which is passed the index of the task
+		*/
+		void runLocalTasks( const std::function<void(const UInt_t)>& job );
+
+		//! The loop run by the worker thread of each task running within this process
+		/*!
+			\param [in] iTask the index of the task
+		*/
+		void workerLoop( const UInt_t iTask );
+
+		//! Stop and join the worker threads
+		void stopWorkers();
+
 
 	private:
 		//! Copy constructor (not implemented)
@@ -216,6 +302,84 @@ class LauSimFitCoordinator : public LauFitObject {
 		//! Likelihood values returned from the tasks
 		std::vector<Double_t> vectorRes_;
 
+		//! The parameter values for each task for all the points of a batch
+		std::vector< std::vector<Double_t> > batchPar_;
+
+		//! Likelihood values returned from each task for all the points of a batch
+		std::vector< std::vector<Double_t> > batchRes_;
+
+		//! The penalty terms from the constraints for all the points of a batch
+		std::vector<Double_t> batchPenalty_;
+
+		//! The parameter values last sent to each task
+		std::vector< std::vector<Double_t> > lastSentPar_;
+
+		//! Flags marking that all parameter values must be sent to each task with the next evaluation
+		std::vector<Bool_t> sendAllPars_;
+
+		//! Indices of the parameters that have changed since the last evaluation
+		std::vector<UInt_t> changedIndices_;
+
+		//! Values of the parameters that have changed since the last evaluation
+		std::vector<Double_t> changedValues_;
+
+		//! Whether or not to use shared memory for the parameter values
+		Bool_t useSharedMemory_;
+
+		//! Whether or not the shared memory has been set up
+		Bool_t sharedMemoryInitialised_;
+
+		//! The shared memory segments for each task
+		std::vector<void*> sharedSegments_;
+
+		//! The sizes of the shared memory segments for each task
+		std::vector<ULong_t> sharedSegmentSizes_;
+
+		//! The parameter values in the shared memory segments for each task
+		std::vector<Double_t*> sharedPar_;
+
+		//! The input and output file names for a task running within this process
+		struct LocalTaskFiles {
+			//! The name of the input data file
+			TString dataFileName_;
+			//! The name of the tree containing the data
+			TString dataTreeName_;
+			//! The file name for the output histograms
+			TString histFileName_;
+			//! The file name for the latex output file
+			TString tableFileName_;
+		};
+
+		//! The tasks running within this process
+		std::vector<LauSimFitTask*> localTasks_;
+
+		//! The file names for the tasks running within this process
+		std::vector<LocalTaskFiles> localTaskFiles_;
+
+		//! The worker threads for the tasks running within this process
+		std::vector<std::thread> workers_;
+
+		//! Mutex protecting the worker thread state
+		std::mutex workMutex_;
+
+		//! Condition variable signalling to the workers that there is a new job
+		std::condition_variable workAvailable_;
+
+		//! Condition variable signalling that all workers have finished their job
+		std::condition_variable workDone_;
+
+		//! The current job for the workers
+		std::function<void(const UInt_t)> workerJob_;
+
+		//! Counter identifying the current job
+		ULong64_t workGeneration_;
+
+		//! The number of workers that have finished the current job
+		UInt_t nWorkersDone_;
+
+		//! Flag to instruct the workers to stop
+		Bool_t stopWorkers_;
+
 		//! The fit timer 
 		TStopwatch timer_; 
 
@@ -0,0 +1,79 @@
+
+/*
+Copyright 2026 University of Warwick
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+Laura++ package authors:
+John Back
+Paul Harrison
+Thomas Latham
+*/
+
+/*! \file LauSimFitProtocol.hh
+    \brief File containing LauSimFitProtocol namespace.
+*/
+
+/*! \namespace LauSimFitProtocol
+    \brief Namespace to contain the definition of the messages exchanged between the simultaneous fit coordinator and tasks.
+
+    Each message is identified by a fixed message type, which is used as the type of the TMessage.
+
+    The parameter values for each likelihood evaluation are sent either:
+    - as a delta: only the indices and values of the parameters that have changed since the previous evaluation,
+      written as raw (native byte order) arrays so that the task can read them directly from the message buffer
+    - via a shared memory segment, when the coordinator and the task are running on the same host,
+      in which case the message simply signals that new values are available
+
+    Several sets of parameter values can also be sent in a single message (e.g. all
+    the points needed to determine the gradient), in which case the values of all
+    parameters are sent for each set and the NLL for each set is returned.
+*/
+
+#ifndef LAU_SIM_FIT_PROTOCOL
+#define LAU_SIM_FIT_PROTOCOL
+
+#include "MessageTypes.h"
+#include "Rtypes.h"
+
+namespace LauSimFitProtocol {
+
+	//! The types of message sent from the coordinator to the tasks
+	/*!
+	    The values start well above those of the message types defined by ROOT
+	    (kMESS_OBJECT etc., some of which TSocket::Recv handles itself)
+	*/
+	enum MessageType {
+		SendParameters = 1000,		/*!< Request the initial parameters from the task */
+		ReadExpt,			/*!< Read the data for an experiment, payload: experiment number */
+		Cache,				/*!< Cache the input data */
+		AsymErrorCalc,			/*!< Mark entering/leaving the asymmetric error calculation, payload: flag */
+		WriteResults,			/*!< Write out the fit results */
+		Finish,				/*!< Finish processing */
+		AttachSharedMemory,		/*!< Attach to a shared memory segment, payload: segment name, host name, number of parameters */
+		DeltaParameters,		/*!< Evaluate the NLL, payload: number of free parameters, number of changed parameters, raw byte order mark, raw indices, raw values */
+		SharedParameters,		/*!< Evaluate the NLL with the values in shared memory, payload: number of free parameters */
+		BatchParameters			/*!< Evaluate the NLL for several sets of values, payload: number of free parameters, number of sets, raw byte order mark, raw values of all parameters for each set */
+	};
+
+	//! Value written at the start of the raw data to check that both sides use the same byte order
+	const UInt_t byteOrderMark = 0x01020304;
+
+	//! The size of the header at the start of each shared memory segment (containing the host name)
+	const UInt_t sharedMemoryHeaderSize = 64;
+
+}
+
+#endif
@@ -38,6 +38,8 @@ Thomas Latham
 #ifndef LAU_SIM_FIT_TASK
 #define LAU_SIM_FIT_TASK
 
+#include <vector>
+
 #include "TMatrixDfwd.h"
 
 #include "LauFitObject.hh"
@@ -107,9 +109,48 @@ class LauSimFitTask : public LauFitObject {
 		*/	
 		void connectToCoordinator( const TString& addressCoordinator, const UInt_t portCoordinator );
 
+		//! Set the task ID number, the total number of tasks and whether asymmetric errors are to be determined
+		/*!
+			\param [in] taskId the ID number of this task
+			\param [in] nTasks the total number of tasks
+			\param [in] useAsymErrs whether or not the fit will determine asymmetric errors
+		*/
+		void setTaskInfo( const UInt_t taskId, const UInt_t nTasks, const Bool_t useAsymErrs );
+
+		//! Initialise the fit model, the results outputs and the input data
+		/*!
+			\param [in] dataFileName the name of the input data file
+			\param [in] dataTreeName the name of the tree containing the data
+			\param [in] histFileName the file name for the output histograms
+			\param [in] tableFileName the file name for the latex output file
+			\return success/failure of the setup
+		*/
+		Bool_t setupTask( const TString& dataFileName, const TString& dataTreeName, const TString& histFileName, const TString& tableFileName );
+
 		//! Listen for requests from the coordinator and act accordingly
 		void processCoordinatorRequests();
 
+		//! Update the parameter values with those that have changed, read from the current message from the coordinator
+		/*!
+			\param [in] nChanged the number of changed parameters
+		*/
+		void applyDeltaParameters( const UInt_t nChanged );
+
+		//! Read several sets of parameter values from the current message from the coordinator
+		/*!
+			\param [in] nPoints the number of sets of parameter values
+		*/
+		void readBatchParameters( const UInt_t nPoints );
+
+		//! Attach to the shared memory segment via which the coordinator will send the parameter values
+		/*!
+			\param [in] segmentName the name of the shared memory segment
+			\param [in] hostName the name of the host on which the coordinator is running
+			\param [in] nPars the number of parameters in the segment
+			\return whether or not the segment was successfully attached
+		*/
+		Bool_t attachSharedMemory( const TString& segmentName, const TString& hostName, const UInt_t nPars );
+
 		//! Setup saving of fit results to ntuple/LaTeX table etc.
 		/*!
 		  	Provide here a default implementation that produces an ntuple only.
@@ -120,6 +161,14 @@ class LauSimFitTask : public LauFitObject {
 		*/	
 		virtual void setupResultsOutputs( const TString& histFileName, const TString& tableFileName );
 
+		//! Determine whether the fit results should be added to those already in the output file
+		/*!
+		  	By default the file is overwritten.
+
+			\return whether to append the fit results
+		*/
+		virtual Bool_t appendFitResults() const {return kFALSE;}
+
 		//! Package the initial fit parameters for transmission to the coordinator
 		/*!
 			\param [out] array the array to be filled with the LauParameter objects
@@ -159,6 +208,9 @@ class LauSimFitTask : public LauFitObject {
 		virtual void writeOutAllFitResults();
 
 	private:
+		//! LauSimFitCoordinator is a friend class, so that it can drive tasks running within its own process
+		friend class LauSimFitCoordinator;
+
 		//! Copy constructor (not implemented)
 		LauSimFitTask(const LauSimFitTask& rhs);
 
@@ -180,6 +232,21 @@ class LauSimFitTask : public LauFitObject {
 		//! Parameter values array (for reading from the coordinator)
 		Double_t* parValues_;
 
+		//! Parameter values for each of the sets of a batch
+		std::vector<Double_t> batchPar_;
+
+		//! The NLL values for each of the sets of a batch
+		std::vector<Double_t> batchRes_;
+
+		//! The shared memory segment attached for receiving parameter values
+		void* sharedSegment_;
+
+		//! The size of the shared memory segment
+		ULong_t sharedSegmentSize_;
+
+		//! The parameter values in the shared memory segment
+		Double_t* sharedPar_;
+
 		//! The fit ntuple
 		LauFitNtuple* fitNtuple_;
 
@@ -173,6 +173,43 @@ class LauSimpleFitModel : public LauAbsFitModel {
 		*/	
 		virtual void setAmpCoeffSet(LauAbsCoeffSet* coeffSet);
 
+		//! Add a variant of the signal DP model for which weights are also calculated when weighting events
+		/*!
+			The weights are stored in the branch dpModelWeight_<name>, alongside those of the nominal model, in the same pass over the input.
+			The model is initialised here with the given coefficients.
+			To be weighted in parallel with the nominal model (see LauAbsFitModel::setWeightingThreads) it should be built with its own LauDaughters object.
+
+			\param [in] name the name of the variant
+			\param [in] dpModel the DP model of the variant
+			\param [in] coeffs the amplitude coefficients of the variant, in the order in which the resonances are stored in the model
+		*/
+		void addWeightVariant(const TString& name, LauIsobarDynamics* dpModel, const std::vector<LauComplex>& coeffs);
+
+		//! Use a binned approximation of the likelihood in the fit
+		/*!
+			Rather than evaluating the likelihood of each event, the events are counted in bins of the DP
+			and the likelihood is calculated from the integral of the model over each bin, obtained from the normalisation integration grid.
+			This is only possible for fits to signal events with no extra PDFs, no SCF component and no sWeights,
+			otherwise the unbinned likelihood is used.
+
+			The bins are defined as for LauScfMap, i.e. in m13Sq vs m23Sq, or in mPrime vs thPrime if the kinematics use the square DP.
+			They should be large compared to the spacing of the integration grid.
+			The loss of information due to the binning is estimated and reported after the fit.
+
+			\param [in] binning histogram defining the bins
+		*/
+		void useBinnedLikelihood(const TH2* binning);
+
+		//! Use a binned approximation of the likelihood in the fit, with uniform bins
+		/*!
+			The bins cover the full kinematic range of the DP, or of the square DP if it is used by the kinematics.
+			See useBinnedLikelihood(const TH2*) for details.
+
+			\param [in] nBinsX the number of bins in m13Sq (or mPrime)
+			\param [in] nBinsY the number of bins in m23Sq (or thPrime)
+		*/
+		void useBinnedLikelihood(const UInt_t nBinsX, const UInt_t nBinsY);
+
                 //! Calculate the DP amplitude(s) for a given DP position
                 /*!
                     If not already done, this function will initialise the DP models
@@ -191,6 +228,24 @@ class LauSimpleFitModel : public LauAbsFitModel {
                 */
                 virtual std::map<TString, Double_t> getDPLikelihoods( const Double_t m13Sq, const Double_t m23Sq );
 
+		//! Calculate the DP amplitude(s) for many DP positions
+		/*!
+			See LauAbsFitModel::getDPAmps
+			\param [in] m13Sq the invariant mass squared of children 1 and 3 for each point
+			\param [in] m23Sq the invariant mass squared of children 2 and 3 for each point
+			\return a container of the complex amplitudes at each point, labelled to indicate to which component they belong
+		*/
+		virtual std::map< TString, std::vector<LauComplex> > getDPAmps( const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq );
+
+		//! Calculate the DP likelihood(s) for many DP positions
+		/*!
+			See LauAbsFitModel::getDPLikelihoods
+			\param [in] m13Sq the invariant mass squared of children 1 and 3 for each point
+			\param [in] m23Sq the invariant mass squared of children 2 and 3 for each point
+			\return a container of the likelihood values at each point, labelled to indicate to which component they belong
+		*/
+		virtual std::map< TString, std::vector<Double_t> > getDPLikelihoods( const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq );
+
 	protected:
 		//! Define a map to be used to store a category name and numbers
 		typedef std::map< TString, std::pair<Int_t,Double_t> > LauGenInfo;
@@ -226,6 +281,12 @@ class LauSimpleFitModel : public LauAbsFitModel {
 		//! Recalculate Normalization the signal DP models
 		virtual void recalculateNormalisation();
 
+		//! Determine whether the binned approximation of the likelihood is in use
+		virtual Bool_t binnedLikelihood() const;
+
+		//! Calculate the binned approximation of the log-likelihood
+		virtual Double_t getBinnedLogLikelihood();
+
 		//! Update the coefficients
 		virtual void updateCoeffs();
 
@@ -238,6 +299,12 @@ class LauSimpleFitModel : public LauAbsFitModel {
 		//! Read in the input fit data variables, e.g. m13Sq and m23Sq
 		virtual void cacheInputFitVars();
 
+		//! The signal Dalitz plot models whose integration grids are saved with the checkpoint
+		/*!
+			\return the models
+		*/
+		virtual std::vector<LauIsobarDynamics*> checkpointDPModels() const {return std::vector<LauIsobarDynamics*>( 1, sigDPModel_ );}
+
 		//! Check the initial fit parameters
 		virtual void checkInitFitParams();
 
@@ -348,8 +415,9 @@ class LauSimpleFitModel : public LauAbsFitModel {
 		/*! 
 			\param [in] extraPdfs the list of extra PDFs
 			\param [in] embeddedData the embedded data sample
+			\return success/failure of the generation
 		*/	
-		void generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData);
+		Bool_t generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData);
 
 		//! Add sPlot branches for the extra PDFs
 		/*!
@@ -541,6 +609,41 @@ class LauSimpleFitModel : public LauAbsFitModel {
 		//! Total background likelihood(s)
 		std::vector<Double_t> bkgndTotalLike_;
 
+		// Handles to the generated ntuple branches that are set for every event
+
+		//! Handle to the branch for the event number within the experiment
+		LauGenNtuple::IntegerBranchHandle genEvtNumHandle_;
+
+		//! Handle to the branch for the event weight
+		LauGenNtuple::DoubleBranchHandle genEvtWeightHandle_;
+
+		//! Handle to the branch for the efficiency
+		LauGenNtuple::DoubleBranchHandle genEffHandle_;
+
+		//! Handle to the branch flagging signal events
+		LauGenNtuple::IntegerBranchHandle genSigHandle_;
+
+		//! Handle to the branch flagging truth-matched signal events (null if not stored)
+		LauGenNtuple::IntegerBranchHandle genTMSigHandle_;
+
+		//! Handle to the branch flagging self cross feed signal events (null if not stored)
+		LauGenNtuple::IntegerBranchHandle genSCFSigHandle_;
+
+		//! Handles to the branches flagging each background class
+		std::vector<LauGenNtuple::IntegerBranchHandle> genBkgndHandles_;
+
+		//! Handles to the DP branches, in the order m12, m23, m13, m12Sq, m23Sq, m13Sq, cosHel12, cosHel23, cosHel13, mPrime, thPrime
+		std::vector<LauGenNtuple::DoubleBranchHandle> genDPHandles_;
+
+		//! The names of the DP model variants to be weighted
+		std::vector<TString> weightVariantNames_;
+
+		//! The DP model variants to be weighted
+		std::vector<LauIsobarDynamics*> weightVariantModels_;
+
+		//! The histogram defining the bins of the binned likelihood (null if not requested)
+		TH2* likeBinning_{0};
+
 		ClassDef(LauSimpleFitModel,0) // Total fit/ToyMC model
 
 };
@@ -0,0 +1,66 @@
+
+/*
+Copyright 2026 University of Warwick
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+Laura++ package authors:
+John Back
+Paul Harrison
+Thomas Latham
+*/
+
+/*! \file LauVectorMath.hh
+    \brief File containing LauVectorMath namespace.
+*/
+
+/*! \namespace LauVectorMath
+    \brief Namespace for holding mathematical functions that act on arrays of values.
+
+    The loops are written such that the compiler is able to vectorise them,
+    which the standard library functions generally prevent.
+    The results agree with the standard library to within a couple of units
+    in the last place, except that results that would be subnormal are
+    flushed to zero.
+*/
+
+#ifndef LAU_VECTOR_MATH
+#define LAU_VECTOR_MATH
+
+#include "Rtypes.h"
+
+namespace LauVectorMath {
+
+	//! Calculate the exponential of each of the values in an array
+	/*!
+	    The input and output arrays may be the same.
+
+	    \param [in] nValues the number of values
+	    \param [in] input the values of the argument
+	    \param [out] output the exponentials of the values
+	*/
+	void exp(const UInt_t nValues, const Double_t* input, Double_t* output);
+
+	//! Multiply each of the values in an array by a constant factor
+	/*!
+	    \param [in] nValues the number of values
+	    \param [in] factor the factor by which to multiply
+	    \param [in,out] values the values to be scaled
+	*/
+	void scale(const UInt_t nValues, const Double_t factor, Double_t* values);
+
+}
+
+#endif
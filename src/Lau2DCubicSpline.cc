@@ -227,6 +227,50 @@ Double_t Lau2DCubicSpline::evaluate(Double_t x, Double_t y) const
     return retVal;
 }
 
+Double_t Lau2DCubicSpline::evaluateProduct(Double_t x, Double_t y, const std::vector<Lau2DCubicSpline*>& others) const
+{
+    // protect against NaN and out of range
+    if (x <= xmin || x >= xmax || y <= ymin || y >= ymax || x != x || y != y)
+	return 0.;
+    // find the bin in question
+    const Int_t binx = Int_t(Double_t(nBinsX) * (x - xmin) / (xmax - xmin));
+    const Int_t biny = Int_t(Double_t(nBinsY) * (y - ymin) / (ymax - ymin));
+    // get low edge of bin
+    const Double_t xlo = Double_t(nBinsX - binx) / Double_t(nBinsX) * xmin +
+	Double_t(binx) / Double_t(nBinsX) * xmax;
+    const Double_t ylo = Double_t(nBinsY - biny) / Double_t(nBinsY) * ymin +
+	Double_t(biny) / Double_t(nBinsY) * ymax;
+    // normalise to coordinates in unit sqare
+    const Double_t hx = (x - xlo) / binSizeX;
+    const Double_t hy = (y - ylo) / binSizeY;
+    // monomials, shared by all of the splines since they have the same knots
+    Double_t mono[NCoeff];
+    const Double_t hxton[4] = { hx * hx * hx, hx * hx, hx, 1. };
+    const Double_t hyton[4] = { hy * hy * hy, hy * hy, hy, 1. };
+    for (Int_t k = 0; k < NCoeff; ++k)
+	mono[k] = hxton[k % 4] * hyton[k / 4];
+    // sum up for this spline
+    Double_t retVal = 0.;
+    for (Int_t k = 0; k < NCoeff; ++k)
+	retVal += coeff(binx, biny, k) * mono[k];
+    // and multiply by the others
+    for (std::vector<Lau2DCubicSpline*>::const_iterator it = others.begin(); it != others.end(); ++it) {
+	Double_t lsum = 0.;
+	for (Int_t k = 0; k < NCoeff; ++k)
+	    lsum += (*it)->coeff(binx, biny, k) * mono[k];
+	retVal *= lsum;
+    }
+
+    return retVal;
+}
+
+Bool_t Lau2DCubicSpline::sameKnots(const Lau2DCubicSpline& other) const
+{
+    return (nBinsX == other.nBinsX && nBinsY == other.nBinsY &&
+	    xmin == other.xmin && xmax == other.xmax &&
+	    ymin == other.ymin && ymax == other.ymax);
+}
+
 Double_t Lau2DCubicSpline::analyticalIntegral() const
 {
     return evalXY(xmin,xmax,ymin,ymax);
@@ -52,7 +52,8 @@ Lau2DHistDP::Lau2DHistDP(const TH2* hist, const LauDaughters* daughters,
 	rangeX_(0.0), rangeY_(0.0),
 	binXWidth_(0.0), binYWidth_(0.0),
 	nBinsX_(0), nBinsY_(0),
-	useInterpolation_(useInterpolation)
+	useInterpolation_(useInterpolation),
+	nLayers_(1)
 {
 	if ( ! hist_ ) {
 		std::cerr << "ERROR in Lau2DHistDP constructor : the histogram pointer is null." << std::endl;
@@ -83,6 +84,7 @@ Lau2DHistDP::Lau2DHistDP(const TH2* hist, const LauDaughters* daughters,
 	if (avEff > 0.0 && avEffError > 0.0) {
 		this->raiseOrLowerBins(hist_,avEff,avEffError);
 	}
+	this->fillLattice();
 }
 
 Lau2DHistDP::Lau2DHistDP(const TH2* hist, const TH2* errorHi, const TH2* errorLo, const LauDaughters* daughters,
@@ -97,7 +99,8 @@ Lau2DHistDP::Lau2DHistDP(const TH2* hist, const TH2* errorHi, const TH2* errorLo
 	rangeX_(0.0), rangeY_(0.0),
 	binXWidth_(0.0), binYWidth_(0.0),
 	nBinsX_(0), nBinsY_(0),
-	useInterpolation_(useInterpolation)
+	useInterpolation_(useInterpolation),
+	nLayers_(1)
 {
 	if ( ! hist_ ) {
 		std::cerr << "ERROR in Lau2DHistDP constructor : the histogram pointer is null." << std::endl;
@@ -178,6 +181,7 @@ Lau2DHistDP::Lau2DHistDP(const TH2* hist, const TH2* errorHi, const TH2* errorLo
 	if (avEff > 0.0 && avEffError > 0.0) {
 		this->raiseOrLowerBins(hist_,avEff,avEffError);
 	}
+	this->fillLattice();
 }
 
 Lau2DHistDP::~Lau2DHistDP()
@@ -195,6 +199,15 @@ Lau2DHistDP::~Lau2DHistDP()
 }
 
 Double_t Lau2DHistDP::getBinHistValue(Int_t xBinNo, Int_t yBinNo) const
+{
+	Double_t value(1.0);
+	for ( UInt_t layer(0); layer < nLayers_; ++layer ) {
+		value *= this->getBinLayerValue(xBinNo, yBinNo, layer);
+	}
+	return value;
+}
+
+Double_t Lau2DHistDP::getBinLayerValue(Int_t xBinNo, Int_t yBinNo, UInt_t layer) const
 {
 	if (xBinNo < 0) {
 		xBinNo = 0;
@@ -208,10 +221,80 @@ Double_t Lau2DHistDP::getBinHistValue(Int_t xBinNo, Int_t yBinNo) const
 		return 0.0;
 	}
 
-	Double_t value = hist_->GetBinContent(xBinNo+1, yBinNo+1);
+	Double_t value = binContents_[ (xBinNo*nBinsY_ + yBinNo)*nLayers_ + layer ];
 	return value;
 }
 
+void Lau2DHistDP::fillLattice()
+{
+	// Copy the bin contents into a flat array and precompute which
+	// bin centres lie within the kinematic boundary, so that
+	// interpolateXY need not query the histogram or the kinematics
+	const UInt_t nBins = static_cast<UInt_t>(nBinsX_*nBinsY_);
+	binContents_.resize( nBins );
+	binCentreInDP_.resize( nBins );
+
+	for ( Int_t i(0); i < nBinsX_; ++i ) {
+		const Double_t cbinx = Double_t(i+0.5)*rangeX_/nBinsX_ + minX_;
+		for ( Int_t j(0); j < nBinsY_; ++j ) {
+			const Double_t cbiny = Double_t(j+0.5)*rangeY_/nBinsY_ + minY_;
+			binContents_[ i*nBinsY_ + j ] = hist_->GetBinContent(i+1, j+1);
+			binCentreInDP_[ i*nBinsY_ + j ] = this->withinDPBoundaries(cbinx,cbiny);
+		}
+	}
+}
+
+Bool_t Lau2DHistDP::sameLattice(const Lau2DHistDP& other) const
+{
+	return ( nBinsX_ == other.nBinsX_ && nBinsY_ == other.nBinsY_ &&
+		 minX_ == other.minX_ && maxX_ == other.maxX_ &&
+		 minY_ == other.minY_ && maxY_ == other.maxY_ &&
+		 this->usingSquareDP() == other.usingSquareDP() &&
+		 this->usingUpperHalf() == other.usingUpperHalf() &&
+		 useInterpolation_ == other.useInterpolation_ );
+}
+
+Bool_t Lau2DHistDP::multiplyBins(const Lau2DHistDP& other)
+{
+	if ( ! this->sameLattice(other) ) {
+		return kFALSE;
+	}
+
+	const UInt_t nBins = static_cast<UInt_t>(nBinsX_*nBinsY_);
+
+	if ( ! useInterpolation_ ) {
+		// The raw bin values are used so the product can be formed bin by bin
+		for ( UInt_t k(0); k < nBins; ++k ) {
+			Double_t factor(1.0);
+			for ( UInt_t layer(0); layer < other.nLayers_; ++layer ) {
+				factor *= other.binContents_[ k*other.nLayers_ + layer ];
+			}
+			for ( UInt_t layer(0); layer < nLayers_; ++layer ) {
+				binContents_[ k*nLayers_ + layer ] *= factor;
+			}
+		}
+		return kTRUE;
+	}
+
+	// The product of interpolations is not the interpolation of the product,
+	// so instead append the other contents as additional layers of each bin.
+	// The neighbouring bins and their weights are then shared between the layers.
+	const UInt_t nLayers = nLayers_ + other.nLayers_;
+	std::vector<Double_t> contents( nBins*nLayers );
+	for ( UInt_t k(0); k < nBins; ++k ) {
+		for ( UInt_t layer(0); layer < nLayers_; ++layer ) {
+			contents[ k*nLayers + layer ] = binContents_[ k*nLayers_ + layer ];
+		}
+		for ( UInt_t layer(0); layer < other.nLayers_; ++layer ) {
+			contents[ k*nLayers + nLayers_ + layer ] = other.binContents_[ k*other.nLayers_ + layer ];
+		}
+	}
+	binContents_.swap( contents );
+	nLayers_ = nLayers;
+
+	return kTRUE;
+}
+
 Double_t Lau2DHistDP::interpolateXY(Double_t x, Double_t y) const
 {
 	// This function returns the interpolated value of the histogram function
@@ -246,7 +329,8 @@ Double_t Lau2DHistDP::interpolateXY(Double_t x, Double_t y) const
 	Double_t cbiny = Double_t(j+0.5)*rangeY_/nBinsY_ + minY_;
 
 	// If bin centres are outside kinematic region, do not extrapolate
-	if (this->withinDPBoundaries(cbinx,cbiny) == kFALSE) {return this->getBinHistValue(i,j);}
+	const Bool_t centreInDP = ( i >= 0 && j >= 0 ) ? binCentreInDP_[ i*nBinsY_ + j ] : this->withinDPBoundaries(cbinx,cbiny);
+	if (centreInDP == kFALSE) {return this->getBinHistValue(i,j);}
 
 	// Find the adjacent bins
 	Double_t deltax = x - cbinx;
@@ -292,10 +376,13 @@ Double_t Lau2DHistDP::interpolateXY(Double_t x, Double_t y) const
 			Double_t dx1 = TMath::Abs(cbinx_adj - x);
 			Double_t inter_denom = dx0 + dx1;
 
-			Double_t value1 = this->getBinHistValue(i,j);
-			Double_t value2 = this->getBinHistValue(i_adj,j);
+			value = 1.0;
+			for ( UInt_t layer(0); layer < nLayers_; ++layer ) {
+				Double_t value1 = this->getBinLayerValue(i,j,layer);
+				Double_t value2 = this->getBinLayerValue(i_adj,j,layer);
 
-			value = (value1*dx1 + value2*dx0)/inter_denom;
+				value *= (value1*dx1 + value2*dx0)/inter_denom;
+			}
 
 		}
 
@@ -315,10 +402,13 @@ Double_t Lau2DHistDP::interpolateXY(Double_t x, Double_t y) const
 			Double_t dy1 = TMath::Abs(cbiny_adj - y);
 			Double_t inter_denom = dy0 + dy1;
 
-			Double_t value1 = this->getBinHistValue(i,j);
-			Double_t value2 = this->getBinHistValue(i,j_adj);
+			value = 1.0;
+			for ( UInt_t layer(0); layer < nLayers_; ++layer ) {
+				Double_t value1 = this->getBinLayerValue(i,j,layer);
+				Double_t value2 = this->getBinLayerValue(i,j_adj,layer);
 
-			value = (value1*dy1 + value2*dy0)/inter_denom;
+				value *= (value1*dy1 + value2*dy0)/inter_denom;
+			}
 
 		}
 
@@ -329,7 +419,7 @@ Double_t Lau2DHistDP::interpolateXY(Double_t x, Double_t y) const
 		Double_t cbinx_adj = Double_t(i_adj+0.5)*rangeX_/nBinsX_ + minX_;
 		Double_t cbiny_adj = Double_t(j_adj+0.5)*rangeY_/nBinsY_ + minY_;
 
-		if (this->withinDPBoundaries(cbinx_adj, cbiny_adj) == kFALSE) {
+		if (binCentreInDP_[ i_adj*nBinsY_ + j_adj ] == kFALSE) {
 
 			// The adjacent bin is outside the DP range. Don't extrapolate.
 			value = this->getBinHistValue(i,j);
@@ -343,13 +433,20 @@ Double_t Lau2DHistDP::interpolateXY(Double_t x, Double_t y) const
 
 			Double_t inter_denom = (dx0 + dx1)*(dy0 + dy1);
 
-			Double_t value1 = this->getBinHistValue(i,j);
-			Double_t value2 = this->getBinHistValue(i_adj,j);
-			Double_t value3 = this->getBinHistValue(i,j_adj);
-			Double_t value4 = this->getBinHistValue(i_adj,j_adj);
+			const Double_t w1 = dx1*dy1/inter_denom;
+			const Double_t w2 = dx0*dy1/inter_denom;
+			const Double_t w3 = dx1*dy0/inter_denom;
+			const Double_t w4 = dx0*dy0/inter_denom;
+
+			value = 1.0;
+			for ( UInt_t layer(0); layer < nLayers_; ++layer ) {
+				Double_t value1 = this->getBinLayerValue(i,j,layer);
+				Double_t value2 = this->getBinLayerValue(i_adj,j,layer);
+				Double_t value3 = this->getBinLayerValue(i,j_adj,layer);
+				Double_t value4 = this->getBinLayerValue(i_adj,j_adj,layer);
 
-			value = value1*dx1*dy1 + value2*dx0*dy1 + value3*dx1*dy0 + value4*dx0*dy0;
-			value /= inter_denom;
+				value *= value1*w1 + value2*w2 + value3*w3 + value4*w4;
+			}
 		}
 
 	}
@@ -164,6 +164,31 @@ Lau2DSplineDP::~Lau2DSplineDP()
 {
 	delete spline_;
 	spline_ = 0;
+
+	std::vector<Lau2DCubicSpline*>::iterator it = factors_.begin();
+	const std::vector<Lau2DCubicSpline*>::iterator end = factors_.end();
+	for ( ; it != end; ++it ) {
+		delete *it;
+	}
+	factors_.clear();
+}
+
+Bool_t Lau2DSplineDP::multiplySpline(Lau2DSplineDP& other)
+{
+	if ( spline_ == 0 || other.spline_ == 0 ||
+	     this->usingSquareDP() != other.usingSquareDP() ||
+	     this->usingUpperHalf() != other.usingUpperHalf() ||
+	     ! spline_->sameKnots(*other.spline_) ) {
+		return kFALSE;
+	}
+
+	factors_.push_back(other.spline_);
+	factors_.insert(factors_.end(), other.factors_.begin(), other.factors_.end());
+
+	other.spline_ = 0;
+	other.factors_.clear();
+
+	return kTRUE;
 }
 
 Double_t Lau2DSplineDP::interpolateXY(Double_t x, Double_t y) const
@@ -184,6 +209,10 @@ Double_t Lau2DSplineDP::interpolateXY(Double_t x, Double_t y) const
 		return 0.0;
 	}
 
-	return spline_->evaluate(x,y);
+	if ( factors_.empty() ) {
+		return spline_->evaluate(x,y);
+	}
+
+	return spline_->evaluateProduct(x,y,factors_);
 
 }
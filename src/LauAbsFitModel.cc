@@ -26,12 +26,23 @@ Thomas Latham
   \brief File containing implementation of LauAbsFitModel class.
  */
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "TH2.h"
 #include "TMessage.h"
 #include "TMonitor.h"
+#include "TROOT.h"
 #include "TSystem.h"
 #include "TVirtualFitter.h"
 
@@ -41,7 +52,10 @@ Thomas Latham
 #include "LauComplex.hh"
 #include "LauFitter.hh"
 #include "LauFitDataTree.hh"
+#include "LauFitNtuple.hh"
 #include "LauGenNtuple.hh"
+#include "LauIsobarDynamics.hh"
+#include "LauParallel.hh"
 #include "LauParameter.hh"
 #include "LauParamFixed.hh"
 #include "LauPrint.hh"
@@ -76,6 +90,8 @@ LauAbsFitModel::LauAbsFitModel() :
 	doSFit_(kFALSE),
 	sWeightBranchName_(""),
 	sWeightScaleFactor_(1.0),
+	batchStart_(0),
+	batchEnd_(0),
 	outputTableName_(""),
 	fitToyMCFileName_("fitToyMC.root"),
 	fitToyMCTableName_("fitToyMCTable"),
@@ -83,7 +99,22 @@ LauAbsFitModel::LauAbsFitModel() :
 	fitToyMCPoissonSmear_(kFALSE),
 	sPlotFileName_(""),
 	sPlotTreeName_(""),
-	sPlotVerbosity_("")
+	sPlotVerbosity_(""),
+	sPlotChunkSize_(0),
+	genNtupleQueueSize_(0),
+	weightChunkSize_(100000),
+	weightThreads_(1),
+	scanProcesses_(1),
+	scanFileName_(""),
+	scanTreeName_(""),
+	scanNtuple_(0),
+	checkpointFileName_(""),
+	checkpointInterval_(1000),
+	checkpointCalls_(0),
+	checkpointActive_(kFALSE),
+	resumedFromCheckpoint_(kFALSE),
+	checkpointExpt_(0),
+	checkpointBestNLL_(std::numeric_limits<Double_t>::max())
 {
 }
 
@@ -93,6 +124,7 @@ LauAbsFitModel::~LauAbsFitModel()
 	delete inputFitData_; inputFitData_ = 0;
 	delete genNtuple_; genNtuple_ = 0;
 	delete sPlotNtuple_; sPlotNtuple_ = 0;
+	delete scanNtuple_; scanNtuple_ = 0;
 }
 
 void LauAbsFitModel::run(const TString& applicationCode, const TString& dataFileName, const TString& dataTreeName,
@@ -110,6 +142,18 @@ void LauAbsFitModel::run(const TString& applicationCode, const TString& dataFile
 	TString dataFileNameCopy(dataFileName);
 	TString dataTreeNameCopy(dataTreeName);
 
+	// When resuming an interrupted fit, the integration grids saved with the
+	// checkpoint spare the DP models from evaluating them all again
+	if ( runCode.Contains("fit") && checkpointFileName_ != "" && ! gSystem->AccessPathName( checkpointFileName_ ) ) {
+		const std::vector<LauIsobarDynamics*> dpModels { this->checkpointDPModels() };
+		for ( UInt_t iModel(0); iModel < dpModels.size(); ++iModel ) {
+			const TString gridFileName { this->checkpointGridFileName( iModel ) };
+			if ( ! gSystem->AccessPathName( gridFileName ) ) {
+				dpModels[iModel]->readIntegrationGrid( gridFileName );
+			}
+		}
+	}
+
 	// Initialise the fit par vectors. Each class that inherits from this one
 	// must implement this sensibly for all vectors specified in clearFitParVectors,
 	// i.e. specify parameter names, initial, min, max and fixed values
@@ -273,6 +317,7 @@ void LauAbsFitModel::generate(const TString& dataFileName, const TString& dataTr
 	std::cout << "INFO in LauAbsFitModel::generate : Creating generation ntuple." << std::endl;
 	if (genNtuple_ != 0) {delete genNtuple_; genNtuple_ = 0;}
 	genNtuple_ = new LauGenNtuple(dataFileName,dataTreeName);
+	genNtuple_->asyncFill(genNtupleQueueSize_);
 
 	// add branches for storing the experiment number and the number of
 	// the event within the current experiment
@@ -362,6 +407,16 @@ void LauAbsFitModel::setGenNtupleDoubleBranchValue(const TString& name, Double_t
 	genNtuple_->setDoubleBranchValue(name,value);
 }
 
+LauGenNtuple::IntegerBranchHandle LauAbsFitModel::genNtupleIntegerBranchHandle(const TString& name)
+{
+	return genNtuple_->integerBranchHandle(name);
+}
+
+LauGenNtuple::DoubleBranchHandle LauAbsFitModel::genNtupleDoubleBranchHandle(const TString& name)
+{
+	return genNtuple_->doubleBranchHandle(name);
+}
+
 Int_t LauAbsFitModel::getGenNtupleIntegerBranchValue(const TString& name) const
 {
 	return genNtuple_->getIntegerBranchValue(name);
@@ -402,6 +457,109 @@ void LauAbsFitModel::fillSPlotNtupleBranches()
 	sPlotNtuple_->fillBranches();
 }
 
+void LauAbsFitModel::runWeightingTasks(const std::vector<LauWeightingTask>& tasks) const
+{
+	// Group together the tasks that update the same kinematics object,
+	// since those cannot safely be run at the same time
+	std::vector< std::vector<const LauWeightingTask*> > groups;
+	std::vector<const LauKinematics*> groupKinematics;
+	for ( std::vector<LauWeightingTask>::const_iterator iter = tasks.begin(); iter != tasks.end(); ++iter ) {
+		std::vector<const LauKinematics*>::const_iterator found = std::find( groupKinematics.begin(), groupKinematics.end(), iter->first );
+		if ( found == groupKinematics.end() ) {
+			groupKinematics.push_back( iter->first );
+			groups.push_back( std::vector<const LauWeightingTask*>( 1, &(*iter) ) );
+		} else {
+			groups[ found - groupKinematics.begin() ].push_back( &(*iter) );
+		}
+	}
+
+	const UInt_t nGroups = groups.size();
+	const UInt_t nThreads = std::min( weightThreads_, nGroups );
+	if ( nThreads > 1 ) {
+		ROOT::EnableThreadSafety();
+	}
+
+	auto runGroups = [&groups](const UInt_t /*iRange*/, const UInt_t firstGroup, const UInt_t lastGroup)
+	{
+		for ( UInt_t iGroup(firstGroup); iGroup < lastGroup; ++iGroup ) {
+			for ( std::vector<const LauWeightingTask*>::const_iterator iter = groups[iGroup].begin(); iter != groups[iGroup].end(); ++iter ) {
+				(*iter)->second();
+			}
+		}
+	};
+	LauParallel::forEachRange( nGroups, nThreads, 1, runGroups );
+}
+
+std::map<TString, TH2*> LauAbsFitModel::getDPLikelihoodHists( const TH2* binning )
+{
+	std::map<TString, TH2*> hists;
+	if ( binning == 0 ) {
+		std::cerr << "ERROR in LauAbsFitModel::getDPLikelihoodHists : The binning histogram pointer is null." << std::endl;
+		return hists;
+	}
+
+	const TAxis* xAxis = binning->GetXaxis();
+	const TAxis* yAxis = binning->GetYaxis();
+	const Int_t nBinsX = xAxis->GetNbins();
+	const Int_t nBinsY = yAxis->GetNbins();
+
+	std::vector<Double_t> m13Sq; m13Sq.reserve( nBinsX*nBinsY );
+	std::vector<Double_t> m23Sq; m23Sq.reserve( nBinsX*nBinsY );
+	for ( Int_t iX(1); iX <= nBinsX; ++iX ) {
+		for ( Int_t iY(1); iY <= nBinsY; ++iY ) {
+			m13Sq.push_back( xAxis->GetBinCenter( iX ) );
+			m23Sq.push_back( yAxis->GetBinCenter( iY ) );
+		}
+	}
+
+	const std::map< TString, std::vector<Double_t> > likelihoods = this->getDPLikelihoods( m13Sq, m23Sq );
+
+	for ( std::map< TString, std::vector<Double_t> >::const_iterator iter = likelihoods.begin(); iter != likelihoods.end(); ++iter ) {
+		TH2* hist = dynamic_cast<TH2*>( binning->Clone( TString(binning->GetName()) + "_" + iter->first ) );
+		hist->SetDirectory(0);
+		hist->Reset();
+		const std::vector<Double_t>& values = iter->second;
+		UInt_t iPoint(0);
+		for ( Int_t iX(1); iX <= nBinsX; ++iX ) {
+			for ( Int_t iY(1); iY <= nBinsY; ++iY ) {
+				hist->SetBinContent( iX, iY, values[iPoint++] );
+			}
+		}
+		hists[ iter->first ] = hist;
+	}
+
+	return hists;
+}
+
+void LauAbsFitModel::readDataColumns(const std::vector<TString>& names, const UInt_t firstEvt, const UInt_t nEvts, std::vector< std::vector<Double_t> >& columns) const
+{
+	const UInt_t nNames = names.size();
+	columns.resize( nNames );
+	for ( UInt_t iName(0); iName < nNames; ++iName ) {
+		columns[iName].resize( nEvts );
+	}
+
+	// Copy straight from the mapped columns when reading a flat file
+	if ( inputFitData_->isFlatFile() ) {
+		for ( UInt_t iName(0); iName < nNames; ++iName ) {
+			const Double_t* column = inputFitData_->getColumn( names[iName] );
+			if ( ! column ) {
+				std::cerr << "ERROR in LauAbsFitModel::readDataColumns : Variable \"" << names[iName] << "\" not found in the flat file." << std::endl;
+				gSystem->Exit(EXIT_FAILURE);
+			}
+			std::copy( column + firstEvt, column + firstEvt + nEvts, columns[iName].begin() );
+		}
+		return;
+	}
+
+	for ( UInt_t iEvt(0); iEvt < nEvts; ++iEvt ) {
+		const LauFitData& evtData = inputFitData_->getData( firstEvt + iEvt );
+		for ( UInt_t iName(0); iName < nNames; ++iName ) {
+			columns[iName][iEvt] = evtData.at( names[iName] );
+		}
+	}
+}
+
 void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeName, const TString& histFileName, const TString& tableFileNameBase)
 {
 	// Routine to perform the total fit.
@@ -412,22 +570,66 @@ void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeNam
 	std::cout << "INFO in LauAbsFitModel::fit : First experiment = " << firstExp << std::endl;
 	std::cout << "INFO in LauAbsFitModel::fit : Number of experiments = " << nExp << std::endl;
 
+	// Pick up where an interrupted job left off, if it left a checkpoint
+	UInt_t startExp = firstExp;
+	resumedFromCheckpoint_ = kFALSE;
+	if ( checkpointFileName_ != "" && this->readCheckpoint() ) {
+		if ( checkpointExpt_ < firstExp || checkpointExpt_ >= (firstExp+nExp) ) {
+			std::cerr << "WARNING in LauAbsFitModel::fit : Checkpoint is for experiment " << checkpointExpt_ << ", which is not in the range to be fitted, ignoring it." << std::endl;
+			checkpointPars_.clear();
+		} else {
+			std::cout << "INFO in LauAbsFitModel::fit : Resuming from checkpoint at experiment " << checkpointExpt_ << std::endl;
+			startExp = checkpointExpt_;
+			resumedFromCheckpoint_ = kTRUE;
+		}
+	}
+
 	// Start the cumulative timer
 	cumulTimer_.Start();
 
 	this->resetFitCounters();
 
+	// When resuming, the outputs are appended to, but anything saved for
+	// the interrupted experiment (e.g. if the job was killed between saving
+	// the outputs and recording the experiment in the checkpoint) is dropped
+	const TString resumeSelection { Form("iExpt<%u", startExp) };
+
 	// Create and setup the fit results ntuple
 	this->setupResultsOutputs( histFileName, tableFileNameBase );
+	if ( resumedFromCheckpoint_ ) {
+		this->fitNtuple()->keepEntries( resumeSelection );
+	}
 
 	// Create and setup the sPlot ntuple
 	if (this->writeSPlotData()) {
 		std::cout << "INFO in LauAbsFitModel::fit : Creating sPlot ntuple." << std::endl;
 		if (sPlotNtuple_ != 0) {delete sPlotNtuple_; sPlotNtuple_ = 0;}
-		sPlotNtuple_ = new LauGenNtuple(sPlotFileName_,sPlotTreeName_);
+		sPlotNtuple_ = new LauGenNtuple(sPlotFileName_,sPlotTreeName_,resumedFromCheckpoint_);
+		if ( resumedFromCheckpoint_ ) {
+			sPlotNtuple_->keepEntries( resumeSelection );
+		}
 		this->setupSPlotNtupleBranches();
 	}
 
+	// Create the profile likelihood scan ntuple
+	if ( ! scanParNames_.empty() ) {
+		std::cout << "INFO in LauAbsFitModel::fit : Creating profile likelihood scan ntuple." << std::endl;
+		delete scanNtuple_;
+		scanNtuple_ = new LauGenNtuple(scanFileName_,scanTreeName_,resumedFromCheckpoint_);
+		if ( resumedFromCheckpoint_ ) {
+			scanNtuple_->keepEntries( resumeSelection );
+		}
+		scanNtuple_->addIntegerBranch("iExpt");
+		scanNtuple_->addIntegerBranch("iScanPoint");
+		scanNtuple_->addIntegerBranch("fitStatus");
+		scanNtuple_->addDoubleBranch("NLL");
+		scanNtuple_->addDoubleBranch("deltaNLL");
+		scanNtuple_->addDoubleBranch("EDM");
+		for ( LauParameterPList::const_iterator iter = fitVars_.begin(); iter != fitVars_.end(); ++iter ) {
+			scanNtuple_->addDoubleBranch( (*iter)->name() );
+		}
+	}
+
 	// This reads in the given dataFile and creates an input
 	// fit data tree that stores them for all events and experiments.
 	Bool_t dataOK = this->verifyFitData(dataFileName,dataTreeName);
@@ -437,7 +639,7 @@ void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeNam
 	}
 
 	// Loop over the number of experiments
-	for (UInt_t iExp = firstExp; iExp < (firstExp+nExp); ++iExp) {
+	for (UInt_t iExp = startExp; iExp < (firstExp+nExp); ++iExp) {
 
 		// Start the timer to see how long each fit takes
 		timer_.Start();
@@ -448,6 +650,9 @@ void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeNam
 		if (nEvents < 1) {
 			std::cerr << "WARNING in LauAbsFitModel::fit : Zero events in experiment " << iExp << ", skipping..." << std::endl;
 			timer_.Stop();
+			if ( checkpointFileName_ != "" ) {
+				this->writeCheckpoint( iExp+1, kFALSE );
+			}
 			continue;
 		}
 
@@ -467,7 +672,9 @@ void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeNam
 		this->generateConstraintMeans( conVars_ );
 
 		// Do the fit for this experiment
+		checkpointActive_ = ( checkpointFileName_ != "" );
 		this->fitExpt();
+		checkpointActive_ = kFALSE;
 
 		// Write the results into the ntuple
 		this->finaliseFitResults( outputTableName_ );
@@ -487,6 +694,23 @@ void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeNam
 			this->createFitToyMC(fitToyMCFileName_, fitToyMCTableName_);
 		}
 
+		// Scan the profile likelihood around the minimum
+		if ( scanNtuple_ != 0 ) {
+			this->runProfileScan();
+		}
+
+		// Make sure the results so far are on disk and record that this experiment is done
+		if ( checkpointFileName_ != "" ) {
+			this->fitNtuple()->autoSave();
+			if ( sPlotNtuple_ != 0 ) {
+				sPlotNtuple_->autoSave();
+			}
+			if ( scanNtuple_ != 0 ) {
+				scanNtuple_->autoSave();
+			}
+			this->writeCheckpoint( iExp+1, kFALSE );
+		}
+
 	} // Loop over number of experiments
 
 	// Print out total timing info.
@@ -505,9 +729,23 @@ void LauAbsFitModel::fit(const TString& dataFileName, const TString& dataTreeNam
 
 	// Write out any fit results (ntuples etc...).
 	this->writeOutAllFitResults();
+	if ( scanNtuple_ != 0 ) {
+		scanNtuple_->writeOutGenResults();
+		delete scanNtuple_; scanNtuple_ = 0;
+	}
 	if ( this->writeSPlotData() ) {
 		this->calculateSPlotData();
 	}
+
+	// The job is complete, so there is nothing to resume
+	if ( checkpointFileName_ != "" ) {
+		gSystem->Unlink( checkpointFileName_ );
+		const UInt_t nDPModels = this->checkpointDPModels().size();
+		for ( UInt_t iModel(0); iModel < nDPModels; ++iModel ) {
+			gSystem->Unlink( this->checkpointGridFileName( iModel ) );
+		}
+	}
+	resumedFromCheckpoint_ = kFALSE;
 }
 
 void LauAbsFitModel::setupResultsOutputs( const TString& histFileName, const TString& tableFileName )
@@ -564,8 +802,32 @@ void LauAbsFitModel::fitExpt()
 	// Update initial fit parameters if required (e.g. if using random numbers).
 	this->checkInitFitParams();
 
+	// If resuming an interrupted fit, start from where it had got to
+	// (the nominal initial values are put back once the fit is done)
+	std::map<LauParameter*, Double_t> nominalInitValues;
+	if ( ! checkpointPars_.empty() ) {
+		for ( LauParameterPList::iterator iter = fitVars_.begin(); iter != fitVars_.end(); ++iter ) {
+			std::map< TString, std::pair<Double_t,Double_t> >::const_iterator found = checkpointPars_.find( (*iter)->name() );
+			if ( found == checkpointPars_.end() || (*iter)->fixed() ) {
+				continue;
+			}
+			nominalInitValues[ *iter ] = (*iter)->initValue();
+			(*iter)->initValue( found->second.first );
+			(*iter)->error( found->second.second );
+		}
+		std::cout << "INFO in LauAbsFitModel::fitExpt : Starting from the checkpointed values of " << nominalInitValues.size() << " parameters." << std::endl;
+		checkpointPars_.clear();
+	}
+
+	// Reset the record of the best point, used for checkpointing
+	checkpointBestNLL_ = std::numeric_limits<Double_t>::max();
+	checkpointBestValues_.clear();
+	checkpointCalls_ = 0;
+
 	// Initialise the fitter
 	LauFitter::fitter().useAsymmFitErrors( this->useAsymmFitErrors() );
+	LauFitter::fitter().useBatchedGradient( this->useBatchedGradient() );
+	LauFitter::fitter().minosProcesses( this->minosProcesses() );
 	LauFitter::fitter().twoStageFit( this->twoStageFit() );
 	LauFitter::fitter().initialise( this, fitVars_ );
 
@@ -595,16 +857,486 @@ void LauAbsFitModel::fitExpt()
 	// all sub-classes can use within their own finalFitResults implementation
 	// used below (e.g. putting them into an ntuple in a root file)
 	LauFitter::fitter().updateParameters();
+
+	for ( std::map<LauParameter*, Double_t>::const_iterator iter = nominalInitValues.begin(); iter != nominalInitValues.end(); ++iter ) {
+		iter->first->initValue( iter->second );
+	}
+}
+
+void LauAbsFitModel::setProfileScan(const TString& parName, const UInt_t nPoints, const Double_t minVal, const Double_t maxVal,
+		const TString& fileName, const TString& treeName)
+{
+	if ( nPoints == 0 ) {
+		std::cerr << "ERROR in LauAbsFitModel::setProfileScan : The number of scan points must be non-zero." << std::endl;
+		return;
+	}
+
+	scanParNames_.assign( 1, parName );
+	scanGrids_.assign( 1, std::vector<Double_t>( nPoints, minVal ) );
+	for ( UInt_t i(1); i < nPoints; ++i ) {
+		scanGrids_[0][i] = minVal + i * ( maxVal - minVal ) / ( nPoints - 1 );
+	}
+
+	scanFileName_ = fileName;
+	scanTreeName_ = treeName;
+}
+
+void LauAbsFitModel::setProfileScan(const TString& parName1, const UInt_t nPoints1, const Double_t minVal1, const Double_t maxVal1,
+		const TString& parName2, const UInt_t nPoints2, const Double_t minVal2, const Double_t maxVal2,
+		const TString& fileName, const TString& treeName)
+{
+	if ( nPoints2 == 0 ) {
+		std::cerr << "ERROR in LauAbsFitModel::setProfileScan : The number of scan points must be non-zero." << std::endl;
+		return;
+	}
+	if ( parName1 == parName2 ) {
+		std::cerr << "ERROR in LauAbsFitModel::setProfileScan : Cannot scan parameter \"" << parName1 << "\" against itself." << std::endl;
+		return;
+	}
+
+	this->setProfileScan( parName1, nPoints1, minVal1, maxVal1, fileName, treeName );
+	if ( scanParNames_.empty() ) {
+		return;
+	}
+
+	scanParNames_.push_back( parName2 );
+	scanGrids_.push_back( std::vector<Double_t>( nPoints2, minVal2 ) );
+	for ( UInt_t i(1); i < nPoints2; ++i ) {
+		scanGrids_[1][i] = minVal2 + i * ( maxVal2 - minVal2 ) / ( nPoints2 - 1 );
+	}
+}
+
+void LauAbsFitModel::runProfileScan()
+{
+	// Find the scanned parameters amongst the fit parameters
+	const UInt_t nScanPars = scanParNames_.size();
+	std::vector<UInt_t> scanParIndices( nScanPars, 0 );
+	const UInt_t nPars = fitVars_.size();
+	for ( UInt_t iScan(0); iScan < nScanPars; ++iScan ) {
+		UInt_t iPar(0);
+		while ( iPar < nPars && fitVars_[iPar]->name() != scanParNames_[iScan] ) {
+			++iPar;
+		}
+		if ( iPar == nPars ) {
+			std::cerr << "ERROR in LauAbsFitModel::runProfileScan : Could not find fit parameter \"" << scanParNames_[iScan] << "\", not running the scan." << std::endl;
+			return;
+		}
+		scanParIndices[iScan] = iPar;
+	}
+
+	// Remember the results of the nominal fit, so that they can be restored afterwards
+	const Double_t minNLL = this->nll();
+	const UInt_t nominalNParams = this->nTotParams();
+	const UInt_t nominalNFreeParams = this->nFreeParams();
+	const Double_t nominalWorstLogLike = this->worstLogLike();
+	std::vector<Double_t> bestValues( nPars ), initValues( nPars ), errors( nPars ), negErrors( nPars ), posErrors( nPars ), gccs( nPars );
+	std::vector<Bool_t> fixed( nPars );
+	for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+		const LauParameter* par = fitVars_[iPar];
+		bestValues[iPar] = par->value();
+		initValues[iPar] = par->initValue();
+		errors[iPar] = par->error();
+		negErrors[iPar] = par->negError();
+		posErrors[iPar] = par->posError();
+		gccs[iPar] = par->globalCorrelationCoeff();
+		fixed[iPar] = par->fixed();
+	}
+
+	// Find the scan point closest to the nominal minimum
+	const UInt_t nX = scanGrids_[0].size();
+	const UInt_t nY = ( nScanPars > 1 ) ? scanGrids_[1].size() : 1;
+	const UInt_t nPoints = nX * nY;
+	UInt_t startX[2] = { 0, 0 };
+	for ( UInt_t iScan(0); iScan < nScanPars; ++iScan ) {
+		const std::vector<Double_t>& grid = scanGrids_[iScan];
+		const Double_t best = bestValues[ scanParIndices[iScan] ];
+		for ( UInt_t i(1); i < grid.size(); ++i ) {
+			if ( TMath::Abs( grid[i] - best ) < TMath::Abs( grid[ startX[iScan] ] - best ) ) {
+				startX[iScan] = i;
+			}
+		}
+	}
+
+	// Visit the points in rings of increasing distance from there,
+	// so that each point has a completed neighbour to start from
+	auto ringDistance = [nY, &startX](const UInt_t iPoint)
+	{
+		const Int_t dX = TMath::Abs( static_cast<Int_t>( iPoint / nY ) - static_cast<Int_t>( startX[0] ) );
+		const Int_t dY = TMath::Abs( static_cast<Int_t>( iPoint % nY ) - static_cast<Int_t>( startX[1] ) );
+		return std::max( dX, dY );
+	};
+	std::vector<UInt_t> order( nPoints );
+	for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+		order[iPoint] = iPoint;
+	}
+	std::stable_sort( order.begin(), order.end(), [&ringDistance](const UInt_t a, const UInt_t b) { return ringDistance(a) < ringDistance(b); } );
+
+	// The scan points only need the minimum, not the errors
+	LauFitter::fitter().useAsymmFitErrors( kFALSE );
+	LauFitter::fitter().useBatchedGradient( this->useBatchedGradient() );
+	LauFitter::fitter().twoStageFit( kFALSE );
+
+	for ( UInt_t iScan(0); iScan < nScanPars; ++iScan ) {
+		fitVars_[ scanParIndices[iScan] ]->fixed( kTRUE );
+	}
+
+	std::cout << "INFO in LauAbsFitModel::runProfileScan : Scanning the profile likelihood at " << nPoints << " points in up to " << scanProcesses_ << " processes." << std::endl;
+
+	// Refit at each of the given points in turn, each starting from the minimum of the nearest of them already
+	// completed, and return for each point its index, the fit status, NLL and EDM, and the values of all the parameters
+	const UInt_t rowSize = 4 + nPars;
+	auto fitPoints = [&](const std::vector<UInt_t>& points)
+	{
+		std::vector<Double_t> rows;
+		rows.reserve( points.size() * rowSize );
+
+		std::vector< std::vector<Double_t> > minima( nPoints );
+		std::vector<UInt_t> completed;
+		completed.reserve( points.size() );
+
+		for ( std::vector<UInt_t>::const_iterator iter = points.begin(); iter != points.end(); ++iter ) {
+
+			const UInt_t iPoint = *iter;
+			const UInt_t iX = iPoint / nY;
+			const UInt_t iY = iPoint % nY;
+
+			// Start from the minimum of the nearest completed point, or the nominal minimum for the first point
+			const std::vector<Double_t>* startValues = &bestValues;
+			UInt_t nearestDist(0);
+			for ( std::vector<UInt_t>::const_iterator done = completed.begin(); done != completed.end(); ++done ) {
+				const UInt_t dX = ( *done / nY > iX ) ? *done / nY - iX : iX - *done / nY;
+				const UInt_t dY = ( *done % nY > iY ) ? *done % nY - iY : iY - *done % nY;
+				const UInt_t dist = dX*dX + dY*dY;
+				if ( startValues == &bestValues || dist < nearestDist ) {
+					startValues = &minima[ *done ];
+					nearestDist = dist;
+				}
+			}
+
+			for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+				fitVars_[iPar]->initValue( (*startValues)[iPar] );
+			}
+			const UInt_t gridIndices[2] = { iX, iY };
+			for ( UInt_t iScan(0); iScan < nScanPars; ++iScan ) {
+				LauParameter* par = fitVars_[ scanParIndices[iScan] ];
+				const Double_t scanValue = scanGrids_[iScan][ gridIndices[iScan] ];
+				par->initValue( scanValue );
+				par->value( scanValue );
+			}
+
+			LauFitter::fitter().initialise( this, fitVars_ );
+			this->startNewFit( LauFitter::fitter().nParameters(), LauFitter::fitter().nFreeParameters() );
+			const LauAbsFitter::FitStatus fitResult = LauFitter::fitter().minimise();
+			LauFitter::fitter().updateParameters();
+
+			std::vector<Double_t>& minimum = minima[iPoint];
+			minimum.resize( nPars );
+			for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+				minimum[iPar] = fitVars_[iPar]->value();
+			}
+			completed.push_back( iPoint );
+
+			rows.push_back( iPoint );
+			rows.push_back( fitResult.status );
+			rows.push_back( fitResult.NLL );
+			rows.push_back( fitResult.EDM );
+			rows.insert( rows.end(), minimum.begin(), minimum.end() );
+		}
+
+		return rows;
+	};
+
+	// Share out the points between the processes by their direction from the starting point, so that
+	// each share is a sector running outwards from the nominal minimum: its first point is next to
+	// the nominal minimum and each later one has a completed neighbour within the same share.
+	// Points in exactly the same direction are kept together, so a 1D scan has at most two shares.
+	auto direction = [nY, &startX](const UInt_t iPoint)
+	{
+		const Double_t dX = static_cast<Int_t>( iPoint / nY ) - static_cast<Int_t>( startX[0] );
+		const Double_t dY = static_cast<Int_t>( iPoint % nY ) - static_cast<Int_t>( startX[1] );
+		return TMath::ATan2( dY, dX );
+	};
+	std::vector<UInt_t> outerPoints( order.begin() + 1, order.end() );
+	std::stable_sort( outerPoints.begin(), outerPoints.end(), [&direction](const UInt_t a, const UInt_t b) { return direction(a) < direction(b); } );
+
+	const UInt_t nOuter = outerPoints.size();
+	std::vector< std::vector<UInt_t> > shares;
+	UInt_t shareEnd(0);
+	for ( UInt_t iProc(1); iProc <= scanProcesses_ && shareEnd < nOuter; ++iProc ) {
+		const UInt_t shareStart = shareEnd;
+		shareEnd = std::max( iProc * nOuter / scanProcesses_, shareStart + 1 );
+		while ( shareEnd < nOuter && direction( outerPoints[shareEnd] ) == direction( outerPoints[shareEnd-1] ) ) {
+			++shareEnd;
+		}
+		// within each share, visit the points in rings of increasing distance from the starting point
+		std::vector<UInt_t> share( outerPoints.begin() + shareStart, outerPoints.begin() + shareEnd );
+		std::stable_sort( share.begin(), share.end(), [&ringDistance](const UInt_t a, const UInt_t b) { return ringDistance(a) < ringDistance(b); } );
+		shares.push_back( share );
+	}
+
+	// The starting point itself goes to the share done in this process
+	if ( shares.empty() ) {
+		shares.push_back( std::vector<UInt_t>() );
+	}
+	shares.back().insert( shares.back().begin(), order[0] );
+	const UInt_t nShares = shares.size();
+
+	// Make sure nothing buffered gets written out by the children as well
+	std::cout.flush();
+	std::cerr.flush();
+	std::fflush(nullptr);
+
+	// The last share is done in this process, the others are each done in a forked process
+	// that sends back its rows, which are then stored in the ntuple here
+	std::vector<pid_t> pids;
+	std::vector<Int_t> pipes;
+	std::vector<UInt_t> localPoints;
+	for ( UInt_t iShare(0); iShare < nShares; ++iShare ) {
+
+		const std::vector<UInt_t>& points = shares[iShare];
+
+		Int_t fds[2] = { -1, -1 };
+		pid_t pid(-1);
+		if ( iShare+1 < nShares && ::pipe(fds) == 0 ) {
+			pid = ::fork();
+			if ( pid < 0 ) {
+				::close(fds[0]);
+				::close(fds[1]);
+			}
+		}
+
+		if ( pid == 0 ) {
+			// In the child: fit this share of the points and send back the rows
+			::close(fds[0]);
+			const std::vector<Double_t> rows = fitPoints( points );
+
+			const char* data = reinterpret_cast<const char*>( rows.data() );
+			size_t toWrite = rows.size() * sizeof(Double_t);
+			while ( toWrite > 0 ) {
+				const ssize_t written = ::write(fds[1], data, toWrite);
+				if ( written <= 0 ) {
+					break;
+				}
+				data += written;
+				toWrite -= written;
+			}
+			::close(fds[1]);
+			::_exit( EXIT_SUCCESS );
+		}
+
+		if ( pid < 0 ) {
+			// Not forked, so do this share here once the children have been started
+			if ( iShare+1 < nShares ) {
+				std::cerr << "WARNING in LauAbsFitModel::runProfileScan : Unable to fork process " << iShare << ", its points will be done in this process." << std::endl;
+			}
+			localPoints.insert( localPoints.end(), points.begin(), points.end() );
+			continue;
+		}
+
+		::close(fds[1]);
+		pids.push_back(pid);
+		pipes.push_back(fds[0]);
+	}
+
+	std::vector<Double_t> rows = fitPoints( localPoints );
+
+	// Gather the rows from the children
+	for ( UInt_t iChild(0); iChild < pids.size(); ++iChild ) {
+
+		std::vector<char> bytes;
+		char buffer[4096];
+		ssize_t nRead(0);
+		while ( ( nRead = ::read(pipes[iChild], buffer, sizeof(buffer)) ) > 0 ) {
+			bytes.insert( bytes.end(), buffer, buffer + nRead );
+		}
+		::close(pipes[iChild]);
+
+		Int_t childStatus(0);
+		::waitpid(pids[iChild], &childStatus, 0);
+
+		// Only take complete rows
+		const UInt_t nRows = bytes.size() / ( rowSize * sizeof(Double_t) );
+		const std::vector<Double_t>::size_type nFilled = rows.size();
+		rows.resize( nFilled + nRows * rowSize );
+		std::copy( bytes.begin(), bytes.begin() + nRows * rowSize * sizeof(Double_t), reinterpret_cast<char*>( rows.data() + nFilled ) );
+	}
+
+	// Store the rows in the ntuple, in the order in which the points were visited
+	std::vector<const Double_t*> pointRows( nPoints, nullptr );
+	for ( std::vector<Double_t>::size_type iRow(0); iRow < rows.size(); iRow += rowSize ) {
+		const UInt_t iPoint = static_cast<UInt_t>( rows[iRow] );
+		if ( iPoint < nPoints ) {
+			pointRows[iPoint] = &rows[iRow];
+		}
+	}
+	UInt_t nMissing(0);
+	for ( std::vector<UInt_t>::const_iterator iter = order.begin(); iter != order.end(); ++iter ) {
+		const UInt_t iPoint = *iter;
+		const Double_t* row = pointRows[iPoint];
+		if ( ! row ) {
+			++nMissing;
+			continue;
+		}
+		for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+			scanNtuple_->setDoubleBranchValue( fitVars_[iPar]->name(), row[4+iPar] );
+		}
+		scanNtuple_->setIntegerBranchValue( "iExpt", this->iExpt() );
+		scanNtuple_->setIntegerBranchValue( "iScanPoint", iPoint );
+		scanNtuple_->setIntegerBranchValue( "fitStatus", static_cast<Int_t>( row[1] ) );
+		scanNtuple_->setDoubleBranchValue( "NLL", row[2] );
+		scanNtuple_->setDoubleBranchValue( "deltaNLL", row[2] - minNLL );
+		scanNtuple_->setDoubleBranchValue( "EDM", row[3] );
+		scanNtuple_->fillBranches();
+	}
+	if ( nMissing > 0 ) {
+		std::cerr << "ERROR in LauAbsFitModel::runProfileScan : Incomplete results from the scan processes, " << nMissing << " points are missing." << std::endl;
+	}
+
+	// Restore the results of the nominal fit
+	for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+		LauParameter* par = fitVars_[iPar];
+		par->fixed( fixed[iPar] );
+		par->initValue( initValues[iPar] );
+		par->valueAndErrors( bestValues[iPar], errors[iPar], negErrors[iPar], posErrors[iPar] );
+		par->globalCorrelationCoeff( gccs[iPar] );
+	}
+	this->startNewFit( nominalNParams, nominalNFreeParams );
+	this->worstLogLike( nominalWorstLogLike );
+
+	// and bring the fitter and the model back into line with them
+	LauFitter::fitter().useAsymmFitErrors( this->useAsymmFitErrors() );
+	LauFitter::fitter().twoStageFit( this->twoStageFit() );
+	LauFitter::fitter().initialise( this, fitVars_ );
+	this->recalculateNormalisation();
+	this->propagateParUpdates();
+}
+
+void LauAbsFitModel::useCheckpointing(const TString& fileName, const UInt_t nCalls)
+{
+	if ( fileName == "" || nCalls == 0 ) {
+		std::cerr << "ERROR in LauAbsFitModel::useCheckpointing : A file name and a non-zero number of calls between checkpoints must be given." << std::endl;
+		return;
+	}
+
+	checkpointFileName_ = fileName;
+	checkpointInterval_ = nCalls;
+}
+
+Bool_t LauAbsFitModel::readCheckpoint()
+{
+	checkpointPars_.clear();
+
+	std::ifstream fin( checkpointFileName_.Data() );
+	if ( ! fin ) {
+		return kFALSE;
+	}
+
+	// The file consists of an "experiment" entry followed by any number of "parameter" entries
+	Bool_t haveExpt(kFALSE);
+	std::string key;
+	while ( fin >> key ) {
+		if ( key == "experiment" ) {
+			haveExpt = static_cast<Bool_t>( fin >> checkpointExpt_ );
+		} else if ( key == "parameter" ) {
+			std::string name;
+			Double_t value(0.0), stepSize(0.0);
+			if ( ! ( fin >> name >> value >> stepSize ) ) {
+				break;
+			}
+			checkpointPars_[ name.c_str() ] = std::make_pair( value, stepSize );
+		} else {
+			break;
+		}
+	}
+
+	if ( ! haveExpt || ! fin.eof() ) {
+		std::cerr << "ERROR in LauAbsFitModel::readCheckpoint : Could not read checkpoint file \"" << checkpointFileName_ << "\", ignoring it." << std::endl;
+		checkpointPars_.clear();
+		return kFALSE;
+	}
+
+	return kTRUE;
+}
+
+void LauAbsFitModel::writeCheckpoint(const UInt_t iExpt, const Bool_t withPars) const
+{
+	// Write to a temporary file and then move it into place, so that
+	// the job being killed part way through cannot leave a truncated checkpoint
+	const TString tmpFileName { checkpointFileName_ + ".tmp" };
+	std::ofstream fout( tmpFileName.Data() );
+	fout << "experiment " << iExpt << "\n";
+
+	if ( withPars && checkpointBestValues_.size() == fitVars_.size() ) {
+		const std::vector<Double_t> stepSizes { LauFitter::fitter().currentStepSizes() };
+		fout << std::setprecision(17);
+		for ( UInt_t i(0); i < fitVars_.size(); ++i ) {
+			if ( fitVars_[i]->fixed() || i >= stepSizes.size() ) {
+				continue;
+			}
+			fout << "parameter " << fitVars_[i]->name() << " " << checkpointBestValues_[i] << " " << stepSizes[i] << "\n";
+		}
+	}
+
+	fout.close();
+	if ( ! fout ) {
+		std::cerr << "ERROR in LauAbsFitModel::writeCheckpoint : Problem writing checkpoint file \"" << tmpFileName << "\"." << std::endl;
+		return;
+	}
+
+	gSystem->Rename( tmpFileName, checkpointFileName_ );
+}
+
+void LauAbsFitModel::updateCheckpoint(const Double_t negLogLike)
+{
+	// Keep track of the best point seen so far - the points MINUIT tries
+	// can be anywhere, so that is the one worth restarting from
+	Bool_t newBest(kFALSE);
+	if ( negLogLike < checkpointBestNLL_ ) {
+		checkpointBestNLL_ = negLogLike;
+		checkpointBestValues_.resize( fitVars_.size() );
+		for ( UInt_t i(0); i < fitVars_.size(); ++i ) {
+			checkpointBestValues_[i] = fitVars_[i]->value();
+		}
+		newBest = kTRUE;
+	}
+
+	// Once a checkpoint is due, wait (for at most another interval) for a
+	// new best point, since only then do the integration grids of the DP
+	// models correspond to the checkpointed values and can be saved with them
+	++checkpointCalls_;
+	if ( ( newBest && checkpointCalls_ >= checkpointInterval_ ) || checkpointCalls_ >= 2*checkpointInterval_ ) {
+		if ( newBest ) {
+			const std::vector<LauIsobarDynamics*> dpModels { this->checkpointDPModels() };
+			for ( UInt_t iModel(0); iModel < dpModels.size(); ++iModel ) {
+				dpModels[iModel]->writeIntegrationGrid( this->checkpointGridFileName( iModel ) );
+			}
+		}
+		this->writeCheckpoint( this->iExpt(), kTRUE );
+		checkpointCalls_ = 0;
+	}
+}
+
+TString LauAbsFitModel::checkpointGridFileName(const UInt_t iModel) const
+{
+	TString fileName { checkpointFileName_ };
+	fileName += ".grid";
+	fileName += iModel;
+	return fileName;
 }
 
 void LauAbsFitModel::calculateSPlotData()
 {
 	if (sPlotNtuple_ != 0) {
-		sPlotNtuple_->addFriendTree(inputFitData_->fileName(), inputFitData_->treeName());
+		if ( inputFitData_->isFlatFile() ) {
+			std::cerr << "WARNING in LauAbsFitModel::calculateSPlotData : Input data were read from a flat file, which cannot be added as a friend of the sPlot tree." << std::endl;
+		} else {
+			sPlotNtuple_->addFriendTree(inputFitData_->fileName(), inputFitData_->treeName());
+		}
 		sPlotNtuple_->writeOutGenResults();
 		LauSPlot splot(sPlotNtuple_->fileName(), sPlotNtuple_->treeName(), this->firstExpt(), this->nExpt(),
 				this->variableNames(), this->freeSpeciesNames(), this->fixdSpeciesNames(), this->twodimPDFs(),
 				this->splitSignal(), this->scfDPSmear());
+		splot.useStreaming(sPlotChunkSize_);
 		splot.runCalculations(sPlotVerbosity_);
 		splot.writeOutResults();
 	}
@@ -735,8 +1467,9 @@ Double_t LauAbsFitModel::getTotNegLogLikelihood()
 	// This function assumes that the fit parameters and data tree have
 	// already been set-up correctly.
 
-	// Loop over the data points to calculate the log likelihood
-	Double_t logLike = this->getLogLikelihood( 0, this->eventsPerExpt() );
+	// Loop over the data points to calculate the log likelihood,
+	// or over the bins if the binned approximation is in use
+	Double_t logLike = this->binnedLikelihood() ? this->getBinnedLogLikelihood() : this->getLogLikelihood( 0, this->eventsPerExpt() );
 
 	// Include the Poisson term in the extended likelihood if required
 	if (this->doEMLFit()) {
@@ -750,6 +1483,12 @@ Double_t LauAbsFitModel::getTotNegLogLikelihood()
 	}
 
 	Double_t totNegLogLike = -logLike;
+
+	// Keep the checkpoint of the fit in progress up to date
+	if ( checkpointActive_ && ! this->withinAsymErrorCalc() ) {
+		this->updateCheckpoint( totNegLogLike );
+	}
+
 	return totNegLogLike;
 }
 
@@ -779,6 +1518,13 @@ Double_t LauAbsFitModel::getLogLikelihood( UInt_t iStart, UInt_t iEnd )
 	Double_t logLike(0.0);
 	const Double_t worstLL = this->worstLogLike();
 
+	// Enable the batch evaluation of the PDF products for this range of events
+	batchStart_ = iStart;
+	batchEnd_ = iEnd;
+	for ( std::map<const LauPdfList*, std::vector<Double_t>>::iterator iter = batchPdfProducts_.begin(); iter != batchPdfProducts_.end(); ++iter ) {
+		iter->second.clear();
+	}
+
 	// Loop over the number of events in this experiment
 	Bool_t ok(kTRUE);
 	for (UInt_t iEvt = iStart; iEvt < iEnd; ++iEvt) {
@@ -801,6 +1547,10 @@ Double_t LauAbsFitModel::getLogLikelihood( UInt_t iStart, UInt_t iEnd )
 		}
 	}
 
+	// Disable the batch evaluation again
+	batchStart_ = 0;
+	batchEnd_ = 0;
+
 	if (!ok) {
 		std::cerr << "                                                  : Returning worst NLL found so far to force MINUIT out of this region." << std::endl;
 		logLike = worstLL;
@@ -981,6 +1731,35 @@ void LauAbsFitModel::cacheInfo(LauPdfList& pdfList, const LauFitDataTree& theDat
 
 Double_t LauAbsFitModel::prodPdfValue(LauPdfList& pdfList, UInt_t iEvt)
 {
+	// If we're within getLogLikelihood, see if this list can be evaluated for all events in one go
+	if ( iEvt >= batchStart_ && iEvt < batchEnd_ && !pdfList.empty() ) {
+
+		Bool_t canBatch(kTRUE);
+		for (LauPdfList::const_iterator pdf_iter = pdfList.begin(); pdf_iter != pdfList.end(); ++pdf_iter) {
+			const LauAbsPdf* pdf = (*pdf_iter);
+			if ( pdf->isDPDependent() || ! ( pdf->hasBatchKernel() || pdf->cachePDF() ) ) {
+				canBatch = kFALSE;
+				break;
+			}
+		}
+
+		if ( canBatch ) {
+			std::vector<Double_t>& products = batchPdfProducts_[ &pdfList ];
+			if ( products.empty() ) {
+				const UInt_t nEvts = batchEnd_ - batchStart_;
+				products.assign( nEvts, 1.0 );
+				batchPdfValues_.resize( nEvts );
+				for (LauPdfList::iterator pdf_iter = pdfList.begin(); pdf_iter != pdfList.end(); ++pdf_iter) {
+					(*pdf_iter)->calcLikelihoods( batchStart_, nEvts, &batchPdfValues_[0] );
+					for ( UInt_t i(0); i < nEvts; ++i ) {
+						products[i] *= batchPdfValues_[i];
+					}
+				}
+			}
+			return products[ iEvt - batchStart_ ];
+		}
+	}
+
 	Double_t pdfVal = 1.0;
 	for (LauPdfList::iterator pdf_iter = pdfList.begin(); pdf_iter != pdfList.end(); ++pdf_iter) {
 		(*pdf_iter)->calcLikelihoodInfo(iEvt);
@@ -37,6 +37,7 @@ Thomas Latham
 #include "LauRandom.hh"
 #include "LauIntegrals.hh"
 #include "LauKinematics.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauAbsPdf)
 
@@ -57,7 +58,13 @@ LauAbsPdf::LauAbsPdf(const TString& theVarName, const std::vector<LauAbsRValue*>
 	integMethod_(GaussLegendre),
 	withinNormCalc_(kFALSE),
 	withinGeneration_(kFALSE),
-	normWeightsDone_(kFALSE)
+	normWeightsDone_(kFALSE),
+	trapezoidNorm_(0.0),
+	normUpToDate_(kFALSE),
+	useGenTable_(kFALSE),
+	genTableBins_(1000),
+	genTableDPCells_(10),
+	genTableExceeded_(kFALSE)
 {
 	// Store the variable name
 	varNames_.insert( std::make_pair( 0, theVarName ) );
@@ -83,7 +90,13 @@ LauAbsPdf::LauAbsPdf(const std::vector<TString>& theVarNames, const std::vector<
 	integMethod_(GaussLegendre),
 	withinNormCalc_(kFALSE),
 	withinGeneration_(kFALSE),
-	normWeightsDone_(kFALSE)
+	normWeightsDone_(kFALSE),
+	trapezoidNorm_(0.0),
+	normUpToDate_(kFALSE),
+	useGenTable_(kFALSE),
+	genTableBins_(1000),
+	genTableDPCells_(10),
+	genTableExceeded_(kFALSE)
 {
 	// Check that we have at least one variable
 	if ( theVarNames.empty() ) {
@@ -203,6 +216,7 @@ void LauAbsPdf::setMinAbscissa(const TString& theVarName, Double_t minAbscissa)
 		const TString& name = iter->second;
 		if ( name == theVarName ) {
 			minAbscissas_[ index ] = minAbscissa;
+			normUpToDate_ = kFALSE;
 			return;
 		}
 	}
@@ -217,6 +231,7 @@ void LauAbsPdf::setMaxAbscissa(const TString& theVarName, Double_t maxAbscissa)
 		const TString& name = iter->second;
 		if ( name == theVarName ) {
 			maxAbscissas_[ index ] = maxAbscissa;
+			normUpToDate_ = kFALSE;
 			return;
 		}
 	}
@@ -270,24 +285,46 @@ void LauAbsPdf::cacheInfo(const LauFitDataTree& inputData)
 	// clear the vectors and reserve enough space
 	UInt_t nEvents = inputData.nEvents();
 	abscissas_.clear(); abscissas_.reserve(nEvents);
+	abscissaColumn_.clear(); abscissaColumn_.reserve(nEvents);
 	unNormPDFValues_.clear(); unNormPDFValues_.reserve(nEvents);
 
-	for (UInt_t iEvt = 0; iEvt < nEvents; ++iEvt) {
-
-		const LauFitData& dataValues = inputData.getData(iEvt);
-
-		LauAbscissas myData;
-		// add all our variables into the data
+	// Read the values directly from the columns when we can
+	std::vector<const Double_t*> columns;
+	if ( inputData.isFlatFile() ) {
 		for ( std::map<UInt_t,TString>::const_iterator var_iter = varNames_.begin(); var_iter != varNames_.end(); ++var_iter ) {
-			LauFitData::const_iterator iter = dataValues.find( var_iter->second );
-			myData.push_back( iter->second );
+			columns.push_back( inputData.getColumn( var_iter->second ) );
 		}
-		// if we're DP dependent then we'll need the DP co-ordinates as well
 		if ( this->isDPDependent() ) {
-			LauFitData::const_iterator iter = dataValues.find( "m13Sq" );
-			myData.push_back( iter->second );
-			iter = dataValues.find( "m23Sq" );
-			myData.push_back( iter->second );
+			columns.push_back( inputData.getColumn( "m13Sq" ) );
+			columns.push_back( inputData.getColumn( "m23Sq" ) );
+		}
+		if ( std::find( columns.begin(), columns.end(), static_cast<const Double_t*>(0) ) != columns.end() ) {
+			columns.clear();
+		}
+	}
+
+	for (UInt_t iEvt = 0; iEvt < nEvents; ++iEvt) {
+
+		LauAbscissas myData;
+		if ( ! columns.empty() ) {
+			for ( std::vector<const Double_t*>::const_iterator col_iter = columns.begin(); col_iter != columns.end(); ++col_iter ) {
+				myData.push_back( (*col_iter)[iEvt] );
+			}
+		} else {
+			const LauFitData& dataValues = inputData.getData(iEvt);
+
+			// add all our variables into the data
+			for ( std::map<UInt_t,TString>::const_iterator var_iter = varNames_.begin(); var_iter != varNames_.end(); ++var_iter ) {
+				LauFitData::const_iterator iter = dataValues.find( var_iter->second );
+				myData.push_back( iter->second );
+			}
+			// if we're DP dependent then we'll need the DP co-ordinates as well
+			if ( this->isDPDependent() ) {
+				LauFitData::const_iterator iter = dataValues.find( "m13Sq" );
+				myData.push_back( iter->second );
+				iter = dataValues.find( "m23Sq" );
+				myData.push_back( iter->second );
+			}
 		}
 
 		if (!this->checkRange(myData)) {
@@ -295,6 +332,7 @@ void LauAbsPdf::cacheInfo(const LauFitDataTree& inputData)
 		}
 
 		abscissas_.push_back( myData );
+		abscissaColumn_.push_back( myData[0] );
 
 		if (this->cachePDF()) {
 			this->calcLikelihoodInfo( myData );
@@ -334,7 +372,11 @@ LauFitData LauAbsPdf::generate(const LauKinematics* kinematics)
 	// container for holding the generated abscissa(s)
 	LauAbscissas genAbscissa(1);
 
-	// Generate the value of the abscissa.
+	// Generate the value of the abscissa, using the tabulated envelope if requested
+	if ( useGenTable_ ) {
+		gotAbscissa = this->generateFromTable( kinematics, genAbscissa );
+	}
+
 	Double_t genPDFVal(0.0);
 	Double_t PDFheight = this->getMaxHeight()*(1.0+1e-11);
 	while (!gotAbscissa) {
@@ -365,6 +407,259 @@ LauFitData LauAbsPdf::generate(const LauKinematics* kinematics)
 	return genData;
 }
 
+void LauAbsPdf::useGenTable(Bool_t useTable, UInt_t nBins, UInt_t nDPCells)
+{
+	if ( useTable && ( nBins == 0 || nDPCells == 0 ) ) {
+		std::cerr << "ERROR in LauAbsPdf::useGenTable : The number of bins and DP cells must be non-zero." << std::endl;
+		return;
+	}
+
+	if ( useTable && this->nInputVars() > 1 ) {
+		std::cerr << "ERROR in LauAbsPdf::useGenTable : Tabulated generation only works for 1D PDFs." << std::endl;
+		return;
+	}
+
+	useGenTable_ = useTable;
+	genTableBins_ = nBins;
+	genTableDPCells_ = nDPCells;
+
+	genTables_.clear();
+	genTableParValues_.clear();
+	genTableExceeded_ = kFALSE;
+}
+
+Bool_t LauAbsPdf::checkGenTable()
+{
+	const Bool_t ok = ! genTableExceeded_;
+	genTableExceeded_ = kFALSE;
+	return ok;
+}
+
+Bool_t LauAbsPdf::generateFromTable(const LauKinematics* kinematics, LauAbscissas& genAbscissa)
+{
+	// Check whether the parameter values or range have changed since the tables were made
+	const UInt_t nPars = param_.size();
+	std::vector<Double_t> currentValues;
+	currentValues.reserve( nPars + 2 );
+	for ( UInt_t i(0); i < nPars; ++i ) {
+		currentValues.push_back( param_[i]->unblindValue() );
+	}
+	currentValues.push_back( this->getMinAbscissa() );
+	currentValues.push_back( this->getMaxAbscissa() );
+
+	if ( currentValues != genTableParValues_ ) {
+		genTables_.clear();
+		genTableParValues_ = currentValues;
+	}
+
+	// Find which DP cell we are in
+	UInt_t iCell(0);
+	if ( this->isDPDependent() ) {
+		const Double_t m13SqMin = kinematics->getm13SqMin();
+		const Double_t m23SqMin = kinematics->getm23SqMin();
+		const Double_t m13SqRange = kinematics->getm13SqMax() - m13SqMin;
+		const Double_t m23SqRange = kinematics->getm23SqMax() - m23SqMin;
+
+		Int_t i13 = static_cast<Int_t>( genTableDPCells_ * ( kinematics->getm13Sq() - m13SqMin ) / m13SqRange );
+		Int_t i23 = static_cast<Int_t>( genTableDPCells_ * ( kinematics->getm23Sq() - m23SqMin ) / m23SqRange );
+		i13 = TMath::Max( 0, TMath::Min( i13, static_cast<Int_t>(genTableDPCells_) - 1 ) );
+		i23 = TMath::Max( 0, TMath::Min( i23, static_cast<Int_t>(genTableDPCells_) - 1 ) );
+
+		iCell = i13 * genTableDPCells_ + i23;
+
+		genAbscissa.resize(3);
+		genAbscissa[1] = kinematics->getm13Sq();
+		genAbscissa[2] = kinematics->getm23Sq();
+	}
+
+	// Make the table for this cell if we don't already have it
+	std::map<UInt_t,GenTable>::iterator iter = genTables_.find( iCell );
+	if ( iter == genTables_.end() ) {
+		GenTable table;
+		if ( ! this->buildGenTable( kinematics, iCell, table ) ) {
+			return kFALSE;
+		}
+		iter = genTables_.insert( std::make_pair( iCell, table ) ).first;
+	}
+	GenTable& table = iter->second;
+
+	const Double_t minAbscissa = this->getMinAbscissa();
+	const Double_t maxAbscissa = this->getMaxAbscissa();
+	const Double_t binWidth = this->getRange() / genTableBins_;
+
+	while ( kTRUE ) {
+
+		// Choose the bin using the alias method
+		const Double_t r = randomFun_->Rndm() * genTableBins_;
+		UInt_t iBin = TMath::Min( static_cast<UInt_t>(r), genTableBins_ - 1 );
+		if ( r - iBin >= table.prob_[iBin] ) {
+			iBin = table.alias_[iBin];
+		}
+
+		// Then the position within the bin
+		genAbscissa[0] = minAbscissa + ( iBin + randomFun_->Rndm() ) * binWidth;
+		if ( genAbscissa[0] > maxAbscissa ) {
+			genAbscissa[0] = maxAbscissa;
+		}
+
+		// And finally accept or reject against the envelope
+		this->calcLikelihoodInfo(genAbscissa);
+		const Double_t genPDFVal = this->getUnNormLikelihood();
+		const Double_t height = table.heights_[iBin];
+
+		const Bool_t accepted = ( randomFun_->Rndm() * height <= genPDFVal );
+
+		// If the envelope has been exceeded, raise it in this bin, the
+		// generation should then be restarted since it is biased
+		if (genPDFVal > height) {
+			std::cerr << "WARNING in LauAbsPdf::generateFromTable : genPDFVal = " << genPDFVal << " is larger than the envelope height " << height << " for the abscissa = " << genAbscissa[0] << "." << std::endl;
+			std::cerr << "                                        : Raising the envelope in this bin, the generation needs to be restarted." << std::endl;
+			table.heights_[iBin] = genPDFVal * 1.2;
+			this->buildGenTableAlias( table );
+			genTableExceeded_ = kTRUE;
+		}
+
+		if (accepted) {
+			return kTRUE;
+		}
+	}
+}
+
+Bool_t LauAbsPdf::buildGenTable(const LauKinematics* kinematics, UInt_t iCell, GenTable& table)
+{
+	const UInt_t nBins = genTableBins_;
+	const Double_t minAbscissa = this->getMinAbscissa();
+	const Double_t maxAbscissa = this->getMaxAbscissa();
+	const Double_t binWidth = this->getRange() / nBins;
+
+	// Determine the DP points at which to evaluate the PDF:
+	// the corners and centre of the DP cell
+	std::vector< std::pair<Double_t,Double_t> > dpPoints;
+	if ( this->isDPDependent() ) {
+		const UInt_t i13 = iCell / genTableDPCells_;
+		const UInt_t i23 = iCell % genTableDPCells_;
+		const Double_t m13SqWidth = ( kinematics->getm13SqMax() - kinematics->getm13SqMin() ) / genTableDPCells_;
+		const Double_t m23SqWidth = ( kinematics->getm23SqMax() - kinematics->getm23SqMin() ) / genTableDPCells_;
+		const Double_t m13SqLow = kinematics->getm13SqMin() + i13 * m13SqWidth;
+		const Double_t m23SqLow = kinematics->getm23SqMin() + i23 * m23SqWidth;
+
+		dpPoints.push_back( std::make_pair( m13SqLow, m23SqLow ) );
+		dpPoints.push_back( std::make_pair( m13SqLow + m13SqWidth, m23SqLow ) );
+		dpPoints.push_back( std::make_pair( m13SqLow, m23SqLow + m23SqWidth ) );
+		dpPoints.push_back( std::make_pair( m13SqLow + m13SqWidth, m23SqLow + m23SqWidth ) );
+		dpPoints.push_back( std::make_pair( m13SqLow + 0.5*m13SqWidth, m23SqLow + 0.5*m23SqWidth ) );
+	} else {
+		dpPoints.push_back( std::make_pair( 0.0, 0.0 ) );
+	}
+
+	// Evaluate the PDF at the edges and centre of each bin and find the largest and smallest values
+	std::vector<Double_t> maxVals( nBins, 0.0 );
+	std::vector<Double_t> minVals( nBins, 0.0 );
+
+	LauAbscissas point( this->isDPDependent() ? 3 : 1 );
+	for ( UInt_t iPoint(0); iPoint < dpPoints.size(); ++iPoint ) {
+
+		if ( this->isDPDependent() ) {
+			point[1] = dpPoints[iPoint].first;
+			point[2] = dpPoints[iPoint].second;
+		}
+
+		point[0] = minAbscissa;
+		this->calcLikelihoodInfo(point);
+		Double_t lowVal = this->getUnNormLikelihood();
+
+		for ( UInt_t iBin(0); iBin < nBins; ++iBin ) {
+			point[0] = minAbscissa + ( iBin + 0.5 ) * binWidth;
+			this->calcLikelihoodInfo(point);
+			const Double_t midVal = this->getUnNormLikelihood();
+
+			point[0] = ( iBin == nBins-1 ) ? maxAbscissa : minAbscissa + ( iBin + 1 ) * binWidth;
+			this->calcLikelihoodInfo(point);
+			const Double_t highVal = this->getUnNormLikelihood();
+
+			const Double_t binMax = TMath::Max( lowVal, TMath::Max( midVal, highVal ) );
+			const Double_t binMin = TMath::Min( lowVal, TMath::Min( midVal, highVal ) );
+
+			if ( iPoint == 0 || binMax > maxVals[iBin] ) {
+				maxVals[iBin] = binMax;
+			}
+			if ( iPoint == 0 || binMin < minVals[iBin] ) {
+				minVals[iBin] = binMin;
+			}
+
+			lowVal = highVal;
+		}
+	}
+
+	// The envelope height is the largest value found plus the spread of values within the bin,
+	// which allows for the function peaking between the sampled points (should it still be
+	// exceeded, generateFromTable raises it and the generation is restarted)
+	table.heights_.resize( nBins );
+	Double_t sumHeights(0.0);
+	for ( UInt_t iBin(0); iBin < nBins; ++iBin ) {
+		table.heights_[iBin] = 2.0*maxVals[iBin] - minVals[iBin];
+		sumHeights += table.heights_[iBin];
+	}
+
+	if ( ! ( sumHeights > 0.0 ) ) {
+		std::cerr << "WARNING in LauAbsPdf::buildGenTable : The envelope is zero everywhere, will use the maximum height instead." << std::endl;
+		return kFALSE;
+	}
+
+	this->buildGenTableAlias( table );
+
+	return kTRUE;
+}
+
+void LauAbsPdf::buildGenTableAlias(GenTable& table) const
+{
+	const UInt_t nBins = table.heights_.size();
+
+	Double_t sumHeights(0.0);
+	for ( UInt_t iBin(0); iBin < nBins; ++iBin ) {
+		sumHeights += table.heights_[iBin];
+	}
+
+	// Construct the alias table
+	table.prob_.resize( nBins );
+	table.alias_.resize( nBins );
+
+	std::vector<UInt_t> small, large;
+	small.reserve( nBins );
+	large.reserve( nBins );
+	for ( UInt_t iBin(0); iBin < nBins; ++iBin ) {
+		table.prob_[iBin] = table.heights_[iBin] * nBins / sumHeights;
+		table.alias_[iBin] = iBin;
+		if ( table.prob_[iBin] < 1.0 ) {
+			small.push_back( iBin );
+		} else {
+			large.push_back( iBin );
+		}
+	}
+
+	while ( ! small.empty() && ! large.empty() ) {
+		const UInt_t iSmall = small.back(); small.pop_back();
+		const UInt_t iLarge = large.back(); large.pop_back();
+
+		table.alias_[iSmall] = iLarge;
+		table.prob_[iLarge] -= ( 1.0 - table.prob_[iSmall] );
+
+		if ( table.prob_[iLarge] < 1.0 ) {
+			small.push_back( iLarge );
+		} else {
+			large.push_back( iLarge );
+		}
+	}
+
+	// Anything left over (due to rounding) should always take its own bin
+	for ( std::vector<UInt_t>::const_iterator iter = small.begin(); iter != small.end(); ++iter ) {
+		table.prob_[*iter] = 1.0;
+	}
+	for ( std::vector<UInt_t>::const_iterator iter = large.begin(); iter != large.end(); ++iter ) {
+		table.prob_[*iter] = 1.0;
+	}
+}
+
 Double_t LauAbsPdf::getLikelihood() const
 {
 	if (TMath::Abs(norm_) > 1e-10) {
@@ -392,6 +687,42 @@ void LauAbsPdf::calcLikelihoodInfo(UInt_t iEvt)
 	}
 }
 
+void LauAbsPdf::calcLikelihoods(UInt_t iStart, UInt_t nEvts, Double_t* likelihoods)
+{
+	if ( nEvts == 0 ) {
+		return;
+	}
+
+	const Bool_t useKernel = this->hasBatchKernel() && !this->cachePDF() && !this->isDPDependent() && this->nInputVars() == 1
+		&& abscissaColumn_.size() == abscissas_.size() && iStart + nEvts <= abscissaColumn_.size();
+
+	if ( ! useKernel ) {
+		for ( UInt_t i(0); i < nEvts; ++i ) {
+			this->calcLikelihoodInfo( iStart + i );
+			likelihoods[i] = this->getLikelihood();
+		}
+		return;
+	}
+
+	// The parameters are the same for every event, so the normalisation only needs updating once
+	this->updateNorm();
+	this->calcUnNormPDFValues( nEvts, &abscissaColumn_[iStart], likelihoods );
+
+	const Double_t norm = this->getNorm();
+	const Double_t invNorm = (TMath::Abs(norm) > 1e-10) ? 1.0/norm : 0.0;
+	LauVectorMath::scale( nEvts, invNorm, likelihoods );
+}
+
+void LauAbsPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	LauAbscissas abscissa(1);
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		abscissa[0] = abscissas[i];
+		this->calcLikelihoodInfo( abscissa );
+		values[i] = this->getUnNormLikelihood();
+	}
+}
+
 LauAbsRValue* LauAbsPdf::findParameter(const TString& parName)
 {
 	for ( std::vector<LauAbsRValue*>::iterator iter = param_.begin(); iter != param_.end(); ++iter ) {
@@ -459,6 +790,31 @@ void LauAbsPdf::calcNorm()
 	this->withinNormCalc(kFALSE);
 } 
 
+void LauAbsPdf::updateNorm()
+{
+	// Check whether any of the parameter values have changed since the last time
+	const UInt_t nPars = param_.size();
+	if ( normParValues_.size() != nPars ) {
+		normParValues_.resize( nPars );
+		normUpToDate_ = kFALSE;
+	}
+
+	for ( UInt_t i(0); i < nPars; ++i ) {
+		const Double_t value = param_[i]->unblindValue();
+		if ( value != normParValues_[i] ) {
+			normParValues_[i] = value;
+			normUpToDate_ = kFALSE;
+		}
+	}
+
+	if ( normUpToDate_ ) {
+		return;
+	}
+
+	this->calcNorm();
+	normUpToDate_ = kTRUE;
+}
+
 Double_t LauAbsPdf::integrGaussLegendre()
 {
 	if (!this->normWeightsDone()) {
@@ -537,7 +893,7 @@ Double_t LauAbsPdf::integTrapezoid()
 	Double_t abscVal, tnm, sum, del;
 	Int_t it, j;
 
-	static Double_t norm(0.0);
+	Double_t& norm = trapezoidNorm_;
 	Double_t range = this->getRange();
 
 	if (this->nNormPoints()==1){
@@ -244,6 +244,10 @@ LauComplex LauAbsResonance::amplitude(const LauKinematics* kinematics)
 		}
 	}
 
+	// Keep the factors applied to the numerator, for those lineshapes that report them
+	spinTerm_ = spinTerm;
+	barrierScaling_ = 0.0;
+
 	// Calculate the full amplitude
 	LauComplex resAmplitude = this->resAmp(mass_, spinTerm);
 
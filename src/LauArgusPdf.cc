@@ -34,6 +34,7 @@ Thomas Latham
 
 #include "LauArgusPdf.hh"
 #include "LauConstants.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauArgusPdf)
 
@@ -92,7 +93,31 @@ void LauArgusPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
+	}
+}
+
+void LauArgusPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	// Get the up to date parameter values
+	Double_t xi = xi_->unblindValue();
+	Double_t m0 = m0_->unblindValue();
+
+	// Calculate the exponents for all the abscissa values and then exponentiate them all together
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t x = abscissas[i]/m0;
+		Double_t term = 1.0 - x*x;
+		term = (term < 0.0) ? 0.0 : term;
+		values[i] = -xi*term;
+	}
+
+	LauVectorMath::exp( nValues, values, values );
+
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t x = abscissas[i]/m0;
+		Double_t term = 1.0 - x*x;
+		term = (term < 0.0) ? 0.0 : term;
+		values[i] *= abscissas[i]*TMath::Sqrt(term);
 	}
 }
 
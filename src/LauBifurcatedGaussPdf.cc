@@ -34,6 +34,7 @@ Thomas Latham
 
 #include "LauBifurcatedGaussPdf.hh"
 #include "LauConstants.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauBifurcatedGaussPdf)
 
@@ -104,14 +105,47 @@ void LauBifurcatedGaussPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	}
 	value = TMath::Exp(coef*arg*arg);
 
+	this->setUnNormPDFVal(value);
+
+	// if the parameters are floating then we
+	// need to recalculate the normalisation
+	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
+		this->updateNorm();
+	}
+}
+
+void LauBifurcatedGaussPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	// Get the up to date parameter values
+	Double_t mean = mean_->unblindValue();
+	Double_t sigmaL = sigmaL_->unblindValue();
+	Double_t sigmaR = sigmaR_->unblindValue();
+
+	const Double_t coefL = (TMath::Abs(sigmaL) > 1e-30) ? -0.5/(sigmaL*sigmaL) : 0.0;
+	const Double_t coefR = (TMath::Abs(sigmaR) > 1e-30) ? -0.5/(sigmaR*sigmaR) : 0.0;
+
+	// Calculate the exponents for all the abscissa values and then exponentiate them all together
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t arg = abscissas[i] - mean;
+		const Double_t coef = (arg < 0.0) ? coefL : coefR;
+		values[i] = coef*arg*arg;
+	}
+
+	LauVectorMath::exp( nValues, values, values );
+}
+
+void LauBifurcatedGaussPdf::calcNorm() 
+{
+	// Get the up to date parameter values
+	Double_t mean = mean_->unblindValue();
+	Double_t sigmaL = sigmaL_->unblindValue();
+	Double_t sigmaR = sigmaR_->unblindValue();
+
 	// Calculate the norm
 	Double_t xscaleL = LauConstants::root2*sigmaL;
 	Double_t xscaleR = LauConstants::root2*sigmaR;
-	
-	Double_t integral(0.0);
-	Double_t norm(0.0);
-	Double_t result(0.0);
 
+	Double_t integral(0.0);
 
 	if(this->getMaxAbscissa() < mean){
 		integral = sigmaL * ( TMath::Erf((this->getMaxAbscissa() - mean)/xscaleL) - TMath::Erf((this->getMinAbscissa() - mean)/xscaleL));
@@ -119,20 +153,11 @@ void LauBifurcatedGaussPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 		integral = sigmaR * (TMath::Erf((this->getMaxAbscissa() - mean)/xscaleR) - TMath::Erf((this->getMinAbscissa() - mean)/xscaleR));
 	}else{
 		integral = sigmaR*TMath::Erf((this->getMaxAbscissa() -mean)/xscaleR) - sigmaL*TMath::Erf((this->getMinAbscissa() - mean)/xscaleL);
-      	}
-	
-	norm = LauConstants::rootPiBy2*integral;
+	}
 
-	// the result
-	result = value/norm;
-  	this->setUnNormPDFVal(result);
+	Double_t norm = LauConstants::rootPiBy2*integral;
 
-}
-
-void LauBifurcatedGaussPdf::calcNorm() 
-{
-	// Nothing to do here, since it already normalized
-	this->setNorm(1.0);
+	this->setNorm(norm);
 }
 
 
@@ -255,11 +255,20 @@ void LauBkgndDPModel::fillDataTree(const LauFitDataTree& inputFitTree)
 
         Double_t m13Sq { 0.0 }, m23Sq { 0.0 };
 
+	// Read the DP co-ordinates directly from the columns when we can
+	const Double_t* m13SqColumn { inputFitTree.isFlatFile() ? inputFitTree.getColumn("m13Sq") : nullptr };
+	const Double_t* m23SqColumn { inputFitTree.isFlatFile() ? inputFitTree.getColumn("m23Sq") : nullptr };
+
 	for (UInt_t iEvt = 0; iEvt < nEvents; iEvt++) {
 
-		const LauFitData& dataValues = inputFitTree.getData(iEvt);
-		m13Sq = dataValues.at("m13Sq");
-		m23Sq = dataValues.at("m23Sq");
+		if ( m13SqColumn && m23SqColumn ) {
+			m13Sq = m13SqColumn[iEvt];
+			m23Sq = m23SqColumn[iEvt];
+		} else {
+			const LauFitData& dataValues = inputFitTree.getData(iEvt);
+			m13Sq = dataValues.at("m13Sq");
+			m23Sq = dataValues.at("m23Sq");
+		}
 
                 bgData_[iEvt] = this->getUnNormValue( m13Sq, m23Sq );
         }
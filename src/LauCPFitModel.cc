@@ -26,6 +26,7 @@ Thomas Latham
   \brief File containing implementation of LauCPFitModel class.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -99,7 +100,13 @@ LauCPFitModel::LauCPFitModel(LauIsobarDynamics* negModel, LauIsobarDynamics* pos
 	sigExtraLike_(0.0),
 	scfExtraLike_(0.0),
 	sigTotalLike_(0.0),
-	scfTotalLike_(0.0)
+	scfTotalLike_(0.0),
+	genEvtNumHandle_(0),
+	genEvtWeightHandle_(0),
+	genEffHandle_(0),
+	genSigHandle_(0),
+	genTMSigHandle_(0),
+	genSCFSigHandle_(0)
 {
 	const LauDaughters* negDaug = negSigModel_->getDaughters();
 	if (negDaug != 0) {negParent_ = negDaug->getNameParent();}
@@ -1520,13 +1527,14 @@ Bool_t LauCPFitModel::genExpt()
 	Bool_t genOK(kTRUE);
 	Int_t evtNum(0);
 
+	// Each experiment is generated from its own blocks of signal candidates
+	negSigModel_->clearGenQueue();
+	posSigModel_->clearGenQueue();
+
 	const UInt_t nBkgnds = this->nBkgndClasses();
 	std::vector<TString> bkgndClassNames(nBkgnds);
-	std::vector<TString> bkgndClassNamesGen(nBkgnds);
 	for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
-		TString name( this->bkgndClassName(iBkgnd) );
-		bkgndClassNames[iBkgnd] = name;
-		bkgndClassNamesGen[iBkgnd] = "gen"+name;
+		bkgndClassNames[iBkgnd] = this->bkgndClassName(iBkgnd);
 	}
 
 	const Bool_t storeSCFTruthInfo = ( useSCF_ || ( this->enableEmbedding() &&
@@ -1543,26 +1551,26 @@ Bool_t LauCPFitModel::genExpt()
 
 		for (Int_t iEvt(0); iEvt<nEvtsGen; ++iEvt) {
 
-			this->setGenNtupleDoubleBranchValue( "evtWeight", evtWeight );
-			this->setGenNtupleDoubleBranchValue( "efficiency", 1.0 );
+			this->setGenNtupleDoubleBranchValue( genEvtWeightHandle_, evtWeight );
+			this->setGenNtupleDoubleBranchValue( genEffHandle_, 1.0 );
 
 			if (type == "signal") {
-				this->setGenNtupleIntegerBranchValue("genSig",1);
+				this->setGenNtupleIntegerBranchValue(genSigHandle_,1);
 				for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
-					this->setGenNtupleIntegerBranchValue( bkgndClassNamesGen[iBkgnd], 0 );
+					this->setGenNtupleIntegerBranchValue( genBkgndHandles_[iBkgnd], 0 );
 				}
 				genOK = this->generateSignalEvent();
 				if ( curEvtCharge_ > 0 ){
-					this->setGenNtupleDoubleBranchValue( "efficiency", posSigModel_->getEvtEff() );
+					this->setGenNtupleDoubleBranchValue( genEffHandle_, posSigModel_->getEvtEff() );
 				} else {
-					this->setGenNtupleDoubleBranchValue( "efficiency", negSigModel_->getEvtEff() );
+					this->setGenNtupleDoubleBranchValue( genEffHandle_, negSigModel_->getEvtEff() );
 				}
 
 			} else {
-				this->setGenNtupleIntegerBranchValue("genSig",0);
+				this->setGenNtupleIntegerBranchValue(genSigHandle_,0);
 				if ( storeSCFTruthInfo ) {
-					this->setGenNtupleIntegerBranchValue("genTMSig",0);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 				}
 				UInt_t bkgndID(0);
 				for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
@@ -1571,7 +1579,7 @@ Bool_t LauCPFitModel::genExpt()
 						gen = 1;
 						bkgndID = iBkgnd;
 					}
-					this->setGenNtupleIntegerBranchValue( bkgndClassNamesGen[iBkgnd], gen );
+					this->setGenNtupleIntegerBranchValue( genBkgndHandles_[iBkgnd], gen );
 				}
 				genOK = this->generateBkgndEvent(bkgndID);
 			}
@@ -1589,7 +1597,7 @@ Bool_t LauCPFitModel::genExpt()
 
 			// Store the event number (within this experiment)
 			// and then increment it
-			this->setGenNtupleIntegerBranchValue("iEvtWithinExpt",evtNum);
+			this->setGenNtupleIntegerBranchValue(genEvtNumHandle_,evtNum);
 			++evtNum;
 
 			this->fillGenNtupleBranches();
@@ -1738,12 +1746,12 @@ Bool_t LauCPFitModel::generateSignalEvent()
 					frac = scfFrac_.genValue();
 				}
 				if ( frac < LauRandom::randomFun()->Rndm() ) {
-					this->setGenNtupleIntegerBranchValue("genTMSig",1);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 					genSCF = kFALSE;
 				} else {
-					this->setGenNtupleIntegerBranchValue("genTMSig",0);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 					genSCF = kTRUE;
 
 					// Optionally smear the DP position
@@ -1787,12 +1795,12 @@ Bool_t LauCPFitModel::generateSignalEvent()
 		} else if ( useSCF_ ) {
 			Double_t frac = scfFrac_.genValue();
 			if ( frac < LauRandom::randomFun()->Rndm() ) {
-				this->setGenNtupleIntegerBranchValue("genTMSig",1);
-				this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+				this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+				this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 				genSCF = kFALSE;
 			} else {
-				this->setGenNtupleIntegerBranchValue("genTMSig",0);
-				this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+				this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+				this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 				genSCF = kTRUE;
 			}
 		}
@@ -1800,12 +1808,12 @@ Bool_t LauCPFitModel::generateSignalEvent()
 	if (genOK) {
 		if ( useSCF_ ) {
 			if ( genSCF ) {
-				this->generateExtraPdfValues(scfPdfs, embeddedData);
+				genOK = this->generateExtraPdfValues(scfPdfs, embeddedData);
 			} else {
-				this->generateExtraPdfValues(sigPdfs, embeddedData);
+				genOK = this->generateExtraPdfValues(sigPdfs, embeddedData);
 			}
 		} else {
-			this->generateExtraPdfValues(sigPdfs, embeddedData);
+			genOK = this->generateExtraPdfValues(sigPdfs, embeddedData);
 		}
 	}
 	// Check for problems with the embedding
@@ -1864,7 +1872,7 @@ Bool_t LauCPFitModel::generateBkgndEvent(UInt_t bkgndID)
 		}
 	}
 	if (genOK) {
-		this->generateExtraPdfValues(extraPdfs, embeddedData);
+		genOK = this->generateExtraPdfValues(extraPdfs, embeddedData);
 	}
 
 	// Check for problems with the embedding
@@ -1919,6 +1927,37 @@ void LauCPFitModel::setupGenNtupleBranches()
 			}
 		}
 	}
+
+	// Now that all the branches exist, get the handles to those set for every event
+	genEvtNumHandle_ = this->genNtupleIntegerBranchHandle("iEvtWithinExpt");
+	genEvtWeightHandle_ = this->genNtupleDoubleBranchHandle("evtWeight");
+	genEffHandle_ = this->genNtupleDoubleBranchHandle("efficiency");
+	genSigHandle_ = this->genNtupleIntegerBranchHandle("genSig");
+	genTMSigHandle_ = 0;
+	genSCFSigHandle_ = 0;
+	if ( useSCF_ || ( this->enableEmbedding() &&
+				negSignalTree_ != 0 && negSignalTree_->haveBranch("mcMatch") &&
+				posSignalTree_ != 0 && posSignalTree_->haveBranch("mcMatch") ) ) {
+		genTMSigHandle_ = this->genNtupleIntegerBranchHandle("genTMSig");
+		genSCFSigHandle_ = this->genNtupleIntegerBranchHandle("genSCFSig");
+	}
+	genBkgndHandles_.resize( nBkgnds );
+	for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
+		TString name( this->bkgndClassName(iBkgnd) );
+		name.Prepend("gen");
+		genBkgndHandles_[iBkgnd] = this->genNtupleIntegerBranchHandle(name);
+	}
+	genDPHandles_.assign( 11, 0 );
+	if (this->useDP() == kTRUE) {
+		const char* dpNames[9] = { "m12", "m23", "m13", "m12Sq", "m23Sq", "m13Sq", "cosHel12", "cosHel23", "cosHel13" };
+		for ( UInt_t i(0); i < 9; ++i ) {
+			genDPHandles_[i] = this->genNtupleDoubleBranchHandle( dpNames[i] );
+		}
+		if ( negKinematics_->squareDP() && posKinematics_->squareDP() ) {
+			genDPHandles_[9] = this->genNtupleDoubleBranchHandle("mPrime");
+			genDPHandles_[10] = this->genNtupleDoubleBranchHandle("thPrime");
+		}
+	}
 }
 
 void LauCPFitModel::setDPBranchValues()
@@ -1931,22 +1970,22 @@ void LauCPFitModel::setDPBranchValues()
 	}
 
 	// Store all the DP information
-	this->setGenNtupleDoubleBranchValue("m12", kinematics->getm12());
-	this->setGenNtupleDoubleBranchValue("m23", kinematics->getm23());
-	this->setGenNtupleDoubleBranchValue("m13", kinematics->getm13());
-	this->setGenNtupleDoubleBranchValue("m12Sq", kinematics->getm12Sq());
-	this->setGenNtupleDoubleBranchValue("m23Sq", kinematics->getm23Sq());
-	this->setGenNtupleDoubleBranchValue("m13Sq", kinematics->getm13Sq());
-	this->setGenNtupleDoubleBranchValue("cosHel12", kinematics->getc12());
-	this->setGenNtupleDoubleBranchValue("cosHel23", kinematics->getc23());
-	this->setGenNtupleDoubleBranchValue("cosHel13", kinematics->getc13());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[0], kinematics->getm12());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[1], kinematics->getm23());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[2], kinematics->getm13());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[3], kinematics->getm12Sq());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[4], kinematics->getm23Sq());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[5], kinematics->getm13Sq());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[6], kinematics->getc12());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[7], kinematics->getc23());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[8], kinematics->getc13());
 	if (kinematics->squareDP()) {
-		this->setGenNtupleDoubleBranchValue("mPrime", kinematics->getmPrime());
-		this->setGenNtupleDoubleBranchValue("thPrime", kinematics->getThetaPrime());
+		this->setGenNtupleDoubleBranchValue(genDPHandles_[9], kinematics->getmPrime());
+		this->setGenNtupleDoubleBranchValue(genDPHandles_[10], kinematics->getThetaPrime());
 	}
 }
 
-void LauCPFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData)
+Bool_t LauCPFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData)
 {
 	LauKinematics* kinematics(0);
 	if (curEvtCharge_<0) {
@@ -1962,9 +2001,11 @@ void LauCPFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedDat
 
 	if (extraPdfs->empty()) {
 		//std::cerr << "WARNING in LauCPFitModel::generateExtraPdfValues : PDF list is empty." << std::endl;
-		return;
+		return kTRUE;
 	}
 
+	Bool_t genOK(kTRUE);
+
 	// Generate from the extra PDFs
 	for (LauPdfList::iterator pdf_iter = extraPdfs->begin(); pdf_iter != extraPdfs->end(); ++pdf_iter) {
 		LauFitData genValues;
@@ -1972,6 +2013,10 @@ void LauCPFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedDat
 			genValues = embeddedData->getValues( (*pdf_iter)->varNames() );
 		} else {
 			genValues = (*pdf_iter)->generate(kinematics);
+			// If the tabulated envelope was exceeded the generation needs to be restarted
+			if ( ! (*pdf_iter)->checkGenTable() ) {
+				genOK = kFALSE;
+			}
 		}
 		for ( LauFitData::const_iterator var_iter = genValues.begin(); var_iter != genValues.end(); ++var_iter ) {
 			TString varName = var_iter->first;
@@ -1981,6 +2026,7 @@ void LauCPFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedDat
 			}
 		}
 	}
+	return genOK;
 }
 
 Bool_t LauCPFitModel::storeSignalMCMatch(LauEmbeddedData* embeddedData)
@@ -1997,12 +2043,12 @@ Bool_t LauCPFitModel::storeSignalMCMatch(LauEmbeddedData* embeddedData)
 
 	// Set the variables accordingly.
 	if (match) {
-		this->setGenNtupleIntegerBranchValue("genTMSig",1);
-		this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+		this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+		this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 		genSCF = kFALSE;
 	} else {
-		this->setGenNtupleIntegerBranchValue("genTMSig",0);
-		this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+		this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+		this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 		genSCF = kTRUE;
 	}
 
@@ -2990,6 +3036,135 @@ std::map<TString, Double_t> LauCPFitModel::getDPLikelihoods(const Double_t m13Sq
 	return likelihoods;
 }
 
+std::map< TString, std::vector<LauComplex> > LauCPFitModel::getDPAmps(const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq)
+{
+	// Initialise the DP model, if not already done
+	if ( negCoeffs_.empty() || posCoeffs_.empty() ) {
+		this->updateCoeffs();
+		this->initialiseDPModels();
+	}
+
+	std::map< TString, std::vector<LauComplex> > amps;
+
+	if ( m13Sq.size() != m23Sq.size() ) {
+		std::cerr << "ERROR in LauCPFitModel::getDPAmps : Different numbers of m13Sq and m23Sq values supplied." << std::endl;
+		return amps;
+	}
+
+	const UInt_t nPoints = m13Sq.size();
+
+	// Create all the output arrays first, so that they can be filled concurrently
+	std::vector<LauWeightingTask> tasks;
+
+	const LauIsobarDynamics* models[2] = { negSigModel_, posSigModel_ };
+	const TString labels[2] = { "signal_" + negParent_, "signal_" + posParent_ };
+	std::vector<LauComplex> resAmps[2];
+
+	for ( UInt_t iModel(0); iModel < 2; ++iModel ) {
+		const UInt_t nAmp = models[iModel]->getnCohAmp();
+		std::vector<LauComplex>& totAmps = amps[ labels[iModel] ];
+		totAmps.resize( nPoints );
+		resAmps[iModel].resize( nPoints*nAmp );
+
+		LauIsobarDynamics* model = ( iModel == 0 ) ? negSigModel_ : posSigModel_;
+		std::vector<LauComplex>& modelResAmps = resAmps[iModel];
+		tasks.push_back( LauWeightingTask( model->getKinematics(), [model, &m13Sq, &m23Sq, &totAmps, &modelResAmps, nPoints]()
+		{
+			std::vector<Double_t> likelihoods( nPoints );
+			model->calcDPValues( nPoints, m13Sq.data(), m23Sq.data(), likelihoods.data(), totAmps.data(), modelResAmps.data() );
+		} ) );
+	}
+
+	this->runWeightingTasks( tasks );
+
+	for ( UInt_t iModel(0); iModel < 2; ++iModel ) {
+		const UInt_t nAmp = models[iModel]->getnCohAmp();
+		for ( UInt_t iAmp(0); iAmp < nAmp; ++iAmp ) {
+			std::vector<LauComplex>& compAmps = amps[ labels[iModel] + "_" + models[iModel]->getResonance(iAmp)->getResonanceName() ];
+			compAmps.resize( nPoints );
+			for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+				compAmps[iPoint] = resAmps[iModel][ iPoint*nAmp + iAmp ];
+			}
+		}
+	}
+
+	return amps;
+}
+
+std::map< TString, std::vector<Double_t> > LauCPFitModel::getDPLikelihoods(const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq)
+{
+	// Initialise the DP model, if not already done
+	if ( negCoeffs_.empty() || posCoeffs_.empty() ) {
+		this->updateCoeffs();
+		this->initialiseDPModels();
+	}
+
+	std::map< TString, std::vector<Double_t> > likelihoods;
+
+	if ( m13Sq.size() != m23Sq.size() ) {
+		std::cerr << "ERROR in LauCPFitModel::getDPLikelihoods : Different numbers of m13Sq and m23Sq values supplied." << std::endl;
+		return likelihoods;
+	}
+
+	const UInt_t nPoints = m13Sq.size();
+
+	// Create all the output arrays first, so that they can be filled concurrently
+	std::vector<LauWeightingTask> tasks;
+
+	// See comment in getEvtDPLikelihood for explanation of the 2.0 factor
+	const Double_t norm { 2.0 / ( negSigModel_->getDPNorm() + posSigModel_->getDPNorm() ) };
+
+	std::vector<Double_t>& negSigLikes = likelihoods[ "signal_" + negParent_ ];
+	std::vector<Double_t>& posSigLikes = likelihoods[ "signal_" + posParent_ ];
+	for ( UInt_t iModel(0); iModel < 2; ++iModel ) {
+		LauIsobarDynamics* model = ( iModel == 0 ) ? negSigModel_ : posSigModel_;
+		std::vector<Double_t>& sigLikes = ( iModel == 0 ) ? negSigLikes : posSigLikes;
+		sigLikes.resize( nPoints );
+		tasks.push_back( LauWeightingTask( model->getKinematics(), [model, &m13Sq, &m23Sq, &sigLikes, nPoints, norm]()
+		{
+			model->calcDPValues( nPoints, m13Sq.data(), m23Sq.data(), sigLikes.data() );
+
+			// Convert from the model's own normalisation to the combined one
+			const Double_t scale { model->getDPNorm() * norm };
+			for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+				sigLikes[iPoint] *= scale;
+			}
+		} ) );
+	}
+
+	// TODO - SCF signal
+	static bool warningIssued { false };
+	if ( useSCF_ && ! warningIssued ) {
+		warningIssued = true;
+		std::cerr << "WARNING in LauCPFitModel::getDPLikelihoods : calculation of SCF likelihoods not currently implemented in this function\n";
+		std::cerr << "                                           : signal likelihood will just be the truth-matched value";
+		std::cerr << std::endl;
+	}
+
+	if ( usingBkgnd_ ) {
+		const UInt_t nBkgnds { this->nBkgndClasses() };
+		for ( UInt_t bkgndID( 0 ); bkgndID < nBkgnds; ++bkgndID ) {
+			for ( UInt_t iModel(0); iModel < 2; ++iModel ) {
+				LauAbsBkgndDPModel* bkgndModel = ( iModel == 0 ) ? negBkgndDPModels_[bkgndID] : posBkgndDPModels_[bkgndID];
+				const TString& parent = ( iModel == 0 ) ? negParent_ : posParent_;
+				std::vector<Double_t>& bkgndLikes = likelihoods[ this->bkgndClassName( bkgndID ) + "_" + parent ];
+				bkgndLikes.resize( nPoints );
+				tasks.push_back( LauWeightingTask( bkgndModel->getKinematics(), [bkgndModel, &m13Sq, &m23Sq, &bkgndLikes, nPoints]()
+				{
+					const LauKinematics* kinematics = bkgndModel->getKinematics();
+					for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+						bkgndLikes[iPoint] = kinematics->withinDPLimits( m13Sq[iPoint], m23Sq[iPoint] ) ? bkgndModel->getLikelihood( m13Sq[iPoint], m23Sq[iPoint] ) : 0.0;
+					}
+				} ) );
+			}
+		}
+	}
+
+	this->runWeightingTasks( tasks );
+
+	return likelihoods;
+}
+
 void LauCPFitModel::embedNegSignal(const TString& fileName, const TString& treeName,
 		Bool_t reuseEventsWithinEnsemble, Bool_t reuseEventsWithinExperiment,
 		Bool_t useReweighting)
@@ -3125,6 +3300,8 @@ void LauCPFitModel::weightEvents( const TString& dataFileName, const TString& da
   const Ssiz_t index { weightsFileName.Last('.') };
   weightsFileName.Insert( index, "_DPweights" );
 
+  const UInt_t nVariants { static_cast<UInt_t>( weightVariantNames_.size() ) };
+
   LauGenNtuple weightsTuple { weightsFileName, dataTreeName };
   weightsTuple.addIntegerBranch( "iExpt" );
   weightsTuple.addIntegerBranch( "iEvtWithinExpt" );
@@ -3132,6 +3309,44 @@ void LauCPFitModel::weightEvents( const TString& dataFileName, const TString& da
   if ( squareDP ) {
     weightsTuple.addDoubleBranch( "sqDPJacobian" );
   }
+  for ( UInt_t iVariant{0}; iVariant < nVariants; ++iVariant ) {
+    weightsTuple.addDoubleBranch( "dpModelWeight_" + weightVariantNames_[iVariant] );
+  }
+
+  const LauGenNtuple::IntegerBranchHandle exptHandle { weightsTuple.integerBranchHandle( "iExpt" ) };
+  const LauGenNtuple::IntegerBranchHandle evtHandle { weightsTuple.integerBranchHandle( "iEvtWithinExpt" ) };
+  const LauGenNtuple::DoubleBranchHandle weightHandle { weightsTuple.doubleBranchHandle( "dpModelWeight" ) };
+  const LauGenNtuple::DoubleBranchHandle jacobianHandle { squareDP ? weightsTuple.doubleBranchHandle( "sqDPJacobian" ) : nullptr };
+  std::vector<LauGenNtuple::DoubleBranchHandle> variantHandles( nVariants );
+  for ( UInt_t iVariant{0}; iVariant < nVariants; ++iVariant ) {
+    variantHandles[iVariant] = weightsTuple.doubleBranchHandle( "dpModelWeight_" + weightVariantNames_[iVariant] );
+  }
+
+  // Write out each chunk in the background while the next one is weighted
+  const UInt_t chunkSize { this->weightingChunkSize() };
+  weightsTuple.asyncFill( chunkSize );
+
+  // The nominal models come first, followed by the variants,
+  // each normalised to the average of its negative and positive normalisations
+  std::vector<LauIsobarDynamics*> negModels { negSigModel_ };
+  negModels.insert( negModels.end(), weightVariantNegModels_.begin(), weightVariantNegModels_.end() );
+  std::vector<LauIsobarDynamics*> posModels { posSigModel_ };
+  posModels.insert( posModels.end(), weightVariantPosModels_.begin(), weightVariantPosModels_.end() );
+  const UInt_t nModels { static_cast<UInt_t>( negModels.size() ) };
+
+  std::vector<Double_t> norms( nModels );
+  for ( UInt_t iModel{0}; iModel < nModels; ++iModel ) {
+    norms[iModel] = 0.5 * ( negModels[iModel]->getDPNorm() + posModels[iModel]->getDPNorm() );
+  }
+
+  const std::vector<TString> columnNames { "m13Sq_MC", "m23Sq_MC", "charge" };
+  std::vector< std::vector<Double_t> > columns;
+
+  // The events of each charge are gathered together so that each model sees a contiguous block
+  std::vector<UInt_t> negEvents, posEvents;
+  std::vector<Double_t> negM13Sq, negM23Sq, posM13Sq, posM23Sq;
+  std::vector< std::vector<Double_t> > negWeights( nModels ), posWeights( nModels );
+  std::vector<Double_t> negJacobians, posJacobians;
 
   const UInt_t nExpmt { this->nExpt() };
   const UInt_t firstExpmt { this->firstExpt() };
@@ -3145,51 +3360,90 @@ void LauCPFitModel::weightEvents( const TString& dataFileName, const TString& da
       continue;
     }
 
-    weightsTuple.setIntegerBranchValue( "iExpt", iExpmt );
-
-    // Calculate and store the weights for the events in this experiment
-    for ( UInt_t iEvent{0}; iEvent < nEvents; ++iEvent ) {
-
-      weightsTuple.setIntegerBranchValue( "iEvtWithinExpt", iEvent );
-
-      const LauFitData& evtData = inputFitData->getData( iEvent );
+    weightsTuple.setIntegerBranchValue( exptHandle, iExpmt );
 
-      const auto m13Sq_MC { evtData.at( "m13Sq_MC" ) };
-      const auto m23Sq_MC { evtData.at( "m23Sq_MC" ) };
-      const auto charge { static_cast<Int_t>( evtData.at( "charge" ) ) };
+    // Calculate and store the weights for the events in this experiment, a chunk at a time
+    for ( UInt_t firstEvent{0}; firstEvent < nEvents; firstEvent += chunkSize ) {
 
-      Double_t dpModelWeight{0.0};
-      Double_t jacobian{1.0};
+      const UInt_t nChunkEvents { std::min( chunkSize, nEvents - firstEvent ) };
 
-      LauKinematics * kinematics{nullptr};
-      LauIsobarDynamics * dpModel{nullptr};
+      this->readDataColumns( columnNames, firstEvent, nChunkEvents, columns );
 
-      if (charge > 0) {
-        kinematics = posKinematics_;
-        dpModel = posSigModel_;
-      } else {
-        kinematics = negKinematics_;
-        dpModel = negSigModel_;
+      negEvents.clear(); negM13Sq.clear(); negM23Sq.clear();
+      posEvents.clear(); posM13Sq.clear(); posM23Sq.clear();
+      for ( UInt_t iEvent{0}; iEvent < nChunkEvents; ++iEvent ) {
+        const auto charge { static_cast<Int_t>( columns[2][iEvent] ) };
+        if ( charge > 0 ) {
+          posEvents.push_back( iEvent );
+          posM13Sq.push_back( columns[0][iEvent] );
+          posM23Sq.push_back( columns[1][iEvent] );
+        } else {
+          negEvents.push_back( iEvent );
+          negM13Sq.push_back( columns[0][iEvent] );
+          negM23Sq.push_back( columns[1][iEvent] );
+        }
       }
-
-      if ( kinematics->withinDPLimits( m13Sq_MC, m23Sq_MC ) ) {
-
-        kinematics->updateKinematics( m13Sq_MC, m23Sq_MC );
-        dpModelWeight = dpModel->getEventWeight();
-
-        if ( squareDP ) {
-          jacobian = kinematics->calcSqDPJacobian();
+      const UInt_t nNeg { static_cast<UInt_t>( negEvents.size() ) };
+      const UInt_t nPos { static_cast<UInt_t>( posEvents.size() ) };
+      negJacobians.resize( nNeg );
+      posJacobians.resize( nPos );
+
+      std::vector<LauWeightingTask> tasks;
+      for ( UInt_t iModel{0}; iModel < nModels; ++iModel ) {
+        negWeights[iModel].resize( nNeg );
+        posWeights[iModel].resize( nPos );
+
+        LauIsobarDynamics* negModel { negModels[iModel] };
+        LauIsobarDynamics* posModel { posModels[iModel] };
+        const Double_t* negM13SqData { negM13Sq.data() };
+        const Double_t* negM23SqData { negM23Sq.data() };
+        const Double_t* posM13SqData { posM13Sq.data() };
+        const Double_t* posM23SqData { posM23Sq.data() };
+        Double_t* negModelWeights { negWeights[iModel].data() };
+        Double_t* posModelWeights { posWeights[iModel].data() };
+        Double_t* negModelJacobians { ( iModel == 0 && squareDP ) ? negJacobians.data() : nullptr };
+        Double_t* posModelJacobians { ( iModel == 0 && squareDP ) ? posJacobians.data() : nullptr };
+
+        tasks.push_back( std::make_pair( negModel->getKinematics(), [=]() {
+          negModel->calcEventWeights( nNeg, negM13SqData, negM23SqData, negModelWeights, negModelJacobians );
+        } ) );
+        tasks.push_back( std::make_pair( posModel->getKinematics(), [=]() {
+          posModel->calcEventWeights( nPos, posM13SqData, posM23SqData, posModelWeights, posModelJacobians );
+        } ) );
+      }
+      this->runWeightingTasks( tasks );
+
+      // Put the events back in their original order
+      std::vector<Double_t> jacobians( squareDP ? nChunkEvents : 0, 1.0 );
+      std::vector< std::vector<Double_t> > weights( nModels, std::vector<Double_t>( nChunkEvents ) );
+      for ( UInt_t iModel{0}; iModel < nModels; ++iModel ) {
+        for ( UInt_t i{0}; i < nNeg; ++i ) {
+          weights[iModel][ negEvents[i] ] = negWeights[iModel][i] / norms[iModel];
+        }
+        for ( UInt_t i{0}; i < nPos; ++i ) {
+          weights[iModel][ posEvents[i] ] = posWeights[iModel][i] / norms[iModel];
         }
-
-        const Double_t norm { 0.5 * ( negSigModel_->getDPNorm() + posSigModel_->getDPNorm() ) };
-        dpModelWeight /= norm;
       }
-
-      weightsTuple.setDoubleBranchValue( "dpModelWeight", dpModelWeight );
       if ( squareDP ) {
-        weightsTuple.setDoubleBranchValue( "sqDPJacobian", jacobian );
+        for ( UInt_t i{0}; i < nNeg; ++i ) {
+          jacobians[ negEvents[i] ] = negJacobians[i];
+        }
+        for ( UInt_t i{0}; i < nPos; ++i ) {
+          jacobians[ posEvents[i] ] = posJacobians[i];
+        }
+      }
+
+      for ( UInt_t iEvent{0}; iEvent < nChunkEvents; ++iEvent ) {
+        weightsTuple.setIntegerBranchValue( evtHandle, firstEvent + iEvent );
+        weightsTuple.setDoubleBranchValue( weightHandle, weights[0][iEvent] );
+        if ( squareDP ) {
+          weightsTuple.setDoubleBranchValue( jacobianHandle, jacobians[iEvent] );
+        }
+        for ( UInt_t iVariant{0}; iVariant < nVariants; ++iVariant ) {
+          weightsTuple.setDoubleBranchValue( variantHandles[iVariant], weights[iVariant+1][iEvent] );
+        }
+        weightsTuple.fillBranches();
       }
-      weightsTuple.fillBranches();
     }
 
   }
@@ -3199,6 +3453,29 @@ void LauCPFitModel::weightEvents( const TString& dataFileName, const TString& da
   weightsTuple.writeOutGenResults();
 }
 
+void LauCPFitModel::addWeightVariant(const TString& name, LauIsobarDynamics* negModel, LauIsobarDynamics* posModel, const std::vector<LauComplex>& negCoeffs, const std::vector<LauComplex>& posCoeffs)
+{
+  if ( negModel == nullptr || posModel == nullptr ) {
+    std::cerr << "ERROR in LauCPFitModel::addWeightVariant : The DP models of variant \"" << name << "\" must not be null." << std::endl;
+    return;
+  }
+  if ( std::find( weightVariantNames_.begin(), weightVariantNames_.end(), name ) != weightVariantNames_.end() ) {
+    std::cerr << "ERROR in LauCPFitModel::addWeightVariant : A variant called \"" << name << "\" has already been added." << std::endl;
+    return;
+  }
+  if ( negCoeffs.size() != negModel->getnTotAmp() || posCoeffs.size() != posModel->getnTotAmp() ) {
+    std::cerr << "ERROR in LauCPFitModel::addWeightVariant : Wrong number of coefficients supplied for variant \"" << name << "\"." << std::endl;
+    return;
+  }
+
+  negModel->initialise( negCoeffs );
+  posModel->initialise( posCoeffs );
+
+  weightVariantNames_.push_back( name );
+  weightVariantNegModels_.push_back( negModel );
+  weightVariantPosModels_.push_back( posModel );
+}
+
 
 void LauCPFitModel::savePDFPlots(const TString& label)
 {
@@ -3235,6 +3512,27 @@ void LauCPFitModel::savePDFPlots(const TString& label)
    delta13 = (maxs13 - mins13)/n13;
    delta23 = (maxs23 - mins23)/n23;
    UInt_t nAmp = negSigModel_->getnCohAmp();
+
+   // Evaluate the models at all of the points in one go
+   std::vector<Double_t> pointsS13, pointsS23;
+   for (Int_t i=0; i<n13; i++) {
+   	s13 = mins13 + i*delta13;
+   	for (Int_t j=0; j<n23; j++) {
+   		s23 = mins23 + j*delta23;
+   		if (negSigModel_->getKinematics()->withinDPLimits2(s23, s13)) {
+   			if (negSigModel_->getDaughters()->gotSymmetricalDP() && (s13>s23) )  continue;
+   			pointsS13.push_back(s13);
+   			pointsS23.push_back(s23);
+   		}
+   	}
+   }
+   const UInt_t nPoints = pointsS13.size();
+   std::vector<Double_t> likelihoods( nPoints );
+   std::vector<LauComplex> negTotAmps( nPoints ), posTotAmps( nPoints );
+   std::vector<LauComplex> negResAmps( nPoints * nAmp ), posResAmps( nPoints * nAmp );
+   negSigModel_->calcDPValues( nPoints, pointsS13.data(), pointsS23.data(), likelihoods.data(), negTotAmps.data(), negResAmps.data() );
+   posSigModel_->calcDPValues( nPoints, pointsS13.data(), pointsS23.data(), likelihoods.data(), posTotAmps.data(), posResAmps.data() );
+
    for (UInt_t resID = 0; resID <= nAmp; ++resID)
    {
 	TGraph2D *posDt = new TGraph2D();
@@ -3263,32 +3561,23 @@ void LauCPFitModel::savePDFPlots(const TString& label)
 	acpDt->SetTitle(resName+" ("+label+") Asymmetry");
 
 	Int_t count=0;
-	for (Int_t i=0; i<n13; i++) {
-		s13 = mins13 + i*delta13;
-		for (Int_t j=0; j<n23; j++) {
-			s23 = mins23 + j*delta23;
-			if (negSigModel_->getKinematics()->withinDPLimits2(s23, s13))
-			{
-				if (negSigModel_->getDaughters()->gotSymmetricalDP() && (s13>s23) )  continue;
-
-				negSigModel_->calcLikelihoodInfo(s13, s23);
-				posSigModel_->calcLikelihoodInfo(s13, s23);
+	for (UInt_t iPoint=0; iPoint<nPoints; iPoint++) {
+		s13 = pointsS13[iPoint];
+		s23 = pointsS23[iPoint];
 
-				LauComplex negChAmp = negSigModel_->getEvtDPAmp();
-				LauComplex posChAmp = posSigModel_->getEvtDPAmp();
+		LauComplex negChAmp = negTotAmps[iPoint];
+		LauComplex posChAmp = posTotAmps[iPoint];
 
-				if (resID != nAmp){
-					negChAmp = negSigModel_->getFullAmplitude(resID);
-					posChAmp = posSigModel_->getFullAmplitude(resID);
-				}
-				negChPdf = negChAmp.abs2();
-				posChPdf = posChAmp.abs2();
-				negDt->SetPoint(count,s23,s13,negChPdf); // s23=sHigh, s13 = sLow
-				posDt->SetPoint(count,s23,s13,posChPdf); // s23=sHigh, s13 = sLow
-				acpDt->SetPoint(count,s23,s13, negChPdf - posChPdf); // s23=sHigh, s13 = sLow
-				count++;
-			}
+		if (resID != nAmp){
+			negChAmp = negResAmps[iPoint*nAmp + resID];
+			posChAmp = posResAmps[iPoint*nAmp + resID];
 		}
+		negChPdf = negChAmp.abs2();
+		posChPdf = posChAmp.abs2();
+		negDt->SetPoint(count,s23,s13,negChPdf); // s23=sHigh, s13 = sLow
+		posDt->SetPoint(count,s23,s13,posChPdf); // s23=sHigh, s13 = sLow
+		acpDt->SetPoint(count,s23,s13, negChPdf - posChPdf); // s23=sHigh, s13 = sLow
+		count++;
 	}
    	gStyle->SetPalette(1);
         TCanvas *posC = new TCanvas("c"+resName+label + "Positive",resName+" ("+label+") Positive",0,0,600,400);
@@ -3360,44 +3649,60 @@ void LauCPFitModel::savePDFPlotsWave(const TString& label, const Int_t& spin)
 	delta23 = (maxs23 - mins23)/n23;
 	UInt_t nAmp = negSigModel_->getnCohAmp();
 
-	Int_t count=0;
-	for (Int_t i=0; i<n13; i++)
+	// Find the components with this spin
+	std::vector<UInt_t> waveResIDs;
+	for (UInt_t resID = 0; resID < nAmp; ++resID)
 	{
+		const LauIsobarDynamics* model = negSigModel_;
+		const LauAbsResonance* resonance = model->getResonance(resID);
+		Int_t spin_res = resonance->getSpin();
+		if (spin != spin_res) continue;
+		waveResIDs.push_back(resID);
+	}
+
+	// Evaluate the models at all of the points in one go
+	std::vector<Double_t> pointsS13, pointsS23;
+	for (Int_t i=0; i<n13; i++) {
 		s13 = mins13 + i*delta13;
-		for (Int_t j=0; j<n23; j++)
-		{
+		for (Int_t j=0; j<n23; j++) {
 			s23 = mins23 + j*delta23;
-			if (negSigModel_->getKinematics()->withinDPLimits2(s23, s13))
-			{
+			if (negSigModel_->getKinematics()->withinDPLimits2(s23, s13)) {
 				if (negSigModel_->getDaughters()->gotSymmetricalDP() && (s13>s23) )  continue;
+				pointsS13.push_back(s13);
+				pointsS23.push_back(s23);
+			}
+		}
+	}
+	const UInt_t nPoints = pointsS13.size();
 
-				LauComplex negChAmp(0,0);
-				LauComplex posChAmp(0,0);
-				Bool_t noWaveRes = kTRUE;
-				negSigModel_->calcLikelihoodInfo(s13, s23);
-				for (UInt_t resID = 0; resID < nAmp; ++resID)
-				{
-					const LauIsobarDynamics* model = negSigModel_;
-					const LauAbsResonance* resonance = model->getResonance(resID);
-					Int_t spin_res = resonance->getSpin();
-					if (spin != spin_res) continue;
-					noWaveRes = kFALSE;
-					negChAmp += negSigModel_->getFullAmplitude(resID);
-					posChAmp += posSigModel_->getFullAmplitude(resID);
-				}
-
-				if (noWaveRes) return;
+	if (waveResIDs.empty() && nPoints > 0) return;
 
-				negChPdf = negChAmp.abs2();
-				posChPdf = posChAmp.abs2();
+	std::vector<Double_t> likelihoods( nPoints );
+	std::vector<LauComplex> negResAmps( nPoints * nAmp ), posResAmps( nPoints * nAmp );
+	negSigModel_->calcDPValues( nPoints, pointsS13.data(), pointsS23.data(), likelihoods.data(), 0, negResAmps.data() );
+	posSigModel_->calcDPValues( nPoints, pointsS13.data(), pointsS23.data(), likelihoods.data(), 0, posResAmps.data() );
 
-				negDt->SetPoint(count,s23,s13,negChPdf); // s23=sHigh, s13 = sLow
-				posDt->SetPoint(count,s23,s13,posChPdf); // s23=sHigh, s13 = sLow
-				acpDt->SetPoint(count,s23,s13, negChPdf - posChPdf); // s23=sHigh, s13 = sLow
-				count++;
+	Int_t count=0;
+	for (UInt_t iPoint=0; iPoint<nPoints; iPoint++)
+	{
+		s13 = pointsS13[iPoint];
+		s23 = pointsS23[iPoint];
 
-			}
+		LauComplex negChAmp(0,0);
+		LauComplex posChAmp(0,0);
+		for (std::vector<UInt_t>::const_iterator iter = waveResIDs.begin(); iter != waveResIDs.end(); ++iter)
+		{
+			negChAmp += negResAmps[iPoint*nAmp + (*iter)];
+			posChAmp += posResAmps[iPoint*nAmp + (*iter)];
 		}
+
+		negChPdf = negChAmp.abs2();
+		posChPdf = posChAmp.abs2();
+
+		negDt->SetPoint(count,s23,s13,negChPdf); // s23=sHigh, s13 = sLow
+		posDt->SetPoint(count,s23,s13,posChPdf); // s23=sHigh, s13 = sLow
+		acpDt->SetPoint(count,s23,s13, negChPdf - posChPdf); // s23=sHigh, s13 = sLow
+		count++;
 	}
    	gStyle->SetPalette(1);
         TCanvas *posC = new TCanvas("c"+tStrResID+label + "Positive",tStrResID+" ("+label+") Positive",0,0,600,400);
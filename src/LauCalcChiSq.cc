@@ -40,6 +40,11 @@ Thomas Latham
   7x7 or 11x11 bins. For each stage of the subdivision, each bin is first
   divided into equally populated bins in x then each of these is further divded
   into equally popiulated bins in y.
+  The subdivision is done level by level, partitioning the entries in place
+  around the required quantiles (as in the construction of a kd-tree), so that
+  the whole binning is built in O(N log N), with the bins of each level being
+  split concurrently. The resulting bin boundaries can be written to a file and
+  reused, so that many toy samples can be compared using identical bins.
  
   The (Pearson) chi-squared is then the sum of the chi-squared contributions of
   all bins:
@@ -48,9 +53,12 @@ Thomas Latham
  */
 
 #include "LauCalcChiSq.hh"
+#include "LauParallel.hh"
 
 #include "TAxis.h"
+#include "TBranch.h"
 #include "TFile.h"
+#include "TLeaf.h"
 #include "TMath.h"
 #include "TSystem.h"
 #include "TTree.h"
@@ -59,10 +67,15 @@ Thomas Latham
 #include "TColor.h"
 #include "TStyle.h"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <cstdlib>
 #include <cmath>
+#include <limits>
+#include <thread>
 
 ClassImp(LauCalcChiSq)
 
@@ -88,6 +101,9 @@ LauCalcChiSq::LauCalcChiSq(const TString& inputFileName) :
 	yMax_(0.0),
 	nParams_(0),
 	scaleFactor_(1.0),
+	inputBinningFileName_(""),
+	outputBinningFileName_(""),
+	nThreads_(std::thread::hardware_concurrency()),
 	verbose_(kFALSE)
 {
 }
@@ -336,54 +352,40 @@ void LauCalcChiSq::initialiseHistos()
 	std::cout<<"Minimum bin content is "<<minContent_<<std::endl;
 	std::cout<<"Number of free parameters is "<<nParams_<<std::endl;
 
-	Double_t x;
-	Double_t y;
+	// read the coordinates from both trees
+	std::vector<Double_t> xs1, ys1;
+	this->readCoordinates(tree1, xName1_, yName1_, xs1, ys1);
 
-	tree1->SetBranchAddress(xName1_.Data(),&x);
-	tree1->SetBranchAddress(yName1_.Data(),&y);
+	std::vector<Double_t> xs2, ys2;
+	this->readCoordinates(tree2, xName2_, yName2_, xs2, ys2);
 
-	Int_t nEntries = tree1->GetEntries();
-
-	Double_t* xs = new Double_t[nEntries];
-	Double_t* ys = new Double_t[nEntries];
-
-	for ( Int_t i=0; i < nEntries; ++i ) {
-		tree1->GetEntry( i );
-		xs[i] = x;
-		ys[i] = y;
+	//either reuse an existing binning or perform the adaptive binning based on the low stat sample
+	if ( inputBinningFileName_ != "" ) {
+		this->readBinning(inputBinningFileName_);
+	} else {
+		this->buildBinning(xs1, ys1);
+	}
+	if ( outputBinningFileName_ != "" ) {
+		this->writeBinning(outputBinningFileName_);
 	}
 
-	theHisto_ = new TH2Poly("theHisto_", "", xMin_, xMax_, yMin_, yMax_);
-
-	//select the number of divisions to get us closest to minContent entries per bin
-	std::vector<Int_t> divisions;
-	this->pickBinning(xs,ys,nEntries,divisions);
-
-	//perform the adaptive bining based on  histo1_
-	this->getHisto(xMin_, xMax_, yMin_, yMax_, xs, ys, nEntries, divisions);
+	this->createHisto();
 
 	histo1_           = dynamic_cast<TH2Poly*>(theHisto_->Clone("histo1_"));
 	histo2_           = dynamic_cast<TH2Poly*>(theHisto_->Clone("histo2_"));
 	pullHisto_        = dynamic_cast<TH2Poly*>(theHisto_->Clone("pullHisto_"));
 	chiSqHisto_       = dynamic_cast<TH2Poly*>(theHisto_->Clone("chiSqHisto_"));
 	chiSqSignedHisto_ = dynamic_cast<TH2Poly*>(theHisto_->Clone("chiSqSignedHisto_"));
-	delete[] xs;
-	delete[] ys;
-
-	//fill the two histograms from the trees
-	TString drawString1, drawString2, weightString2;
-	drawString1 += yName1_;
-	drawString1 += ":";
-	drawString1 += xName1_;
-	drawString1 += ">>histo1_";
-	drawString2 += yName2_;
-	drawString2 += ":";
-	drawString2 += xName2_;
-	drawString2 += ">>histo2_";
-	weightString2 += scaleFactor_;
-
-	tree1->Draw(drawString1);
-	tree2->Draw(drawString2,weightString2);
+
+	//fill the two histograms from the coordinates
+	std::vector<Double_t> counts1, counts2;
+	this->countEntries(xs1, ys1, counts1);
+	this->countEntries(xs2, ys2, counts2);
+
+	for (UInt_t i=0; i<counts1.size(); ++i) {
+		histo1_->SetBinContent(i+1, counts1[i]);
+		histo2_->SetBinContent(i+1, scaleFactor_*counts2[i]);
+	}
 
 	histo1_->SetDirectory(0);
 	histo2_->SetDirectory(0);
@@ -398,16 +400,36 @@ void LauCalcChiSq::initialiseHistos()
 	delete file2;
 }
 
-void LauCalcChiSq::pickBinning(const Double_t* xs, const Double_t* ys, const Int_t nEntries, std::vector<Int_t>& divisions)
+void LauCalcChiSq::readCoordinates(TTree* tree, const TString& xName, const TString& yName, std::vector<Double_t>& xs, std::vector<Double_t>& ys) const
 {
-	//first check how many events we have within the histogram limits
-	Int_t nIn(0);
-	for(Int_t i=0; i<nEntries; ++i) {
-		if(xs[i]<xMax_ && xs[i] >= xMin_ && ys[i]<yMax_ && ys[i] >= yMin_) {
-			++nIn;
+	TLeaf* xLeaf = tree->GetLeaf(xName.Data());
+	TLeaf* yLeaf = tree->GetLeaf(yName.Data());
+	if (xLeaf == 0 || yLeaf == 0) {
+		std::cerr<<"Error. Could not find the leaves "<<xName<<" and "<<yName
+		    <<" in the tree "<<tree->GetName()<<std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+
+	// only read the two branches that we need
+	TBranch* xBranch = xLeaf->GetBranch();
+	TBranch* yBranch = yLeaf->GetBranch();
+
+	const Long64_t nEntries = tree->GetEntries();
+	xs.resize(nEntries);
+	ys.resize(nEntries);
+
+	for ( Long64_t i=0; i < nEntries; ++i ) {
+		xBranch->GetEntry( i );
+		if ( yBranch != xBranch ) {
+			yBranch->GetEntry( i );
 		}
+		xs[i] = xLeaf->GetValue();
+		ys[i] = yLeaf->GetValue();
 	}
+}
 
+void LauCalcChiSq::pickBinning(const Int_t nIn, std::vector<Int_t>& divisions) const
+{
 	//aim to have exactly minContent events in each bin
 	Int_t nBinsTarget = nIn / minContent_;
 
@@ -463,81 +485,265 @@ void LauCalcChiSq::pickBinning(const Double_t* xs, const Double_t* ys, const Int
 	}
 }
 
-void LauCalcChiSq::getHisto(const Double_t xMin, const Double_t xMax, const Double_t yMin, const Double_t yMax, const Double_t* xs, const Double_t* ys, const Int_t nEntries, const std::vector<Int_t>& divisions, const UInt_t iter)
+void LauCalcChiSq::buildBinning(const std::vector<Double_t>& xs, const std::vector<Double_t>& ys)
 {
+	typedef std::array<Double_t,2> Point;
 
-	//If it's the last iteration create the bin and return
-	if(iter == divisions.size()) {
-		Double_t * x_new = new Double_t[5];
-		Double_t * y_new = new Double_t[5];
-		x_new[0] = xMin; x_new[1] = xMin; x_new[2] = xMax; x_new[3] = xMax; x_new[4] = xMin;
-		y_new[0] = yMin; y_new[1] = yMax; y_new[2] = yMax; y_new[3] = yMin; y_new[4] = yMin;
-		theHisto_->AddBin(5, x_new, y_new);
-		if(verbose_) std::cout << "Adding bin from (" << xMin << "," << yMin << ") to (" << xMax << "," << yMax << ")" << std::endl;
-		return;
+	//first select the events within the histogram limits
+	std::vector<Point> points;
+	points.reserve(xs.size());
+	for(UInt_t i=0; i<xs.size(); ++i) {
+		if(xs[i]<xMax_ && xs[i] >= xMin_ && ys[i]<yMax_ && ys[i] >= yMin_) {
+			points.push_back( Point{{xs[i], ys[i]}} );
+		}
 	}
 
-	//If not the last iteration then divide the bin
-	Int_t n_divx=divisions[iter];
-	Int_t n_divy=divisions[iter];
+	//select the number of divisions to get us closest to minContent entries per bin
+	divisions_.clear();
+	this->pickBinning(points.size(), divisions_);
+
+	const UInt_t nLevels = divisions_.size();
+	xLimits_.assign(nLevels, std::vector<Double_t>());
+	yLimits_.assign(nLevels, std::vector<Double_t>());
+
+	//the entries of each bin of the current level occupy a contiguous range of the points
+	std::vector<Int_t> starts(2);
+	starts[0] = 0;
+	starts[1] = points.size();
+	std::vector<Double_t> bounds(4);
+	bounds[0] = xMin_; bounds[1] = xMax_; bounds[2] = yMin_; bounds[3] = yMax_;
+
+	for (UInt_t iLevel=0; iLevel<nLevels; ++iLevel) {
+
+		const Int_t nDiv = divisions_[iLevel];
+		const Int_t nBins = starts.size()-1;
+
+		if(verbose_) std::cout << "Dividing " << nBins << " bins into " << nDiv << " by " << nDiv << " subbins" << std::endl;
+
+		std::vector<Double_t>& xLimits = xLimits_[iLevel];
+		std::vector<Double_t>& yLimits = yLimits_[iLevel];
+		xLimits.resize(nBins*(nDiv+1));
+		yLimits.resize(nBins*nDiv*(nDiv+1));
+
+		std::vector<Int_t> newStarts(nBins*nDiv*nDiv+1);
+		newStarts.back() = points.size();
+		std::vector<Double_t> newBounds(4*nBins*nDiv*nDiv);
+
+		//divide the entries [first,first+nEntries) into nDiv equally populated ranges
+		//in coordinate iCoord, storing the delimitting values in limits
+		auto partition = [nDiv]( Point* first, const Int_t nEntries, const UInt_t iCoord, const Double_t lower, const Double_t upper, Double_t* limits )
+		{
+			limits[0] = lower;
+			limits[nDiv] = upper;
+			Int_t prevPos(0);
+			for (Int_t iDiv=1; iDiv<nDiv; ++iDiv) {
+				const Int_t pos = static_cast<Long64_t>(nEntries)*iDiv/nDiv;
+				if (nEntries == 0) {
+					limits[iDiv] = lower + (upper-lower)*iDiv/nDiv;
+					continue;
+				}
+				std::nth_element( first+prevPos, first+pos, first+nEntries, [iCoord](const Point& a, const Point& b) {return a[iCoord] < b[iCoord];} );
+				limits[iDiv] = first[pos][iCoord];
+				prevPos = pos;
+			}
+		};
+
+		auto splitBins = [&]( const UInt_t /*iRange*/, const Int_t firstBin, const Int_t lastBin )
+		{
+			for (Int_t iBin=firstBin; iBin<lastBin; ++iBin) {
+				Point* first = points.data() + starts[iBin];
+				const Int_t nEntries = starts[iBin+1] - starts[iBin];
+				const Double_t* bound = &bounds[4*iBin];
+
+				//first divide bin into equally populated bins in x
+				Double_t* xLim = &xLimits[iBin*(nDiv+1)];
+				partition( first, nEntries, 0, bound[0], bound[1], xLim );
+
+				//then for each bin in x divide into equally populated bins in y
+				for (Int_t iDivx=0; iDivx<nDiv; ++iDivx) {
+					const Int_t xBegin = static_cast<Long64_t>(nEntries)*iDivx/nDiv;
+					const Int_t xCount = static_cast<Long64_t>(nEntries)*(iDivx+1)/nDiv - xBegin;
+
+					Double_t* yLim = &yLimits[(iBin*nDiv+iDivx)*(nDiv+1)];
+					partition( first+xBegin, xCount, 1, bound[2], bound[3], yLim );
+
+					//record the entries and limits of each sub bin
+					for (Int_t iDivy=0; iDivy<nDiv; ++iDivy) {
+						const Int_t subBin = (iBin*nDiv+iDivx)*nDiv+iDivy;
+						newStarts[subBin] = starts[iBin] + xBegin + static_cast<Long64_t>(xCount)*iDivy/nDiv;
+						newBounds[4*subBin+0] = xLim[iDivx];
+						newBounds[4*subBin+1] = xLim[iDivx+1];
+						newBounds[4*subBin+2] = yLim[iDivy];
+						newBounds[4*subBin+3] = yLim[iDivy+1];
+					}
+				}
+			}
+		};
+		LauParallel::forEachRange( nBins, nThreads_, 1, splitBins );
 
-	if(verbose_) std::cout << "Dividing bin from (" << xMin << "," << yMin << ") to (" << xMax << "," << yMax << ") into " << n_divx << " by " << n_divy << " subbins" << std::endl;
+		starts.swap(newStarts);
+		bounds.swap(newBounds);
+	}
+}
 
-	Double_t *xIn = new Double_t[nEntries];
-	Double_t *yIn = new Double_t[nEntries];
-	Int_t *xIndex = new Int_t [nEntries+2];
-	Int_t *yIndex = new Int_t [nEntries+2];
+void LauCalcChiSq::createHisto()
+{
+	theHisto_ = new TH2Poly("theHisto_", "", xMin_, xMax_, yMin_, yMax_);
 
-	Int_t xCountIn = 0;
-	for(Int_t i = 0; i<nEntries; ++i) {
-		if ((xs[i]<xMin)||(xs[i]>xMax)||(ys[i]<yMin)||(ys[i]>yMax)) continue;
-		xIn[xCountIn] = xs[i];
-		++xCountIn;
+	//with no subdivisions there is just the one bin
+	if (divisions_.empty()) {
+		if(verbose_) std::cout << "Adding bin from (" << xMin_ << "," << yMin_ << ") to (" << xMax_ << "," << yMax_ << ")" << std::endl;
+		theHisto_->AddBin(xMin_, yMin_, xMax_, yMax_);
+		return;
 	}
 
-	//find the delimitting x and y values for the sub bins
-	Double_t xLimits[n_divx + 1];
-	Double_t yLimits[n_divx][n_divy + 1];
+	//otherwise the bins are the subdivisions of the last level, in order
+	const Int_t nDiv = divisions_.back();
+	const std::vector<Double_t>& xLimits = xLimits_.back();
+	const std::vector<Double_t>& yLimits = yLimits_.back();
+	const Int_t nParents = xLimits.size()/(nDiv+1);
+
+	for (Int_t iParent=0; iParent<nParents; ++iParent) {
+		const Double_t* xLim = &xLimits[iParent*(nDiv+1)];
+		for (Int_t iDivx=0; iDivx<nDiv; ++iDivx) {
+			const Double_t* yLim = &yLimits[(iParent*nDiv+iDivx)*(nDiv+1)];
+			for (Int_t iDivy=0; iDivy<nDiv; ++iDivy) {
+				if(verbose_) std::cout << "Adding bin from (" << xLim[iDivx] << "," << yLim[iDivy] << ") to (" << xLim[iDivx+1] << "," << yLim[iDivy+1] << ")" << std::endl;
+				theHisto_->AddBin(xLim[iDivx], yLim[iDivy], xLim[iDivx+1], yLim[iDivy+1]);
+			}
+		}
+	}
+}
 
-	//first sort entries in x and divide bin into equally populated bins in x
-	TMath::Sort(xCountIn, xIn, xIndex, false);
+Int_t LauCalcChiSq::findBin(const Double_t x, const Double_t y) const
+{
+	if (!(x<xMax_ && x >= xMin_ && y<yMax_ && y >= yMin_)) {
+		return -1;
+	}
 
-	xLimits[0] = xMin;
-	xLimits[n_divx] = xMax;
-	for (Int_t nDivx = 0; nDivx < n_divx; ++nDivx){
-		if (nDivx  < (n_divx-1)){
-			xLimits[nDivx+1] = xIn[xIndex[xCountIn*(nDivx+1)/n_divx]];
-		}
+	//descend through the levels, finding the sub bin at each one
+	Int_t iBin(0);
+	for (UInt_t iLevel=0; iLevel<divisions_.size(); ++iLevel) {
+		const Int_t nDiv = divisions_[iLevel];
+		const Double_t* xLim = &xLimits_[iLevel][iBin*(nDiv+1)];
+		const Int_t iDivx = std::upper_bound(xLim+1, xLim+nDiv, x) - (xLim+1);
+		const Double_t* yLim = &yLimits_[iLevel][(iBin*nDiv+iDivx)*(nDiv+1)];
+		const Int_t iDivy = std::upper_bound(yLim+1, yLim+nDiv, y) - (yLim+1);
+		iBin = (iBin*nDiv+iDivx)*nDiv+iDivy;
+	}
+	return iBin;
+}
 
-		//for each bin in x divide into equally populated bins in y
-		yLimits[nDivx][0] = yMin;
-		yLimits[nDivx][n_divy] = yMax;
-		Int_t yCountIn = 0;
+void LauCalcChiSq::countEntries(const std::vector<Double_t>& xs, const std::vector<Double_t>& ys, std::vector<Double_t>& counts) const
+{
+	Int_t nBins(1);
+	for (std::vector<Int_t>::const_iterator iter = divisions_.begin(); iter != divisions_.end(); ++iter) {
+		nBins *= (*iter) * (*iter);
+	}
+
+	//each thread fills its own set of counts, which are then summed
+	std::vector< std::vector<Double_t> > threadCounts( std::max(nThreads_, 1U) );
+
+	auto fillCounts = [&]( const UInt_t iThread, const Int_t first, const Int_t last )
+	{
+		std::vector<Double_t>& myCounts = threadCounts[iThread];
+		myCounts.assign(nBins, 0.0);
+		for (Int_t i=first; i<last; ++i) {
+			const Int_t iBin = this->findBin(xs[i], ys[i]);
+			if (iBin >= 0) {
+				myCounts[iBin] += 1.0;
+			}
+		}
+	};
+	const UInt_t nUsed = LauParallel::forEachRange( xs.size(), nThreads_, 1, fillCounts );
 
-		for(Int_t i = 0; i<nEntries; ++i) {
-			if ((xs[i]<xMin)||(xs[i]>xMax)||(ys[i]<yMin)||(ys[i]>yMax)) continue;
-			if ((xs[i]<xLimits[nDivx])||(xs[i]>=xLimits[nDivx+1])||(ys[i]<yMin)||(ys[i]>yMax)) continue;
-			yIn[yCountIn] = ys[i];
-			++yCountIn;
+	counts.assign(nBins, 0.0);
+	for (UInt_t iThread=0; iThread<nUsed; ++iThread) {
+		for (Int_t iBin=0; iBin<nBins; ++iBin) {
+			counts[iBin] += threadCounts[iThread][iBin];
 		}
+	}
+}
 
-		TMath::Sort(yCountIn, yIn, yIndex, false);
+void LauCalcChiSq::writeBinning(const TString& fileName) const
+{
+	std::ofstream outFile(fileName.Data());
+	if (!outFile.good()) {
+		std::cerr<<"Error. Could not open the binning file "<<fileName<<" for writing"<<std::endl;
+		return;
+	}
 
-		for (Int_t nDivy = 1; nDivy < n_divy; ++nDivy){
-			yLimits[nDivx][nDivy] = yIn[yIndex[yCountIn*nDivy/n_divy]];
+	outFile << std::setprecision(std::numeric_limits<Double_t>::max_digits10);
+	outFile << xMin_ << " " << xMax_ << " " << yMin_ << " " << yMax_ << "\n";
+
+	outFile << divisions_.size();
+	for (std::vector<Int_t>::const_iterator iter = divisions_.begin(); iter != divisions_.end(); ++iter) {
+		outFile << " " << (*iter);
+	}
+	outFile << "\n";
+
+	for (UInt_t iLevel=0; iLevel<divisions_.size(); ++iLevel) {
+		for (std::vector<Double_t>::const_iterator iter = xLimits_[iLevel].begin(); iter != xLimits_[iLevel].end(); ++iter) {
+			outFile << (*iter) << " ";
+		}
+		outFile << "\n";
+		for (std::vector<Double_t>::const_iterator iter = yLimits_[iLevel].begin(); iter != yLimits_[iLevel].end(); ++iter) {
+			outFile << (*iter) << " ";
 		}
+		outFile << "\n";
 	}
 
-	delete[] xIn;
-	delete[] yIn;
-	delete[] xIndex;
-	delete[] yIndex;
+	outFile.close();
 
-	//call for each sub bin
-	for (Int_t nDivx = 0; nDivx < n_divx; ++nDivx){
-		for (Int_t nDivy = 0; nDivy < n_divy; ++nDivy){
-			this->getHisto(xLimits[nDivx], xLimits[nDivx + 1], yLimits[nDivx][nDivy], yLimits[nDivx][nDivy + 1], xs, ys, nEntries, divisions,iter+1);
+	std::cout<<"Binning written to "<<fileName<<std::endl;
+}
+
+void LauCalcChiSq::readBinning(const TString& fileName)
+{
+	std::ifstream inFile(fileName.Data());
+
+	Double_t xMin(0.0), xMax(0.0), yMin(0.0), yMax(0.0);
+	UInt_t nLevels(0);
+	inFile >> xMin >> xMax >> yMin >> yMax >> nLevels;
+	if (!inFile.good()) {
+		std::cerr<<"Error. Could not read the binning file "<<fileName<<std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+
+	if (xMin != xMin_ || xMax != xMax_ || yMin != yMin_ || yMax != yMax_) {
+		std::cerr<<"Warning. The histogram limits in the binning file "<<fileName<<" differ from those in the input file, using those from the binning file"<<std::endl;
+	}
+	xMin_ = xMin; xMax_ = xMax; yMin_ = yMin; yMax_ = yMax;
+
+	divisions_.resize(nLevels);
+	for (UInt_t iLevel=0; iLevel<nLevels; ++iLevel) {
+		inFile >> divisions_[iLevel];
+	}
+
+	xLimits_.assign(nLevels, std::vector<Double_t>());
+	yLimits_.assign(nLevels, std::vector<Double_t>());
+
+	Int_t nBins(1);
+	for (UInt_t iLevel=0; iLevel<nLevels; ++iLevel) {
+		const Int_t nDiv = divisions_[iLevel];
+		xLimits_[iLevel].resize(nBins*(nDiv+1));
+		yLimits_[iLevel].resize(nBins*nDiv*(nDiv+1));
+		for (std::vector<Double_t>::iterator iter = xLimits_[iLevel].begin(); iter != xLimits_[iLevel].end(); ++iter) {
+			inFile >> (*iter);
 		}
+		for (std::vector<Double_t>::iterator iter = yLimits_[iLevel].begin(); iter != yLimits_[iLevel].end(); ++iter) {
+			inFile >> (*iter);
+		}
+		nBins *= nDiv*nDiv;
 	}
+
+	if (inFile.fail()) {
+		std::cerr<<"Error. The binning file "<<fileName<<" is incomplete"<<std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+
+	inFile.close();
+
+	std::cout<<"Using "<<nBins<<" bins read from "<<fileName<<std::endl;
 }
 
@@ -120,7 +120,7 @@ void LauChebychevPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
 	}
 }
 
@@ -53,6 +53,7 @@ using std::endl;
 
 #include "LauCruijffPdf.hh"
 #include "LauConstants.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauCruijffPdf)
 
@@ -131,12 +132,39 @@ void LauCruijffPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
 	}
 	
 	this->setUnNormPDFVal(value);
 }
 
+void LauCruijffPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	// Get the up to date parameter values
+	Double_t mean = mean_->unblindValue();
+	Double_t sigmaL = sigmaL_->unblindValue();
+	Double_t sigmaR = sigmaR_->unblindValue();
+	Double_t alphaL = alphaL_->unblindValue();
+	Double_t alphaR = alphaR_->unblindValue();
+
+	const Bool_t useL = (TMath::Abs(sigmaL) > 1e-30);
+	const Bool_t useR = (TMath::Abs(sigmaR) > 1e-30);
+	const Double_t twoSigmaLSq = 2.0*sigmaL*sigmaL;
+	const Double_t twoSigmaRSq = 2.0*sigmaR*sigmaR;
+
+	// Calculate the exponents for all the abscissa values and then exponentiate them all together
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t arg = abscissas[i] - mean;
+		const Bool_t left = (arg < 0.0);
+		const Double_t denom = left ? (twoSigmaLSq + alphaL*arg*arg) : (twoSigmaRSq + alphaR*arg*arg);
+		const Bool_t use = left ? useL : useR;
+		const Double_t coef = use ? -1.0/denom : 0.0;
+		values[i] = coef*arg*arg;
+	}
+
+	LauVectorMath::exp( nValues, values, values );
+}
+
 void LauCruijffPdf::calcPDFHeight( const LauKinematics* /*kinematics*/ )
 {
 	if (this->heightUpToDate()) {
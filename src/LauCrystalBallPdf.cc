@@ -53,6 +53,7 @@ using std::endl;
 
 #include "LauConstants.hh"
 #include "LauCrystalBallPdf.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauCrystalBallPdf)
 
@@ -130,11 +131,42 @@ void LauCrystalBallPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
 	}
 
 }
 
+void LauCrystalBallPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	// Get the up to date parameter values
+	Double_t mean = mean_->unblindValue();
+	Double_t sigma = sigma_->unblindValue();
+	Double_t alpha = alpha_->unblindValue();
+	Double_t n = n_->unblindValue();
+
+	const Double_t sign = (alpha < 0.0) ? -1.0 : 1.0;
+	const Double_t absAlpha = TMath::Abs(alpha);
+
+	// First treat every value as being in the Gaussian core
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t t = sign*(abscissas[i] - mean)/sigma;
+		values[i] = -0.5*t*t;
+	}
+
+	LauVectorMath::exp( nValues, values, values );
+
+	// Then correct those that are actually in the power-law tail
+	const Double_t a = TMath::Power(n/absAlpha,n)*TMath::Exp(-0.5*absAlpha*absAlpha);
+	const Double_t b = n/absAlpha - absAlpha;
+
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t t = sign*(abscissas[i] - mean)/sigma;
+		if (t < -absAlpha) {
+			values[i] = a/TMath::Power(b - t, n);
+		}
+	}
+}
+
 void LauCrystalBallPdf::calcNorm() 
 {
 	// Get the up to date parameter values
@@ -69,7 +69,8 @@ LauDPDepCruijffPdf::LauDPDepCruijffPdf(const TString& theVarName, const std::vec
 	sigmaRCoeffs_(sigmaRCoeffs),
 	alphaLCoeffs_(alphaLCoeffs),
 	alphaRCoeffs_(alphaRCoeffs),
-	dpAxis_(dpAxis)
+	dpAxis_(dpAxis),
+	trapezoidNorm_(0.0)
 {
 	// Constructor for the Dalitz-plot dependent Cruijff PDF.
 
@@ -200,7 +201,7 @@ Double_t LauDPDepCruijffPdf::integrGaussLegendre()
 
 Double_t LauDPDepCruijffPdf::integTrapezoid()
 {
-	static Double_t norm(0.0);
+	Double_t& norm = trapezoidNorm_;
 	Double_t range = this->getRange();
 
 	if (this->nNormPoints()==1){
@@ -190,7 +190,7 @@ void LauEffModel::addEffHisto(const TH2* effHisto, Bool_t useInterpolation,
 	std::cout<<"INFO in LauEffModel::addEffHisto : Efficiency histogram has upperHalf = "<<static_cast<Int_t>(upperHalf)<<std::endl;
 
 	// Copy the histogram.
-	effHisto_.push_back(new Lau2DHistDP(effHisto, daughters_,
+	this->addHistComponent(new Lau2DHistDP(effHisto, daughters_,
 			useInterpolation, fluctuateEffHisto_,
 			avEff, absError, upperHalf, squareDP));
 }
@@ -206,7 +206,7 @@ void LauEffModel::addEffHisto(const TH2* effHisto, const TH2* errorHi, const TH2
 	std::cout<<"INFO in LauEffModel::addEffHisto : Efficiency histogram has upperHalf = "<<static_cast<Int_t>(upperHalf)<<std::endl;
 
 	// Copy the histogram.
-	effHisto_.push_back(new Lau2DHistDP(effHisto, errorHi, errorLo, daughters_,
+	this->addHistComponent(new Lau2DHistDP(effHisto, errorHi, errorLo, daughters_,
 			useInterpolation, fluctuateEffHisto_,
 			avEff, absError, upperHalf, squareDP));
 }
@@ -222,7 +222,7 @@ void LauEffModel::addEffSpline(const TH2* effHisto,
 	std::cout<<"INFO in LauEffModel::addEffSpline : Efficiency histogram has upperHalf = "<<static_cast<Int_t>(upperHalf)<<std::endl;
 
 	// Copy the histogram.
-	effHisto_.push_back(new Lau2DSplineDP(effHisto, daughters_,
+	this->addSplineComponent(new Lau2DSplineDP(effHisto, daughters_,
 			fluctuateEffHisto_, avEff, absError, upperHalf, squareDP));
 }
 
@@ -237,10 +237,48 @@ void LauEffModel::addEffSpline(const TH2* effHisto, const TH2* errorHi, const TH
 	std::cout<<"INFO in LauEffModel::addEffSpline : Efficiency histogram has upperHalf = "<<static_cast<Int_t>(upperHalf)<<std::endl;
 
 	// Copy the histogram.
-	effHisto_.push_back(new Lau2DSplineDP(effHisto, errorHi, errorLo, daughters_,
+	this->addSplineComponent(new Lau2DSplineDP(effHisto, errorHi, errorLo, daughters_,
 			fluctuateEffHisto_, avEff, absError, upperHalf, squareDP));
 }
 
+void LauEffModel::addHistComponent(Lau2DHistDP* histo)
+{
+	// If the new histogram has the same binning and interpolation setting as an
+	// existing component then we can combine it with that component, so that
+	// only a single lookup is needed when calculating the efficiency
+	std::vector<Lau2DAbsDP*>::iterator it = effHisto_.begin();
+	std::vector<Lau2DAbsDP*>::iterator end = effHisto_.end();
+	for( ; it!=end; ++it) {
+		Lau2DHistDP* existing = dynamic_cast<Lau2DHistDP*>(*it);
+		if ( existing != 0 && existing->multiplyBins(*histo) ) {
+			std::cout<<"INFO in LauEffModel::addHistComponent : Efficiency histogram has been combined with an existing histogram with the same binning"<<std::endl;
+			delete histo;
+			return;
+		}
+	}
+
+	effHisto_.push_back(histo);
+}
+
+void LauEffModel::addSplineComponent(Lau2DSplineDP* spline)
+{
+	// If the new spline has the same knots and co-ordinates as an existing
+	// spline component then it is evaluated together with that component,
+	// so that the cell lookup is only needed once when calculating the efficiency
+	std::vector<Lau2DAbsDP*>::iterator it = effHisto_.begin();
+	std::vector<Lau2DAbsDP*>::iterator end = effHisto_.end();
+	for( ; it!=end; ++it) {
+		Lau2DSplineDP* existing = dynamic_cast<Lau2DSplineDP*>(*it);
+		if ( existing != 0 && existing->multiplySpline(*spline) ) {
+			std::cout<<"INFO in LauEffModel::addSplineComponent : Efficiency spline has been combined with an existing spline with the same binning"<<std::endl;
+			delete spline;
+			return;
+		}
+	}
+
+	effHisto_.push_back(spline);
+}
+
 Double_t LauEffModel::getEffHistValue(const LauKinematics* kinematics) const
 {
 	// Get the efficiency from the 2D histo.
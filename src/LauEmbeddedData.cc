@@ -27,6 +27,7 @@ Thomas Latham
 */
 
 #include <iostream>
+#include <utility>
 #include <vector>
 using std::cerr;
 using std::endl;
@@ -43,7 +44,8 @@ ClassImp(LauEmbeddedData)
 
 LauEmbeddedData::LauEmbeddedData(const TString& fileName, const TString& treeName, Bool_t allowReuseOfEvents) :
 	theDataTree_(new LauFitDataTree(fileName,treeName)),
-	reuseEvents_(allowReuseOfEvents)
+	reuseEvents_(allowReuseOfEvents),
+	nUsedEvents_(0)
 {
 }
 
@@ -67,9 +69,133 @@ Bool_t LauEmbeddedData::findBranches()
 
 	theDataTree_->readAllData();
 
+	// Start afresh with the new data
+	eventOrder_.resize( this->nEvents() );
+	for ( UInt_t iEvt(0); iEvt < eventOrder_.size(); ++iEvt ) {
+		eventOrder_[iEvt] = iEvt;
+	}
+	nUsedEvents_ = 0;
+	reweightCaches_.clear();
+
 	return kTRUE;
 }
 
+UInt_t LauEmbeddedData::drawUnusedEvent()
+{
+	// Move a randomly chosen unused event to the end of the used
+	// events, i.e. perform one step of a Fisher-Yates shuffle
+	const UInt_t nUnused = eventOrder_.size() - nUsedEvents_;
+	const UInt_t iChoice = nUsedEvents_ + LauRandom::randomFun()->Integer(nUnused);
+	std::swap( eventOrder_[nUsedEvents_], eventOrder_[iChoice] );
+	return eventOrder_[nUsedEvents_++];
+}
+
+const LauEmbeddedData::ReweightCache& LauEmbeddedData::getReweightCache(LauIsobarDynamics* dynamics)
+{
+	ReweightCache& cache = reweightCaches_[dynamics];
+	const UInt_t numEvents = this->nEvents();
+	if ( cache.weights_.size() == numEvents && cache.modelVersion_ == dynamics->getModelVersion() ) {
+		return cache;
+	}
+
+	cache.modelVersion_ = dynamics->getModelVersion();
+	cache.maxWeight_ = 0.0;
+	cache.weights_.assign( numEvents, 0.0 );
+	cache.aliasProbs_.clear();
+	cache.aliases_.clear();
+
+	LauKinematics* kinematics = dynamics->getKinematics();
+
+	// Read the true DP co-ordinates directly from the columns when we can
+	const Double_t* m13SqColumn = theDataTree_->isFlatFile() ? theDataTree_->getColumn("m13Sq_MC") : 0;
+	const Double_t* m23SqColumn = theDataTree_->isFlatFile() ? theDataTree_->getColumn("m23Sq_MC") : 0;
+
+	UInt_t nOutside(0);
+	for ( UInt_t iEvt(0); iEvt < numEvents; ++iEvt ) {
+
+		Double_t m13Sq_MC(0.0), m23Sq_MC(0.0);
+		if ( m13SqColumn && m23SqColumn ) {
+			m13Sq_MC = m13SqColumn[iEvt];
+			m23Sq_MC = m23SqColumn[iEvt];
+		} else {
+			theData_ = theDataTree_->getData(iEvt);
+			m13Sq_MC = this->getValue("m13Sq_MC");
+			m23Sq_MC = this->getValue("m23Sq_MC");
+		}
+
+		if ( ! kinematics->withinDPLimits(m13Sq_MC,m23Sq_MC) ) {
+			++nOutside;
+			continue;
+		}
+
+		kinematics->updateKinematics(m13Sq_MC, m23Sq_MC);
+		const Double_t weight = dynamics->getEventWeight();
+		cache.weights_[iEvt] = weight;
+		if ( weight > cache.maxWeight_ ) {
+			cache.maxWeight_ = weight;
+		}
+	}
+
+	if ( nOutside > 0 ) {
+		cerr<<"WARNING in LauEmbeddedData::getReweightCache : "<<nOutside<<" events are not within the DP boundary and will never be selected."<<endl;
+	}
+
+	if ( this->reuseEvents() ) {
+		this->buildAliasTable( cache );
+	}
+
+	return cache;
+}
+
+void LauEmbeddedData::buildAliasTable(ReweightCache& cache) const
+{
+	// Walker's alias method, as arranged by Vose
+	const UInt_t numEvents = cache.weights_.size();
+
+	Double_t sum(0.0);
+	for ( std::vector<Double_t>::const_iterator iter = cache.weights_.begin(); iter != cache.weights_.end(); ++iter ) {
+		sum += (*iter);
+	}
+	if ( sum <= 0.0 ) {
+		return;
+	}
+
+	cache.aliasProbs_.resize( numEvents );
+	cache.aliases_.resize( numEvents );
+
+	std::vector<UInt_t> small, large;
+	for ( UInt_t iEvt(0); iEvt < numEvents; ++iEvt ) {
+		cache.aliasProbs_[iEvt] = cache.weights_[iEvt] * numEvents / sum;
+		cache.aliases_[iEvt] = iEvt;
+		if ( cache.aliasProbs_[iEvt] < 1.0 ) {
+			small.push_back( iEvt );
+		} else {
+			large.push_back( iEvt );
+		}
+	}
+
+	while ( ! small.empty() && ! large.empty() ) {
+		const UInt_t iSmall = small.back();
+		small.pop_back();
+		const UInt_t iLarge = large.back();
+
+		cache.aliases_[iSmall] = iLarge;
+		cache.aliasProbs_[iLarge] -= ( 1.0 - cache.aliasProbs_[iSmall] );
+		if ( cache.aliasProbs_[iLarge] < 1.0 ) {
+			large.pop_back();
+			small.push_back( iLarge );
+		}
+	}
+
+	// Anything left over is only there because of rounding
+	for ( std::vector<UInt_t>::const_iterator iter = small.begin(); iter != small.end(); ++iter ) {
+		cache.aliasProbs_[*iter] = 1.0;
+	}
+	for ( std::vector<UInt_t>::const_iterator iter = large.begin(); iter != large.end(); ++iter ) {
+		cache.aliasProbs_[*iter] = 1.0;
+	}
+}
+
 Bool_t LauEmbeddedData::getReweightedEvent(LauIsobarDynamics* dynamics)
 {
 	if (!theDataTree_) {
@@ -85,68 +211,63 @@ Bool_t LauEmbeddedData::getReweightedEvent(LauIsobarDynamics* dynamics)
 	UInt_t numEvents = this->nEvents();
 	UInt_t iEvt(0);
 
-	// First select a random event within the embedded data sample
+	LauKinematics* kinematics = dynamics->getKinematics();
+
+	// Without the kinematics there is nothing to reweight with, so just select a random event
+	if (kinematics == 0) {
+		if (this->reuseEvents()) {
+			iEvt = LauRandom::randomFun()->Integer(numEvents);
+		} else {
+			if (this->nUsedEvents() == numEvents) {
+				cerr<<"ERROR in LauEmbeddedData::getReweightedEvent : Have already used all events in the tree."<<endl;
+				return kFALSE;
+			}
+			iEvt = this->drawUnusedEvent();
+		}
+		theData_ = theDataTree_->getData(iEvt);
+		return kTRUE;
+	}
+
+	const ReweightCache& cache = this->getReweightCache(dynamics);
+	if (cache.maxWeight_ <= 0.0) {
+		cerr<<"ERROR in LauEmbeddedData::getReweightedEvent : None of the events in the tree has a non-zero weight."<<endl;
+		return kFALSE;
+	}
+
 	if (this->reuseEvents()) {
+		// Sample directly according to the weights using the alias table
 		iEvt = LauRandom::randomFun()->Integer(numEvents);
-	} else {
-		if (this->nUsedEvents() == numEvents) {
-			cerr<<"ERROR in LauEmbeddedData::getReweightedEvent : Have already used all events in the tree."<<endl;
-			return kFALSE;
+		if (LauRandom::randomFun()->Rndm() >= cache.aliasProbs_[iEvt]) {
+			iEvt = cache.aliases_[iEvt];
 		}
-		Bool_t ok(kFALSE);
-		while (!ok) {
-			iEvt = LauRandom::randomFun()->Integer(numEvents);
-			ok = usedEvents_.insert(iEvt).second;
+	} else {
+		// Visit the unused events in random order until one is accepted
+		// according to the ratio of its weight to the largest weight
+		Bool_t accepted(kFALSE);
+		while (!accepted) {
+			if (this->nUsedEvents() == numEvents) {
+				cerr<<"ERROR in LauEmbeddedData::getReweightedEvent : Have already used all events in the tree."<<endl;
+				return kFALSE;
+			}
+			iEvt = this->drawUnusedEvent();
+			accepted = ( LauRandom::randomFun()->Rndm() * cache.maxWeight_ < cache.weights_[iEvt] );
 		}
 	}
 
 	// Retrieve the data for the selected event
 	theData_ = theDataTree_->getData(iEvt);
 
-	LauKinematics* kinematics = dynamics->getKinematics();
-
-	if (kinematics != 0) {
-
-	        // Get the true m13Sq, m23Sq variables.
-	        Double_t m13Sq_MC = this->getValue("m13Sq_MC");
-		Double_t m23Sq_MC = this->getValue("m23Sq_MC");
+	// Recalculate the model at the true DP co-ordinates, so that it is
+	// left in the state corresponding to the selected event
+	Double_t m13Sq_MC = this->getValue("m13Sq_MC");
+	Double_t m23Sq_MC = this->getValue("m23Sq_MC");
+	kinematics->updateKinematics(m13Sq_MC, m23Sq_MC);
+	dynamics->getEventWeight();
 
-		if (kinematics->withinDPLimits(m13Sq_MC,m23Sq_MC)) {
-
-		        // Update the kinematics with the true m13Sq, m23Sq variables
-		        kinematics->updateKinematics(m13Sq_MC, m23Sq_MC);
-
-			// Use this event or not, according to whether the amplitude model selects it.
-			// The LauIsobarDynamics uses an accept/reject method based on the 
-			// ratio of the current to maximum ASq value. Other models may use alternative methods,
-			// but they must provide a yes/no answer if the event is accepted.
-			Bool_t gotReweightedEvent = dynamics->gotReweightedEvent();
-			if (gotReweightedEvent == kTRUE) {
-
-				// Event is accepted.
-				// Update the kinematics to use the reco variables.
-			        Double_t m13Sq = this->getValue("m13Sq");
-				Double_t m23Sq = this->getValue("m23Sq");
-				kinematics->updateKinematics(m13Sq, m23Sq);
-
-				if (LauIsobarDynamics::GenOK != dynamics->checkToyMC(kFALSE,kFALSE)) {
-					return kFALSE;
-				}
-
-			} else {
-			  
-			        // Recursively run this function until we get an accepted event
-			        return this->getReweightedEvent(dynamics);
-			  
-			}
-			
-		} else {
-
-		        cerr<<"WARNING in LauEmbeddedData::getReweightedEvent : Skipping event "<<iEvt<<", which isn't within the DP boundary."<<endl;
-			return this->getReweightedEvent(dynamics);
-		  
-		}
-	}
+	// Update the kinematics to use the reco variables.
+	Double_t m13Sq = this->getValue("m13Sq");
+	Double_t m23Sq = this->getValue("m23Sq");
+	kinematics->updateKinematics(m13Sq, m23Sq);
 
 	return kTRUE;
 }
@@ -159,29 +280,32 @@ void LauEmbeddedData::getEmbeddedEvent(LauKinematics* kinematics)
 	}
 	UInt_t numEvents = this->nEvents();
 	UInt_t iEvt(0);
-	if (this->reuseEvents()) {
-		iEvt = LauRandom::randomFun()->Integer(numEvents);
-	} else {
-		if (this->nUsedEvents() == numEvents) {
-			cerr<<"ERROR in LauEmbeddedData::getEmbeddedEvent : Have already used all events in the tree."<<endl;
-			return;
-		}
-		Bool_t ok(kFALSE);
-		while (!ok) {
+
+	// Keep selecting events until we find one within the DP
+	Bool_t ok(kFALSE);
+	while (!ok) {
+		if (this->reuseEvents()) {
 			iEvt = LauRandom::randomFun()->Integer(numEvents);
-			ok = usedEvents_.insert(iEvt).second;
+		} else {
+			if (this->nUsedEvents() == numEvents) {
+				cerr<<"ERROR in LauEmbeddedData::getEmbeddedEvent : Have already used all events in the tree."<<endl;
+				return;
+			}
+			iEvt = this->drawUnusedEvent();
+		}
+		theData_ = theDataTree_->getData(iEvt);
+
+		if (kinematics==0) {
+			break;
 		}
-	}
-	theData_ = theDataTree_->getData(iEvt);
 
-	if (kinematics!=0) {
 		Double_t m13Sq = this->getValue("m13Sq");
 		Double_t m23Sq = this->getValue("m23Sq");
 		if (kinematics->withinDPLimits(m13Sq,m23Sq)) {
 			kinematics->updateKinematics(m13Sq,m23Sq);
+			ok = kTRUE;
 		} else {
 			cerr<<"WARNING in LauEmbeddedData::getEmbeddedEvent : Skipping event that isn't within the DP boundary."<<endl;
-			this->getEmbeddedEvent(kinematics);
 		}
 	}
 }
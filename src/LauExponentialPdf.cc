@@ -93,7 +93,7 @@ void LauExponentialPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
 	}
 
 }
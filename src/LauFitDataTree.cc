@@ -26,9 +26,18 @@ Thomas Latham
     \brief File containing implementation of LauFitDataTree class.
 */
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <numeric>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "TFile.h"
 #include "TLeaf.h"
@@ -39,15 +48,67 @@ Thomas Latham
 
 ClassImp(LauFitDataTree)
 
+namespace {
+
+	// Identifier written at the start of every flat file
+	const char flatFileMagic[8] = {'L','A','U','F','L','A','T','1'};
+
+	// Version of the flat file layout, to be incremented whenever it changes
+	const UInt_t flatFileVersion = 1;
+
+	// Word written in the byte order of the writing machine, so that files written with a different one are rejected
+	const UInt_t flatFileByteOrder = 0x01020304;
+
+	// Alignment (in bytes) of each column in the flat file
+	const ULong64_t flatFileAlignment = 64;
+
+	// Size (in bytes) of the null-padded column name records
+	const ULong64_t flatFileNameLength = 64;
+
+	// Layout of the flat file header, which occupies the first 64 bytes
+	struct LauFlatFileHeader {
+		char magic[8];
+		UInt_t nColumns;
+		UInt_t nExpts;
+		ULong64_t nEvents;
+		ULong64_t dataOffset;
+		ULong64_t columnStride;
+		UInt_t version;
+		UInt_t byteOrder;
+		char padding[16];
+	};
+
+	// Layout of the per-experiment records that follow the column names
+	struct LauFlatFileExpt {
+		UInt_t iExpt;
+		UInt_t firstEvt;
+		UInt_t nEvts;
+		UInt_t padding;
+	};
+
+	ULong64_t alignToFlatFile(const ULong64_t nBytes)
+	{
+		return ( (nBytes + flatFileAlignment - 1) / flatFileAlignment ) * flatFileAlignment;
+	}
+
+}
+
 
 LauFitDataTree::LauFitDataTree(const TString& rootFileName, const TString& rootTreeName) :
 	rootFileName_(rootFileName),
 	rootTreeName_(rootTreeName),
 	rootFile_(0),
 	rootTree_(0),
-	eventList_(0)
+	eventList_(0),
+	flatBuffer_(0),
+	flatBufferSize_(0),
+	flatNEvents_(0),
+	flatFirstEvt_(0),
+	flatNEvts_(0)
 {
-	if (rootFileName_ != "" && rootTreeName_ != "") {
+	if ( rootFileName_ != "" && LauFitDataTree::checkFlatFile(rootFileName_) ) {
+		this->openFlatFile();
+	} else if (rootFileName_ != "" && rootTreeName_ != "") {
 		this->openFileAndTree();
 	}
 }
@@ -59,6 +120,96 @@ LauFitDataTree::~LauFitDataTree()
 		delete eventList_; eventList_ = 0;
 	}
 	delete rootFile_; rootFile_ = 0;
+
+	if (flatBuffer_) {
+		munmap( const_cast<char*>(flatBuffer_), flatBufferSize_ );
+		flatBuffer_ = 0;
+	}
+}
+
+Bool_t LauFitDataTree::checkFlatFile(const TString& fileName)
+{
+	std::ifstream input( fileName.Data(), std::ios::in | std::ios::binary );
+	if ( ! input ) {
+		return kFALSE;
+	}
+
+	char magic[sizeof(flatFileMagic)];
+	input.read( magic, sizeof(magic) );
+	if ( ! input ) {
+		return kFALSE;
+	}
+
+	return std::memcmp( magic, flatFileMagic, sizeof(flatFileMagic) ) == 0;
+}
+
+void LauFitDataTree::openFlatFile()
+{
+	const Int_t fd = open( rootFileName_.Data(), O_RDONLY );
+	if ( fd < 0 ) {
+		std::cerr << "ERROR in LauFitDataTree::openFlatFile : Problem opening file \"" << rootFileName_ << "\" for reading." << std::endl;
+		return;
+	}
+
+	struct stat fileInfo;
+	if ( fstat( fd, &fileInfo ) != 0 || static_cast<ULong64_t>(fileInfo.st_size) < sizeof(LauFlatFileHeader) ) {
+		std::cerr << "ERROR in LauFitDataTree::openFlatFile : File \"" << rootFileName_ << "\" is too small to be a valid flat file." << std::endl;
+		close( fd );
+		return;
+	}
+
+	const ULong64_t fileSize = static_cast<ULong64_t>(fileInfo.st_size);
+	void* mapped = mmap( 0, fileSize, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( mapped == MAP_FAILED ) {
+		std::cerr << "ERROR in LauFitDataTree::openFlatFile : Problem memory-mapping file \"" << rootFileName_ << "\"." << std::endl;
+		return;
+	}
+
+	const char* buffer = static_cast<const char*>(mapped);
+	const LauFlatFileHeader* header = reinterpret_cast<const LauFlatFileHeader*>(buffer);
+
+	// check that the file was written with this layout and byte order
+	if ( header->version != flatFileVersion || header->byteOrder != flatFileByteOrder ) {
+		std::cerr << "ERROR in LauFitDataTree::openFlatFile : File \"" << rootFileName_ << "\" was written by a different version or on a machine with a different byte order, please write it again." << std::endl;
+		munmap( mapped, fileSize );
+		return;
+	}
+
+	// check that the header is consistent with the size of the file
+	const ULong64_t tableSize = sizeof(LauFlatFileHeader) + header->nColumns * flatFileNameLength + header->nExpts * sizeof(LauFlatFileExpt);
+	const Bool_t sizeOK = ( tableSize <= header->dataOffset )
+		&& ( header->dataOffset % flatFileAlignment == 0 )
+		&& ( header->columnStride >= header->nEvents * sizeof(Double_t) )
+		&& ( header->dataOffset + header->nColumns * header->columnStride <= fileSize );
+	if ( ! sizeOK ) {
+		std::cerr << "ERROR in LauFitDataTree::openFlatFile : File \"" << rootFileName_ << "\" has an inconsistent header, is it truncated?" << std::endl;
+		munmap( mapped, fileSize );
+		return;
+	}
+
+	flatBuffer_ = buffer;
+	flatBufferSize_ = fileSize;
+	flatNEvents_ = static_cast<UInt_t>(header->nEvents);
+	flatFirstEvt_ = 0;
+	flatNEvts_ = flatNEvents_;
+
+	flatColumns_.clear();
+	flatColumns_.reserve( header->nColumns );
+	for ( UInt_t iCol(0); iCol < header->nColumns; ++iCol ) {
+		flatColumns_.push_back( reinterpret_cast<const Double_t*>( flatBuffer_ + header->dataOffset + iCol * header->columnStride ) );
+	}
+
+	flatExpts_.clear();
+	const LauFlatFileExpt* expts = reinterpret_cast<const LauFlatFileExpt*>( flatBuffer_ + sizeof(LauFlatFileHeader) + header->nColumns * flatFileNameLength );
+	for ( UInt_t iRec(0); iRec < header->nExpts; ++iRec ) {
+		flatExpts_[ expts[iRec].iExpt ] = std::make_pair( expts[iRec].firstEvt, expts[iRec].nEvts );
+	}
+
+	// we will read all the columns in sequence, so let the kernel know
+	madvise( mapped, fileSize, MADV_WILLNEED );
+
+	std::cout << "INFO in LauFitDataTree::openFlatFile : Memory-mapped flat file \"" << rootFileName_ << "\"." << std::endl;
 }
 
 void LauFitDataTree::openFileAndTree()
@@ -91,6 +242,10 @@ void LauFitDataTree::openFileAndTree()
 
 Bool_t LauFitDataTree::findBranches()
 {
+	if (flatBuffer_) {
+		return this->findFlatColumns();
+	}
+
 	if (!rootTree_) {
 		std::cerr << "ERROR in LauFitDataTree::findBranches : Invalid pointer to data tree." << std::endl;
 		return kFALSE;
@@ -155,8 +310,81 @@ Bool_t LauFitDataTree::findBranches()
 	return kTRUE;
 }
 
+Bool_t LauFitDataTree::findFlatColumns()
+{
+	// this method should only be called once
+	if ( ! leafNames_.empty() ) {
+		std::cerr << "ERROR in LauFitDataTree::findFlatColumns : Columns already found, not running again." << std::endl;
+		return kFALSE;
+	}
+
+	eventData_.clear();
+	eventDataOut_.clear();
+	fakeEvents_.clear();
+
+	const UInt_t numColumns = flatColumns_.size();
+	eventData_.reserve( numColumns );
+
+	const char* names = flatBuffer_ + sizeof(LauFlatFileHeader);
+	for ( UInt_t iCol(0); iCol < numColumns; ++iCol ) {
+
+		const char* rawName = names + iCol * flatFileNameLength;
+		TString name( rawName, strnlen( rawName, flatFileNameLength ) );
+
+		leafNames_[ name ] = iCol;
+		eventData_.push_back( 0.0 );
+		eventDataOut_[ name ] = 0.0;
+	}
+
+	std::cout << "INFO in LauFitDataTree::findFlatColumns : Finished finding flat file columns." << std::endl;
+	std::cout << "                                        : File contains " << numColumns << " columns and a total of " << this->nTotalEvents() << " events." << std::endl;
+
+	return kTRUE;
+}
+
+UInt_t LauFitDataTree::nTreeEvents() const
+{
+	if ( flatBuffer_ ) {
+		return flatNEvents_;
+	}
+	return rootTree_ ? static_cast<UInt_t>(rootTree_->GetEntries()) : 0;
+}
+
+UInt_t LauFitDataTree::nEvents() const
+{
+	if ( flatBuffer_ ) {
+		return flatNEvts_;
+	}
+	return eventList_ ? static_cast<UInt_t>(eventList_->GetN()) : this->nTreeEvents();
+}
+
 void LauFitDataTree::readExperimentData(UInt_t iExpt)
 {
+	// The flat file stores the events grouped by experiment, so just need to look up where this one is
+	if (flatBuffer_) {
+		if (!this->haveBranch("iExpt")) {
+			if ( iExpt == 0 ) {
+				std::cerr << "WARNING in LauFitDataTree::readExperimentData : Flat file does not contain \"iExpt\" column, will read all data in the file" << std::endl;
+				this->readAllData();
+			} else {
+				std::cerr << "ERROR in LauFitDataTree::readExperimentData : Flat file does not contain \"iExpt\" column and experiment requested is > 0, will not read anything" << std::endl;
+			}
+			return;
+		}
+
+		std::cout << "INFO in LauFitDataTree::readExperimentData : Setting flat file to experiment number " << iExpt << "." << std::endl;
+		std::map<UInt_t, std::pair<UInt_t,UInt_t>>::const_iterator iter = flatExpts_.find( iExpt );
+		if ( iter == flatExpts_.end() ) {
+			flatFirstEvt_ = 0;
+			flatNEvts_ = 0;
+		} else {
+			flatFirstEvt_ = iter->second.first;
+			flatNEvts_ = iter->second.second;
+		}
+		std::cout << "                                           : Found " << this->nEvents() << " events." << std::endl;
+		return;
+	}
+
 	// Check that we have a valid tree to read from
 	if (!rootTree_) {
 		std::cerr << "ERROR in LauFitDataTree::readExperimentData : Invalid pointer to data tree." << std::endl;
@@ -205,7 +433,9 @@ void LauFitDataTree::readExperimentData(UInt_t iExpt)
 
 UInt_t LauFitDataTree::nBranches() const
 {
-	if ( rootTree_ ) {
+	if ( flatBuffer_ ) {
+		return flatColumns_.size();
+	} else if ( rootTree_ ) {
 		return static_cast<UInt_t>(rootTree_->GetNbranches());
 	} else if ( ! fakeEvents_.empty() ) {
 		std::vector<LauEventData>::const_iterator fakeIter = fakeEvents_.begin();
@@ -278,22 +508,22 @@ Bool_t LauFitDataTree::haveBranch(const TString& name) const
 
 void LauFitDataTree::disableAllBranches() const
 {
-         rootTree_->SetBranchStatus("*", 0);
+         if (rootTree_) {rootTree_->SetBranchStatus("*", 0);}
 }
 
 void LauFitDataTree::enableAllBranches() const
 {
-         rootTree_->SetBranchStatus("*", 1);
+         if (rootTree_) {rootTree_->SetBranchStatus("*", 1);}
 }
 
 void LauFitDataTree::enableBranch(const TString& name) const
 {
-         if (this->haveBranch(name)) {rootTree_->SetBranchStatus(name, 1);}
+         if (rootTree_ && this->haveBranch(name)) {rootTree_->SetBranchStatus(name, 1);}
 }
 
 void LauFitDataTree::disableBranch(const TString& name) const
 {
-         if (this->haveBranch(name)) {rootTree_->SetBranchStatus(name, 0);}
+         if (rootTree_ && this->haveBranch(name)) {rootTree_->SetBranchStatus(name, 0);}
 }
 
 void LauFitDataTree::loadData()
@@ -341,6 +571,12 @@ void LauFitDataTree::loadData()
 
 void LauFitDataTree::readAllData()
 {
+	if (flatBuffer_) {
+		flatFirstEvt_ = 0;
+		flatNEvts_ = flatNEvents_;
+		return;
+	}
+
 	delete eventList_; eventList_ = 0;
 	this->loadData();
 }
@@ -354,7 +590,14 @@ const LauFitData& LauFitDataTree::getData(UInt_t iEvt) const
 	const UInt_t numFakeEvents = this->nFakeEvents();
 
 	// Does the requested event come from the tree or from the fake events list?
-	if ( iEvt < numTreeEvents ) {
+	if ( iEvt < numTreeEvents && flatBuffer_ ) {
+		// Read the event directly from the mapped columns
+		const UInt_t iEntry = flatFirstEvt_ + iEvt;
+		const UInt_t numColumns = flatColumns_.size();
+		for ( UInt_t iCol(0); iCol < numColumns; ++iCol ) {
+			eventData_[ iCol ] = flatColumns_[ iCol ][ iEntry ];
+		}
+	} else if ( iEvt < numTreeEvents ) {
 		if ( iEvt > treeEvents_.size() ) { // this shouldn't happen, but just in case...
 			std::cerr << "ERROR in LauFitDataTree::getData : Requested event, " << iEvt << ", not found." << std::endl;
 			gSystem->Exit(EXIT_FAILURE);
@@ -386,3 +629,140 @@ const LauFitData& LauFitDataTree::getData(UInt_t iEvt) const
 	return eventDataOut_;
 }
 
+
+const Double_t* LauFitDataTree::getColumn(const TString& name) const
+{
+	if ( ! flatBuffer_ ) {
+		return 0;
+	}
+
+	LauNameIndexMap::const_iterator iter = leafNames_.find( name );
+	if ( iter == leafNames_.end() ) {
+		std::cerr << "ERROR in LauFitDataTree::getColumn : Column \"" << name << "\" not found." << std::endl;
+		return 0;
+	}
+
+	return flatColumns_[ iter->second ] + flatFirstEvt_;
+}
+
+Bool_t LauFitDataTree::writeFlatFile(const TString& flatFileName) const
+{
+	if ( flatBuffer_ ) {
+		std::cerr << "ERROR in LauFitDataTree::writeFlatFile : Data are already being read from a flat file." << std::endl;
+		return kFALSE;
+	}
+	if ( !rootTree_ || leaves_.empty() ) {
+		std::cerr << "ERROR in LauFitDataTree::writeFlatFile : No data tree branches found, make sure findBranches has been called." << std::endl;
+		return kFALSE;
+	}
+	// Determine the names of all the columns
+	std::vector<TString> colNames;
+	for ( LauLeafList::const_iterator iter = leaves_.begin(); iter != leaves_.end(); ++iter ) {
+		colNames.push_back( (*iter)->GetName() );
+	}
+	const UInt_t nColumns = colNames.size();
+	for ( std::vector<TString>::const_iterator iter = colNames.begin(); iter != colNames.end(); ++iter ) {
+		if ( static_cast<ULong64_t>(iter->Length()) >= flatFileNameLength ) {
+			std::cerr << "ERROR in LauFitDataTree::writeFlatFile : Branch name \"" << *iter << "\" is too long to be stored." << std::endl;
+			return kFALSE;
+		}
+	}
+
+	// Read and validate every event in the tree
+	const UInt_t nEntries = static_cast<UInt_t>(rootTree_->GetEntries());
+	std::vector< std::vector<Double_t> > columns( nColumns, std::vector<Double_t>( nEntries ) );
+
+	for ( UInt_t iEntry(0); iEntry < nEntries; ++iEntry ) {
+
+		rootTree_->GetEntry(iEntry);
+
+		for ( UInt_t iCol(0); iCol < nColumns; ++iCol ) {
+			const Double_t value = leaves_[ iCol ]->GetValue();
+			if ( std::isnan( value ) || std::isinf( value ) ) {
+				std::cerr << "ERROR in LauFitDataTree::writeFlatFile : Event " << iEntry << " has infinite or NaN entry for variable " << colNames[iCol] << std::endl;
+				return kFALSE;
+			}
+			columns[ iCol ][ iEntry ] = value;
+		}
+	}
+
+	// Group the events by experiment, preserving their order within each experiment
+	std::vector<UInt_t> order( nEntries );
+	std::iota( order.begin(), order.end(), 0 );
+	std::vector<LauFlatFileExpt> expts;
+
+	LauNameIndexMap::const_iterator exptIter = leafNames_.find("iExpt");
+	if ( exptIter != leafNames_.end() ) {
+		const std::vector<Double_t>& exptCol = columns[ exptIter->second ];
+		std::stable_sort( order.begin(), order.end(), [&exptCol](const UInt_t a, const UInt_t b) { return exptCol[a] < exptCol[b]; } );
+
+		for ( UInt_t iEvt(0); iEvt < nEntries; ++iEvt ) {
+			const UInt_t iExpt = static_cast<UInt_t>( exptCol[ order[iEvt] ] );
+			if ( expts.empty() || expts.back().iExpt != iExpt ) {
+				LauFlatFileExpt record;
+				record.iExpt = iExpt;
+				record.firstEvt = iEvt;
+				record.nEvts = 0;
+				record.padding = 0;
+				expts.push_back( record );
+			}
+			++expts.back().nEvts;
+		}
+	}
+
+	// Fill in the header
+	LauFlatFileHeader header;
+	std::memset( &header, 0, sizeof(header) );
+	std::memcpy( header.magic, flatFileMagic, sizeof(flatFileMagic) );
+	header.nColumns = nColumns;
+	header.nExpts = expts.size();
+	header.nEvents = nEntries;
+	header.dataOffset = alignToFlatFile( sizeof(LauFlatFileHeader) + nColumns * flatFileNameLength + expts.size() * sizeof(LauFlatFileExpt) );
+	header.columnStride = alignToFlatFile( nEntries * sizeof(Double_t) );
+	header.version = flatFileVersion;
+	header.byteOrder = flatFileByteOrder;
+
+	std::ofstream output( flatFileName.Data(), std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( ! output ) {
+		std::cerr << "ERROR in LauFitDataTree::writeFlatFile : Problem opening file \"" << flatFileName << "\" for writing." << std::endl;
+		return kFALSE;
+	}
+
+	output.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+
+	for ( std::vector<TString>::const_iterator iter = colNames.begin(); iter != colNames.end(); ++iter ) {
+		char name[flatFileNameLength];
+		std::memset( name, 0, flatFileNameLength );
+		std::memcpy( name, iter->Data(), iter->Length() );
+		output.write( name, flatFileNameLength );
+	}
+
+	if ( ! expts.empty() ) {
+		output.write( reinterpret_cast<const char*>(&expts[0]), expts.size() * sizeof(LauFlatFileExpt) );
+	}
+
+	const std::vector<char> padding( flatFileAlignment, 0 );
+	ULong64_t written = sizeof(LauFlatFileHeader) + nColumns * flatFileNameLength + expts.size() * sizeof(LauFlatFileExpt);
+	output.write( &padding[0], header.dataOffset - written );
+
+	std::vector<Double_t> sorted( nEntries );
+	const ULong64_t columnBytes = nEntries * sizeof(Double_t);
+	for ( UInt_t iCol(0); iCol < nColumns; ++iCol ) {
+		for ( UInt_t iEvt(0); iEvt < nEntries; ++iEvt ) {
+			sorted[ iEvt ] = columns[ iCol ][ order[iEvt] ];
+		}
+		if ( nEntries > 0 ) {
+			output.write( reinterpret_cast<const char*>(&sorted[0]), columnBytes );
+		}
+		output.write( &padding[0], header.columnStride - columnBytes );
+	}
+
+	if ( ! output ) {
+		std::cerr << "ERROR in LauFitDataTree::writeFlatFile : Problem writing to file \"" << flatFileName << "\"." << std::endl;
+		return kFALSE;
+	}
+
+	std::cout << "INFO in LauFitDataTree::writeFlatFile : Written " << nEntries << " events with " << nColumns << " columns (" << expts.size() << " experiments) to file \"" << flatFileName << "\"." << std::endl;
+
+	return kTRUE;
+}
@@ -43,7 +43,7 @@ Thomas Latham
 ClassImp(LauFitNtuple)
 
 
-LauFitNtuple::LauFitNtuple(const TString& fileName, Bool_t storeAsymErrors) :
+LauFitNtuple::LauFitNtuple(const TString& fileName, Bool_t storeAsymErrors, Bool_t append) :
 	rootFileName_(fileName),
 	rootFile_(0),
 	fitResults_(0),
@@ -55,10 +55,20 @@ LauFitNtuple::LauFitNtuple(const TString& fileName, Bool_t storeAsymErrors) :
 	nExtraPars_(0),
 	iExpt_(0)
 {
-	rootFile_ = TFile::Open(rootFileName_, "recreate");
+	rootFile_ = TFile::Open(rootFileName_, append ? "update" : "recreate");
 	rootFile_->cd();
-	fitResults_ = new TTree("fitResults", "fitResults");
-	fitResults_->SetDirectory(rootFile_);
+
+	// when appending, pick up the tree (and the experiments already stored in it) from the existing file
+	if ( append ) {
+		fitResults_ = dynamic_cast<TTree*>( rootFile_->Get("fitResults") );
+		if ( fitResults_ != 0 ) {
+			std::cout << "INFO in LauFitNtuple::LauFitNtuple : Appending to existing fit ntuple with " << fitResults_->GetEntries() << " entries." << std::endl;
+		}
+	}
+	if ( fitResults_ == 0 ) {
+		fitResults_ = new TTree("fitResults", "fitResults");
+		fitResults_->SetDirectory(rootFile_);
+	}
 
 	fitVars_.clear(); extraVars_.clear();
 }
@@ -237,41 +247,41 @@ void LauFitNtuple::updateFitNtuple()
 		std::cout << "INFO in LauFitNtuple::updateFitNtuple : totNoPars = " << nFitPars_ << std::endl;
 
 		// Add experiment number as a branch
-		fitResults_->Branch("iExpt", &iExpt_, "iExpt/I");
-		fitResults_->Branch("fitStatus", &fitStatus_.status, "fitStatus/I");
+		this->defineBranch("iExpt", &iExpt_, "iExpt/I");
+		this->defineBranch("fitStatus", &fitStatus_.status, "fitStatus/I");
 
 		// Add NLL (negative log-likelihood) and EDM values from fit
-		fitResults_->Branch("NLL", &fitStatus_.NLL, "NLL/D");
-		fitResults_->Branch("EDM", &fitStatus_.EDM, "EDM/D");
+		this->defineBranch("NLL", &fitStatus_.NLL, "NLL/D");
+		this->defineBranch("EDM", &fitStatus_.EDM, "EDM/D");
 
 		for (UInt_t i = 0; i < nFitPars_; i++) {
 
 			TString parName = fitVars_[i]->name();
 			TString parNameD(parName); parNameD += "/D";
-			fitResults_->Branch(parName.Data(), &fitVars_[i]->value_, parNameD.Data());
+			this->defineBranch(parName, &fitVars_[i]->value_, parNameD);
 
 			TString parInitName(parName); parInitName += "_True";
 			TString parInitNameD(parInitName); parInitNameD += "/D";
-			fitResults_->Branch(parInitName.Data(), &fitVars_[i]->genValue_, parInitNameD.Data());
+			this->defineBranch(parInitName, &fitVars_[i]->genValue_, parInitNameD);
 
 			if (!fitVars_[i]->fixed()) {
 				TString parErrName(parName); parErrName += "_Error";
 				TString parErrNameD(parErrName); parErrNameD += "/D";
-				fitResults_->Branch(parErrName.Data(), &fitVars_[i]->error_, parErrNameD.Data());
+				this->defineBranch(parErrName, &fitVars_[i]->error_, parErrNameD);
 
 				if ( storeAsymErrors_ ) {
 					TString parNegErrName(parName); parNegErrName += "_NegError";
 					TString parNegErrNameD(parNegErrName); parNegErrNameD += "/D";
-					fitResults_->Branch(parNegErrName.Data(), &fitVars_[i]->negError_, parNegErrNameD.Data());
+					this->defineBranch(parNegErrName, &fitVars_[i]->negError_, parNegErrNameD);
 
 					TString parPosErrName(parName); parPosErrName += "_PosError";
 					TString parPosErrNameD(parPosErrName); parPosErrNameD += "/D";
-					fitResults_->Branch(parPosErrName.Data(), &fitVars_[i]->posError_, parPosErrNameD.Data());
+					this->defineBranch(parPosErrName, &fitVars_[i]->posError_, parPosErrNameD);
 				}
 
 				TString parPullName(parName); parPullName += "_Pull";
 				TString parPullNameD(parPullName); parPullNameD += "/D";
-				fitResults_->Branch(parPullName.Data(), &fitVars_[i]->pull_, parPullNameD.Data());
+				this->defineBranch(parPullName, &fitVars_[i]->pull_, parPullNameD);
 			}
 
 			// Now add in the correlation matrix values (only for floating parameters)
@@ -279,7 +289,7 @@ void LauFitNtuple::updateFitNtuple()
 				// First the global correlation coeffs
 				TString parGCCName(parName); parGCCName += "_GCC";
 				TString parGCCNameD(parGCCName); parGCCNameD += "/D";
-				fitResults_->Branch(parGCCName.Data(), &fitVars_[i]->gcc_, parGCCNameD.Data());
+				this->defineBranch(parGCCName, &fitVars_[i]->gcc_, parGCCNameD);
 
 				if ( ! corrMatrix_.empty() ) {
 					// Then the rest
@@ -290,7 +300,7 @@ void LauFitNtuple::updateFitNtuple()
 							corrName += parName; corrName += "__"; corrName += parName2;
 
 							TString corrNameD(corrName); corrNameD += "/D";	
-							fitResults_->Branch(corrName.Data(), &corrMatrix_[i][j], corrNameD.Data());
+							this->defineBranch(corrName, &corrMatrix_[i][j], corrNameD);
 						}
 					}
 				}
@@ -302,11 +312,11 @@ void LauFitNtuple::updateFitNtuple()
 
 			TString parName = extraVars_[i].name();
 			TString parNameD(parName); parNameD += "/D";
-			fitResults_->Branch(parName.Data(), &extraVars_[i].value_, parNameD.Data());
+			this->defineBranch(parName, &extraVars_[i].value_, parNameD);
 
 			TString parInitName(parName); parInitName += "_True";
 			TString parInitNameD(parInitName); parInitNameD += "/D";
-			fitResults_->Branch(parInitName.Data(), &extraVars_[i].genValue_, parInitNameD.Data());
+			this->defineBranch(parInitName, &extraVars_[i].genValue_, parInitNameD);
 
 			//TString parErrName(parName); parErrName += "_Error";
 			//TString parErrNameD(parErrName); parErrNameD += "/D";
@@ -331,6 +341,47 @@ void LauFitNtuple::updateFitNtuple()
 	fitResults_->Fill();
 }  
 
+void LauFitNtuple::defineBranch(const TString& name, void* address, const TString& leafList)
+{
+	// A tree picked up from an existing file already has its branches, they just need connecting
+	if ( fitResults_->GetBranch(name) != 0 ) {
+		fitResults_->SetBranchAddress(name, address);
+	} else {
+		fitResults_->Branch(name, address, leafList);
+	}
+}
+
+void LauFitNtuple::autoSave()
+{
+	// Flush the entries filled so far to the file so that they survive the job being killed
+	if ( rootFile_ == 0 || fitResults_ == 0 ) {
+		return;
+	}
+	rootFile_->cd();
+	fitResults_->AutoSave("SaveSelf");
+}
+
+void LauFitNtuple::keepEntries(const TString& selection)
+{
+	if ( definedFitTree_ ) {
+		std::cerr << "ERROR in LauFitNtuple::keepEntries : Already stored results in the tree, cannot select entries." << std::endl;
+		return;
+	}
+
+	// Replace the tree by a copy containing only the selected entries
+	// (the old copy on the file is superseded once the new one is saved)
+	rootFile_->cd();
+	TTree* selectedTree = fitResults_->CopyTree(selection);
+	const Long64_t nDropped = fitResults_->GetEntries() - selectedTree->GetEntries();
+	delete fitResults_;
+	fitResults_ = selectedTree;
+	fitResults_->SetDirectory(rootFile_);
+
+	if ( nDropped > 0 ) {
+		std::cout << "INFO in LauFitNtuple::keepEntries : Dropped " << nDropped << " entries that fail \"" << selection << "\"." << std::endl;
+	}
+}
+
 void LauFitNtuple::writeOutFitResults()
 {
 	// Write out the fit ntuple to the appropriate root file
@@ -42,6 +42,8 @@ ClassImp(LauFitObject)
 LauFitObject::LauFitObject() : TObject(),
 	twoStageFit_(kFALSE),
 	useAsymmFitErrors_(kFALSE),
+	useBatchedGradient_(kFALSE),
+	minosProcesses_(1),
 	nParams_(0),
 	nFreeParams_(0),
 	withinAsymErrorCalc_(kFALSE),
@@ -71,6 +73,15 @@ void LauFitObject::setNExpts(UInt_t nExperiments, UInt_t firstExperiment, Bool_t
 	}
 }
 
+void LauFitObject::getTotNegLogLikelihoods(const UInt_t nPoints, Double_t* pars, const Int_t npar, Double_t* negLogLikes)
+{
+	const UInt_t nPars = this->nTotParams();
+	for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+		this->setParsFromMinuit( pars + iPoint*nPars, npar );
+		negLogLikes[iPoint] = this->getTotNegLogLikelihood();
+	}
+}
+
 void LauFitObject::resetFitCounters()
 {
 	numberOKFits_ = 0;
@@ -37,6 +37,7 @@ using std::endl;
 
 #include "LauConstants.hh"
 #include "LauGaussPdf.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauGaussPdf)
 
@@ -97,11 +98,29 @@ void LauGaussPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
 	}
 
 }
 
+void LauGaussPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	// Get the up to date parameter values
+	Double_t mean = mean_->unblindValue();
+	Double_t sigma = sigma_->unblindValue();
+
+	// Calculate the exponents for all the abscissa values and then exponentiate them all together
+	const Double_t factor = (TMath::Abs(sigma) > 1e-10) ? -0.5 : 0.0;
+	const Double_t divisor = (TMath::Abs(sigma) > 1e-10) ? sigma*sigma : 1.0;
+
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		const Double_t arg = abscissas[i] - mean;
+		values[i] = factor*arg*arg/divisor;
+	}
+
+	LauVectorMath::exp( nValues, values, values );
+}
+
 void LauGaussPdf::calcNorm() 
 {
 	// Get the up to date parameter values
@@ -26,12 +26,14 @@ Thomas Latham
     \brief File containing implementation of LauGenNtuple class.
 */
 
+#include <algorithm>
 #include <iostream>
 using std::cout;
 using std::cerr;
 using std::endl;
 
 #include "TFile.h"
+#include "TROOT.h"
 #include "TTree.h"
 
 #include "LauGenNtuple.hh"
@@ -39,18 +41,25 @@ using std::endl;
 ClassImp(LauGenNtuple)
 
 
-LauGenNtuple::LauGenNtuple(const TString& rootFileName, const TString& rootTreeName) :
+LauGenNtuple::LauGenNtuple(const TString& rootFileName, const TString& rootTreeName, const Bool_t append) :
 	rootFileName_(rootFileName),
 	rootTreeName_(rootTreeName),
 	rootFile_(0),
 	rootTree_(0),
-	definedBranches_(kFALSE)
+	append_(append),
+	definedBranches_(kFALSE),
+	queueSize_(0),
+	queueHead_(0),
+	nQueued_(0),
+	stopWriter_(kFALSE)
 {
 	this->createFileAndTree();
 }
 
 LauGenNtuple::~LauGenNtuple()
 {
+	this->flush();
+
 	// seems that closing the file deletes the tree
 	// so only delete if the file is still open for some reason
 	if (rootFile_ && rootFile_->IsOpen()) {
@@ -68,11 +77,19 @@ void LauGenNtuple::createFileAndTree()
 			cerr<<"ERROR in LauGenNtuple::createFileAndTree : Bad filename supplied, not creating file or tree."<<endl;
 			return;
 		}
-		rootFile_ = TFile::Open(rootFileName_, "recreate");
+		rootFile_ = TFile::Open(rootFileName_, append_ ? "update" : "recreate");
 		if (!rootFile_ || rootFile_->IsZombie() || !rootFile_->IsWritable()) {
 			cerr<<"ERROR in LauGenNtuple::createFileAndTree : Problem opening file \""<<rootFileName_<<"\" for writing, not creating tree."<<endl;
 			return;
 		}
+		// when appending, pick up the tree (and the entries already stored in it) from the existing file
+		if (append_ && !rootTree_) {
+			rootTree_ = dynamic_cast<TTree*>( rootFile_->Get(rootTreeName_) );
+			if (rootTree_) {
+				cout<<"INFO in LauGenNtuple::createFileAndTree : Appending to existing tree \""<<rootTreeName_<<"\" with "<<rootTree_->GetEntries()<<" entries."<<endl;
+				this->definedBranches(kFALSE);
+			}
+		}
 	}
 	// check whether we've already created the tree
 	if (!rootTree_) {
@@ -112,6 +129,26 @@ void LauGenNtuple::setDoubleBranchValue(const TString& name, Double_t value)
 	doubleVars_[name] = value;
 }
 
+LauGenNtuple::IntegerBranchHandle LauGenNtuple::integerBranchHandle(const TString& name)
+{
+	IntVarMap::iterator iter = intVars_.find( name );
+	if ( iter == intVars_.end() ) {
+		cerr<<"ERROR in LauGenNtuple::integerBranchHandle : no such branch \""<<name<<"\"."<<endl;
+		return 0;
+	}
+	return &(iter->second);
+}
+
+LauGenNtuple::DoubleBranchHandle LauGenNtuple::doubleBranchHandle(const TString& name)
+{
+	DoubleVarMap::iterator iter = doubleVars_.find( name );
+	if ( iter == doubleVars_.end() ) {
+		cerr<<"ERROR in LauGenNtuple::doubleBranchHandle : no such branch \""<<name<<"\"."<<endl;
+		return 0;
+	}
+	return &(iter->second);
+}
+
 Int_t LauGenNtuple::getIntegerBranchValue(const TString& name) const
 {
 	IntVarMap::const_iterator iter = intVars_.find( name );
@@ -140,17 +177,39 @@ void LauGenNtuple::defineBranches()
 		cerr<<"ERROR in LauGenNtuple::defineBranches : Already defined branches, not doing it again."<<endl;
 		return;
 	}
+
+	// The branches are attached to the row buffers rather than to the
+	// variables themselves, so that the variables can be set for the next
+	// event while the tree is being filled in the background
+	intValues_.clear();
+	doubleValues_.clear();
+	intRow_.assign( intVars_.size(), 0 );
+	doubleRow_.assign( doubleVars_.size(), 0.0 );
+
+	UInt_t index(0);
 	for (IntVarMap::iterator iter = intVars_.begin(); iter != intVars_.end(); ++iter) {
 		TString name = iter->first;
-		Int_t * pointer = &(iter->second);
-		TString thirdPart(name);  thirdPart += "/I";
-		rootTree_->Branch(name, pointer, thirdPart);
+		intValues_.push_back( &(iter->second) );
+		Int_t * pointer = &(intRow_[index++]);
+		if (rootTree_->GetBranch(name) != 0) {
+			// a tree picked up from an existing file already has its branches, they just need connecting
+			rootTree_->SetBranchAddress(name, pointer);
+		} else {
+			TString thirdPart(name);  thirdPart += "/I";
+			rootTree_->Branch(name, pointer, thirdPart);
+		}
 	}
+	index = 0;
 	for (DoubleVarMap::iterator iter = doubleVars_.begin(); iter != doubleVars_.end(); ++iter) {
 		TString name = iter->first;
-		Double_t * pointer = &(iter->second);
-		TString thirdPart(name);  thirdPart += "/D";
-		rootTree_->Branch(name, pointer, thirdPart);
+		doubleValues_.push_back( &(iter->second) );
+		Double_t * pointer = &(doubleRow_[index++]);
+		if (rootTree_->GetBranch(name) != 0) {
+			rootTree_->SetBranchAddress(name, pointer);
+		} else {
+			TString thirdPart(name);  thirdPart += "/D";
+			rootTree_->Branch(name, pointer, thirdPart);
+		}
 	}
 	this->definedBranches(kTRUE);
 }
@@ -163,11 +222,156 @@ void LauGenNtuple::fillBranches()
 	} else if (!this->definedBranches()) {
 		this->defineBranches();
 	}
-	rootTree_->Fill();
+
+	const UInt_t nInts = intValues_.size();
+	const UInt_t nDoubles = doubleValues_.size();
+
+	if ( queueSize_ == 0 ) {
+		for ( UInt_t i(0); i < nInts; ++i ) {
+			intRow_[i] = *intValues_[i];
+		}
+		for ( UInt_t i(0); i < nDoubles; ++i ) {
+			doubleRow_[i] = *doubleValues_[i];
+		}
+		rootTree_->Fill();
+		return;
+	}
+
+	if ( ! writer_.joinable() ) {
+		this->startWriter();
+	}
+
+	// Wait for a free slot in the queue and copy the current values into it
+	std::unique_lock<std::mutex> lock( queueMutex_ );
+	rowTaken_.wait( lock, [this]{ return nQueued_ < queueSize_; } );
+
+	const UInt_t slot = ( queueHead_ + nQueued_ ) % queueSize_;
+	Int_t* ints = queuedInts_.data() + slot * nInts;
+	Double_t* doubles = queuedDoubles_.data() + slot * nDoubles;
+	for ( UInt_t i(0); i < nInts; ++i ) {
+		ints[i] = *intValues_[i];
+	}
+	for ( UInt_t i(0); i < nDoubles; ++i ) {
+		doubles[i] = *doubleValues_[i];
+	}
+	++nQueued_;
+
+	lock.unlock();
+	rowQueued_.notify_one();
+}
+
+void LauGenNtuple::asyncFill(UInt_t queueSize)
+{
+	this->flush();
+	queueSize_ = queueSize;
+}
+
+void LauGenNtuple::startWriter()
+{
+	// The writer thread fills the tree while the main thread may be using ROOT
+	ROOT::EnableThreadSafety();
+
+	// The file belongs to the writer thread until it is flushed, so make sure
+	// that nothing created in the meantime by this thread is attached to it
+	if ( gDirectory == rootFile_ ) {
+		gROOT->cd();
+	}
+
+	queuedInts_.assign( queueSize_ * intValues_.size(), 0 );
+	queuedDoubles_.assign( queueSize_ * doubleValues_.size(), 0.0 );
+	queueHead_ = 0;
+	nQueued_ = 0;
+	stopWriter_ = kFALSE;
+
+	writer_ = std::thread( &LauGenNtuple::writerLoop, this );
+}
+
+void LauGenNtuple::writerLoop()
+{
+	const UInt_t nInts = intRow_.size();
+	const UInt_t nDoubles = doubleRow_.size();
+
+	std::unique_lock<std::mutex> lock( queueMutex_ );
+	while ( kTRUE ) {
+		rowQueued_.wait( lock, [this]{ return nQueued_ > 0 || stopWriter_; } );
+		if ( nQueued_ == 0 ) {
+			// only get here once we've been told to stop and the queue is empty
+			break;
+		}
+
+		// Copy the first queued row into the branch buffers and release its slot
+		const Int_t* ints = queuedInts_.data() + queueHead_ * nInts;
+		const Double_t* doubles = queuedDoubles_.data() + queueHead_ * nDoubles;
+		std::copy( ints, ints + nInts, intRow_.begin() );
+		std::copy( doubles, doubles + nDoubles, doubleRow_.begin() );
+		queueHead_ = ( queueHead_ + 1 ) % queueSize_;
+		--nQueued_;
+
+		lock.unlock();
+		rowTaken_.notify_one();
+
+		rootTree_->Fill();
+
+		lock.lock();
+	}
+}
+
+void LauGenNtuple::flush()
+{
+	if ( ! writer_.joinable() ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( queueMutex_ );
+		stopWriter_ = kTRUE;
+	}
+	rowQueued_.notify_one();
+	writer_.join();
+}
+
+void LauGenNtuple::autoSave()
+{
+	if ( !rootFile_ || !rootTree_ ) {
+		return;
+	}
+
+	// Make sure all the rows have made it into the tree before saving it
+	this->flush();
+
+	rootFile_->cd();
+	rootTree_->AutoSave("SaveSelf");
+}
+
+void LauGenNtuple::keepEntries(const TString& selection)
+{
+	if ( !rootFile_ || !rootTree_ ) {
+		cerr<<"ERROR in LauGenNtuple::keepEntries : Tree not created, cannot select entries."<<endl;
+		return;
+	}
+	if ( this->definedBranches() ) {
+		cerr<<"ERROR in LauGenNtuple::keepEntries : Already filled the tree, cannot select entries."<<endl;
+		return;
+	}
+
+	// Replace the tree by a copy containing only the selected entries
+	// (the old copy on the file is superseded once the new one is saved)
+	rootFile_->cd();
+	TTree* selectedTree = rootTree_->CopyTree(selection);
+	const Long64_t nDropped = rootTree_->GetEntries() - selectedTree->GetEntries();
+	delete rootTree_;
+	rootTree_ = selectedTree;
+	rootTree_->SetDirectory(rootFile_);
+
+	if ( nDropped > 0 ) {
+		cout<<"INFO in LauGenNtuple::keepEntries : Dropped "<<nDropped<<" entries from tree \""<<rootTreeName_<<"\" that fail \""<<selection<<"\"."<<endl;
+	}
 }
 
 void LauGenNtuple::deleteAndRecreateTree()
 {
+	this->flush();
+
 	if (rootTree_) {
 		delete rootTree_;
 		rootTree_ = 0;
@@ -181,6 +385,7 @@ Int_t LauGenNtuple::buildIndex(const TString& majorName, const TString& minorNam
 		cerr<<"ERROR in LauGenNtuple::buildIndex : Tree not created, cannot build index."<<endl;
 		return -1;
 	}
+	this->flush();
 	return rootTree_->BuildIndex(majorName, minorName);
 }
 
@@ -194,6 +399,9 @@ void LauGenNtuple::writeOutGenResults()
 		return;
 	}
 
+	// Make sure all the rows have made it into the tree
+	this->flush();
+
 	// Check that the tree exists and if so then make sure we have the
 	// up to date pointer to the file since if it splits via the
 	// TTree::ChangeFile mechanism we're left with a dangling pointer
@@ -212,6 +420,7 @@ void LauGenNtuple::addFriendTree(const TString& rootFileName, const TString& roo
 		cerr<<"ERROR in LauGenNtuple::addFriendTree : Tree not created, cannot add friend."<<endl;
 		return;
 	}
+	this->flush();
 	rootTree_->AddFriend(rootTreeName,rootFileName);
 }
 
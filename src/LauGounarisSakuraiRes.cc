@@ -224,6 +224,9 @@ LauComplex LauGounarisSakuraiRes::resAmp(Double_t mass, Double_t spinTerm)
 	Double_t numerFactor = spinTerm*(1.0 + d_ * resWidth/resMass);
 	if (!this->ignoreBarrierScaling()) {
 		numerFactor *= fFactorR * fFactorB;
+		this->setBarrierScaling( fFactorR * fFactorB );
+	} else {
+		this->setBarrierScaling( 1.0 );
 	}
 	const Double_t denomFactor = (massSqTerm + f)*(massSqTerm + f) + resMassSq_*totWidth*totWidth;
 	resAmplitude.rescale(numerFactor/denomFactor);
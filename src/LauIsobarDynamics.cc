@@ -26,14 +26,21 @@ Thomas Latham
     \brief File containing implementation of LauIsobarDynamics class.
 */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <iterator>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "TFile.h"
+#include "TH2.h"
 #include "TRandom.h"
+#include "TRandom3.h"
+#include "TROOT.h"
 #include "TSystem.h"
 
 #include "LauAbsEffModel.hh"
@@ -53,6 +60,8 @@ Thomas Latham
 #include "LauKMatrixPropagator.hh"
 #include "LauKMatrixPropFactory.hh"
 #include "LauNRAmplitude.hh"
+#include "LauParallel.hh"
+#include "LauParameter.hh"
 #include "LauPrint.hh"
 #include "LauRandom.hh"
 #include "LauResonanceInfo.hh"
@@ -62,6 +71,22 @@ Thomas Latham
 
 ClassImp(LauIsobarDynamics)
 
+namespace {
+	//! Identifier at the start of an integration grid file
+	const char gridFileMagic[8] = {'L','A','U','G','R','I','D','1'};
+
+	//! Word following the identifier, used to reject files written with a different byte order
+	const UInt_t gridFileByteOrder = 0x01020304;
+
+	//! Describe a region of the integration scheme, so that the regions of a grid read from file can be checked
+	std::vector<Double_t> describeGridRegion( const LauDPPartialIntegralInfo* intInfo )
+	{
+		return { intInfo->getMinm13(), intInfo->getMaxm13(), intInfo->getMinm23(), intInfo->getMaxm23(),
+			static_cast<Double_t>( intInfo->getnm13Points() ), static_cast<Double_t>( intInfo->getnm23Points() ),
+			intInfo->getSquareDP() ? 1.0 : 0.0 };
+	}
+}
+
 // for Kpipi: only one scfFraction 2D histogram is needed
 LauIsobarDynamics::LauIsobarDynamics(LauDaughters* daughters, LauAbsEffModel* effModel, LauAbsEffModel* scfFractionModel) :
 	daughters_(daughters),
@@ -199,6 +224,8 @@ LauIsobarDynamics::~LauIsobarDynamics()
 		delete (*it);
 	}
 	dpPartialIntegralInfo_.clear();
+
+	delete likeBinning_; likeBinning_ = 0;
 }
 
 void LauIsobarDynamics::resetNormVectors()
@@ -239,7 +266,12 @@ void LauIsobarDynamics::recalculateNormalisation()
 
 	this->resetNormVectors();
 	this->findIntegralsToBeRecalculated();
+
+	// Any amplitudes on the grid that can be taken from file need not be
+	// evaluated again, but those of the data events must still be updated
+	const std::set<UInt_t> restoredAmps { this->restoreIntegrationGrid() };
 	this->calcDPNormalisation();
+	integralsToBeCalculated_.insert( restoredAmps.begin(), restoredAmps.end() );
 
 	integralsDone_ = kTRUE;
 }
@@ -358,6 +390,10 @@ void LauIsobarDynamics::initialise(const std::vector<LauComplex>& coeffs)
 
 	this->collateResonanceParameters();
 
+	for ( std::vector<LauIsobarDynamics*>::iterator iter = evalWorkers_.begin(); iter != evalWorkers_.end(); ++iter ) {
+		this->initialiseWorker( *iter );
+	}
+
 	if ( resonancePars_.empty() ) {
 		recalcNormalisation_ = kFALSE;
 	} else {
@@ -389,7 +425,13 @@ void LauIsobarDynamics::initialise(const std::vector<LauComplex>& coeffs)
 		// |fNorm_[i]|^2 * |fSqSum[i]|^2 = 1,
 		// i.e. fNorm_[i] normalises each resonance contribution to give the same number of
 		// events in the DP, accounting for the total DP area and the dynamics of the resonance.
+		// Any amplitudes on the grid that can be taken from file need not be evaluated.
+		if ( ! normalizationSchemeDone_ ) {
+			this->calcDPNormalisationScheme();
+		}
+		const std::set<UInt_t> restoredAmps { this->restoreIntegrationGrid() };
 		this->calcDPNormalisation();
+		integralsToBeCalculated_.insert( restoredAmps.begin(), restoredAmps.end() );
 
 		// Write the integrals to a file (mainly for debugging purposes)
 		this->writeIntegralsFile();
@@ -680,6 +722,243 @@ void LauIsobarDynamics::writeIntegralsFile()
 
 }
 
+Bool_t LauIsobarDynamics::writeIntegrationGrid(const TString& fileName) const
+{
+	if ( ! integralsDone_ || dpPartialIntegralInfo_.empty() ) {
+		std::cerr << "ERROR in LauIsobarDynamics::writeIntegrationGrid : The integrals have not been calculated, not writing the grid." << std::endl;
+		return kFALSE;
+	}
+
+	// Write to a temporary file and then move it into place, so that
+	// the job being killed part way through cannot leave a truncated file
+	const TString tmpFileName { fileName + ".tmp" };
+	std::ofstream fout( tmpFileName.Data(), std::ios::binary );
+
+	auto writeUInt = [&fout]( const UInt_t value ) {
+		fout.write( reinterpret_cast<const char*>(&value), sizeof(value) );
+	};
+	auto writeName = [&fout,&writeUInt]( const TString& name ) {
+		writeUInt( name.Length() );
+		fout.write( name.Data(), name.Length() );
+	};
+
+	fout.write( gridFileMagic, sizeof(gridFileMagic) );
+	writeUInt( gridFileByteOrder );
+
+	// The components and the floating parameter values for which the grid was calculated
+	writeUInt( nAmp_ );
+	writeUInt( nIncohAmp_ );
+	for ( UInt_t i(0); i < nAmp_; ++i ) {
+		writeName( resTypAmp_[i] );
+	}
+	for ( UInt_t i(0); i < nIncohAmp_; ++i ) {
+		writeName( incohResTypAmp_[i] );
+	}
+	const UInt_t nResPars = resonancePars_.size();
+	writeUInt( nResPars );
+	for ( UInt_t iPar(0); iPar < nResPars; ++iPar ) {
+		writeName( resonancePars_[iPar]->name() );
+	}
+	fout.write( reinterpret_cast<const char*>( resonanceParValues_.data() ), nResPars * sizeof(Double_t) );
+
+	// The regions of the grid, each followed by the values at its points
+	const UInt_t nValues = 2*nAmp_ + nIncohAmp_;
+	std::vector<Double_t> values;
+	writeUInt( dpPartialIntegralInfo_.size() );
+	for ( std::vector<LauDPPartialIntegralInfo*>::const_iterator regIter = dpPartialIntegralInfo_.begin(); regIter != dpPartialIntegralInfo_.end(); ++regIter ) {
+		const LauDPPartialIntegralInfo* intInfo = *regIter;
+		const UInt_t nm13Points = intInfo->getnm13Points();
+		const UInt_t nm23Points = intInfo->getnm23Points();
+
+		const std::vector<Double_t> region { describeGridRegion( intInfo ) };
+		fout.write( reinterpret_cast<const char*>( region.data() ), region.size() * sizeof(Double_t) );
+
+		values.resize( nm13Points * nm23Points * nValues );
+		std::vector<Double_t>::iterator valIter = values.begin();
+		for ( UInt_t i(0); i < nm13Points; ++i ) {
+			for ( UInt_t j(0); j < nm23Points; ++j ) {
+				for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+					const LauComplex& amp = intInfo->getAmplitude( i, j, iAmp );
+					*valIter++ = amp.re();
+					*valIter++ = amp.im();
+				}
+				for ( UInt_t iAmp(0); iAmp < nIncohAmp_; ++iAmp ) {
+					*valIter++ = intInfo->getIntensity( i, j, iAmp );
+				}
+			}
+		}
+		fout.write( reinterpret_cast<const char*>( values.data() ), values.size() * sizeof(Double_t) );
+	}
+
+	fout.close();
+	if ( ! fout ) {
+		std::cerr << "ERROR in LauIsobarDynamics::writeIntegrationGrid : Problem writing file \"" << tmpFileName << "\"." << std::endl;
+		return kFALSE;
+	}
+
+	gSystem->Rename( tmpFileName, fileName );
+	return kTRUE;
+}
+
+Bool_t LauIsobarDynamics::readIntegrationGrid(const TString& fileName)
+{
+	gridFileAmpNames_.clear();
+	gridFileParNames_.clear();
+	gridFileParValues_.clear();
+	gridFileRegions_.clear();
+	gridFileValues_.clear();
+	gridFileAmps_.clear();
+
+	std::ifstream fin( fileName.Data(), std::ios::binary );
+
+	auto readUInt = [&fin]() {
+		UInt_t value(0);
+		fin.read( reinterpret_cast<char*>(&value), sizeof(value) );
+		return value;
+	};
+	auto readName = [&fin,&readUInt]() {
+		std::string name( readUInt(), ' ' );
+		fin.read( &name[0], name.size() );
+		return TString( name.c_str() );
+	};
+
+	char magic[sizeof(gridFileMagic)];
+	fin.read( magic, sizeof(magic) );
+	if ( ! fin || std::memcmp( magic, gridFileMagic, sizeof(gridFileMagic) ) != 0 || readUInt() != gridFileByteOrder ) {
+		std::cerr << "ERROR in LauIsobarDynamics::readIntegrationGrid : File \"" << fileName << "\" is not an integration grid file written on this machine." << std::endl;
+		return kFALSE;
+	}
+
+	const UInt_t nAmp = readUInt();
+	const UInt_t nIncohAmp = readUInt();
+	for ( UInt_t i(0); fin && i < nAmp+nIncohAmp; ++i ) {
+		gridFileAmpNames_.push_back( readName() );
+	}
+	const UInt_t nResPars = readUInt();
+	for ( UInt_t iPar(0); fin && iPar < nResPars; ++iPar ) {
+		gridFileParNames_.push_back( readName() );
+	}
+	gridFileParValues_.resize( fin ? nResPars : 0 );
+	fin.read( reinterpret_cast<char*>( gridFileParValues_.data() ), gridFileParValues_.size() * sizeof(Double_t) );
+
+	const UInt_t nValues = 2*nAmp + nIncohAmp;
+	const UInt_t nRegions = readUInt();
+	for ( UInt_t iReg(0); fin && iReg < nRegions; ++iReg ) {
+		std::vector<Double_t> region( 7 );
+		fin.read( reinterpret_cast<char*>( region.data() ), region.size() * sizeof(Double_t) );
+		if ( ! fin ) {
+			break;
+		}
+		std::vector<Double_t> values( static_cast<UInt_t>( region[4] ) * static_cast<UInt_t>( region[5] ) * nValues );
+		fin.read( reinterpret_cast<char*>( values.data() ), values.size() * sizeof(Double_t) );
+		gridFileRegions_.push_back( region );
+		gridFileValues_.push_back( values );
+	}
+
+	if ( ! fin ) {
+		std::cerr << "ERROR in LauIsobarDynamics::readIntegrationGrid : Problem reading file \"" << fileName << "\", is it truncated?" << std::endl;
+		gridFileAmpNames_.clear();
+		gridFileParNames_.clear();
+		gridFileParValues_.clear();
+		gridFileRegions_.clear();
+		gridFileValues_.clear();
+		return kFALSE;
+	}
+
+	for ( UInt_t i(0); i < nAmp+nIncohAmp; ++i ) {
+		gridFileAmps_.insert(i);
+	}
+
+	std::cout << "INFO in LauIsobarDynamics::readIntegrationGrid : Read integration grid with " << nRegions << " regions from file \"" << fileName << "\"." << std::endl;
+	return kTRUE;
+}
+
+std::set<UInt_t> LauIsobarDynamics::restoreIntegrationGrid()
+{
+	std::set<UInt_t> restored;
+	if ( gridFileAmps_.empty() ) {
+		return restored;
+	}
+
+	// Check that the grid read from file belongs to this model and integration scheme
+	const UInt_t nResPars = resonancePars_.size();
+	const UInt_t nRegions = dpPartialIntegralInfo_.size();
+	Bool_t matches = ( gridFileAmpNames_.size() == nAmp_+nIncohAmp_ && gridFileParNames_.size() == nResPars && gridFileRegions_.size() == nRegions );
+	for ( UInt_t i(0); matches && i < nAmp_; ++i ) {
+		matches = ( gridFileAmpNames_[i] == resTypAmp_[i] );
+	}
+	for ( UInt_t i(0); matches && i < nIncohAmp_; ++i ) {
+		matches = ( gridFileAmpNames_[nAmp_+i] == incohResTypAmp_[i] );
+	}
+	for ( UInt_t iPar(0); matches && iPar < nResPars; ++iPar ) {
+		matches = ( gridFileParNames_[iPar] == resonancePars_[iPar]->name() );
+	}
+	for ( UInt_t iReg(0); matches && iReg < nRegions; ++iReg ) {
+		matches = ( gridFileRegions_[iReg] == describeGridRegion( dpPartialIntegralInfo_[iReg] ) );
+	}
+	if ( ! matches ) {
+		std::cerr << "WARNING in LauIsobarDynamics::restoreIntegrationGrid : The integration grid read from file does not match the model or the integration scheme, ignoring it." << std::endl;
+		gridFileAmps_.clear();
+	}
+
+	// Only the components whose floating parameters have the values they had
+	// when the grid was written can be taken from it.  The values need only
+	// agree to within rounding, since MINUIT's transformation of bounded
+	// parameters changes the last few bits of the values it starts from.
+	std::set_intersection( integralsToBeCalculated_.begin(), integralsToBeCalculated_.end(), gridFileAmps_.begin(), gridFileAmps_.end(), std::inserter( restored, restored.begin() ) );
+	for ( UInt_t iPar(0); matches && iPar < nResPars; ++iPar ) {
+		const Double_t value = resonanceParValues_[iPar];
+		const Double_t fileValue = gridFileParValues_[iPar];
+		if ( TMath::Abs( value - fileValue ) > 1e-10 * TMath::Max( TMath::Abs(value), TMath::Abs(fileValue) ) ) {
+			const std::vector<UInt_t>& indices = resonanceParResIndex_[iPar];
+			for ( std::vector<UInt_t>::const_iterator indexIter = indices.begin(); indexIter != indices.end(); ++indexIter ) {
+				restored.erase(*indexIter);
+			}
+		}
+	}
+
+	const UInt_t nValues = 2*nAmp_ + nIncohAmp_;
+	for ( UInt_t iReg(0); iReg < nRegions && ! restored.empty(); ++iReg ) {
+		LauDPPartialIntegralInfo* intInfo = dpPartialIntegralInfo_[iReg];
+		const UInt_t nm13Points = intInfo->getnm13Points();
+		const UInt_t nm23Points = intInfo->getnm23Points();
+		const std::vector<Double_t>& values = gridFileValues_[iReg];
+
+		for ( UInt_t i(0); i < nm13Points; ++i ) {
+			for ( UInt_t j(0); j < nm23Points; ++j ) {
+				const Double_t* point = values.data() + ( i * nm23Points + j ) * nValues;
+				for ( std::set<UInt_t>::const_iterator iter = restored.begin(); iter != restored.end(); ++iter ) {
+					const UInt_t iAmp = *iter;
+					if ( iAmp < nAmp_ ) {
+						intInfo->storeAmplitude( i, j, iAmp, LauComplex( point[2*iAmp], point[2*iAmp+1] ) );
+					} else {
+						intInfo->storeIntensity( i, j, iAmp-nAmp_, point[nAmp_+iAmp] );
+					}
+				}
+			}
+		}
+	}
+
+	for ( std::set<UInt_t>::const_iterator iter = restored.begin(); iter != restored.end(); ++iter ) {
+		integralsToBeCalculated_.erase(*iter);
+		gridFileAmps_.erase(*iter);
+	}
+	if ( ! restored.empty() ) {
+		std::cout << "INFO in LauIsobarDynamics::restoreIntegrationGrid : Took the integration grid amplitudes of " << restored.size() << " components from file." << std::endl;
+	}
+
+	// Free the memory once everything in the file has been used
+	if ( gridFileAmps_.empty() ) {
+		gridFileAmpNames_.clear();
+		gridFileParNames_.clear();
+		gridFileParValues_.clear();
+		gridFileRegions_.clear();
+		gridFileValues_.clear();
+	}
+
+	return restored;
+}
+
 LauAbsResonance* LauIsobarDynamics::addResonance(const TString& resName, const Int_t resPairAmpInt, const LauAbsResonance::LauResonanceModel resType, const LauBlattWeisskopfFactor::BlattWeisskopfCategory bwCategory)
 {
 	// Function to add a resonance in a Dalitz plot.
@@ -1027,6 +1306,17 @@ void LauIsobarDynamics::calcDPNormalisation()
 		fNorm_[i] = 0.0;
 		if (fSqSum_[i] > 0.0) {fNorm_[i] = TMath::Sqrt(1.0/(fSqSum_[i]));}
 	}
+
+	// The amplitudes on the grid have changed, so the generation envelope
+	// will need to be rebuilt and any queued events are out of date
+	genEnvInitialised_ = kFALSE;
+	genQueue_.clear();
+	++modelVersion_;
+
+	// as do the integrals over the likelihood bins
+	if ( likeBinning_ ) {
+		this->calcBinIntegrals();
+	}
 }
 
 std::vector< std::pair<Double_t, Double_t> > LauIsobarDynamics::formGapsFromRegions( const std::vector< std::pair<Double_t, Double_t> >& regions, const Double_t min, const Double_t max ) const
@@ -2281,6 +2571,40 @@ Double_t LauIsobarDynamics::calcSigDPNorm()
 	return DPNorm_;
 }
 
+void LauIsobarDynamics::useGenEnvelope(const Bool_t useEnvelope, const Double_t margin, const UInt_t cellPoints)
+{
+	if ( margin < 0.0 || cellPoints == 0 ) {
+		std::cerr<<"ERROR in LauIsobarDynamics::useGenEnvelope : Margin must not be negative and cells must contain at least one grid point."<<std::endl;
+		return;
+	}
+
+	useGenEnvelope_ = useEnvelope;
+	genEnvMargin_ = margin;
+	genEnvCellPoints_ = cellPoints;
+
+	// make sure the envelope is rebuilt before it is next used
+	genEnvInitialised_ = kFALSE;
+	genEnvCells_.clear();
+	genEnvCumVolumes_.clear();
+	genQueue_.clear();
+}
+
+void LauIsobarDynamics::useGenProposal(const Bool_t useProposal, const Double_t flatFraction)
+{
+	if ( flatFraction <= 0.0 || flatFraction > 1.0 ) {
+		std::cerr<<"ERROR in LauIsobarDynamics::useGenProposal : Fraction of flat phase space must be in the range (0,1], not "<<flatFraction<<"."<<std::endl;
+		return;
+	}
+
+	useGenProposal_ = useProposal;
+	genPropFlatFrac_ = flatFraction;
+
+	// make sure the proposal is rebuilt before it is next used
+	genPropInitialised_ = kFALSE;
+	genPropComps_.clear();
+	genQueue_.clear();
+}
+
 Bool_t LauIsobarDynamics::generate()
 {
 	// Routine to generate a signal event according to the Dalitz plot
@@ -2292,7 +2616,13 @@ Bool_t LauIsobarDynamics::generate()
 		integralsToBeCalculated_.insert(i);
 	}
 
-	if ( aSqMaxAuto_ ) {
+	if ( useGenEnvelope_ && ! genEnvInitialised_ ) {
+		this->initGenEnvelope();
+	}
+	const Bool_t useEnvelope = this->usingGenEnvelope();
+
+	// The global maximum is not needed when using the envelope
+	if ( aSqMaxAuto_ && ! useEnvelope ) {
 		std::cout<<"INFO in LauIsobarDynamics::generate : Starting auto-location of |A|^2 maximum"<<std::endl;
 
 		LauASqMaxFinder finder{*this};
@@ -2304,14 +2634,47 @@ Bool_t LauIsobarDynamics::generate()
 		std::cout<<"                                    : applying safety factor of 10\% gives:  "<<aSqMaxSet_<<std::endl;
 	}
 
+	if ( ! useEnvelope && useGenProposal_ && ! genPropInitialised_ ) {
+		this->initGenProposal();
+	}
+	const Bool_t useProposal = ! useEnvelope && this->usingGenProposal();
+
 	nSigGenLoop_ = 0;
 	Bool_t generatedSig(kFALSE);
 
+	// When generating in blocks, take the next event from the queue, refilling it as necessary
+	if ( genBlockSize_ > 0 && ! useProposal ) {
+		while ( genQueue_.empty() && nSigGenLoop_ < iterationsMax_ && ! genEnvExceeded_ ) {
+			this->fillGenQueue(useEnvelope);
+		}
+		if ( ! genQueue_.empty() ) {
+			// Recalculate everything at the accepted point so that it is available to the caller
+			this->calcLikelihoodInfo( genQueue_.front().first, genQueue_.front().second );
+			genQueue_.pop_front();
+			generatedSig = kTRUE;
+			nSigGenLoop_ = 0;
+		}
+	}
+
 	while (generatedSig == kFALSE && nSigGenLoop_ < iterationsMax_) {
 
 		// Generates uniform DP phase-space distribution
+		// (or uniformly within an envelope cell, or from the resonance-shaped proposal density)
 		Double_t m13Sq(0.0), m23Sq(0.0);
-		kinematics_->genFlatPhaseSpace(m13Sq, m23Sq);
+		Double_t jacobian(1.0);
+		UInt_t iCell(0);
+		if ( useEnvelope ) {
+			Double_t x(0.0), y(0.0);
+			if ( ! this->genFromEnvelope(*LauRandom::randomFun(), iCell, x, y, jacobian) ) {
+				++nSigGenLoop_;
+				continue;
+			}
+			this->calcEnvelopeMassSq(kinematics_, iCell, x, y, m13Sq, m23Sq);
+		} else if ( useProposal ) {
+			this->genFromProposal(m13Sq, m23Sq);
+		} else {
+			kinematics_->genFlatPhaseSpace(m13Sq, m23Sq);
+		}
 
 		// If we're in a symmetrical DP then we should only generate events in one half
 		// TODO - what do we do for fully symmetric?
@@ -2321,169 +2684,847 @@ Bool_t LauIsobarDynamics::generate()
 			m23Sq = tmpSq;
 		}
 
-		// Calculate the amplitudes and total amplitude for the given DP point
-		this->calcLikelihoodInfo(m13Sq, m23Sq);
-
-
 		// Throw the random number and check it against the ratio of ASq and the accept/reject ceiling
 		const Double_t randNo = LauRandom::randomFun()->Rndm();
-		if (randNo > ASq_/aSqMaxSet_) {
-			++nSigGenLoop_;
-		} else {
+		if ( this->testGenCandidate(m13Sq, m23Sq, jacobian, iCell, randNo, useEnvelope, useProposal) ) {
 			generatedSig = kTRUE;
 			nSigGenLoop_ = 0;
-
-			// Keep a note of the maximum ASq that we've found
-			if (ASq_ > aSqMaxVar_) {aSqMaxVar_ = ASq_;}
+		} else {
+			++nSigGenLoop_;
 		}
 
 	} // while loop
 
 	// Check that all is well with the generation
+	// (if not, any queued events are also biased)
 	Bool_t sigGenOK(kTRUE);
 	if (GenOK != this->checkToyMC(kTRUE,kFALSE)) {
 		sigGenOK = kFALSE;
+		genQueue_.clear();
 	}
 
 	return sigGenOK;
 }
 
-LauIsobarDynamics::ToyMCStatus LauIsobarDynamics::checkToyMC(Bool_t printErrorMessages, Bool_t printInfoMessages)
+Bool_t LauIsobarDynamics::testGenCandidate(const Double_t m13Sq, const Double_t m23Sq, const Double_t jacobian, const UInt_t iCell, const Double_t randNo, const Bool_t useEnvelope, const Bool_t useProposal)
 {
-	// Check whether we have generated the toy MC OK.
-	ToyMCStatus ok(GenOK);
+	// Calculate the amplitudes and total amplitude for the given DP point
+	this->calcLikelihoodInfo(m13Sq, m23Sq);
 
-	if (nSigGenLoop_ >= iterationsMax_) {
-		// Exceeded maximum allowed iterations - the generation is too inefficient
-		if (printErrorMessages) {
-			std::cerr<<"WARNING in LauIsobarDynamics::checkToyMC : More than "<<iterationsMax_<<" iterations performed and no event accepted."<<std::endl;
-		}
+	return this->acceptGenCandidate(ASq_, m13Sq, m23Sq, jacobian, iCell, randNo, useEnvelope, useProposal);
+}
 
-		if ( aSqMaxSet_ > 1.01 * aSqMaxVar_ ) {
-			if (printErrorMessages) {
-				std::cerr<<"                                         : |A|^2 maximum was set to "<<aSqMaxSet_<<" but this appears to be too high."<<std::endl;
-				std::cerr<<"                                         : Maximum value of |A|^2 found so far = "<<aSqMaxVar_<<std::endl;
-				std::cerr<<"                                         : The value of |A|^2 maximum will be decreased and the generation restarted."<<std::endl;
-			}
-			aSqMaxSet_ = 1.01 * aSqMaxVar_;
-			std::cout<<"INFO in LauIsobarDynamics::checkToyMC : |A|^2 max reset to "<<aSqMaxSet_<<std::endl;
-			ok = MaxIterError;
-		} else {
-			if (printErrorMessages) {
-				std::cerr<<"                                         : |A|^2 maximum was set to "<<aSqMaxSet_<<", which seems to be correct for the given model."<<std::endl;
-				std::cerr<<"                                         : However, the generation is very inefficient - please check your model."<<std::endl;
-				std::cerr<<"                                         : The maximum number of iterations will be increased and the generation restarted."<<std::endl;
-			}
-			iterationsMax_ *= 2;
-			std::cout<<"INFO in LauIsobarDynamics::checkToyMC : max number of iterations reset to "<<iterationsMax_<<std::endl;
-			ok = MaxIterError;
-		}
-	} else if (aSqMaxVar_ > aSqMaxSet_) {
-		// Found a value of ASq higher than the accept/reject ceiling - the generation is biased
-		if (printErrorMessages) {
-			std::cerr<<"WARNING in LauIsobarDynamics::checkToyMC : |A|^2 maximum was set to "<<aSqMaxSet_<<" but a value exceeding this was found: "<<aSqMaxVar_<<std::endl;
-			std::cerr<<"                                         : This value was found at m13Sq = "<<kinematics_->getm13Sq()<<" and m23Sq = "<<kinematics_->getm23Sq()<<std::endl;
-			std::cerr<<"                                         : Run was invalid, as any generated MC will be biased, according to the accept/reject method!"<<std::endl;
-			std::cerr<<"                                         : The value of |A|^2 maximum be reset to be > "<<aSqMaxVar_<<" and the generation restarted."<<std::endl;
-		}
-		aSqMaxSet_ = 1.01 * aSqMaxVar_;
-		std::cout<<"INFO in LauIsobarDynamics::checkToyMC : |A|^2 max reset to "<<aSqMaxSet_<<std::endl;
-		ok = ASqMaxError;
-	} else if (printInfoMessages) {
-		std::cout<<"INFO in LauIsobarDynamics::checkToyMC : aSqMaxSet = "<<aSqMaxSet_<<" and aSqMaxVar = "<<aSqMaxVar_<<std::endl;
+Bool_t LauIsobarDynamics::acceptGenCandidate(const Double_t aSq, const Double_t m13Sq, const Double_t m23Sq, const Double_t jacobian, const UInt_t iCell, const Double_t randNo, const Bool_t useEnvelope, const Bool_t useProposal)
+{
+	// When using the envelope, the quantity to accept/reject is ASq in
+	// the co-ordinates of the cell, with the envelope height as the ceiling.
+	// When using the proposal density, the quantity to accept/reject is
+	// the ratio of ASq to the proposal, with its own ceiling
+	Double_t value(aSq);
+	Double_t ceiling(aSqMaxSet_);
+	if ( useEnvelope ) {
+		value *= jacobian;
+		ceiling = genEnvCells_[iCell].height_;
+	} else if ( useProposal ) {
+		value /= this->calcProposalRatio(m13Sq, m23Sq);
+		ceiling = genPropRatioMaxSet_;
 	}
 
-	return ok;
-}
+	if (randNo > value/ceiling) {
+		return kFALSE;
+	}
 
-void LauIsobarDynamics::setDataEventNo(UInt_t iEvt)
-{
-	// Retrieve the data for event iEvt
-	if (data_.size() > iEvt) {
-		currentEvent_ = data_[iEvt];
-	} else {
-		std::cerr<<"ERROR in LauIsobarDynamics::setDataEventNo : Event index too large: "<<iEvt<<" >= "<<data_.size()<<"."<<std::endl;
+	// Keep a note of the maximum ASq that we've found
+	if (aSq > aSqMaxVar_) {aSqMaxVar_ = aSq;}
+	if (useProposal && value > genPropRatioMaxVar_) {genPropRatioMaxVar_ = value;}
+
+	// If the envelope has been exceeded, raise it in this cell, the
+	// generation will then be restarted since it is biased
+	if (useEnvelope && value > ceiling) {
+		std::cerr<<"WARNING in LauIsobarDynamics::acceptGenCandidate : |A|^2 of "<<value<<" exceeds the envelope of "<<ceiling<<" at m13Sq = "<<m13Sq<<" and m23Sq = "<<m23Sq<<std::endl;
+		genEnvCells_[iCell].height_ = value * (1.0 + genEnvMargin_);
+		this->calcEnvelopeVolumes();
+		genEnvExceeded_ = kTRUE;
 	}
 
-	m13Sq_ = currentEvent_->retrievem13Sq();
-	m23Sq_ = currentEvent_->retrievem23Sq();
-	mPrime_ = currentEvent_->retrievemPrime();
-	thPrime_ = currentEvent_->retrievethPrime();
-	tagCat_ = currentEvent_->retrieveTagCat();
-	eff_ = currentEvent_->retrieveEff();
-	scfFraction_ = currentEvent_->retrieveScfFraction();	// These two are necessary, even though the dynamics don't actually use scfFraction_ or jacobian_,
-	jacobian_ = currentEvent_->retrieveJacobian();		// since this is at the heart of the caching mechanism.
+	return kTRUE;
 }
 
-void LauIsobarDynamics::calcLikelihoodInfo(const UInt_t iEvt)
+void LauIsobarDynamics::useBlockGeneration(const UInt_t blockSize, const UInt_t nThreads)
 {
-	// Calculate the likelihood and associated info
-	// for the given event using cached information
-	evtLike_ = 0.0;
-
-	// retrieve the cached dynamics from the tree:
-	// realAmp, imagAmp for each resonance plus efficiency, scf fraction and jacobian
-	this->setDataEventNo(iEvt);
+	genBlockSize_ = blockSize;
+	genBlockThreads_ = ( nThreads > 0 ) ? nThreads : 1;
+	genQueue_.clear();
 
-	// use realAmp and imagAmp to create the resonance amplitudes
-	const std::vector<Double_t>& realAmp = currentEvent_->retrieveRealAmp();
-	const std::vector<Double_t>& imagAmp = currentEvent_->retrieveImagAmp();
-	const std::vector<Double_t>& incohInten = currentEvent_->retrieveIncohIntensities();
-	for (UInt_t i = 0; i < nAmp_; i++) {
-		this->setFFTerm(i, realAmp[i], imagAmp[i]);
+	if ( genBlockThreads_ > 1 ) {
+		ROOT::EnableThreadSafety();
 	}
-	for (UInt_t i = 0; i < nIncohAmp_; i++) {
-		this->setIncohIntenTerm(i, incohInten[i]);
+}
+
+void LauIsobarDynamics::fillGenQueue(const Bool_t useEnvelope)
+{
+	// Each chunk of candidates has its own random number stream, seeded in
+	// turn from the global generator, so that the result does not depend on
+	// how the chunks are shared out between the threads
+	const UInt_t chunkSize(1024);
+	const UInt_t nChunks = ( genBlockSize_ + chunkSize - 1 ) / chunkSize;
+
+	genCandidates_.resize( genBlockSize_ );
+
+	std::vector<UInt_t> seeds( nChunks );
+	for ( UInt_t iChunk(0); iChunk < nChunks; ++iChunk ) {
+		// avoid a seed of zero, which TRandom3 takes to mean a random seed
+		seeds[iChunk] = LauRandom::randomFun()->Integer( kMaxUInt - 1 ) + 1;
 	}
 
-	// Update the dynamics - calculates totAmp_ and then ASq_ = totAmp_.abs2() * eff_
-	// All calculated using cached information on the individual amplitudes and efficiency.
-	this->calcTotalAmp(kTRUE);
+	auto proposeChunks = [this, useEnvelope, &seeds](const UInt_t /*iRange*/, const UInt_t firstChunk, const UInt_t lastChunk)
+	{
+		for ( UInt_t iChunk(firstChunk); iChunk < lastChunk; ++iChunk ) {
+			TRandom3 rng( seeds[iChunk] );
+			std::vector<GenCandidate>::iterator first = genCandidates_.begin() + iChunk * chunkSize;
+			std::vector<GenCandidate>::iterator last = ( (iChunk+1) * chunkSize < genCandidates_.size() ) ? first + chunkSize : genCandidates_.end();
+			this->proposeGenCandidates( useEnvelope, rng, first, last );
+		}
+	};
+	LauParallel::forEachRange( nChunks, genBlockThreads_, 1, proposeChunks );
 
-	// Calculate the normalised matrix element squared value
-	if (DPNorm_ > 1e-10) {
-		evtLike_ = ASq_/DPNorm_;
+	// |A|^2 is calculated for the candidates by this model and its evaluation workers
+	this->syncEvaluationWorkers();
+
+	auto evalCandidates = [this, useEnvelope](const UInt_t iShare, const UInt_t first, const UInt_t last)
+	{
+		this->evalGenCandidates( *(this->getEvaluationModel( iShare )), useEnvelope, genCandidates_.begin() + first, genCandidates_.begin() + last );
+	};
+	LauParallel::forEachRange( genCandidates_.size(), this->getnEvaluationThreads(), 256, evalCandidates );
+
+	// The accept/reject decisions can update the envelope, so the candidates are tested in turn
+	for ( std::vector<GenCandidate>::const_iterator iter = genCandidates_.begin(); iter != genCandidates_.end(); ++iter ) {
+
+		if ( ! iter->valid_ ) {
+			++nSigGenLoop_;
+			continue;
+		}
+
+		if ( this->acceptGenCandidate(iter->aSq_, iter->m13Sq_, iter->m23Sq_, iter->jacobian_, iter->iCell_, iter->randNo_, useEnvelope, kFALSE) ) {
+			genQueue_.push_back( std::make_pair( iter->m13Sq_, iter->m23Sq_ ) );
+			nSigGenLoop_ = 0;
+		} else {
+			++nSigGenLoop_;
+		}
+
+		// Stop if the rest of the block would be biased or nothing is being accepted
+		if ( genEnvExceeded_ || nSigGenLoop_ >= iterationsMax_ ) {
+			break;
+		}
 	}
 }
 
-void LauIsobarDynamics::calcLikelihoodInfo(const Double_t m13Sq, const Double_t m23Sq)
+void LauIsobarDynamics::evalGenCandidates(LauIsobarDynamics& model, const Bool_t useEnvelope, std::vector<GenCandidate>::iterator first, std::vector<GenCandidate>::iterator last) const
 {
-	this->calcLikelihoodInfo(m13Sq, m23Sq, -1);
-}
+	LauKinematics* kinematics = model.kinematics_;
 
-void LauIsobarDynamics::calcLikelihoodInfo(const Double_t m13Sq, const Double_t m23Sq, const Int_t tagCat)
-{
-	// Calculate the likelihood and associated info
-	// for the given point in the Dalitz plot
-	// Also retrieves the SCF fraction in the bin where the event lies (done
-	// here to cache it along with the the rest of the DP quantities, like eff)
-	// The jacobian for the square DP is calculated here for the same reason.
-	evtLike_ = 0.0;
+	for ( std::vector<GenCandidate>::iterator iter = first; iter != last; ++iter ) {
 
-	// update the kinematics for the specified DP point
-	kinematics_->updateKinematics(m13Sq, m23Sq);
+		if ( ! iter->valid_ ) {
+			continue;
+		}
 
-	// calculate the jacobian and the scfFraction to cache them later
-	scfFraction_ = this->retrieveScfFraction(tagCat);
-	if (kinematics_->squareDP() == kTRUE) {
-		jacobian_ = kinematics_->calcSqDPJacobian();
-	}
+		Double_t m13Sq(iter->x_), m23Sq(iter->y_);
+		if ( useEnvelope ) {
+			this->calcEnvelopeMassSq(kinematics, iter->iCell_, iter->x_, iter->y_, m13Sq, m23Sq);
+		}
 
-	// calculate the ff_ terms and retrieves eff_ from the efficiency model
-	this->calculateAmplitudes();
-	// then calculate totAmp_ and finally ASq_ = totAmp_.abs2() * eff_
-	this->calcTotalAmp(kTRUE);
+		// If we're in a symmetrical DP then we should only generate events in one half
+		if ( symmetricalDP_ && !fullySymmetricDP_ && m13Sq > m23Sq ) {
+			Double_t tmpSq = m13Sq;
+			m13Sq = m23Sq;
+			m23Sq = tmpSq;
+		}
 
-	// Calculate the normalised matrix element squared value
-	if (DPNorm_ > 1e-10) {
-		evtLike_ = ASq_/DPNorm_;
+		// Calculate the amplitudes and total amplitude, as in LauIsobarDynamics::calcLikelihoodInfo
+		kinematics->updateKinematics(m13Sq, m23Sq);
+		model.calculateAmplitudes();
+		model.calcTotalAmp(kTRUE);
+
+		iter->m13Sq_ = m13Sq;
+		iter->m23Sq_ = m23Sq;
+		iter->aSq_ = model.ASq_;
 	}
 }
 
-void LauIsobarDynamics::modifyDataTree()
+void LauIsobarDynamics::proposeGenCandidates(const Bool_t useEnvelope, TRandom& rng, std::vector<GenCandidate>::iterator first, std::vector<GenCandidate>::iterator last) const
 {
-	if ( recalcNormalisation_ == kFALSE ) {
-		return;
+	const Double_t m13SqMin = kinematics_->getm13SqMin();
+	const Double_t m13SqRange = kinematics_->getm13SqMax() - m13SqMin;
+	const Double_t m23SqMin = kinematics_->getm23SqMin();
+	const Double_t m23SqRange = kinematics_->getm23SqMax() - m23SqMin;
+
+	for ( std::vector<GenCandidate>::iterator iter = first; iter != last; ++iter ) {
+		iter->iCell_ = 0;
+		iter->jacobian_ = 1.0;
+		if ( useEnvelope ) {
+			iter->valid_ = this->genFromEnvelope( rng, iter->iCell_, iter->x_, iter->y_, iter->jacobian_ );
+		} else {
+			// as LauKinematics::genFlatPhaseSpace
+			do {
+				iter->x_ = m13SqMin + rng.Rndm()*m13SqRange;
+				iter->y_ = m23SqMin + rng.Rndm()*m23SqRange;
+			} while ( ! kinematics_->withinDPLimits( iter->x_, iter->y_ ) );
+			iter->valid_ = kTRUE;
+		}
+		iter->randNo_ = rng.Rndm();
+	}
+}
+
+void LauIsobarDynamics::initGenEnvelope()
+{
+	genEnvInitialised_ = kTRUE;
+	genEnvCells_.clear();
+	genEnvCumVolumes_.clear();
+	genEnvExceeded_ = kFALSE;
+
+	if ( dpPartialIntegralInfo_.empty() ) {
+		std::cerr<<"WARNING in LauIsobarDynamics::initGenEnvelope : The integration grid has not been calculated, cannot build the envelope."<<std::endl;
+		return;
+	}
+
+	// The integral of ASq over the DP, to estimate the acceptance
+	Double_t aSqIntegral(0.0);
+	Double_t maxHeight(0.0);
+
+	for ( std::vector<LauDPPartialIntegralInfo*>::const_iterator regIter = dpPartialIntegralInfo_.begin(); regIter != dpPartialIntegralInfo_.end(); ++regIter ) {
+
+		const LauDPPartialIntegralInfo* intInfo = (*regIter);
+		const Bool_t squareDP = intInfo->getSquareDP();
+		const UInt_t nm13Points = intInfo->getnm13Points();
+		const UInt_t nm23Points = intInfo->getnm23Points();
+
+		// Order the grid points along each axis and group them into cells
+		std::vector<UInt_t> m13Order( nm13Points ), m23Order( nm23Points );
+		for ( UInt_t i(0); i < nm13Points; ++i ) { m13Order[i] = i; }
+		for ( UInt_t j(0); j < nm23Points; ++j ) { m23Order[j] = j; }
+		std::sort( m13Order.begin(), m13Order.end(), [intInfo](const UInt_t a, const UInt_t b){ return intInfo->getM13Value(a) < intInfo->getM13Value(b); } );
+		std::sort( m23Order.begin(), m23Order.end(), [intInfo](const UInt_t a, const UInt_t b){ return intInfo->getM23Value(a) < intInfo->getM23Value(b); } );
+
+		const UInt_t nXCells = ( nm13Points + genEnvCellPoints_ - 1 ) / genEnvCellPoints_;
+		const UInt_t nYCells = ( nm23Points + genEnvCellPoints_ - 1 ) / genEnvCellPoints_;
+
+		// The cell edges lie half way between the neighbouring grid points
+		std::vector<Double_t> xEdges( nXCells+1 ), yEdges( nYCells+1 );
+		xEdges[0] = intInfo->getMinm13();
+		xEdges[nXCells] = intInfo->getMaxm13();
+		for ( UInt_t iX(1); iX < nXCells; ++iX ) {
+			const UInt_t iPoint = iX * genEnvCellPoints_;
+			xEdges[iX] = 0.5 * ( intInfo->getM13Value( m13Order[iPoint-1] ) + intInfo->getM13Value( m13Order[iPoint] ) );
+		}
+		yEdges[0] = intInfo->getMinm23();
+		yEdges[nYCells] = intInfo->getMaxm23();
+		for ( UInt_t iY(1); iY < nYCells; ++iY ) {
+			const UInt_t iPoint = iY * genEnvCellPoints_;
+			yEdges[iY] = 0.5 * ( intInfo->getM23Value( m23Order[iPoint-1] ) + intInfo->getM23Value( m23Order[iPoint] ) );
+		}
+
+		// Find the largest value of ASq (times the Jacobian) in each cell
+		// using the amplitudes already stored at the grid points
+		std::vector<Double_t> cellMax( nXCells * nYCells, 0.0 );
+		for ( UInt_t iRank(0); iRank < nm13Points; ++iRank ) {
+
+			const UInt_t i = m13Order[iRank];
+			const Double_t m13 = intInfo->getM13Value(i);
+			const UInt_t iX = iRank / genEnvCellPoints_;
+
+			for ( UInt_t jRank(0); jRank < nm23Points; ++jRank ) {
+
+				const UInt_t j = m23Order[jRank];
+				const Double_t m23 = intInfo->getM23Value(j);
+				const UInt_t iY = jRank / genEnvCellPoints_;
+
+				// NB if squareDP is true, m13 and m23 are actually mPrime and thetaPrime
+				Bool_t withinDP = squareDP ? kinematics_->withinSqDPLimits(m13, m23) : kinematics_->withinDPLimits(m13*m13, m23*m23);
+				if ( ! withinDP ) {
+					continue;
+				}
+
+				for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+					ff_[iAmp] = intInfo->getAmplitude( i, j, iAmp );
+				}
+				for ( UInt_t iAmp(0); iAmp < nIncohAmp_; ++iAmp ) {
+					incohInten_[iAmp] = intInfo->getIntensity( i, j, iAmp );
+				}
+				eff_ = intInfo->getEfficiency( i, j );
+				this->calcTotalAmp(kTRUE);
+
+				aSqIntegral += ASq_ * intInfo->getWeight( i, j );
+
+				const Double_t jacobian = squareDP ? kinematics_->calcSqDPJacobian(m13, m23) : 4.0*m13*m23;
+				const Double_t value = ASq_ * jacobian;
+				Double_t& currentMax = cellMax[ iX * nYCells + iY ];
+				if ( value > currentMax ) {
+					currentMax = value;
+				}
+			}
+		}
+
+		// The envelope in each cell covers the largest value in it and its
+		// neighbours, to allow for peaks lying between the grid points
+		for ( UInt_t iX(0); iX < nXCells; ++iX ) {
+			for ( UInt_t iY(0); iY < nYCells; ++iY ) {
+
+				Double_t height(0.0);
+				const UInt_t xLow = ( iX > 0 ) ? iX-1 : 0;
+				const UInt_t xHigh = ( iX+1 < nXCells ) ? iX+1 : iX;
+				const UInt_t yLow = ( iY > 0 ) ? iY-1 : 0;
+				const UInt_t yHigh = ( iY+1 < nYCells ) ? iY+1 : iY;
+				for ( UInt_t iNX(xLow); iNX <= xHigh; ++iNX ) {
+					for ( UInt_t iNY(yLow); iNY <= yHigh; ++iNY ) {
+						height = TMath::Max( height, cellMax[ iNX * nYCells + iNY ] );
+					}
+				}
+				height *= ( 1.0 + genEnvMargin_ );
+
+				if ( height > maxHeight ) {
+					maxHeight = height;
+				}
+
+				GenEnvelopeCell cell;
+				cell.squareDP_ = squareDP;
+				cell.xMin_ = xEdges[iX];
+				cell.xMax_ = xEdges[iX+1];
+				cell.yMin_ = yEdges[iY];
+				cell.yMax_ = yEdges[iY+1];
+				cell.height_ = height;
+				genEnvCells_.push_back( cell );
+			}
+		}
+	}
+
+	if ( maxHeight <= 0.0 ) {
+		std::cerr<<"WARNING in LauIsobarDynamics::initGenEnvelope : |A|^2 is zero at all integration grid points, cannot build the envelope."<<std::endl;
+		genEnvCells_.clear();
+		return;
+	}
+
+	// Give cells with no grid points inside the DP a small height, so that
+	// any slivers of the DP within them can still be generated
+	const Double_t minHeight = 1e-3 * maxHeight;
+	for ( std::vector<GenEnvelopeCell>::iterator iter = genEnvCells_.begin(); iter != genEnvCells_.end(); ++iter ) {
+		if ( iter->height_ < minHeight ) {
+			iter->height_ = minHeight;
+		}
+	}
+
+	this->calcEnvelopeVolumes();
+
+	std::cout<<"INFO in LauIsobarDynamics::initGenEnvelope : Built envelope with "<<genEnvCells_.size()<<" cells."<<std::endl;
+	std::cout<<"                                           : Expected acceptance = "<<aSqIntegral/genEnvCumVolumes_.back()<<std::endl;
+}
+
+void LauIsobarDynamics::calcEnvelopeVolumes()
+{
+	genEnvCumVolumes_.resize( genEnvCells_.size() );
+
+	Double_t total(0.0);
+	for ( UInt_t iCell(0); iCell < genEnvCells_.size(); ++iCell ) {
+		const GenEnvelopeCell& cell = genEnvCells_[iCell];
+		total += cell.height_ * ( cell.xMax_ - cell.xMin_ ) * ( cell.yMax_ - cell.yMin_ );
+		genEnvCumVolumes_[iCell] = total;
+	}
+}
+
+Bool_t LauIsobarDynamics::genFromEnvelope(TRandom& rng, UInt_t& iCell, Double_t& x, Double_t& y, Double_t& jacobian) const
+{
+	// Choose the cell according to its volume
+	const Double_t choice = rng.Rndm() * genEnvCumVolumes_.back();
+	iCell = std::upper_bound( genEnvCumVolumes_.begin(), genEnvCumVolumes_.end(), choice ) - genEnvCumVolumes_.begin();
+	if ( iCell >= genEnvCells_.size() ) {
+		iCell = genEnvCells_.size() - 1;
+	}
+	const GenEnvelopeCell& cell = genEnvCells_[iCell];
+
+	// Generate uniformly within the cell
+	x = cell.xMin_ + ( cell.xMax_ - cell.xMin_ ) * rng.Rndm();
+	y = cell.yMin_ + ( cell.yMax_ - cell.yMin_ ) * rng.Rndm();
+
+	if ( cell.squareDP_ ) {
+		if ( ! kinematics_->withinSqDPLimits( x, y ) ) {
+			return kFALSE;
+		}
+		jacobian = kinematics_->calcSqDPJacobian( x, y );
+	} else {
+		if ( ! kinematics_->withinDPLimits( x*x, y*y ) ) {
+			return kFALSE;
+		}
+		jacobian = 4.0*x*y;
+	}
+
+	return kTRUE;
+}
+
+void LauIsobarDynamics::calcEnvelopeMassSq(LauKinematics* kinematics, const UInt_t iCell, const Double_t x, const Double_t y, Double_t& m13Sq, Double_t& m23Sq) const
+{
+	if ( genEnvCells_[iCell].squareDP_ ) {
+		kinematics->updateSqDPKinematics( x, y );
+		m13Sq = kinematics->getm13Sq();
+		m23Sq = kinematics->getm23Sq();
+	} else {
+		m13Sq = x*x;
+		m23Sq = y*y;
+	}
+}
+
+void LauIsobarDynamics::initGenProposal()
+{
+	genPropInitialised_ = kTRUE;
+	genPropComps_.clear();
+	genPropRatioMaxSet_ = 0.0;
+	genPropRatioMaxVar_ = 0.0;
+
+	// Collect the narrow resonances, in the same way as for the integration scheme
+	std::vector< std::pair<Int_t, std::pair<Double_t,Double_t> > > narrowRes;
+
+	// Rho-omega mixing models implicitly contains omega(782) model, but width is of rho(770) - handle as a special case
+	LauResonanceMaker& resonanceMaker = LauResonanceMaker::get();
+	LauResonanceInfo* omega_info = resonanceMaker.getResInfo("omega(782)");
+	const Double_t omegaMass  = (omega_info!=0) ? omega_info->getMass()->unblindValue()  : 0.78265;
+	const Double_t omegaWidth = (omega_info!=0) ? omega_info->getWidth()->unblindValue() : 0.00849;
+
+	for ( std::vector<LauAbsResonance*>::const_iterator iter = sigResonances_.begin(); iter != sigResonances_.end(); ++iter ) {
+		LauAbsResonance::LauResonanceModel model = (*iter)->getResonanceModel();
+		Double_t mass = (*iter)->getMass();
+		Double_t width = (*iter)->getWidth();
+		if ( model == LauAbsResonance::RhoOmegaMix_GS   ||
+		     model == LauAbsResonance::RhoOmegaMix_GS_1 ||
+		     model == LauAbsResonance::RhoOmegaMix_RBW  ||
+		     model == LauAbsResonance::RhoOmegaMix_RBW_1 ) {
+			mass = omegaMass;
+			width = omegaWidth;
+		}
+		narrowRes.push_back( std::make_pair( (*iter)->getPairInt(), std::make_pair( mass, width ) ) );
+	}
+	for ( std::vector<LauAbsIncohRes*>::const_iterator iter = sigIncohResonances_.begin(); iter != sigIncohResonances_.end(); ++iter ) {
+		narrowRes.push_back( std::make_pair( (*iter)->getPairInt(), std::make_pair( (*iter)->getMass(), (*iter)->getWidth() ) ) );
+	}
+
+	for ( std::vector< std::pair<Int_t, std::pair<Double_t,Double_t> > >::const_iterator iter = narrowRes.begin(); iter != narrowRes.end(); ++iter ) {
+
+		const Int_t pair = iter->first;
+		const Double_t mass = iter->second.first;
+		const Double_t width = iter->second.second;
+
+		if ( width > narrowWidth_ || width <= 0.0 || mass <= 0.0 ) {
+			continue;
+		}
+
+		std::vector<Int_t> pairs(1, pair);
+		if ( fullySymmetricDP_ ) {
+			pairs.assign(1, 1);
+			pairs.push_back(2);
+			pairs.push_back(3);
+		}
+
+		for ( std::vector<Int_t>::const_iterator pairIter = pairs.begin(); pairIter != pairs.end(); ++pairIter ) {
+
+			Double_t mSqMin(0.0), mSqMax(0.0);
+			if ( (*pairIter) == 1 ) {
+				mSqMin = kinematics_->getm23SqMin();
+				mSqMax = kinematics_->getm23SqMax();
+			} else if ( (*pairIter) == 2 ) {
+				mSqMin = kinematics_->getm13SqMin();
+				mSqMax = kinematics_->getm13SqMax();
+			} else if ( (*pairIter) == 3 ) {
+				mSqMin = kinematics_->getm12SqMin();
+				mSqMax = kinematics_->getm12SqMax();
+			} else {
+				continue;
+			}
+
+			const Double_t mSq = mass*mass;
+			if ( mSq < mSqMin || mSq > mSqMax ) {
+				continue;
+			}
+
+			// The Breit-Wigner in the mass squared is generated as
+			// mSq + mGamma * tan(u), with u uniform in [uMin, uMax]
+			GenProposalComponent comp;
+			comp.pair_ = (*pairIter);
+			comp.mSq_ = mSq;
+			comp.mGamma_ = mass*width;
+			comp.uMin_ = TMath::ATan( (mSqMin - mSq)/comp.mGamma_ );
+			comp.uRange_ = TMath::ATan( (mSqMax - mSq)/comp.mGamma_ ) - comp.uMin_;
+			genPropComps_.push_back( comp );
+
+			std::cout<<"INFO in LauIsobarDynamics::initGenProposal : Adding generation proposal component with mass = "<<mass<<", width = "<<width<<", pair int = "<<comp.pair_<<std::endl;
+		}
+	}
+
+	if ( genPropComps_.empty() ) {
+		std::cout<<"INFO in LauIsobarDynamics::initGenProposal : No narrow resonances found, will generate from flat phase space."<<std::endl;
+		return;
+	}
+
+	// Integrate the extent in m13Sq over m23Sq to get the DP area, using
+	// m23Sq = min + range*(1-cos(t))/2 to smooth out the endpoints
+	const Double_t m23SqMin = kinematics_->getm23SqMin();
+	const Double_t halfRange = 0.5 * ( kinematics_->getm23SqMax() - m23SqMin );
+	const UInt_t nSteps(2000);
+	const Double_t step = TMath::Pi() / nSteps;
+	Double_t area(0.0);
+	for ( UInt_t i(1); i < nSteps; ++i ) {
+		const Double_t t = i * step;
+		const Double_t m23Sq = m23SqMin + halfRange * ( 1.0 - TMath::Cos(t) );
+		const Double_t weight = ( i%2 == 1 ) ? 4.0 : 2.0;
+		area += weight * this->calcDPExtent( 1, m23Sq ) * halfRange * TMath::Sin(t);
+	}
+	genPropDPArea_ = area * step / 3.0;
+
+	// Find the accept/reject ceiling by sampling the proposal density.
+	// Since the flat part of the proposal is always present, the ratio
+	// can never exceed aSqMaxSet_ divided by its fraction.
+	const UInt_t nScan(20000);
+	Double_t maxRatio(0.0);
+	for ( UInt_t i(0); i < nScan; ++i ) {
+		Double_t m13Sq(0.0), m23Sq(0.0);
+		this->genFromProposal(m13Sq, m23Sq);
+		if ( symmetricalDP_ && !fullySymmetricDP_ && m13Sq > m23Sq ) {
+			Double_t tmpSq = m13Sq;
+			m13Sq = m23Sq;
+			m23Sq = tmpSq;
+		}
+		this->calcLikelihoodInfo(m13Sq, m23Sq);
+		const Double_t ratio = ASq_ / this->calcProposalRatio(m13Sq, m23Sq);
+		if ( ratio > maxRatio ) {
+			maxRatio = ratio;
+		}
+	}
+
+	genPropRatioMaxSet_ = TMath::Min( 1.10 * maxRatio, aSqMaxSet_ / genPropFlatFrac_ );
+
+	std::cout<<"INFO in LauIsobarDynamics::initGenProposal : DP area = "<<genPropDPArea_<<std::endl;
+	std::cout<<"                                           : maximum of |A|^2/proposal = "<<genPropRatioMaxSet_<<" (compared to |A|^2 maximum of "<<aSqMaxSet_<<")"<<std::endl;
+}
+
+void LauIsobarDynamics::genFromProposal(Double_t& m13Sq, Double_t& m23Sq) const
+{
+	// Choose between flat phase space and the resonant components, which all have the same weight
+	const Double_t choice = LauRandom::randomFun()->Rndm();
+	if ( choice < genPropFlatFrac_ ) {
+		kinematics_->genFlatPhaseSpace(m13Sq, m23Sq);
+		return;
+	}
+
+	const UInt_t nComps = genPropComps_.size();
+	UInt_t iComp = static_cast<UInt_t>( ( choice - genPropFlatFrac_ ) / ( 1.0 - genPropFlatFrac_ ) * nComps );
+	if ( iComp >= nComps ) {
+		iComp = nComps - 1;
+	}
+	const GenProposalComponent& comp = genPropComps_[iComp];
+
+	// Generate the mass squared of the pair from the Breit-Wigner and the
+	// helicity angle uniformly, which is uniform in the other invariant masses
+	const Double_t u = comp.uMin_ + comp.uRange_ * LauRandom::randomFun()->Rndm();
+	const Double_t mass = TMath::Sqrt( comp.mSq_ + comp.mGamma_ * TMath::Tan(u) );
+	const Double_t cosHel = 2.0 * LauRandom::randomFun()->Rndm() - 1.0;
+
+	if ( comp.pair_ == 1 ) {
+		kinematics_->updateKinematicsFrom23( mass, cosHel );
+	} else if ( comp.pair_ == 2 ) {
+		kinematics_->updateKinematicsFrom13( mass, cosHel );
+	} else {
+		kinematics_->updateKinematicsFrom12( mass, cosHel );
+	}
+
+	m13Sq = kinematics_->getm13Sq();
+	m23Sq = kinematics_->getm23Sq();
+}
+
+Double_t LauIsobarDynamics::calcProposalRatio(const Double_t m13Sq, const Double_t m23Sq) const
+{
+	const UInt_t nPoints = ( symmetricalDP_ && !fullySymmetricDP_ ) ? 2 : 1;
+	const Double_t compWeight = ( 1.0 - genPropFlatFrac_ ) / genPropComps_.size();
+
+	Double_t ratio(0.0);
+	for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+
+		// the second point is the reflection of the first
+		const Double_t x = ( iPoint == 0 ) ? m13Sq : m23Sq;
+		const Double_t y = ( iPoint == 0 ) ? m23Sq : m13Sq;
+
+		Double_t compSum(0.0);
+		for ( std::vector<GenProposalComponent>::const_iterator iter = genPropComps_.begin(); iter != genPropComps_.end(); ++iter ) {
+			Double_t mSq(0.0);
+			if ( iter->pair_ == 1 ) {
+				mSq = y;
+			} else if ( iter->pair_ == 2 ) {
+				mSq = x;
+			} else {
+				mSq = kinematics_->calcThirdMassSq( x, y );
+			}
+
+			// the density in the pair mass squared divided by
+			// the extent of the DP in the other direction
+			const Double_t extent = this->calcDPExtent( iter->pair_, mSq );
+			if ( extent <= 0.0 ) {
+				continue;
+			}
+			const Double_t diff = mSq - iter->mSq_;
+			const Double_t bw = iter->mGamma_ / ( iter->uRange_ * ( diff*diff + iter->mGamma_*iter->mGamma_ ) );
+			compSum += bw / extent;
+		}
+
+		ratio += genPropFlatFrac_ + compWeight * genPropDPArea_ * compSum;
+	}
+
+	return ratio;
+}
+
+Double_t LauIsobarDynamics::calcDPExtent(const Int_t pair, const Double_t mSq) const
+{
+	// The extent is 4*p*q, where p and q are the momenta of the pair daughters
+	// and of the bachelor in the pair rest frame, which is given by
+	// sqrt( lambda(mSq, ma^2, mb^2) * lambda(mSq, M^2, mc^2) ) / mSq
+
+	Double_t maSq(0.0), mbSq(0.0), mcSq(0.0);
+	const Double_t m1Sq = kinematics_->getm1() * kinematics_->getm1();
+	const Double_t m2Sq = kinematics_->getm2() * kinematics_->getm2();
+	const Double_t m3Sq = kinematics_->getm3() * kinematics_->getm3();
+	if ( pair == 1 ) {
+		maSq = m2Sq; mbSq = m3Sq; mcSq = m1Sq;
+	} else if ( pair == 2 ) {
+		maSq = m1Sq; mbSq = m3Sq; mcSq = m2Sq;
+	} else {
+		maSq = m1Sq; mbSq = m2Sq; mcSq = m3Sq;
+	}
+	const Double_t mParentSq = kinematics_->getmParentSq();
+
+	const Double_t lambdaDaug = mSq*mSq + maSq*maSq + mbSq*mbSq - 2.0*( mSq*maSq + mSq*mbSq + maSq*mbSq );
+	const Double_t lambdaBach = mSq*mSq + mParentSq*mParentSq + mcSq*mcSq - 2.0*( mSq*mParentSq + mSq*mcSq + mParentSq*mcSq );
+
+	if ( lambdaDaug <= 0.0 || lambdaBach <= 0.0 || mSq <= 0.0 ) {
+		return 0.0;
+	}
+
+	return TMath::Sqrt( lambdaDaug * lambdaBach ) / mSq;
+}
+
+LauIsobarDynamics::ToyMCStatus LauIsobarDynamics::checkToyMC(Bool_t printErrorMessages, Bool_t printInfoMessages)
+{
+	// Check whether we have generated the toy MC OK.
+	if ( this->usingGenEnvelope() ) {
+		return this->checkEnvelopeToyMC(printErrorMessages, printInfoMessages);
+	} else if ( this->usingGenProposal() ) {
+		return this->checkProposalToyMC(printErrorMessages, printInfoMessages);
+	}
+
+	ToyMCStatus ok(GenOK);
+
+	if (nSigGenLoop_ >= iterationsMax_) {
+		// Exceeded maximum allowed iterations - the generation is too inefficient
+		if (printErrorMessages) {
+			std::cerr<<"WARNING in LauIsobarDynamics::checkToyMC : More than "<<iterationsMax_<<" iterations performed and no event accepted."<<std::endl;
+		}
+
+		if ( aSqMaxSet_ > 1.01 * aSqMaxVar_ ) {
+			if (printErrorMessages) {
+				std::cerr<<"                                         : |A|^2 maximum was set to "<<aSqMaxSet_<<" but this appears to be too high."<<std::endl;
+				std::cerr<<"                                         : Maximum value of |A|^2 found so far = "<<aSqMaxVar_<<std::endl;
+				std::cerr<<"                                         : The value of |A|^2 maximum will be decreased and the generation restarted."<<std::endl;
+			}
+			aSqMaxSet_ = 1.01 * aSqMaxVar_;
+			std::cout<<"INFO in LauIsobarDynamics::checkToyMC : |A|^2 max reset to "<<aSqMaxSet_<<std::endl;
+			ok = MaxIterError;
+		} else {
+			if (printErrorMessages) {
+				std::cerr<<"                                         : |A|^2 maximum was set to "<<aSqMaxSet_<<", which seems to be correct for the given model."<<std::endl;
+				std::cerr<<"                                         : However, the generation is very inefficient - please check your model."<<std::endl;
+				std::cerr<<"                                         : The maximum number of iterations will be increased and the generation restarted."<<std::endl;
+			}
+			iterationsMax_ *= 2;
+			std::cout<<"INFO in LauIsobarDynamics::checkToyMC : max number of iterations reset to "<<iterationsMax_<<std::endl;
+			ok = MaxIterError;
+		}
+	} else if (aSqMaxVar_ > aSqMaxSet_) {
+		// Found a value of ASq higher than the accept/reject ceiling - the generation is biased
+		if (printErrorMessages) {
+			std::cerr<<"WARNING in LauIsobarDynamics::checkToyMC : |A|^2 maximum was set to "<<aSqMaxSet_<<" but a value exceeding this was found: "<<aSqMaxVar_<<std::endl;
+			std::cerr<<"                                         : This value was found at m13Sq = "<<kinematics_->getm13Sq()<<" and m23Sq = "<<kinematics_->getm23Sq()<<std::endl;
+			std::cerr<<"                                         : Run was invalid, as any generated MC will be biased, according to the accept/reject method!"<<std::endl;
+			std::cerr<<"                                         : The value of |A|^2 maximum be reset to be > "<<aSqMaxVar_<<" and the generation restarted."<<std::endl;
+		}
+		aSqMaxSet_ = 1.01 * aSqMaxVar_;
+		std::cout<<"INFO in LauIsobarDynamics::checkToyMC : |A|^2 max reset to "<<aSqMaxSet_<<std::endl;
+		ok = ASqMaxError;
+	} else if (printInfoMessages) {
+		std::cout<<"INFO in LauIsobarDynamics::checkToyMC : aSqMaxSet = "<<aSqMaxSet_<<" and aSqMaxVar = "<<aSqMaxVar_<<std::endl;
+	}
+
+	return ok;
+}
+
+LauIsobarDynamics::ToyMCStatus LauIsobarDynamics::checkEnvelopeToyMC(Bool_t printErrorMessages, Bool_t printInfoMessages)
+{
+	// As for checkToyMC but for the piecewise-constant envelope
+	ToyMCStatus ok(GenOK);
+
+	if (nSigGenLoop_ >= iterationsMax_) {
+		// Exceeded maximum allowed iterations - the envelope follows |A|^2 so the model must be very inefficient
+		if (printErrorMessages) {
+			std::cerr<<"WARNING in LauIsobarDynamics::checkEnvelopeToyMC : More than "<<iterationsMax_<<" iterations performed and no event accepted."<<std::endl;
+			std::cerr<<"                                                 : The maximum number of iterations will be increased and the generation restarted."<<std::endl;
+		}
+		iterationsMax_ *= 2;
+		std::cout<<"INFO in LauIsobarDynamics::checkEnvelopeToyMC : max number of iterations reset to "<<iterationsMax_<<std::endl;
+		ok = MaxIterError;
+	} else if (genEnvExceeded_) {
+		// Found a value higher than the envelope - the generation is biased
+		if (printErrorMessages) {
+			std::cerr<<"WARNING in LauIsobarDynamics::checkEnvelopeToyMC : A value of |A|^2 exceeding the envelope was found."<<std::endl;
+			std::cerr<<"                                                 : Run was invalid, as any generated MC will be biased, according to the accept/reject method!"<<std::endl;
+			std::cerr<<"                                                 : The envelope has been raised and the generation will be restarted."<<std::endl;
+		}
+		genEnvExceeded_ = kFALSE;
+		ok = ASqMaxError;
+	} else if (printInfoMessages) {
+		std::cout<<"INFO in LauIsobarDynamics::checkEnvelopeToyMC : generated using envelope with "<<genEnvCells_.size()<<" cells"<<std::endl;
+	}
+
+	return ok;
+}
+
+LauIsobarDynamics::ToyMCStatus LauIsobarDynamics::checkProposalToyMC(Bool_t printErrorMessages, Bool_t printInfoMessages)
+{
+	// As for checkToyMC but checking the ceiling on the ratio of ASq to the proposal density
+	ToyMCStatus ok(GenOK);
+
+	if (nSigGenLoop_ >= iterationsMax_) {
+		// Exceeded maximum allowed iterations - the generation is too inefficient
+		if (printErrorMessages) {
+			std::cerr<<"WARNING in LauIsobarDynamics::checkProposalToyMC : More than "<<iterationsMax_<<" iterations performed and no event accepted."<<std::endl;
+		}
+
+		if ( genPropRatioMaxSet_ > 1.01 * genPropRatioMaxVar_ ) {
+			if (printErrorMessages) {
+				std::cerr<<"                                                 : |A|^2/proposal maximum was set to "<<genPropRatioMaxSet_<<" but this appears to be too high."<<std::endl;
+				std::cerr<<"                                                 : Maximum value of |A|^2/proposal found so far = "<<genPropRatioMaxVar_<<std::endl;
+				std::cerr<<"                                                 : The value of the maximum will be decreased and the generation restarted."<<std::endl;
+			}
+			genPropRatioMaxSet_ = 1.01 * genPropRatioMaxVar_;
+			std::cout<<"INFO in LauIsobarDynamics::checkProposalToyMC : |A|^2/proposal max reset to "<<genPropRatioMaxSet_<<std::endl;
+			ok = MaxIterError;
+		} else {
+			if (printErrorMessages) {
+				std::cerr<<"                                                 : |A|^2/proposal maximum was set to "<<genPropRatioMaxSet_<<", which seems to be correct for the given model."<<std::endl;
+				std::cerr<<"                                                 : However, the generation is very inefficient - please check your model."<<std::endl;
+				std::cerr<<"                                                 : The maximum number of iterations will be increased and the generation restarted."<<std::endl;
+			}
+			iterationsMax_ *= 2;
+			std::cout<<"INFO in LauIsobarDynamics::checkProposalToyMC : max number of iterations reset to "<<iterationsMax_<<std::endl;
+			ok = MaxIterError;
+		}
+	} else if (genPropRatioMaxVar_ > genPropRatioMaxSet_) {
+		// Found a ratio higher than the accept/reject ceiling - the generation is biased
+		if (printErrorMessages) {
+			std::cerr<<"WARNING in LauIsobarDynamics::checkProposalToyMC : |A|^2/proposal maximum was set to "<<genPropRatioMaxSet_<<" but a value exceeding this was found: "<<genPropRatioMaxVar_<<std::endl;
+			std::cerr<<"                                                 : Run was invalid, as any generated MC will be biased, according to the accept/reject method!"<<std::endl;
+			std::cerr<<"                                                 : The value of the maximum will be reset to be > "<<genPropRatioMaxVar_<<" and the generation restarted."<<std::endl;
+		}
+		genPropRatioMaxSet_ = 1.01 * genPropRatioMaxVar_;
+		std::cout<<"INFO in LauIsobarDynamics::checkProposalToyMC : |A|^2/proposal max reset to "<<genPropRatioMaxSet_<<std::endl;
+		ok = ASqMaxError;
+	} else if (printInfoMessages) {
+		std::cout<<"INFO in LauIsobarDynamics::checkProposalToyMC : |A|^2/proposal maxSet = "<<genPropRatioMaxSet_<<" and maxVar = "<<genPropRatioMaxVar_<<std::endl;
+	}
+
+	return ok;
+}
+
+void LauIsobarDynamics::setDataEventNo(UInt_t iEvt)
+{
+	// Retrieve the data for event iEvt
+	if (data_.size() > iEvt) {
+		currentEvent_ = data_[iEvt];
+	} else {
+		std::cerr<<"ERROR in LauIsobarDynamics::setDataEventNo : Event index too large: "<<iEvt<<" >= "<<data_.size()<<"."<<std::endl;
+	}
+
+	m13Sq_ = currentEvent_->retrievem13Sq();
+	m23Sq_ = currentEvent_->retrievem23Sq();
+	mPrime_ = currentEvent_->retrievemPrime();
+	thPrime_ = currentEvent_->retrievethPrime();
+	tagCat_ = currentEvent_->retrieveTagCat();
+	eff_ = currentEvent_->retrieveEff();
+	scfFraction_ = currentEvent_->retrieveScfFraction();	// These two are necessary, even though the dynamics don't actually use scfFraction_ or jacobian_,
+	jacobian_ = currentEvent_->retrieveJacobian();		// since this is at the heart of the caching mechanism.
+}
+
+void LauIsobarDynamics::calcLikelihoodInfo(const UInt_t iEvt)
+{
+	// Calculate the likelihood and associated info
+	// for the given event using cached information
+	evtLike_ = 0.0;
+
+	// retrieve the cached dynamics from the tree:
+	// realAmp, imagAmp for each resonance plus efficiency, scf fraction and jacobian
+	this->setDataEventNo(iEvt);
+
+	// use realAmp and imagAmp to create the resonance amplitudes
+	const std::vector<Double_t>& realAmp = currentEvent_->retrieveRealAmp();
+	const std::vector<Double_t>& imagAmp = currentEvent_->retrieveImagAmp();
+	const std::vector<Double_t>& incohInten = currentEvent_->retrieveIncohIntensities();
+	for (UInt_t i = 0; i < nAmp_; i++) {
+		this->setFFTerm(i, realAmp[i], imagAmp[i]);
+	}
+	for (UInt_t i = 0; i < nIncohAmp_; i++) {
+		this->setIncohIntenTerm(i, incohInten[i]);
+	}
+
+	// Update the dynamics - calculates totAmp_ and then ASq_ = totAmp_.abs2() * eff_
+	// All calculated using cached information on the individual amplitudes and efficiency.
+	this->calcTotalAmp(kTRUE);
+
+	// Calculate the normalised matrix element squared value
+	if (DPNorm_ > 1e-10) {
+		evtLike_ = ASq_/DPNorm_;
+	}
+}
+
+void LauIsobarDynamics::calcLikelihoodInfo(const Double_t m13Sq, const Double_t m23Sq)
+{
+	this->calcLikelihoodInfo(m13Sq, m23Sq, -1);
+}
+
+void LauIsobarDynamics::calcLikelihoodInfo(const Double_t m13Sq, const Double_t m23Sq, const Int_t tagCat)
+{
+	// Calculate the likelihood and associated info
+	// for the given point in the Dalitz plot
+	// Also retrieves the SCF fraction in the bin where the event lies (done
+	// here to cache it along with the the rest of the DP quantities, like eff)
+	// The jacobian for the square DP is calculated here for the same reason.
+	evtLike_ = 0.0;
+
+	// update the kinematics for the specified DP point
+	kinematics_->updateKinematics(m13Sq, m23Sq);
+
+	// calculate the jacobian and the scfFraction to cache them later
+	scfFraction_ = this->retrieveScfFraction(tagCat);
+	if (kinematics_->squareDP() == kTRUE) {
+		jacobian_ = kinematics_->calcSqDPJacobian();
+	}
+
+	// calculate the ff_ terms and retrieves eff_ from the efficiency model
+	this->calculateAmplitudes();
+	// then calculate totAmp_ and finally ASq_ = totAmp_.abs2() * eff_
+	this->calcTotalAmp(kTRUE);
+
+	// Calculate the normalised matrix element squared value
+	if (DPNorm_ > 1e-10) {
+		evtLike_ = ASq_/DPNorm_;
+	}
+}
+
+void LauIsobarDynamics::modifyDataTree()
+{
+	if ( recalcNormalisation_ == kFALSE ) {
+		return;
 	}
 
 	const UInt_t nEvents = data_.size();
@@ -2517,6 +3558,300 @@ void LauIsobarDynamics::modifyDataTree()
 	}
 }
 
+void LauIsobarDynamics::setLikelihoodBinning(const TH2* binning)
+{
+	delete likeBinning_; likeBinning_ = 0;
+	likeBinIndices_.clear();
+	likeGridBins_.clear();
+
+	if ( binning == 0 ) {
+		return;
+	}
+
+	if ( dpPartialIntegralInfo_.empty() ) {
+		std::cerr<<"ERROR in LauIsobarDynamics::setLikelihoodBinning : The model must be initialised before the binning is set."<<std::endl;
+		return;
+	}
+
+	likeBinning_ = dynamic_cast<TH2*>( binning->Clone() );
+	likeBinning_->SetDirectory(0);
+
+	// Assign each point of the integration grid to a bin
+	for ( std::vector<LauDPPartialIntegralInfo*>::const_iterator regIter = dpPartialIntegralInfo_.begin(); regIter != dpPartialIntegralInfo_.end(); ++regIter ) {
+
+		const LauDPPartialIntegralInfo* intInfo = (*regIter);
+		const Bool_t squareDP = intInfo->getSquareDP();
+		const UInt_t nm13Points = intInfo->getnm13Points();
+		const UInt_t nm23Points = intInfo->getnm23Points();
+
+		likeGridBins_.push_back( std::vector<Int_t>( nm13Points*nm23Points, -1 ) );
+		std::vector<Int_t>& gridBins = likeGridBins_.back();
+
+		for ( UInt_t i(0); i < nm13Points; ++i ) {
+			const Double_t m13 = intInfo->getM13Value(i);
+			for ( UInt_t j(0); j < nm23Points; ++j ) {
+				const Double_t m23 = intInfo->getM23Value(j);
+
+				// NB if squareDP is true, m13 and m23 are actually mPrime and thetaPrime
+				if ( squareDP ) {
+					if ( ! kinematics_->withinSqDPLimits(m13, m23) ) {
+						continue;
+					}
+					kinematics_->updateSqDPKinematics(m13, m23);
+				} else {
+					if ( ! kinematics_->withinDPLimits(m13*m13, m23*m23) ) {
+						continue;
+					}
+					kinematics_->updateKinematics(m13*m13, m23*m23);
+				}
+
+				const Int_t globalBin = this->findLikelihoodBin();
+				if ( globalBin < 0 ) {
+					continue;
+				}
+				std::map<Int_t,UInt_t>::const_iterator found = likeBinIndices_.find( globalBin );
+				if ( found == likeBinIndices_.end() ) {
+					found = likeBinIndices_.insert( std::make_pair( globalBin, static_cast<UInt_t>( likeBinIndices_.size() ) ) ).first;
+				}
+				gridBins[ i*nm23Points + j ] = found->second;
+			}
+		}
+	}
+
+	std::cout<<"INFO in LauIsobarDynamics::setLikelihoodBinning : Using "<<likeBinIndices_.size()<<" bins for the binned likelihood."<<std::endl;
+
+	likeBinCounts_.assign( likeBinIndices_.size(), 0.0 );
+	this->calcBinIntegrals();
+}
+
+Int_t LauIsobarDynamics::findLikelihoodBin() const
+{
+	// The bins are in the square DP if the kinematics are, as for LauScfMap
+	Double_t xCoord(0.0), yCoord(0.0);
+	if ( kinematics_->squareDP() ) {
+		xCoord = kinematics_->getmPrime();
+		yCoord = kinematics_->getThetaPrime();
+	} else {
+		xCoord = kinematics_->getm13Sq();
+		yCoord = kinematics_->getm23Sq();
+	}
+
+	const TAxis* xAxis = likeBinning_->GetXaxis();
+	const TAxis* yAxis = likeBinning_->GetYaxis();
+	const Int_t xBin = xAxis->FindFixBin( xCoord );
+	const Int_t yBin = yAxis->FindFixBin( yCoord );
+	if ( xBin < 1 || xBin > xAxis->GetNbins() || yBin < 1 || yBin > yAxis->GetNbins() ) {
+		return -1;
+	}
+
+	return likeBinning_->GetBin( xBin, yBin );
+}
+
+void LauIsobarDynamics::calcBinIntegrals()
+{
+	const UInt_t nBins = likeBinIndices_.size();
+
+	likeBinAreas_.assign( nBins, 0.0 );
+	likeBinFifjEffSums_.assign( nBins*nAmp_*nAmp_, LauComplex(0.0, 0.0) );
+	likeBinFSqEffSums_.assign( nBins*nIncohAmp_, 0.0 );
+
+	// Accumulate the amplitude products stored at the grid points in each bin,
+	// in the same way as the normalisation integrals over the whole DP
+	for ( UInt_t iReg(0); iReg < dpPartialIntegralInfo_.size(); ++iReg ) {
+
+		const LauDPPartialIntegralInfo* intInfo = dpPartialIntegralInfo_[iReg];
+		const std::vector<Int_t>& gridBins = likeGridBins_[iReg];
+		const UInt_t nm13Points = intInfo->getnm13Points();
+		const UInt_t nm23Points = intInfo->getnm23Points();
+
+		for ( UInt_t i(0); i < nm13Points; ++i ) {
+			for ( UInt_t j(0); j < nm23Points; ++j ) {
+
+				const Int_t iBin = gridBins[ i*nm23Points + j ];
+				if ( iBin < 0 ) {
+					continue;
+				}
+
+				const Double_t weight = intInfo->getWeight(i,j);
+				const Double_t effWeight = intInfo->getEfficiency(i,j) * weight;
+
+				likeBinAreas_[iBin] += weight;
+
+				LauComplex* fifjSums = &likeBinFifjEffSums_[ iBin*nAmp_*nAmp_ ];
+				for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+					ff_[iAmp] = intInfo->getAmplitude( i, j, iAmp );
+				}
+				for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+					for ( UInt_t jAmp(iAmp); jAmp < nAmp_; ++jAmp ) {
+						LauComplex term = ff_[iAmp]*ff_[jAmp].conj();
+						term.rescale(effWeight);
+						fifjSums[ iAmp*nAmp_ + jAmp ] += term;
+					}
+				}
+
+				for ( UInt_t iAmp(0); iAmp < nIncohAmp_; ++iAmp ) {
+					likeBinFSqEffSums_[ iBin*nIncohAmp_ + iAmp ] += intInfo->getIntensity( i, j, iAmp ) * effWeight;
+				}
+			}
+		}
+	}
+}
+
+void LauIsobarDynamics::fillBinnedData(const LauFitDataTree& inputFitTree)
+{
+	if ( ! likeBinning_ ) {
+		std::cerr<<"ERROR in LauIsobarDynamics::fillBinnedData : The binning has not been set."<<std::endl;
+		return;
+	}
+
+	likeBinCounts_.assign( likeBinIndices_.size(), 0.0 );
+
+	// Read the DP co-ordinates directly from the columns when we can
+	const Double_t* m13SqColumn = inputFitTree.isFlatFile() ? inputFitTree.getColumn("m13Sq") : 0;
+	const Double_t* m23SqColumn = inputFitTree.isFlatFile() ? inputFitTree.getColumn("m23Sq") : 0;
+
+	UInt_t nOutside(0);
+	const UInt_t nEvents = inputFitTree.nEvents();
+	for ( UInt_t iEvt(0); iEvt < nEvents; ++iEvt ) {
+
+		Double_t m13Sq(0.0), m23Sq(0.0);
+		if ( m13SqColumn && m23SqColumn ) {
+			m13Sq = m13SqColumn[iEvt];
+			m23Sq = m23SqColumn[iEvt];
+		} else {
+			const LauFitData& dataValues = inputFitTree.getData(iEvt);
+			m13Sq = dataValues.find("m13Sq")->second;
+			m23Sq = dataValues.find("m23Sq")->second;
+		}
+
+		Int_t globalBin(-1);
+		if ( kinematics_->withinDPLimits( m13Sq, m23Sq ) ) {
+			kinematics_->updateKinematics( m13Sq, m23Sq );
+			globalBin = this->findLikelihoodBin();
+		}
+
+		std::map<Int_t,UInt_t>::const_iterator found = likeBinIndices_.find( globalBin );
+		if ( found == likeBinIndices_.end() ) {
+			++nOutside;
+			continue;
+		}
+		likeBinCounts_[ found->second ] += 1.0;
+	}
+
+	if ( nOutside > 0 ) {
+		std::cerr<<"WARNING in LauIsobarDynamics::fillBinnedData : "<<nOutside<<" events are not in any bin containing integration grid points, they will be ignored."<<std::endl;
+		std::cerr<<"                                            : Consider using coarser bins."<<std::endl;
+	}
+}
+
+Double_t LauIsobarDynamics::getBinnedNEvents() const
+{
+	Double_t nEvents(0.0);
+	for ( std::vector<Double_t>::const_iterator iter = likeBinCounts_.begin(); iter != likeBinCounts_.end(); ++iter ) {
+		nEvents += (*iter);
+	}
+	return nEvents;
+}
+
+Bool_t LauIsobarDynamics::calcBinnedLogLikelihood(Double_t& logLike) const
+{
+	logLike = 0.0;
+
+	const UInt_t nBins = likeBinCounts_.size();
+	for ( UInt_t iBin(0); iBin < nBins; ++iBin ) {
+
+		const Double_t nEvents = likeBinCounts_[iBin];
+		if ( nEvents <= 0.0 ) {
+			continue;
+		}
+
+		// The integral of the intensity over the bin, as in calcSigDPNorm
+		const LauComplex* fifjSums = &likeBinFifjEffSums_[ iBin*nAmp_*nAmp_ ];
+		Double_t binInt(0.0);
+		for ( UInt_t i(0); i < nAmp_; ++i ) {
+			binInt += Amp_[i].abs2()*fifjSums[ i*nAmp_ + i ].re()*fNorm_[i]*fNorm_[i];
+			for ( UInt_t j(i+1); j < nAmp_; ++j ) {
+				LauComplex AmpTerm = Amp_[i]*Amp_[j].conj();
+				binInt += 2.0*(AmpTerm*fifjSums[ i*nAmp_ + j ]).re()*fNorm_[i]*fNorm_[j];
+			}
+		}
+		for ( UInt_t i(0); i < nIncohAmp_; ++i ) {
+			binInt += Amp_[i+nAmp_].abs2()*likeBinFSqEffSums_[ iBin*nIncohAmp_ + i ]*fNorm_[i+nAmp_]*fNorm_[i+nAmp_];
+		}
+
+		// The mean normalised likelihood within the bin
+		const Double_t likelihood = binInt / ( likeBinAreas_[iBin] * DPNorm_ );
+		if ( ! ( likelihood > 0.0 ) ) {
+			return kFALSE;
+		}
+
+		logLike += nEvents * TMath::Log( likelihood );
+	}
+
+	return kTRUE;
+}
+
+Double_t LauIsobarDynamics::calcBinningBias()
+{
+	const UInt_t nBins = likeBinCounts_.size();
+
+	// First find the integral of the intensity over each bin
+	std::vector<Double_t> binInts( nBins, 0.0 );
+	for ( UInt_t iPass(0); iPass < 2; ++iPass ) {
+
+		std::vector<Double_t> binKLs( nBins, 0.0 );
+
+		for ( UInt_t iReg(0); iReg < dpPartialIntegralInfo_.size(); ++iReg ) {
+
+			const LauDPPartialIntegralInfo* intInfo = dpPartialIntegralInfo_[iReg];
+			const std::vector<Int_t>& gridBins = likeGridBins_[iReg];
+			const UInt_t nm13Points = intInfo->getnm13Points();
+			const UInt_t nm23Points = intInfo->getnm23Points();
+
+			for ( UInt_t i(0); i < nm13Points; ++i ) {
+				for ( UInt_t j(0); j < nm23Points; ++j ) {
+
+					const Int_t iBin = gridBins[ i*nm23Points + j ];
+					if ( iBin < 0 || likeBinCounts_[iBin] <= 0.0 ) {
+						continue;
+					}
+
+					for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+						ff_[iAmp] = intInfo->getAmplitude( i, j, iAmp );
+					}
+					for ( UInt_t iAmp(0); iAmp < nIncohAmp_; ++iAmp ) {
+						incohInten_[iAmp] = intInfo->getIntensity( i, j, iAmp );
+					}
+					eff_ = intInfo->getEfficiency( i, j );
+					this->calcTotalAmp(kTRUE);
+
+					const Double_t weight = intInfo->getWeight(i,j);
+					if ( iPass == 0 ) {
+						binInts[iBin] += weight * ASq_;
+					} else if ( ASq_ > 0.0 && binInts[iBin] > 0.0 ) {
+						// The contribution to the expected log of the ratio of
+						// the intensity to its mean over the bin
+						const Double_t meanASq = binInts[iBin] / likeBinAreas_[iBin];
+						binKLs[iBin] += weight * ASq_ * TMath::Log( ASq_ / meanASq );
+					}
+				}
+			}
+		}
+
+		if ( iPass == 1 ) {
+			Double_t bias(0.0);
+			for ( UInt_t iBin(0); iBin < nBins; ++iBin ) {
+				if ( binInts[iBin] > 0.0 ) {
+					bias += likeBinCounts_[iBin] * binKLs[iBin] / binInts[iBin];
+				}
+			}
+			return bias;
+		}
+	}
+
+	return 0.0;
+}
+
 void LauIsobarDynamics::fillDataTree(const LauFitDataTree& inputFitTree)
 {
 	// In LauFitDataTree, the first two variables should always be m13^2 and m23^2.
@@ -2549,23 +3884,39 @@ void LauIsobarDynamics::fillDataTree(const LauFitDataTree& inputFitTree)
 	std::vector<Double_t> realAmp(nAmp_), imagAmp(nAmp_);
 	Double_t eff(0.0), scfFraction(0.0), jacobian(0.0);
 
-	UInt_t nEvents = inputFitTree.nEvents() + inputFitTree.nFakeEvents();
+	const UInt_t nTreeEvents = inputFitTree.nEvents();
+	UInt_t nEvents = nTreeEvents + inputFitTree.nFakeEvents();
 
 	data_.reserve(nEvents);
 
-	for (UInt_t iEvt = 0; iEvt < nEvents; ++iEvt) {
+	// is there more than one tagging category?
+	// if so then we need to know the category from the data
+	const Bool_t needTagCat = (scfFractionModel_.size()>1);
 
-		const LauFitData& dataValues = inputFitTree.getData(iEvt);
-		LauFitData::const_iterator iter = dataValues.find("m13Sq");
-		m13Sq = iter->second;
-		iter = dataValues.find("m23Sq");
-		m23Sq = iter->second;
+	// Read the values directly from the columns when we can (the fake events are not included in them)
+	const Double_t* m13SqColumn = inputFitTree.isFlatFile() ? inputFitTree.getColumn("m13Sq") : 0;
+	const Double_t* m23SqColumn = inputFitTree.isFlatFile() ? inputFitTree.getColumn("m23Sq") : 0;
+	const Double_t* tagCatColumn = ( inputFitTree.isFlatFile() && needTagCat ) ? inputFitTree.getColumn("tagCat") : 0;
+	const Bool_t useColumns = ( m13SqColumn && m23SqColumn && ( tagCatColumn || ! needTagCat ) );
+
+	for (UInt_t iEvt = 0; iEvt < nEvents; ++iEvt) {
 
-		// is there more than one tagging category?
-		// if so then we need to know the category from the data
-		if (scfFractionModel_.size()>1) {
-			iter = dataValues.find("tagCat");
-			tagCat = static_cast<Int_t>(iter->second);
+		if ( useColumns && iEvt < nTreeEvents ) {
+			m13Sq = m13SqColumn[iEvt];
+			m23Sq = m23SqColumn[iEvt];
+			if (needTagCat) {
+				tagCat = static_cast<Int_t>(tagCatColumn[iEvt]);
+			}
+		} else {
+			const LauFitData& dataValues = inputFitTree.getData(iEvt);
+			LauFitData::const_iterator iter = dataValues.find("m13Sq");
+			m13Sq = iter->second;
+			iter = dataValues.find("m23Sq");
+			m23Sq = iter->second;
+			if (needTagCat) {
+				iter = dataValues.find("tagCat");
+				tagCat = static_cast<Int_t>(iter->second);
+			}
 		}
 
 		// calculates the amplitudes and total amplitude for the given DP point
@@ -2636,6 +3987,265 @@ Double_t LauIsobarDynamics::getEventWeight()
 	return ASq_;
 }
 
+void LauIsobarDynamics::addEvaluationWorker(LauIsobarDynamics* worker)
+{
+	if ( worker == 0 || worker == this ) {
+		std::cerr << "ERROR in LauIsobarDynamics::addEvaluationWorker : The worker must be a separate model." << std::endl;
+		return;
+	}
+
+	// Each worker updates its own kinematics, so they cannot be shared
+	Bool_t sharedKinematics = ( worker->getKinematics() == kinematics_ );
+	for ( std::vector<LauIsobarDynamics*>::const_iterator iter = evalWorkers_.begin(); iter != evalWorkers_.end(); ++iter ) {
+		if ( (*iter) == worker || (*iter)->getKinematics() == worker->getKinematics() ) {
+			sharedKinematics = kTRUE;
+		}
+	}
+	if ( sharedKinematics ) {
+		std::cerr << "ERROR in LauIsobarDynamics::addEvaluationWorker : The worker must be constructed with its own LauDaughters object." << std::endl;
+		return;
+	}
+
+	evalWorkers_.push_back( worker );
+
+	ROOT::EnableThreadSafety();
+
+	// If this model has already been initialised the worker can be prepared straight away
+	if ( integralsDone_ ) {
+		this->initialiseWorker( worker );
+	}
+}
+
+void LauIsobarDynamics::initialiseWorker(LauIsobarDynamics* worker)
+{
+	if ( worker->nAmp_ != nAmp_ || worker->nIncohAmp_ != nIncohAmp_ ) {
+		std::cerr << "ERROR in LauIsobarDynamics::initialiseWorker : The worker has " << worker->nAmp_ << " coherent and " << worker->nIncohAmp_ << " incoherent components, but the model has " << nAmp_ << " and " << nIncohAmp_ << "." << std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+	for ( UInt_t i(0); i < nAmp_; ++i ) {
+		if ( worker->sigResonances_[i]->getResonanceName() != sigResonances_[i]->getResonanceName() ) {
+			std::cerr << "ERROR in LauIsobarDynamics::initialiseWorker : Component " << i << " of the worker is " << worker->sigResonances_[i]->getResonanceName() << " but that of the model is " << sigResonances_[i]->getResonanceName() << "." << std::endl;
+			gSystem->Exit(EXIT_FAILURE);
+		}
+	}
+
+	// The worker does not need the integrals, only the resonances need to be initialised
+	worker->initialiseVectors();
+	worker->collateResonanceParameters();
+
+	if ( worker->resonancePars_.size() != resonancePars_.size() ) {
+		std::cerr << "ERROR in LauIsobarDynamics::initialiseWorker : The worker has " << worker->resonancePars_.size() << " floating resonance parameters, but the model has " << resonancePars_.size() << "." << std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+
+	// The worker always calculates every amplitude
+	worker->integralsToBeCalculated_.clear();
+	for ( UInt_t i(0); i < nAmp_+nIncohAmp_; ++i ) {
+		worker->integralsToBeCalculated_.insert(i);
+	}
+
+	worker->integralsDone_ = kTRUE;
+}
+
+void LauIsobarDynamics::syncEvaluationWorkers()
+{
+	const UInt_t nResPars = resonancePars_.size();
+
+	for ( std::vector<LauIsobarDynamics*>::iterator iter = evalWorkers_.begin(); iter != evalWorkers_.end(); ++iter ) {
+		LauIsobarDynamics* worker = (*iter);
+
+		worker->Amp_ = Amp_;
+		worker->fNorm_ = fNorm_;
+		worker->DPNorm_ = DPNorm_;
+
+		// Parameters that are not shared with the worker need their values copying
+		for ( UInt_t iPar(0); iPar < nResPars; ++iPar ) {
+			LauParameter* workerPar = worker->resonancePars_[iPar];
+			const LauParameter* modelPar = resonancePars_[iPar];
+			if ( workerPar != modelPar && workerPar->value() != modelPar->value() ) {
+				workerPar->value( modelPar->value() );
+			}
+		}
+	}
+}
+
+void LauIsobarDynamics::calcEventWeights(const UInt_t nEvents, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* weights, Double_t* jacobians)
+{
+	// Every amplitude is needed at the new points
+	std::set<UInt_t> integralsToBeCalculated;
+	integralsToBeCalculated.swap( integralsToBeCalculated_ );
+	for ( UInt_t i(0); i < nAmp_+nIncohAmp_; ++i ) {
+		integralsToBeCalculated_.insert(i);
+	}
+
+	// Share the events out between this model and its workers
+	this->syncEvaluationWorkers();
+
+	auto calcWeights = [this, m13Sq, m23Sq, weights, jacobians](const UInt_t iShare, const UInt_t first, const UInt_t last)
+	{
+		this->getEvaluationModel( iShare )->evalEventWeights( last-first, m13Sq+first, m23Sq+first, weights+first, ( jacobians != 0 ) ? jacobians+first : 0 );
+	};
+	LauParallel::forEachRange( nEvents, this->getnEvaluationThreads(), 256, calcWeights );
+
+	integralsToBeCalculated_.swap( integralsToBeCalculated );
+}
+
+void LauIsobarDynamics::evalEventWeights(const UInt_t nEvents, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* weights, Double_t* jacobians)
+{
+	for ( UInt_t iEvt(0); iEvt < nEvents; ++iEvt ) {
+		if ( ! kinematics_->withinDPLimits( m13Sq[iEvt], m23Sq[iEvt] ) ) {
+			weights[iEvt] = 0.0;
+			if ( jacobians ) {
+				jacobians[iEvt] = 1.0;
+			}
+			continue;
+		}
+
+		kinematics_->updateKinematics( m13Sq[iEvt], m23Sq[iEvt] );
+		weights[iEvt] = this->getEventWeight();
+		if ( jacobians ) {
+			jacobians[iEvt] = kinematics_->calcSqDPJacobian();
+		}
+	}
+}
+
+void LauIsobarDynamics::indexIntegrationGrid()
+{
+	gridPointIndex_.clear();
+
+	for ( UInt_t iReg(0); iReg < dpPartialIntegralInfo_.size(); ++iReg ) {
+
+		const LauDPPartialIntegralInfo* intInfo = dpPartialIntegralInfo_[iReg];
+		const Bool_t squareDP = intInfo->getSquareDP();
+		const UInt_t nm13Points = intInfo->getnm13Points();
+		const UInt_t nm23Points = intInfo->getnm23Points();
+
+		for ( UInt_t i(0); i < nm13Points; ++i ) {
+			const Double_t m13 = intInfo->getM13Value(i);
+			for ( UInt_t j(0); j < nm23Points; ++j ) {
+				const Double_t m23 = intInfo->getM23Value(j);
+
+				// NB if squareDP is true, m13 and m23 are actually mPrime and thetaPrime
+				Double_t m13Sq(0.0), m23Sq(0.0);
+				if ( squareDP ) {
+					if ( ! kinematics_->withinSqDPLimits(m13, m23) ) {
+						continue;
+					}
+					kinematics_->updateSqDPKinematics(m13, m23);
+					m13Sq = kinematics_->getm13Sq();
+					m23Sq = kinematics_->getm23Sq();
+				} else {
+					m13Sq = m13*m13;
+					m23Sq = m23*m23;
+					if ( ! kinematics_->withinDPLimits(m13Sq, m23Sq) ) {
+						continue;
+					}
+				}
+
+				const GridPoint point = { iReg, i, j };
+				gridPointIndex_.insert( std::make_pair( std::make_pair( m13Sq, m23Sq ), point ) );
+			}
+		}
+	}
+}
+
+Bool_t LauIsobarDynamics::loadGridPoint(const LauIsobarDynamics& gridModel, const Double_t m13Sq, const Double_t m23Sq)
+{
+	std::map< std::pair<Double_t,Double_t>, GridPoint >::const_iterator found = gridModel.gridPointIndex_.find( std::make_pair( m13Sq, m23Sq ) );
+	if ( found == gridModel.gridPointIndex_.end() ) {
+		return kFALSE;
+	}
+
+	const GridPoint& point = found->second;
+	const LauDPPartialIntegralInfo* intInfo = gridModel.dpPartialIntegralInfo_[ point.region_ ];
+	for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+		ff_[iAmp] = intInfo->getAmplitude( point.m13Point_, point.m23Point_, iAmp );
+	}
+	for ( UInt_t iAmp(0); iAmp < nIncohAmp_; ++iAmp ) {
+		incohInten_[iAmp] = intInfo->getIntensity( point.m13Point_, point.m23Point_, iAmp );
+	}
+	eff_ = intInfo->getEfficiency( point.m13Point_, point.m23Point_ );
+
+	return kTRUE;
+}
+
+void LauIsobarDynamics::getIntegrationGridPoints(std::vector<Double_t>& m13Sq, std::vector<Double_t>& m23Sq)
+{
+	if ( gridPointIndex_.empty() ) {
+		this->indexIntegrationGrid();
+	}
+
+	m13Sq.clear(); m13Sq.reserve( gridPointIndex_.size() );
+	m23Sq.clear(); m23Sq.reserve( gridPointIndex_.size() );
+	for ( std::map< std::pair<Double_t,Double_t>, GridPoint >::const_iterator iter = gridPointIndex_.begin(); iter != gridPointIndex_.end(); ++iter ) {
+		m13Sq.push_back( iter->first.first );
+		m23Sq.push_back( iter->first.second );
+	}
+}
+
+void LauIsobarDynamics::calcDPValues(const UInt_t nPoints, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* likelihoods, LauComplex* totAmps, LauComplex* resAmps)
+{
+	if ( gridPointIndex_.empty() ) {
+		this->indexIntegrationGrid();
+	}
+
+	// Every amplitude is needed at the new points
+	std::set<UInt_t> integralsToBeCalculated;
+	integralsToBeCalculated.swap( integralsToBeCalculated_ );
+	for ( UInt_t i(0); i < nAmp_+nIncohAmp_; ++i ) {
+		integralsToBeCalculated_.insert(i);
+	}
+
+	// Share the points out between this model and its workers, which all use the integration grid of this model
+	this->syncEvaluationWorkers();
+
+	auto calcValues = [this, m13Sq, m23Sq, likelihoods, totAmps, resAmps](const UInt_t iShare, const UInt_t first, const UInt_t last)
+	{
+		this->getEvaluationModel( iShare )->evalDPValues( *this, last-first, m13Sq+first, m23Sq+first, likelihoods+first,
+				( totAmps != 0 ) ? totAmps+first : 0, ( resAmps != 0 ) ? resAmps+first*nAmp_ : 0 );
+	};
+	LauParallel::forEachRange( nPoints, this->getnEvaluationThreads(), 256, calcValues );
+
+	integralsToBeCalculated_.swap( integralsToBeCalculated );
+}
+
+void LauIsobarDynamics::evalDPValues(const LauIsobarDynamics& gridModel, const UInt_t nPoints, const Double_t* m13Sq, const Double_t* m23Sq, Double_t* likelihoods, LauComplex* totAmps, LauComplex* resAmps)
+{
+	for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+
+		if ( ! kinematics_->withinDPLimits( m13Sq[iPoint], m23Sq[iPoint] ) ) {
+			likelihoods[iPoint] = 0.0;
+			if ( totAmps ) {
+				totAmps[iPoint].zero();
+			}
+			if ( resAmps ) {
+				for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+					resAmps[ iPoint*nAmp_ + iAmp ].zero();
+				}
+			}
+			continue;
+		}
+
+		// use the stored amplitudes if this is a point on the integration grid,
+		// otherwise calculate the ff_ terms and retrieve eff_ from the efficiency model
+		if ( ! this->loadGridPoint( gridModel, m13Sq[iPoint], m23Sq[iPoint] ) ) {
+			kinematics_->updateKinematics( m13Sq[iPoint], m23Sq[iPoint] );
+			this->calculateAmplitudes();
+		}
+		this->calcTotalAmp(kTRUE);
+
+		likelihoods[iPoint] = ( DPNorm_ > 1e-10 ) ? ASq_/DPNorm_ : 0.0;
+		if ( totAmps ) {
+			totAmps[iPoint] = totAmp_;
+		}
+		if ( resAmps ) {
+			for ( UInt_t iAmp(0); iAmp < nAmp_; ++iAmp ) {
+				resAmps[ iPoint*nAmp_ + iAmp ] = this->getFullAmplitude( iAmp );
+			}
+		}
+	}
+}
+
 void LauIsobarDynamics::updateCoeffs(const std::vector<LauComplex>& coeffs)
 {
 	// Check that the number of coeffs is correct
@@ -2649,6 +4259,11 @@ void LauIsobarDynamics::updateCoeffs(const std::vector<LauComplex>& coeffs)
 	if (changed) {
 		// Copy the coeffs
 		Amp_ = coeffs;
+
+		// The generation envelope will need to be rebuilt and any queued events are out of date
+		genEnvInitialised_ = kFALSE;
+		genQueue_.clear();
+		++modelVersion_;
 	}
 
 	// TODO should perhaps keep track of whether the resonance parameters have changed here and if none of those and none of the coeffs have changed then we don't need to update the norm
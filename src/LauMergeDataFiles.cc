@@ -31,37 +31,42 @@ Thomas Latham
 #include <iostream>
 #include <map>
 
+#include "TBranch.h"
 #include "TLeaf.h"
 #include "TObjArray.h"
+#include "TROOT.h"
 #include "TSystem.h"
 
 ClassImp(LauMergeDataFiles)
 
 
 LauMergeDataFiles::LauMergeDataFiles(const TString& fileName1, const TString& fileName2, const TString& treeName) :
-	fileName1_(fileName1),
-	fileName2_(fileName2),
 	treeName_(treeName),
-	inputFile1_(0),
-	inputFile2_(0),
-	inputTree1_(0),
-	inputTree2_(0),
 	outputFile_(0),
-	outputTree_(0)
+	outputTree_(0),
+	nThreads_(0)
 {
+	fileNames_.push_back(fileName1);
+	fileNames_.push_back(fileName2);
 }
 
-LauMergeDataFiles::~LauMergeDataFiles()
+LauMergeDataFiles::LauMergeDataFiles(const std::vector<TString>& fileNames, const TString& treeName) :
+	fileNames_(fileNames),
+	treeName_(treeName),
+	outputFile_(0),
+	outputTree_(0),
+	nThreads_(0)
 {
-	if (inputFile1_ && inputFile1_->IsOpen()) {
-		inputFile1_->Close();
-	}
-	delete inputFile1_;
+}
 
-	if (inputFile2_ && inputFile2_->IsOpen()) {
-		inputFile2_->Close();
+LauMergeDataFiles::~LauMergeDataFiles()
+{
+	for ( std::vector<TFile*>::iterator iter = inputFiles_.begin(); iter != inputFiles_.end(); ++iter ) {
+		if ((*iter) && (*iter)->IsOpen()) {
+			(*iter)->Close();
+		}
+		delete (*iter);
 	}
-	delete inputFile2_;
 
 	if (outputFile_ && outputFile_->IsOpen()) {
 		outputFile_->Close();
@@ -71,46 +76,46 @@ LauMergeDataFiles::~LauMergeDataFiles()
 
 void LauMergeDataFiles::openInputFiles()
 {
-	// open the two input ROOT files
-	inputFile1_ = TFile::Open(fileName1_);
-	if (!inputFile1_ || inputFile1_->IsZombie()) {
-		std::cerr<<"Problem opening file: \""<<fileName1_<<"\", exiting..."<<std::endl;
-		gSystem->Exit(EXIT_FAILURE);
-	}
-	inputTree1_ = dynamic_cast<TTree*>( inputFile1_->Get(treeName_) );
-	if (!inputTree1_) {
-		std::cerr<<"Problem getting tree called "<<treeName_<<"from file: \""<<fileName1_<<"\", exiting..."<<std::endl;
+	if ( fileNames_.size() < 2 ) {
+		std::cerr<<"Need at least two files to merge, exiting..."<<std::endl;
 		gSystem->Exit(EXIT_FAILURE);
 	}
 
-	inputFile2_ = TFile::Open(fileName2_);
-	if (!inputFile2_ || inputFile2_->IsZombie()) {
-		std::cerr<<"Problem opening file: \""<<fileName2_<<"\", exiting..."<<std::endl;
-		gSystem->Exit(EXIT_FAILURE);
-	}
-	inputTree2_ = dynamic_cast<TTree*>( inputFile2_->Get(treeName_) );
-	if (!inputTree2_) {
-		std::cerr<<"Problem getting tree called "<<treeName_<<"from file: \""<<fileName2_<<"\", exiting..."<<std::endl;
-		gSystem->Exit(EXIT_FAILURE);
+	// open the input ROOT files
+	for ( std::vector<TString>::const_iterator iter = fileNames_.begin(); iter != fileNames_.end(); ++iter ) {
+		const TString& fileName = (*iter);
+		TFile* inputFile = TFile::Open(fileName);
+		if (!inputFile || inputFile->IsZombie()) {
+			std::cerr<<"Problem opening file: \""<<fileName<<"\", exiting..."<<std::endl;
+			gSystem->Exit(EXIT_FAILURE);
+		}
+		TTree* inputTree = dynamic_cast<TTree*>( inputFile->Get(treeName_) );
+		if (!inputTree) {
+			std::cerr<<"Problem getting tree called "<<treeName_<<"from file: \""<<fileName<<"\", exiting..."<<std::endl;
+			gSystem->Exit(EXIT_FAILURE);
+		}
+		inputFiles_.push_back(inputFile);
+		inputTrees_.push_back(inputTree);
 	}
 }
 
 void LauMergeDataFiles::setupInputTrees()
 {
-	TObjArray* leaves1 = inputTree1_->GetListOfLeaves();
-	TObjArray* leaves2 = inputTree2_->GetListOfLeaves();
+	TObjArray* leaves1 = inputTrees_[0]->GetListOfLeaves();
 	Int_t nLeaves1 = leaves1->GetEntries();
-	Int_t nLeaves2 = leaves2->GetEntries();
-	if ( nLeaves1 != nLeaves2 ) {
-		std::cerr<<"Different number of leaves in the two input trees, not continuing."<<std::endl;
-		return;
+	for ( UInt_t iTree(1); iTree < inputTrees_.size(); ++iTree ) {
+		Int_t nLeaves = inputTrees_[iTree]->GetListOfLeaves()->GetEntries();
+		if ( nLeaves1 != nLeaves ) {
+			std::cerr<<"Different number of leaves in the input trees from "<<fileNames_[0]<<" and "<<fileNames_[iTree]<<", not continuing."<<std::endl;
+			return;
+		}
 	}
 
 	std::cout<<"Setting branches for input trees \""<<treeName_<<"\"..."<<std::endl;
-	inputTree1_->SetBranchAddress("iExpt",&iExpt_);
-	inputTree1_->SetBranchAddress("iEvtWithinExpt",&iEvtWithinExpt_);
-	inputTree2_->SetBranchAddress("iExpt",&iExpt_);
-	inputTree2_->SetBranchAddress("iEvtWithinExpt",&iEvtWithinExpt_);
+	for ( std::vector<TTree*>::iterator iter = inputTrees_.begin(); iter != inputTrees_.end(); ++iter ) {
+		(*iter)->SetBranchAddress("iExpt",&iExpt_);
+		(*iter)->SetBranchAddress("iEvtWithinExpt",&iEvtWithinExpt_);
+	}
 
 	for (Int_t iLeaf(0); iLeaf<nLeaves1; ++iLeaf) {
 
@@ -123,22 +128,28 @@ void LauMergeDataFiles::setupInputTrees()
 			continue;
 		}
 
+		void* address(0);
 		if ( type == "Double_t" ) {
 			std::pair<LeafDoubleMap::iterator,bool> result = doubleVars_.insert(std::make_pair(name,0.0));
-			LeafDoubleMap::iterator iter = result.first;
-			bool ok = result.second;
-			if (ok) {
-				inputTree1_->SetBranchAddress(name,&(iter->second));
-				inputTree2_->SetBranchAddress(name,&(iter->second));
+			if (result.second) {
+				address = &(result.first->second);
 			}
 		} else if ( type == "Int_t" ) {
 			std::pair<LeafIntegerMap::iterator,bool> result = integerVars_.insert(std::make_pair(name,0));
-			LeafIntegerMap::iterator iter = result.first;
-			bool ok = result.second;
-			if (ok) {
-				inputTree1_->SetBranchAddress(name,&(iter->second));
-				inputTree2_->SetBranchAddress(name,&(iter->second));
+			if (result.second) {
+				address = &(result.first->second);
+			}
+		}
+		if (!address) {
+			continue;
+		}
+
+		for ( UInt_t iTree(0); iTree < inputTrees_.size(); ++iTree ) {
+			if ( ! inputTrees_[iTree]->GetLeaf(name) ) {
+				std::cerr<<"Cannot find leaf "<<name<<" in the input tree from "<<fileNames_[iTree]<<", exiting..."<<std::endl;
+				gSystem->Exit(EXIT_FAILURE);
 			}
+			inputTrees_[iTree]->SetBranchAddress(name,address);
 		}
 	}
 	std::cout<<"Set branch addresses for "<<doubleVars_.size()<<" Double_t branches.\n";
@@ -173,6 +184,13 @@ void LauMergeDataFiles::setupOutputTree()
 
 void LauMergeDataFiles::process(const TString& fileName)
 {
+	// optionally let ROOT compress the output baskets in parallel
+	// (unless the caller has already enabled it, in which case leave it as it is)
+	const Bool_t enableMT = ( nThreads_ > 1 && ! ROOT::IsImplicitMTEnabled() );
+	if ( enableMT ) {
+		ROOT::EnableImplicitMT(nThreads_);
+	}
+
 	this->openInputFiles();
 
 	this->setupInputTrees();
@@ -185,41 +203,66 @@ void LauMergeDataFiles::process(const TString& fileName)
 	std::cout<<"Starting to combine the trees..."<<std::endl;
 
 	// Find the first and last entries for each experiment in each tree
-	this->findExperiments( inputTree1_, tree1Expts_ );
-	this->findExperiments( inputTree2_, tree2Expts_ );
+	const UInt_t nTrees = inputTrees_.size();
+	treeExpts_.resize( nTrees );
+	for ( UInt_t iTree(0); iTree < nTrees; ++iTree ) {
+		this->findExperiments( inputTrees_[iTree], treeExpts_[iTree] );
+	}
 
-	// Check that the experiments in the two trees match
+	// Check that the experiments in the trees match
 	if ( !this->checkExperimentMaps() ) {
+		if ( enableMT ) {
+			ROOT::DisableImplicitMT();
+		}
 		return;
 	}
 
+	// The experiments are read in order, so each tree is read through
+	// sequentially - make sure all its branches are read ahead in bulk
+	for ( std::vector<TTree*>::iterator iter = inputTrees_.begin(); iter != inputTrees_.end(); ++iter ) {
+		(*iter)->SetCacheSize(30000000);
+		(*iter)->AddBranchToCache("*",kTRUE);
+	}
+
 	// Loop through the experiments
-	for ( ExptsMap::const_iterator iter1 = tree1Expts_.begin(); iter1 != tree1Expts_.end(); ++iter1 ) {
+	for ( ExptsMap::const_iterator iter1 = treeExpts_[0].begin(); iter1 != treeExpts_[0].end(); ++iter1 ) {
 
-		// get the map element for tree2
 		Int_t expt = iter1->first;
-		ExptsMap::const_iterator iter2 = tree2Expts_.find( expt );
 
-		// determine the number of entries in tree1
-		Int_t nEntriesInTree1 = iter1->second.second - iter1->second.first + 1;
-
-		// read the entries from the trees, filling the output tree
-		this->readExperiment( inputTree1_, iter1, 0 );
-		this->readExperiment( inputTree2_, iter2, nEntriesInTree1 );
+		// read the entries from each tree in turn, filling the output tree,
+		// offsetting the event numbers by the number of entries from the previous trees
+		Int_t nEntriesSoFar(0);
+		for ( UInt_t iTree(0); iTree < nTrees; ++iTree ) {
+			ExptsMap::const_iterator iter = treeExpts_[iTree].find( expt );
+			this->readExperiment( inputTrees_[iTree], iter, nEntriesSoFar );
+			nEntriesSoFar += iter->second.second - iter->second.first + 1;
+		}
 	}
 
 	// Write the output file
 	this->writeFile();
+
+	// and restore ROOT's threading to how we found it
+	if ( enableMT ) {
+		ROOT::DisableImplicitMT();
+	}
 }
 
 void LauMergeDataFiles::findExperiments(TTree* tree, ExptsMap& exptsMap)
 {
 	const Int_t nEntries = tree->GetEntries();
 
+	// only the experiment number is needed here
+	TBranch* exptBranch = tree->GetBranch("iExpt");
+	if ( !exptBranch ) {
+		std::cerr<<"ERROR in LauMergeDataFiles::findExperiments : Cannot find the iExpt branch, exiting..."<<std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+
 	// loop through the tree
 	for ( Int_t iEntry(0); iEntry<nEntries; ++iEntry ) {
 		// grab the entry
-		tree->GetEntry(iEntry);
+		exptBranch->GetEntry(iEntry);
 
 		// see if we already have an element in the map for the
 		// current experiment
@@ -244,23 +287,30 @@ void LauMergeDataFiles::findExperiments(TTree* tree, ExptsMap& exptsMap)
 
 Bool_t LauMergeDataFiles::checkExperimentMaps() const
 {
-	// first check that the two maps are the same size
-	UInt_t size1 = tree1Expts_.size();
-	UInt_t size2 = tree2Expts_.size();
-	if ( size1 != size2 ) {
-		std::cerr<<"ERROR in LauMergeDataFiles::checkExperimentMaps : Experiment maps are not the same size.\n";
-		std::cerr<<"                                                : Tree from "<<fileName1_<<" has "<<size1<<" experiments.";
-		std::cerr<<"                                                : Tree from "<<fileName2_<<" has "<<size2<<" experiments.";
-		return kFALSE;
-	}
+	const ExptsMap& tree1Expts = treeExpts_[0];
 
-	for ( ExptsMap::const_iterator iter1 = tree1Expts_.begin(); iter1 != tree1Expts_.end(); ++iter1 ) {
-		Int_t expt = iter1->first;
-		ExptsMap::const_iterator iter2 = tree2Expts_.find( expt );
-		if ( iter2 == tree2Expts_.end() ) {
-			std::cerr<<"ERROR in LauMergeDataFiles::checkExperimentMaps : Cannot find experiment "<<expt<<" in tree from "<<fileName2_<<std::endl;
+	for ( UInt_t iTree(1); iTree < treeExpts_.size(); ++iTree ) {
+
+		const ExptsMap& tree2Expts = treeExpts_[iTree];
+
+		// first check that the two maps are the same size
+		UInt_t size1 = tree1Expts.size();
+		UInt_t size2 = tree2Expts.size();
+		if ( size1 != size2 ) {
+			std::cerr<<"ERROR in LauMergeDataFiles::checkExperimentMaps : Experiment maps are not the same size.\n";
+			std::cerr<<"                                                : Tree from "<<fileNames_[0]<<" has "<<size1<<" experiments.";
+			std::cerr<<"                                                : Tree from "<<fileNames_[iTree]<<" has "<<size2<<" experiments.";
 			return kFALSE;
 		}
+
+		for ( ExptsMap::const_iterator iter1 = tree1Expts.begin(); iter1 != tree1Expts.end(); ++iter1 ) {
+			Int_t expt = iter1->first;
+			ExptsMap::const_iterator iter2 = tree2Expts.find( expt );
+			if ( iter2 == tree2Expts.end() ) {
+				std::cerr<<"ERROR in LauMergeDataFiles::checkExperimentMaps : Cannot find experiment "<<expt<<" in tree from "<<fileNames_[iTree]<<std::endl;
+				return kFALSE;
+			}
+		}
 	}
 
 	return kTRUE;
@@ -296,15 +346,15 @@ void LauMergeDataFiles::writeFile()
 	outputFile_->Close();
 	delete outputFile_; outputFile_ = 0; outputTree_ = 0;
 
-	inputFile1_->Close();
-	delete inputFile1_; inputFile1_ = 0; inputTree1_ = 0;
-
-	inputFile2_->Close();
-	delete inputFile2_; inputFile2_ = 0; inputTree2_ = 0;
+	for ( std::vector<TFile*>::iterator iter = inputFiles_.begin(); iter != inputFiles_.end(); ++iter ) {
+		(*iter)->Close();
+		delete (*iter);
+	}
+	inputFiles_.clear();
+	inputTrees_.clear();
 
 	doubleVars_.clear();
 	integerVars_.clear();
-	tree1Expts_.clear();
-	tree2Expts_.clear();
+	treeExpts_.clear();
 }
 
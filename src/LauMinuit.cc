@@ -33,11 +33,16 @@ Thomas Latham
 #include "LauParameter.hh"
 #include "LauParamFixed.hh"
 
+#include "TMath.h"
 #include "TMatrixD.h"
 #include "TVirtualFitter.h"
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <array>
+#include <cstdio>
 #include <iostream>
 
 // It's necessary to define an external function that specifies the address of the function
@@ -48,6 +53,9 @@ Thomas Latham
 // and use the member functions to access the parameters/variables.
 extern void logLikeFun(Int_t &npar, Double_t *gin, Double_t &f, Double_t *par, Int_t iflag);
 
+// Calculate the negative log-likelihood and its gradient, with all points required evaluated in a single batch
+void logLikeGradient(LauFitObject* theModel, Int_t npar, Double_t* gin, Double_t& f, Double_t* par);
+
 ClassImp(LauMinuit)
 
 
@@ -143,6 +151,17 @@ void LauMinuit::initialise( LauFitObject* fitObj, const std::vector<LauParameter
 	std::array<Double_t,1> argL { 0.5 };
 	fitStatus_.status = minuit_->ExecuteCommand("SET ERR", argL.data(), argL.size());
 
+	// Tell Minuit whether we will be supplying the gradient
+	// (without the force argument, so that Minuit first checks it against its own numerical estimate)
+	if ( useBatchedGradient_ ) {
+		if ( outputLevel_ > LauOutputLevel::Quiet ) {
+			std::cout << "INFO in LauMinuit::initialise : The NLL gradient will be supplied to Minuit" << std::endl;
+		}
+		minuit_->ExecuteCommand("SET GRADIENT", argL.data(), 0);
+	} else {
+		minuit_->ExecuteCommand("SET NOGRADIENT", argL.data(), 0);
+	}
+
 	//argL[0] = 0;
 	//fitStatus_.status = minuit_->ExecuteCommand("SET STRATEGY", argL.data(), argL.size());
 }
@@ -158,6 +177,8 @@ const LauAbsFitter::FitStatus& LauMinuit::minimise()
 		1000.0*nParams_, // maximum iterations
 		0.05             // tolerance -> min EDM = 0.001*tolerance (0.05)
 	};
+	minosErrors_.clear();
+
 	fitStatus_.status = minuit_->ExecuteCommand("MIGRAD", arglist.data(), arglist.size());
 
 	// Dummy variables - need to feed them to the function
@@ -209,7 +230,11 @@ const LauAbsFitter::FitStatus& LauMinuit::minimise()
 			if (useAsymmFitErrors_ == kTRUE) {
 				LauFitObject* fitObj = this->getFitObject();
 				fitObj->withinAsymErrorCalc( kTRUE );
-				fitStatus_.status = minuit_->ExecuteCommand("MINOS", arglist.data(), 1); 
+				if ( minosProcesses_ > 1 ) {
+					fitStatus_.status = this->runParallelMinos( arglist[0] );
+				} else {
+					fitStatus_.status = minuit_->ExecuteCommand("MINOS", arglist.data(), 1); 
+				}
 				fitObj->withinAsymErrorCalc( kFALSE );
 				if (fitStatus_.status != 0) {
 					std::cerr << "ERROR in LauMinuit::minimise : Error in MINOS routine." << std::endl;
@@ -245,6 +270,157 @@ const LauAbsFitter::FitStatus& LauMinuit::minimise()
 	return fitStatus_;
 }
 
+Int_t LauMinuit::runParallelMinos( const Double_t maxCalls )
+{
+	// Share out the floating parameters between the processes
+	std::vector<UInt_t> freePars;
+	for (UInt_t i{0}; i < nParams_; ++i) {
+		if ( ! params_[i]->fixed() ) {
+			freePars.push_back(i);
+		}
+	}
+	const UInt_t nFree = freePars.size();
+	const UInt_t nProcs = std::min( minosProcesses_, nFree );
+
+	// The minimum found by MIGRAD/HESSE, against which to check for new minima
+	Double_t minNLL{0.0}, edm{0.0}, errdef{0.0};
+	Int_t nvpar{0}, nparx{0};
+	minuit_->GetStats(minNLL, edm, errdef, nvpar, nparx);
+
+	if ( outputLevel_ > LauOutputLevel::Quiet ) {
+		std::cout << "INFO in LauMinuit::runParallelMinos : Running MINOS for " << nFree << " parameters in " << nProcs << " processes" << std::endl;
+	}
+
+	// Make sure nothing buffered gets written out by the children as well
+	std::cout.flush();
+	std::cerr.flush();
+	std::fflush(nullptr);
+
+	std::vector<pid_t> pids;
+	std::vector<Int_t> pipes;
+	std::vector<UInt_t> localPars;
+	for (UInt_t iProc{0}; iProc < nProcs; ++iProc) {
+
+		// MINOS takes the maximum number of calls followed by the (1-based) parameter numbers
+		std::vector<Double_t> minosArgs { maxCalls };
+		for (UInt_t iFree{iProc}; iFree < nFree; iFree += nProcs) {
+			minosArgs.push_back( freePars[iFree] + 1.0 );
+		}
+
+		Int_t fds[2];
+		const pid_t pid { ( ::pipe(fds) == 0 ) ? ::fork() : -1 };
+
+		if ( pid == 0 ) {
+			// In the child: run MINOS on this share of the parameters and send back
+			// the status, NLL, the errors for each parameter and all the parameter values
+			::close(fds[0]);
+			Int_t status { minuit_->ExecuteCommand("MINOS", minosArgs.data(), minosArgs.size()) };
+			Double_t nll{0.0};
+			minuit_->GetStats(nll, edm, errdef, nvpar, nparx);
+
+			std::vector<Double_t> message { static_cast<Double_t>(status), nll };
+			for (UInt_t iArg{1}; iArg < minosArgs.size(); ++iArg) {
+				const UInt_t i { static_cast<UInt_t>(minosArgs[iArg]) - 1 };
+				Double_t error{0.0}, negError{0.0}, posError{0.0}, globalcc{0.0};
+				minuit_->GetErrors(i, posError, negError, error, globalcc);
+				message.push_back( i );
+				message.push_back( negError );
+				message.push_back( posError );
+			}
+			for (UInt_t i{0}; i < nParams_; ++i) {
+				message.push_back( minuit_->GetParameter(i) );
+			}
+
+			const char* data { reinterpret_cast<const char*>( message.data() ) };
+			size_t toWrite { message.size() * sizeof(Double_t) };
+			while ( toWrite > 0 ) {
+				const ssize_t written { ::write(fds[1], data, toWrite) };
+				if ( written <= 0 ) {
+					break;
+				}
+				data += written;
+				toWrite -= written;
+			}
+			::close(fds[1]);
+			::_exit( EXIT_SUCCESS );
+		}
+
+		if ( pid < 0 ) {
+			// Could not fork, so do this share here once the children have finished
+			std::cerr << "WARNING in LauMinuit::runParallelMinos : Unable to fork process " << iProc << ", its parameters will be done afterwards in this process." << std::endl;
+			localPars.insert( localPars.end(), minosArgs.begin()+1, minosArgs.end() );
+			continue;
+		}
+
+		::close(fds[1]);
+		pids.push_back(pid);
+		pipes.push_back(fds[0]);
+	}
+
+	// Gather the results from the children
+	Int_t minosStatus{0};
+	Double_t bestNLL{minNLL};
+	std::vector<Double_t> bestValues;
+	for (UInt_t iChild{0}; iChild < pids.size(); ++iChild) {
+
+		std::vector<char> bytes;
+		char buffer[4096];
+		ssize_t nRead{0};
+		while ( ( nRead = ::read(pipes[iChild], buffer, sizeof(buffer)) ) > 0 ) {
+			bytes.insert( bytes.end(), buffer, buffer + nRead );
+		}
+		std::vector<Double_t> message( bytes.size() / sizeof(Double_t) );
+		std::copy( bytes.begin(), bytes.begin() + message.size() * sizeof(Double_t), reinterpret_cast<char*>( message.data() ) );
+		::close(pipes[iChild]);
+
+		Int_t childStatus{0};
+		::waitpid(pids[iChild], &childStatus, 0);
+
+		// Check that the message is complete: status, NLL, triplets of errors, then the parameter values
+		if ( message.size() < 2 + nParams_ || ( message.size() - 2 - nParams_ ) % 3 != 0 ) {
+			std::cerr << "ERROR in LauMinuit::runParallelMinos : Incomplete results from MINOS process " << iChild << std::endl;
+			minosStatus = -1;
+			continue;
+		}
+
+		if ( message[0] != 0.0 ) {
+			minosStatus = static_cast<Int_t>( message[0] );
+		}
+
+		const UInt_t nErrors { static_cast<UInt_t>( ( message.size() - 2 - nParams_ ) / 3 ) };
+		for (UInt_t iErr{0}; iErr < nErrors; ++iErr) {
+			const UInt_t i { static_cast<UInt_t>( message[ 2 + 3*iErr ] ) };
+			minosErrors_[i] = std::make_pair( message[ 3 + 3*iErr ], message[ 4 + 3*iErr ] );
+		}
+
+		if ( message[1] < bestNLL ) {
+			bestNLL = message[1];
+			bestValues.assign( message.end() - nParams_, message.end() );
+		}
+	}
+
+	// Do any parameters that could not be sent to another process
+	if ( ! localPars.empty() ) {
+		std::vector<Double_t> minosArgs { maxCalls };
+		minosArgs.insert( minosArgs.end(), localPars.begin(), localPars.end() );
+		const Int_t status { minuit_->ExecuteCommand("MINOS", minosArgs.data(), minosArgs.size()) };
+		if ( status != 0 ) {
+			minosStatus = status;
+		}
+	}
+
+	// MINOS can find a new minimum while scanning, in which case the fit should be redone from there
+	const Double_t tolerance{1e-3};
+	if ( ! bestValues.empty() && bestNLL < minNLL - tolerance ) {
+		std::cerr << "WARNING in LauMinuit::runParallelMinos : MINOS found a new minimum, with NLL lower by " << minNLL - bestNLL << ", at:" << std::endl;
+		for (UInt_t i{0}; i < nParams_; ++i) {
+			std::cerr << "                                        : " << params_[i]->name() << " = " << bestValues[i] << std::endl;
+		}
+	}
+
+	return minosStatus;
+}
+
 void LauMinuit::fixSecondStageParameters()
 {
 	for (UInt_t i{0}; i < nParams_; ++i) {
@@ -279,19 +455,41 @@ void LauMinuit::updateParameters()
 		Double_t posError{0.0};
 		Double_t globalcc{0.0};
 		minuit_->GetErrors(i, posError, negError, error, globalcc);
+		// Take the asymmetric errors from the forked MINOS processes if they were calculated there
+		std::map< UInt_t, std::pair<Double_t,Double_t> >::const_iterator minosIter = minosErrors_.find(i);
+		if ( minosIter != minosErrors_.end() ) {
+			negError = minosIter->second.first;
+			posError = minosIter->second.second;
+		}
 		params_[i]->valueAndErrors(value, error, negError, posError);
 		params_[i]->globalCorrelationCoeff(globalcc);
 	}
 }
 
+std::vector<Double_t> LauMinuit::currentStepSizes() const
+{
+	// MINUIT's current error estimates, which it updates as the minimisation proceeds
+	std::vector<Double_t> stepSizes( nParams_, 0.0 );
+	for (UInt_t i{0}; i < nParams_; ++i) {
+		stepSizes[i] = minuit_->GetParError(i);
+	}
+	return stepSizes;
+}
+
 // Definition of the fitting function for Minuit
-void logLikeFun(Int_t& npar, Double_t* /*first_derivatives*/, Double_t& f, Double_t* par, Int_t /*iflag*/)
+void logLikeFun(Int_t& npar, Double_t* first_derivatives, Double_t& f, Double_t* par, Int_t iflag)
 {
 	// Routine that specifies the negative log-likelihood function for the fit.
 	// Used by the MINUIT minimising code.
 
 	LauFitObject* theModel = LauFitter::fitter().getFitObject();
 
+	// Minuit requests the gradient (along with the function value) with iflag = 2
+	if ( iflag == 2 && first_derivatives != nullptr ) {
+		logLikeGradient( theModel, npar, first_derivatives, f, par );
+		return;
+	}
+
 	// Set the internal parameters for this model using parameters from Minuit (pars):
 	theModel->setParsFromMinuit( par, npar );
 
@@ -299,3 +497,72 @@ void logLikeFun(Int_t& npar, Double_t* /*first_derivatives*/, Double_t& f, Doubl
 	f = theModel->getTotNegLogLikelihood();
 }
 
+
+void logLikeGradient(LauFitObject* theModel, Int_t npar, Double_t* gin, Double_t& f, Double_t* par)
+{
+	// Determine the derivatives w.r.t. each free parameter from central
+	// differences (or one-sided differences where a limit would be crossed).
+	// The step for each parameter is a small fraction of its current error estimate.
+	const Double_t stepFraction{0.01};
+
+	TVirtualFitter* fitter { TVirtualFitter::GetFitter() };
+	const UInt_t nPars { static_cast<UInt_t>( fitter->GetNumberTotalParameters() ) };
+
+	// The first point is the nominal one, then up to two per free parameter
+	std::vector<Double_t> points( par, par + nPars );
+	std::vector<UInt_t> upIndex( nPars, 0 );
+	std::vector<UInt_t> downIndex( nPars, 0 );
+	std::vector<Double_t> delta( nPars, 0.0 );
+
+	UInt_t nPoints{1};
+	std::array<char,64> name;
+	for ( UInt_t i{0}; i < nPars; ++i ) {
+		gin[i] = 0.0;
+		if ( fitter->IsFixed(i) ) {
+			continue;
+		}
+
+		Double_t value{0.0}, error{0.0}, minVal{0.0}, maxVal{0.0};
+		fitter->GetParameter( i, name.data(), value, error, minVal, maxVal );
+		const Double_t x { par[i] };
+
+		Double_t step { stepFraction * error };
+		if ( step <= 0.0 ) {
+			step = 1e-4 * std::max( 1.0, TMath::Abs(x) );
+		}
+
+		// If the range between the limits is too narrow for either step, shrink the step until one fits
+		const Bool_t hasLimits { minVal < maxVal };
+		while ( hasLimits && step > 0.0 && x + step > maxVal && x - step < minVal ) {
+			step *= 0.5;
+		}
+		const Bool_t canStepUp { ! hasLimits || x + step <= maxVal };
+		const Bool_t canStepDown { ! hasLimits || x - step >= minVal };
+
+		if ( canStepUp ) {
+			points.insert( points.end(), par, par + nPars );
+			points[ nPoints*nPars + i ] = x + step;
+			upIndex[i] = nPoints++;
+			delta[i] += step;
+		}
+		if ( canStepDown ) {
+			points.insert( points.end(), par, par + nPars );
+			points[ nPoints*nPars + i ] = x - step;
+			downIndex[i] = nPoints++;
+			delta[i] += step;
+		}
+	}
+
+	std::vector<Double_t> negLogLikes( nPoints, 0.0 );
+	theModel->getTotNegLogLikelihoods( nPoints, points.data(), npar, negLogLikes.data() );
+
+	f = negLogLikes[0];
+	for ( UInt_t i{0}; i < nPars; ++i ) {
+		if ( delta[i] > 0.0 ) {
+			gin[i] = ( negLogLikes[ upIndex[i] ] - negLogLikes[ downIndex[i] ] ) / delta[i];
+		}
+	}
+
+	// Leave the model with the nominal parameter values
+	theModel->setParsFromMinuit( par, npar );
+}
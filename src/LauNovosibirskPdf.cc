@@ -37,6 +37,7 @@ using std::endl;
 
 #include "LauNovosibirskPdf.hh"
 #include "LauConstants.hh"
+#include "LauVectorMath.hh"
 
 ClassImp(LauNovosibirskPdf)
 
@@ -115,11 +116,43 @@ void LauNovosibirskPdf::calcLikelihoodInfo(const LauAbscissas& abscissas)
 	// if the parameters are floating then we
 	// need to recalculate the normalisation
 	if (!this->cachePDF() && !this->withinNormCalc() && !this->withinGeneration()) {
-		this->calcNorm();
+		this->updateNorm();
 	}
 	this->setUnNormPDFVal(value);
 }
 
+void LauNovosibirskPdf::calcUnNormPDFValues(UInt_t nValues, const Double_t* abscissas, Double_t* values)
+{
+	// Get the up to date parameter values
+	Double_t mean = mean_->unblindValue();
+	Double_t sigma = sigma_->unblindValue();
+	Double_t tail = tail_->unblindValue();
+
+	// Calculate the exponents for all the abscissa values and then exponentiate them all together
+	if (TMath::Abs(tail) < 1.e-7) {
+		for ( UInt_t i(0); i < nValues; ++i ) {
+			const Double_t arg = (abscissas[i] - mean)/sigma;
+			values[i] = -0.5*arg*arg;
+		}
+	} else {
+		const Double_t qa = tail*TMath::Sqrt(LauConstants::log4);
+		const Double_t qb = TMath::SinH(qa)/qa;
+		const Double_t tailSq = tail*tail;
+		for ( UInt_t i(0); i < nValues; ++i ) {
+			const Double_t qx = (abscissas[i] - mean)/sigma*qb;
+			const Double_t qy = 1.0 + tail*qx;
+			if ( qy > 1.E-7 ) {
+				const Double_t logqy = log(qy)/tail;
+				values[i] = -0.5*( logqy*logqy + tailSq );
+			} else {
+				values[i] = -15.0;
+			}
+		}
+	}
+
+	LauVectorMath::exp( nValues, values, values );
+}
+
 void LauNovosibirskPdf::calcPDFHeight( const LauKinematics* /*kinematics*/ )
 {
 	if (this->heightUpToDate()) {
@@ -0,0 +1,67 @@
+
+/*
+Copyright 2026 University of Warwick
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+Laura++ package authors:
+John Back
+Paul Harrison
+Thomas Latham
+*/
+
+/*! \file LauParallel.cc
+    \brief File containing implementation of LauParallel methods.
+*/
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "LauParallel.hh"
+
+UInt_t LauParallel::forEachRange(const UInt_t nItems, const UInt_t nThreads, const UInt_t minItemsPerThread, const std::function<void(const UInt_t, const UInt_t, const UInt_t)>& func)
+{
+	// Only use as many threads as there is work for
+	const UInt_t nUseful = std::max( nItems / std::max(minItemsPerThread,1U), 1U );
+	const UInt_t nRanges = std::max( std::min( nThreads, nUseful ), 1U );
+	if ( nRanges == 1 ) {
+		func( 0, 0, nItems );
+		return 1;
+	}
+
+	const UInt_t chunkSize = (nItems + nRanges - 1) / nRanges;
+
+	// The calling thread takes the first sub-range, the others are handed out
+	std::vector<std::thread> threads;
+	threads.reserve( nRanges-1 );
+	UInt_t nUsed(1);
+	for ( UInt_t iRange(1); iRange < nRanges; ++iRange ) {
+		const UInt_t first = iRange * chunkSize;
+		const UInt_t last = std::min( first + chunkSize, nItems );
+		if ( first >= last ) {
+			break;
+		}
+		threads.push_back( std::thread( func, iRange, first, last ) );
+		++nUsed;
+	}
+	func( 0, 0, std::min( chunkSize, nItems ) );
+
+	for ( std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter ) {
+		iter->join();
+	}
+
+	return nUsed;
+}
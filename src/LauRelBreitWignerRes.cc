@@ -224,7 +224,10 @@ LauComplex LauRelBreitWignerRes::resAmp(Double_t mass, Double_t spinTerm)
 	// Include Blatt-Weisskopf barrier factors
 	if (!this->ignoreBarrierScaling()) {
 		scale *= fFactorR * fFactorB;
-	} 
+		this->setBarrierScaling( fFactorR * fFactorB );
+	} else {
+		this->setBarrierScaling( 1.0 );
+	}
 
 	resAmplitude.rescale(scale);
 
@@ -28,9 +28,12 @@ Thomas Latham
 
 #include "LauResultsExtractor.hh"
 
+#include <algorithm>
+#include <cfloat>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <thread>
 #include <vector>
 #include <map>
 
@@ -39,8 +42,11 @@ Thomas Latham
 #include "TH1.h"
 #include "TLeaf.h"
 #include "TObjArray.h"
+#include "TROOT.h"
 #include "TSystem.h"
 
+#include "LauParallel.hh"
+
 ClassImp(LauResultsExtractor)
 
 
@@ -51,7 +57,8 @@ LauResultsExtractor::LauResultsExtractor(const TString& inputFileName, const TSt
 	inputTree_(0),
 	outputFile_(0),
 	outputTree_(0),
-	nEntries_(0)
+	nEntries_(0),
+	nThreads_(std::thread::hardware_concurrency())
 {
 }
 
@@ -171,10 +178,6 @@ void LauResultsExtractor::process(Int_t numExpts)
 	std::cout << "\n" << "... finished.\n" << std::endl;
 
 	nEntries_ = inputTree_->GetEntries();
-	this->setupInputTree();
-
-	outputTree_ = new TTree(treeName_,"");
-	this->setupOutputTree(outputTree_);
 
 	// setup the map:
 	// for each experiment there is a pair object holding
@@ -186,41 +189,19 @@ void LauResultsExtractor::process(Int_t numExpts)
 		bestNLL_.insert(std::make_pair(i, std::make_pair(0.0,-1)));
 		worstNLL_.insert(std::make_pair(i, std::make_pair(0.0,-1)));
 		allNLLs_.insert(std::make_pair(i, std::vector<Double_t>()));
-		allNLLs_[i].reserve(nEntries_);
 	}
 	std::cout<<" done.\n"<<std::endl;
 
-	// only read the 3 info branches
-	//this->setInputTreeBranchStatus(kFALSE);
-
-	// loop over the tree and store the best entries for each expt
+	// scan the files and store the best entries for each expt
 	std::cout<<"Starting to store best entry info..."<<std::endl;
-	for (Int_t j(0); j<nEntries_; ++j) {
-
-		if ((nEntries_<100) || (j%(nEntries_/100)==0)) {
-			std::cout<<"Examining entry "<<j<<std::endl;
-		}
-
-		inputTree_->GetEntry(j);
-
-		if ( (fitStatus_ == 3) && (NLL_ > -DBL_MAX/10.0) ) {
-			allNLLs_[iExpt_].push_back(NLL_);
-
-			Double_t curBestNLL = bestNLL_[iExpt_].first;
-			Int_t curBestEntry = bestNLL_[iExpt_].second;
-			if ((NLL_ < curBestNLL) || (curBestEntry == -1)) {
-				bestNLL_[iExpt_] = std::make_pair(NLL_,j);
-			}
+	this->scanInputFiles(numExpts);
+	std::cout<<"Finished storing best entry info.\n"<<std::endl;
 
-			Double_t curWorstNLL = worstNLL_[iExpt_].first;
-			Int_t curWorstEntry = worstNLL_[iExpt_].second;
-			if ((NLL_ > curWorstNLL) || (curWorstEntry == -1)) {
-				worstNLL_[iExpt_] = std::make_pair(NLL_,j);
-			}
-		}
+	// now need to read all branches, but only for the best entries
+	this->setupInputTree();
 
-	}
-	std::cout<<"Finished storing best entry info.\n"<<std::endl;
+	outputTree_ = new TTree(treeName_,"");
+	this->setupOutputTree(outputTree_);
 
 	std::cout<<"Creating NLL histograms..."<<std::flush;
 	TH1* histo(0);
@@ -246,9 +227,6 @@ void LauResultsExtractor::process(Int_t numExpts)
 	}
 	std::cout<<" done.\n"<<std::endl;
 
-	// now need to read all branches
-	//this->setInputTreeBranchStatus(kTRUE);
-
 	std::ofstream fout("best-fit.txt");
 
 	// loop over the experiments, grab the best entry and store it
@@ -279,6 +257,100 @@ void LauResultsExtractor::process(Int_t numExpts)
 	this->writeFile();
 }
 
+void LauResultsExtractor::scanInputFiles(const Int_t numExpts)
+{
+	// the files in the chain and the global entry number of the start of each one
+	TObjArray* fileElements = inputTree_->GetListOfFiles();
+	const Int_t nFiles = fileElements ? fileElements->GetEntries() : 0;
+	const Long64_t* treeOffsets = inputTree_->GetTreeOffset();
+
+	std::vector<TString> fileNames;
+	fileNames.reserve(nFiles);
+	for (Int_t iFile(0); iFile<nFiles; ++iFile) {
+		fileNames.push_back( fileElements->At(iFile)->GetTitle() );
+	}
+
+	// each thread keeps its own best/worst entries and NLL values for each experiment
+	const Int_t nThreads = std::max( std::min( static_cast<Int_t>(nThreads_), nFiles ), 1 );
+	std::vector< std::vector< std::pair<Double_t,Int_t> > > threadBest( nThreads, std::vector< std::pair<Double_t,Int_t> >( numExpts, std::make_pair(0.0,-1) ) );
+	std::vector< std::vector< std::pair<Double_t,Int_t> > > threadWorst( nThreads, std::vector< std::pair<Double_t,Int_t> >( numExpts, std::make_pair(0.0,-1) ) );
+	std::vector< std::vector< std::vector<Double_t> > > threadNLLs( nThreads, std::vector< std::vector<Double_t> >( numExpts ) );
+
+	auto scanFiles = [&]( const UInt_t iThread, const UInt_t firstFile, const UInt_t lastFile )
+	{
+		std::vector< std::pair<Double_t,Int_t> >& best = threadBest[iThread];
+		std::vector< std::pair<Double_t,Int_t> >& worst = threadWorst[iThread];
+		std::vector< std::vector<Double_t> >& allNLLs = threadNLLs[iThread];
+
+		for (UInt_t iFile(firstFile); iFile<lastFile; ++iFile) {
+
+			TFile* file = TFile::Open(fileNames[iFile], "read");
+			TTree* tree = (file && !file->IsZombie()) ? dynamic_cast<TTree*>(file->Get(treeName_)) : 0;
+			if (!tree) {
+				std::cerr<<"Problem reading tree \""<<treeName_<<"\" from file: \""<<fileNames[iFile]<<"\", skipping..."<<std::endl;
+				delete file;
+				continue;
+			}
+
+			// only read the 3 info branches
+			Int_t iExpt(0), fitStatus(0);
+			Double_t NLL(0.0);
+			tree->SetBranchStatus("*",kFALSE);
+			tree->SetBranchStatus("iExpt",kTRUE);
+			tree->SetBranchStatus("fitStatus",kTRUE);
+			tree->SetBranchStatus("NLL",kTRUE);
+			tree->SetBranchAddress("iExpt",&iExpt);
+			tree->SetBranchAddress("fitStatus",&fitStatus);
+			tree->SetBranchAddress("NLL",&NLL);
+
+			const Int_t offset = treeOffsets[iFile];
+			const Int_t nEntries = tree->GetEntries();
+			for (Int_t j(0); j<nEntries; ++j) {
+
+				tree->GetEntry(j);
+
+				if ( (iExpt < 0) || (iExpt >= numExpts) ) {
+					continue;
+				}
+
+				if ( (fitStatus == 3) && (NLL > -DBL_MAX/10.0) ) {
+					allNLLs[iExpt].push_back(NLL);
+
+					if ((NLL < best[iExpt].first) || (best[iExpt].second == -1)) {
+						best[iExpt] = std::make_pair(NLL,offset+j);
+					}
+					if ((NLL > worst[iExpt].first) || (worst[iExpt].second == -1)) {
+						worst[iExpt] = std::make_pair(NLL,offset+j);
+					}
+				}
+			}
+
+			delete file;
+		}
+	};
+
+	// distribute contiguous blocks of files between the threads
+	ROOT::EnableThreadSafety();
+
+	const UInt_t nRanges = LauParallel::forEachRange( nFiles, nThreads, 1, scanFiles );
+
+	// combine the results in file order, so that ties are resolved as for a serial scan
+	for (UInt_t iThread(0); iThread<nRanges; ++iThread) {
+		for (Int_t i(0); i<numExpts; ++i) {
+			const std::pair<Double_t,Int_t>& best = threadBest[iThread][i];
+			if ( (best.second != -1) && ((best.first < bestNLL_[i].first) || (bestNLL_[i].second == -1)) ) {
+				bestNLL_[i] = best;
+			}
+			const std::pair<Double_t,Int_t>& worst = threadWorst[iThread][i];
+			if ( (worst.second != -1) && ((worst.first > worstNLL_[i].first) || (worstNLL_[i].second == -1)) ) {
+				worstNLL_[i] = worst;
+			}
+			std::vector<Double_t>& allNLLs = allNLLs_[i];
+			allNLLs.insert( allNLLs.end(), threadNLLs[iThread][i].begin(), threadNLLs[iThread][i].end() );
+		}
+	}
+}
+
 void LauResultsExtractor::writeFile()
 {
 	if (!outputFile_) {
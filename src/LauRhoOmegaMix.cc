@@ -310,20 +310,26 @@ LauComplex LauRhoOmegaMix::amplitude(const LauKinematics* kinematics) {
     // Add the mixing correction denominator term if required
     if (useDenom_) {
 
-	// Here, we need to disable the rho barrier & spin factors, since they are
+	// Here, we need the rho amplitude without its barrier & spin factors, since they are
 	// only needed for the numerator term of the full amplitude. Note that we still
-	// need to use the momentum-dependent width (with its resonance barrier term)
-
-	// Disable barrier scaling factors for the amplitude (not width)
-	rhoRes_->ignoreBarrierScaling(kTRUE);
-	// Also ignore spin terms for now
-	rhoRes_->ignoreSpin(kTRUE);
+	// need to use the momentum-dependent width (with its resonance barrier term).
+	// So divide them out of the full rho amplitude, unless they vanish at this point.
+	LauComplex rhoAmp2(rhoAmp);
+	const Double_t numerFactor = rhoRes_->getSpinTerm() * rhoRes_->getBarrierScaling();
+	if ( numerFactor != 0.0 ) {
+	    rhoAmp2.rescale( 1.0/numerFactor );
+	} else {
+	    // Disable barrier scaling factors for the amplitude (not width)
+	    rhoRes_->ignoreBarrierScaling(kTRUE);
+	    // Also ignore spin terms for now
+	    rhoRes_->ignoreSpin(kTRUE);
 
-	const LauComplex rhoAmp2 = rhoRes_->amplitude(kinematics);
+	    rhoAmp2 = rhoRes_->amplitude(kinematics);
 
-	// Reinstate barrier scaling and spin term flags
-	rhoRes_->ignoreBarrierScaling(kFALSE);
-	rhoRes_->ignoreSpin(kFALSE);
+	    // Reinstate barrier scaling and spin term flags
+	    rhoRes_->ignoreBarrierScaling(kFALSE);
+	    rhoRes_->ignoreSpin(kFALSE);
+	}
 
 	// Denominator term
 	const LauComplex DeltaSq = LauComplex(Delta*Delta, 0.0);
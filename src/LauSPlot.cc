@@ -36,8 +36,11 @@ Thomas Latham
  *                                                                    *
  **********************************************************************/
 
+#include <algorithm>
 #include <cfloat>
+#include <future>
 #include <iostream>
+#include <thread>
 #include <vector>
 using std::cout;
 using std::cerr;
@@ -48,10 +51,12 @@ using std::endl;
 #include "TLeaf.h"
 #include "TMath.h"
 #include "TObjArray.h"
+#include "TROOT.h"
 #include "TSystem.h"
 #include "TTree.h"
 #include "TVirtualFitter.h"
 
+#include "LauParallel.hh"
 #include "LauSPlot.hh"
 
 extern void Yields(Int_t &, Double_t *, Double_t &f, Double_t *x, Int_t iflag);
@@ -95,7 +100,11 @@ LauSPlot::LauSPlot(const TString& fileName, const TString& treeName,
 	nDiscVars_(variableNames.size()),
 	nFreeSpecies_(freeSpecies.size()),
 	nFixdSpecies_(fixdSpecies.size()),
-	nSpecies_(freeSpecies.size()+fixdSpecies.size())
+	nSpecies_(freeSpecies.size()+fixdSpecies.size()),
+	scfFracLeaf_(0),
+	nPdfValues_(0),
+	nThreads_(std::thread::hardware_concurrency()),
+	chunkSize_(0)
 {
 	this->openInputFileAndTree();
 	this->readInputInfo();
@@ -153,6 +162,11 @@ void LauSPlot::readInputInfo()
 
 	inputOK = this->checkLeaves();
 	this->readInput(inputOK);
+
+	// Once we know the leaves are all there we can replace the names with indices
+	if (inputOK) {
+		this->indexInputLeaves();
+	}
 	return;
 }
 
@@ -368,6 +382,165 @@ Bool_t LauSPlot::checkLeaves() const
 	return kTRUE;
 }
 
+void LauSPlot::indexInputLeaves()
+{
+	// Assign an integer index to each species, variable and exclusion
+	// combination so that the per-event quantities can be stored in
+	// dense arrays rather than in maps keyed by name
+
+	// All species, in the order used for the fit parameters
+	NameSet allSpecies;
+	for (NumbMap::const_iterator free_iter = freeSpecies_.begin(); free_iter != freeSpecies_.end(); ++free_iter) {
+		allSpecies.insert( free_iter->first );
+	}
+	for (NumbMap::const_iterator fixd_iter = fixdSpecies_.begin(); fixd_iter != fixdSpecies_.end(); ++fixd_iter) {
+		allSpecies.insert( fixd_iter->first );
+	}
+	speciesNames_.assign( allSpecies.begin(), allSpecies.end() );
+
+	freeIndices_.clear();
+	for (NumbMap::const_iterator free_iter = freeSpecies_.begin(); free_iter != freeSpecies_.end(); ++free_iter) {
+		freeIndices_.push_back( std::find( speciesNames_.begin(), speciesNames_.end(), free_iter->first ) - speciesNames_.begin() );
+	}
+	fixdIndices_.clear();
+	for (NumbMap::const_iterator fixd_iter = fixdSpecies_.begin(); fixd_iter != fixdSpecies_.end(); ++fixd_iter) {
+		fixdIndices_.push_back( std::find( speciesNames_.begin(), speciesNames_.end(), fixd_iter->first ) - speciesNames_.begin() );
+	}
+
+	// The species for which we read PDF values - if the signal is
+	// split then we read sigTM and sigSCF in place of sig
+	pdfSpeciesNames_.clear();
+	for (std::vector<TString>::const_iterator spec_iter = speciesNames_.begin(); spec_iter != speciesNames_.end(); ++spec_iter) {
+		if ( (*spec_iter) == "sig" && this->signalSplit() ) {
+			pdfSpeciesNames_.push_back("sigTM");
+			pdfSpeciesNames_.push_back("sigSCF");
+		} else {
+			pdfSpeciesNames_.push_back( *spec_iter );
+		}
+	}
+
+	// The variables, followed by the combinations used in 2D PDFs
+	pdfVarNames_.assign( variableNames_.begin(), variableNames_.end() );
+	for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
+		const TString varName = twodim_iter->second.first + twodim_iter->second.second;
+		if ( std::find( pdfVarNames_.begin(), pdfVarNames_.end(), varName ) == pdfVarNames_.end() ) {
+			pdfVarNames_.push_back( varName );
+		}
+	}
+
+	nPdfValues_ = pdfSpeciesNames_.size() * pdfVarNames_.size();
+
+	// Find the leaf for each species/variable combination
+	pdfLeaves_.assign( nPdfValues_, 0 );
+	for (std::vector<TString>::const_iterator spec_iter = pdfSpeciesNames_.begin(); spec_iter != pdfSpeciesNames_.end(); ++spec_iter) {
+		for (std::vector<TString>::const_iterator var_iter = pdfVarNames_.begin(); var_iter != pdfVarNames_.end(); ++var_iter) {
+			TString expectedName(*spec_iter);
+			expectedName += (*var_iter);
+			expectedName += "Like";
+			LeafMap::const_iterator leaf_iter = leaves_.find(expectedName);
+			if ( leaf_iter != leaves_.end() ) {
+				pdfLeaves_[ this->pdfColumn( *spec_iter, *var_iter ) ] = leaf_iter->second;
+			}
+		}
+	}
+
+	scfFracLeaf_ = 0;
+	if ( this->signalSplit() ) {
+		LeafMap::const_iterator leaf_iter = leaves_.find("sigSCFFrac");
+		if ( leaf_iter != leaves_.end() ) {
+			scfFracLeaf_ = leaf_iter->second;
+		}
+	}
+
+	// The combinations of excluded variables, in the order used for the output branches
+	NameSet excludePdf;
+	if (variableNames_.size()<2) {
+		excludePdf.insert("none");
+	} else {
+		excludePdf = variableNames_;
+		excludePdf.insert("none");
+	}
+	excludeNames_.assign( excludePdf.begin(), excludePdf.end() );
+}
+
+Int_t LauSPlot::pdfColumn(const TString& specName, const TString& varName) const
+{
+	std::vector<TString>::const_iterator spec_iter = std::find( pdfSpeciesNames_.begin(), pdfSpeciesNames_.end(), specName );
+	std::vector<TString>::const_iterator var_iter = std::find( pdfVarNames_.begin(), pdfVarNames_.end(), varName );
+	if ( spec_iter == pdfSpeciesNames_.end() || var_iter == pdfVarNames_.end() ) {
+		return -1;
+	}
+	return (spec_iter - pdfSpeciesNames_.begin()) * pdfVarNames_.size() + (var_iter - pdfVarNames_.begin());
+}
+
+void LauSPlot::pdfColumns(const TString& specName, const TString& exclName, std::vector<Int_t>& columns) const
+{
+	columns.clear();
+
+	// loop through the 2D histo list
+	NameSet skipList;
+	for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
+		// if the entry doesn't refer to this
+		// species then skip on
+		if ( specName != twodim_iter->first ) {
+			continue;
+		}
+
+		// retrieve the two variable names
+		const TString& firstVarName = twodim_iter->second.first;
+		const TString& secondVarName = twodim_iter->second.second;
+		if ( firstVarName != exclName && secondVarName != exclName ) {
+			// if neither name is the one being excluded then...
+			// add them both to the skip list
+			skipList.insert( firstVarName );
+			skipList.insert( secondVarName );
+			// and include the combined PDF value
+			columns.push_back( this->pdfColumn( specName, firstVarName + secondVarName ) );
+		}
+	}
+
+	// loop through all the variables
+	for (NameSet::const_iterator var_iter = variableNames_.begin(); var_iter != variableNames_.end(); ++var_iter) {
+		const TString& varName = (*var_iter);
+		// if the variable isn't the one being excluded
+		// and it's not involved in a 2D PDF
+		if ( exclName != varName && skipList.find(varName) == skipList.end() ) {
+			// include its PDF value
+			columns.push_back( this->pdfColumn( specName, varName ) );
+		}
+	}
+}
+
+Int_t LauSPlot::exclIndex(const TString& exclName) const
+{
+	std::vector<TString>::const_iterator iter = std::find( excludeNames_.begin(), excludeNames_.end(), exclName );
+	if ( iter == excludeNames_.end() ) {
+		cerr<<"ERROR in LauSPlot::exclIndex : Unknown excluded variable \""<<exclName<<"\"."<<endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+	return iter - excludeNames_.begin();
+}
+
+std::vector<LauSPlot::NumbMap> LauSPlot::totalPdf() const
+{
+	// Unpack the dense storage into a map for each event
+	std::vector<NumbMap> pdfTot;
+	if ( nSpecies_ <= 0 ) {
+		return pdfTot;
+	}
+	const std::size_t nEvt = pdfTot_.size() / nSpecies_;
+	pdfTot.reserve( nEvt );
+	for (std::size_t iEvt(0); iEvt < nEvt; ++iEvt) {
+		const Double_t * evtPdf = pdfTot_.data() + iEvt * nSpecies_;
+		NumbMap evtMap;
+		for (Int_t i(0); i < nSpecies_; ++i) {
+			evtMap[ speciesNames_[i] ] = evtPdf[i];
+		}
+		pdfTot.push_back( evtMap );
+	}
+	return pdfTot;
+}
+
 void LauSPlot::createCNTree()
 {
 	// check whether we've already created the tree
@@ -440,7 +613,7 @@ void LauSPlot::defineSWeightBranches()
 		cerr<<"ERROR in LauSPlot::defineSWeightBranches : Already defined branches, not doing it again."<<endl;
 		return;
 	}
-	if (sWeights_.empty()) {
+	if (sWeights_.empty() && !this->useStreaming()) {
 		cerr<<"ERROR in LauSPlot::defineSWeightBranches : No entries in the sWeights container, can't define branches."<<endl;
 		return;
 	}
@@ -449,12 +622,13 @@ void LauSPlot::defineSWeightBranches()
 		return;
 	}
 
-	for (std::map<TString,NumbMap>::iterator excl_iter = sWeightsCurrent_.begin(); excl_iter != sWeightsCurrent_.end(); ++excl_iter) {
-		const TString& exclName = excl_iter->first;
-		NumbMap& species = excl_iter->second;
-		for (NumbMap::iterator spec_iter = species.begin(); spec_iter != species.end(); ++spec_iter) {
+	sWeightsCurrent_.resize( excludeNames_.size() * nFreeSpecies_ );
+
+	Double_t * pointer = sWeightsCurrent_.data();
+	for (std::vector<TString>::const_iterator excl_iter = excludeNames_.begin(); excl_iter != excludeNames_.end(); ++excl_iter) {
+		const TString& exclName = (*excl_iter);
+		for (NumbMap::const_iterator spec_iter = freeSpecies_.begin(); spec_iter != freeSpecies_.end(); ++spec_iter) {
 			const TString& specName = spec_iter->first;
-			Double_t * pointer = &(spec_iter->second);
 			TString name(specName); name += "_sWeight";
 			if (exclName == "none") {
 				name += "_all";
@@ -464,6 +638,7 @@ void LauSPlot::defineSWeightBranches()
 			}
 			TString thirdPart(name);  thirdPart += "/D";
 			sweightTree_->Branch(name, pointer, thirdPart);
+			++pointer;
 		}
 	}
 	this->definedSWeightBranches(kTRUE);
@@ -495,10 +670,19 @@ void LauSPlot::setExperiment(Int_t iExpt)
 	cout<<"                          Found "<<nEvents_<<" events."<<endl;
 
 	// make sure we have enough space in the per-event value vectors
-	pdfTot_.clear(); pdfTot_.resize(nEvents_);
-	discPdf_.clear(); discPdf_.resize(nEvents_);
-	scfFrac_.clear(); scfFrac_.resize(nEvents_);
-	sWeights_.clear(); sWeights_.resize(nEvents_);
+	exclFreeYields_.resize( excludeNames_.size() );
+	exclFixdYields_.resize( excludeNames_.size() );
+	exclCovMat_.resize( excludeNames_.size() );
+	pdfTot_.assign( static_cast<std::size_t>(nEvents_) * nSpecies_, 0.0 );
+
+	// in streaming mode the rest is read chunk by chunk later on
+	if ( this->useStreaming() ) {
+		return;
+	}
+
+	discPdf_.assign( static_cast<std::size_t>(nEvents_) * nPdfValues_, 0.0 );
+	scfFrac_.assign( nEvents_, 0.0 );
+	sWeights_.assign( static_cast<std::size_t>(nEvents_) * excludeNames_.size() * nFreeSpecies_, 0.0 );
 
 	// read the info for this experiment
 	this->readExpt();
@@ -506,11 +690,16 @@ void LauSPlot::setExperiment(Int_t iExpt)
 
 void LauSPlot::readExpt()
 {
-	for (Int_t iEvt(0); iEvt < nEvents_; ++iEvt) {
+	this->readEvents( 0, nEvents_, discPdf_.data(), scfFrac_.data() );
+}
+
+void LauSPlot::readEvents(const Int_t firstEvt, const Int_t nEvt, Double_t* pdfValues, Double_t* scfFracs)
+{
+	for (Int_t iEvt(0); iEvt < nEvt; ++iEvt) {
 		// Find which entry from the full tree contains the requested event
-		Long64_t iEntry = eventList_ ? eventList_->GetEntry(iEvt) : iEvt;
+		Long64_t iEntry = eventList_ ? eventList_->GetEntry(firstEvt+iEvt) : firstEvt+iEvt;
 		if (iEntry<0) { // this shouldn't happen, but just in case...
-			cerr<<"ERROR in LauSPlot::readExpt : Problem retrieving event."<<endl;
+			cerr<<"ERROR in LauSPlot::readEvents : Problem retrieving event."<<endl;
 			gSystem->Exit(EXIT_FAILURE);
 		}
 
@@ -518,120 +707,60 @@ void LauSPlot::readExpt()
 		inputTree_->GetEntry(iEntry);
 
 		// If needed retrieve the SCF fraction values
-		if ( this->signalSplit() ) {
-			for (LeafMap::const_iterator leaf_iter = leaves_.begin(); leaf_iter != leaves_.end(); ++leaf_iter) {
-				const TString& leafName = leaf_iter->first;
-				const TLeaf* leaf = leaf_iter->second;
-				if ((leafName == "sigSCFFrac") && (leaf != 0)) {
-					scfFrac_[iEvt] = leaf->GetValue();
-					break;
-				}
-			}
+		if ( scfFracLeaf_ != 0 ) {
+			scfFracs[iEvt] = scfFracLeaf_->GetValue();
 		}
 
-		// Copy the leaf values into discPdf_
-		for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
-			const TString& specName = twodim_iter->first;
-			const TString& firstVarName = twodim_iter->second.first;
-			const TString& secondVarName = twodim_iter->second.second;
-
-			TString varName = firstVarName + secondVarName;
-
-			TString expectedName(specName);
-			expectedName += varName;
-			expectedName += "Like";
-
-			for (LeafMap::const_iterator leaf_iter = leaves_.begin(); leaf_iter != leaves_.end(); ++leaf_iter) {
-				const TString& leafName = leaf_iter->first;
-				const TLeaf* leaf = leaf_iter->second;
-				if ((leafName == expectedName) && (leaf != 0)) {
-					discPdf_[iEvt][specName][varName] = leaf->GetValue();
-					break;
-				}
-			}
+		// Copy the leaf values into the PDF values
+		Double_t * evtPdf = pdfValues + static_cast<std::size_t>(iEvt) * nPdfValues_;
+		for (Int_t iPdf(0); iPdf < nPdfValues_; ++iPdf) {
+			const TLeaf* leaf = pdfLeaves_[iPdf];
+			evtPdf[iPdf] = ( leaf != 0 ) ? leaf->GetValue() : 0.0;
 		}
+	}
+}
 
-		Bool_t needSignalSearch(kFALSE);
-		for (NumbMap::const_iterator fixd_iter = fixdSpecies_.begin(); fixd_iter != fixdSpecies_.end(); ++fixd_iter) {
-			const TString& specName = fixd_iter->first;
-
-			// if the signal is split we need to do a dedicated search
-			// for sigTM and sigSCF, so skip the signal here
-			if ( specName == "sig" && this->signalSplit() ) {
-				needSignalSearch = kTRUE;
-				continue;
-			}
+void LauSPlot::streamEvents(const std::function<void(const Int_t, const Int_t, const Double_t*, const Double_t*)>& process,
+		const std::function<void(const Int_t, const Int_t)>& output)
+{
+	const Int_t nChunks = (nEvents_ + chunkSize_ - 1) / chunkSize_;
+
+	// Two sets of buffers: one is processed while the next chunk is read into the other
+	std::vector<Double_t> pdfBuffers[2];
+	std::vector<Double_t> scfBuffers[2];
+	for (UInt_t iBuf(0); iBuf < 2; ++iBuf) {
+		pdfBuffers[iBuf].resize( static_cast<std::size_t>(chunkSize_) * nPdfValues_ );
+		scfBuffers[iBuf].resize( chunkSize_ );
+	}
 
-			for (NameSet::const_iterator vars_iter = variableNames_.begin(); vars_iter != variableNames_.end(); ++vars_iter) {
-				const TString& varName = (*vars_iter);
-				TString expectedName(specName);
-				expectedName += varName;
-				expectedName += "Like";
-				for (LeafMap::const_iterator leaf_iter = leaves_.begin(); leaf_iter != leaves_.end(); ++leaf_iter) {
-					const TString& leafName = leaf_iter->first;
-					const TLeaf* leaf = leaf_iter->second;
-					if ((leafName == expectedName) && (leaf != 0)) {
-						discPdf_[iEvt][specName][varName] = leaf->GetValue();
-						break;
-					}
-				}
-			}
-		}
+	auto readChunk = [&]( const Int_t iChunk )
+	{
+		const Int_t firstEvt = iChunk * chunkSize_;
+		const Int_t nEvt = std::min( chunkSize_, nEvents_ - firstEvt );
+		this->readEvents( firstEvt, nEvt, pdfBuffers[iChunk%2].data(), scfBuffers[iChunk%2].data() );
+	};
 
-		for (NumbMap::const_iterator free_iter = freeSpecies_.begin(); free_iter != freeSpecies_.end(); ++free_iter) {
-			const TString& specName = free_iter->first;
+	std::future<void> reading = std::async( std::launch::async, readChunk, 0 );
 
-			// if the signal is split we need to do a dedicated search
-			// for sigTM and sigSCF, so skip the signal here
-			if ( specName == "sig" && this->signalSplit() ) {
-				needSignalSearch = kTRUE;
-				continue;
-			}
+	for (Int_t iChunk(0); iChunk < nChunks; ++iChunk) {
+		const Int_t firstEvt = iChunk * chunkSize_;
+		const Int_t nEvt = std::min( chunkSize_, nEvents_ - firstEvt );
 
-			for (NameSet::const_iterator vars_iter = variableNames_.begin(); vars_iter != variableNames_.end(); ++vars_iter) {
-				const TString& varName = (*vars_iter);
-				TString expectedName(specName);
-				expectedName += varName;
-				expectedName += "Like";
-				for (LeafMap::const_iterator leaf_iter = leaves_.begin(); leaf_iter != leaves_.end(); ++leaf_iter) {
-					const TString& leafName = leaf_iter->first;
-					const TLeaf* leaf = leaf_iter->second;
-					if ((leafName == expectedName) && (leaf != 0)) {
-						discPdf_[iEvt][specName][varName] = leaf->GetValue();
-						break;
-					}
-				}
-			}
+		// wait for this chunk to be available and then start on the next one
+		reading.get();
+		if ( iChunk+1 < nChunks ) {
+			reading = std::async( std::launch::async, readChunk, iChunk+1 );
 		}
 
-		if ( needSignalSearch ) {
-			for (NameSet::const_iterator vars_iter = variableNames_.begin(); vars_iter != variableNames_.end(); ++vars_iter) {
-				const TString& varName = (*vars_iter);
-				TString specName("sigTM");
-				TString expectedName(specName);
-				expectedName += varName;
-				expectedName += "Like";
-				for (LeafMap::const_iterator leaf_iter = leaves_.begin(); leaf_iter != leaves_.end(); ++leaf_iter) {
-					const TString& leafName = leaf_iter->first;
-					const TLeaf* leaf = leaf_iter->second;
-					if ((leafName == expectedName) && (leaf != 0)) {
-						discPdf_[iEvt][specName][varName] = leaf->GetValue();
-						break;
-					}
-				}
-				specName = "sigSCF";
-				expectedName = specName;
-				expectedName += varName;
-				expectedName += "Like";
-				for (LeafMap::const_iterator leaf_iter = leaves_.begin(); leaf_iter != leaves_.end(); ++leaf_iter) {
-					const TString& leafName = leaf_iter->first;
-					const TLeaf* leaf = leaf_iter->second;
-					if ((leafName == expectedName) && (leaf != 0)) {
-						discPdf_[iEvt][specName][varName] = leaf->GetValue();
-						break;
-					}
-				}
+		process( firstEvt, nEvt, pdfBuffers[iChunk%2].data(), scfBuffers[iChunk%2].data() );
+
+		// the input and output trees share the file, so anything written
+		// out has to wait until the read-ahead has finished
+		if ( output ) {
+			if ( reading.valid() ) {
+				reading.wait();
 			}
+			output( firstEvt, nEvt );
 		}
 	}
 }
@@ -661,6 +790,11 @@ void LauSPlot::runCalculations(const TString& option)
 	// Make sure that global fitter is MINUIT
 	this->checkFitter();
 
+	// In streaming mode the input tree is read from a separate thread
+	if ( this->useStreaming() ) {
+		ROOT::EnableThreadSafety();
+	}
+
 	// Loop over experiments
 	for (iExpt_ = firstExpt_; iExpt_ < (firstExpt_+nExpt_); ++iExpt_) {
 
@@ -672,22 +806,18 @@ void LauSPlot::runCalculations(const TString& option)
 		}
 
 		// Now loop over the PDFs to exclude, including the case where none are to be excluded.
-		NameSet excludePdf;
-		if (variableNames_.size()<2) {
-			excludePdf.insert("none");
-		} else {
-			excludePdf = variableNames_;
-			excludePdf.insert("none");
-		}
-
-		for (NameSet::const_iterator excl_iter = excludePdf.begin(); excl_iter != excludePdf.end(); ++excl_iter) {
+		for (std::vector<TString>::const_iterator excl_iter = excludeNames_.begin(); excl_iter != excludeNames_.end(); ++excl_iter) {
 
 			const TString& exclName = (*excl_iter);
 
 			cout<<"LauSPlot::runCalculations : Calculating sWeights, excluding PDF: "<<exclName<<"."<<endl;
 
 			// Calculate the per-event total PDF values for each species.
-			this->calcTotPDFValues(exclName);
+			if ( this->useStreaming() ) {
+				this->streamTotPDFValues(exclName);
+			} else {
+				this->calcTotPDFValues(exclName);
+			}
 
 			// Reset the fitter
 			this->initialiseFitter(opt);
@@ -728,7 +858,11 @@ void LauSPlot::runCalculations(const TString& option)
 		if (nFixdSpecies_ > 0) {
 			this->fillCNBranches();
 		}
-		this->fillSWeightBranches();
+		if ( this->useStreaming() ) {
+			this->streamSWeightBranches();
+		} else {
+			this->fillSWeightBranches();
+		}
 	}
 }
 
@@ -777,10 +911,9 @@ void LauSPlot::setFitParameters() const
 
 	// must add the parameters in the same order as they are stored in pdfTot_
 	Int_t ispecies(0);
-	const NumbMap& species = pdfTot_.front();
 
-	for (NumbMap::const_iterator spec_iter = species.begin(); spec_iter != species.end(); ++spec_iter) {
-		const TString& name(spec_iter->first);
+	for (std::vector<TString>::const_iterator spec_iter = speciesNames_.begin(); spec_iter != speciesNames_.end(); ++spec_iter) {
+		const TString& name(*spec_iter);
 
 		// starting parameters should be the original values,
 		// not those that came out of the last fit
@@ -853,10 +986,9 @@ void LauSPlot::retrieveFittedParameters(const TString& opt)
 
 	// remember fit parameters are in same order as in pdfTot_
 	Int_t ispecies(0);
-	const NumbMap& species = pdfTot_.front();
 
-	for (NumbMap::const_iterator spec_iter = species.begin(); spec_iter != species.end(); ++spec_iter) {
-		const TString& name(spec_iter->first);
+	for (std::vector<TString>::const_iterator spec_iter = speciesNames_.begin(); spec_iter != speciesNames_.end(); ++spec_iter) {
+		const TString& name(*spec_iter);
 		NumbMap::iterator free_iter = freeSpecies_.find(name);
 		if (free_iter != freeSpecies_.end()) {
 			free_iter->second = fitter->GetParameter(ispecies);
@@ -871,15 +1003,38 @@ void LauSPlot::retrieveFittedParameters(const TString& opt)
 
 void LauSPlot::printSumOfWeights(const TString& exclName) const
 {
-	for (NumbMap::const_iterator spec_iter = freeSpecies_.begin(); spec_iter != freeSpecies_.end(); ++spec_iter) {
-		const TString& specName = spec_iter->first;
-		Double_t sumweight(0.0);
+	const Int_t iExcl = this->exclIndex(exclName);
+	const std::size_t stride = excludeNames_.size() * nFreeSpecies_;
+
+	std::vector<Double_t> sumweights(nFreeSpecies_, 0.0);
+	if ( ! sWeights_.empty() ) {
 		for (Int_t iEvt(0); iEvt < nEvents_; ++iEvt) {
-			const NumbMap& specWeightMap = sWeights_[iEvt].find(exclName)->second;
-			Double_t weight = specWeightMap.find(specName)->second;
-			sumweight += weight;
+			const Double_t * weights = sWeights_.data() + iEvt*stride + iExcl*nFreeSpecies_;
+			for (Int_t species_n(0); species_n < nFreeSpecies_; ++species_n) {
+				sumweights[species_n] += weights[species_n];
+			}
+		}
+	} else {
+		// in streaming mode the sWeights are not stored, so
+		// calculate them from the total PDF values a chunk at a time
+		std::vector<Double_t> buffer( static_cast<std::size_t>(chunkSize_) * stride );
+		for (Int_t firstEvt(0); firstEvt < nEvents_; firstEvt += chunkSize_) {
+			const Int_t nEvt = std::min( chunkSize_, nEvents_ - firstEvt );
+			this->calcEventWeights( iExcl, nEvt, pdfTot_.data() + static_cast<std::size_t>(firstEvt) * nSpecies_, buffer.data() );
+			for (Int_t iEvt(0); iEvt < nEvt; ++iEvt) {
+				const Double_t * weights = buffer.data() + iEvt*stride + iExcl*nFreeSpecies_;
+				for (Int_t species_n(0); species_n < nFreeSpecies_; ++species_n) {
+					sumweights[species_n] += weights[species_n];
+				}
+			}
 		}
-		cout<<"Sum of sWeights for species \""<<specName<<"\" = "<<sumweight<<endl;
+	}
+
+	Int_t species_n(0);
+	for (NumbMap::const_iterator spec_iter = freeSpecies_.begin(); spec_iter != freeSpecies_.end(); ++spec_iter) {
+		const TString& specName = spec_iter->first;
+		cout<<"Sum of sWeights for species \""<<specName<<"\" = "<<sumweights[species_n]<<endl;
+		++species_n;
 	}
 	cout<<endl;
 }
@@ -890,39 +1045,65 @@ Bool_t LauSPlot::calcCovMatrix()
 
 	TMatrixD invMatrix(nFreeSpecies_,nFreeSpecies_);
 
-	// First calculate the denominator, which is common to all elements
-        std::vector<Double_t> denominator(nEvents_);
-	for (Int_t iEvt(0); iEvt<nEvents_; ++iEvt) {
-		denominator[iEvt] = 0.0;
-		for (NumbMap::const_iterator spec_iter = freeSpecies_.begin(); spec_iter != freeSpecies_.end(); ++spec_iter) {
-			const TString& specName = spec_iter->first;
-			Double_t specNumEvents = spec_iter->second;
-			denominator[iEvt] += specNumEvents * pdfTot_[iEvt][specName];
-		}
-		for (NumbMap::const_iterator spec_iter = fixdSpecies_.begin(); spec_iter != fixdSpecies_.end(); ++spec_iter) {
-			const TString& specName = spec_iter->first;
-			Double_t specNumEvents = spec_iter->second;
-			denominator[iEvt] += specNumEvents * pdfTot_[iEvt][specName];
+	// The yields, in the same order as the indices
+	std::vector<Double_t> freeYields; freeYields.reserve(nFreeSpecies_);
+	for (NumbMap::const_iterator spec_iter = freeSpecies_.begin(); spec_iter != freeSpecies_.end(); ++spec_iter) {
+		freeYields.push_back( spec_iter->second );
+	}
+	std::vector<Double_t> fixdYields; fixdYields.reserve(nFixdSpecies_);
+	for (NumbMap::const_iterator spec_iter = fixdSpecies_.begin(); spec_iter != fixdSpecies_.end(); ++spec_iter) {
+		fixdYields.push_back( spec_iter->second );
+	}
+
+	// The sums are accumulated separately for fixed-size blocks of
+	// events, which are then added in order, so that the result does
+	// not depend on how many threads are used
+	const Int_t blockSize(4096);
+	const Int_t nBlocks = (nEvents_ + blockSize - 1) / blockSize;
+	const Int_t nElements = nFreeSpecies_ * nFreeSpecies_;
+	std::vector<Double_t> blockSums( static_cast<std::size_t>(nBlocks) * nElements, 0.0 );
+
+	auto sumBlocks = [&]( const UInt_t /*iRange*/, const Int_t firstBlock, const Int_t lastBlock )
+	{
+		std::vector<Double_t> freePdf(nFreeSpecies_);
+		for (Int_t iBlock(firstBlock); iBlock < lastBlock; ++iBlock) {
+			Double_t * sums = blockSums.data() + static_cast<std::size_t>(iBlock) * nElements;
+			const Int_t lastEvt = std::min( (iBlock+1) * blockSize, nEvents_ );
+			for (Int_t iEvt(iBlock * blockSize); iEvt < lastEvt; ++iEvt) {
+				const Double_t * evtPdf = pdfTot_.data() + static_cast<std::size_t>(iEvt) * nSpecies_;
+
+				// First calculate the denominator, which is common to all elements
+				Double_t denominator(0.0);
+				for (Int_t i(0); i < nFreeSpecies_; ++i) {
+					freePdf[i] = evtPdf[ freeIndices_[i] ];
+					denominator += freeYields[i] * freePdf[i];
+				}
+				for (Int_t i(0); i < nFixdSpecies_; ++i) {
+					denominator += fixdYields[i] * evtPdf[ fixdIndices_[i] ];
+				}
+				// Square to get the final denominator
+				denominator *= denominator;
+
+				// Then the contribution to each element (the matrix is symmetric)
+				for (Int_t i(0); i < nFreeSpecies_; ++i) {
+					for (Int_t j(i); j < nFreeSpecies_; ++j) {
+						sums[i*nFreeSpecies_+j] += freePdf[i] * freePdf[j] / denominator;
+					}
+				}
+			}
 		}
-		// Square to get the final denominator
-		denominator[iEvt] *= denominator[iEvt];
-	}
-
-	// Then calculate each element
-	Int_t i(0);
-	for (NumbMap::const_iterator spec_iter_i = freeSpecies_.begin(); spec_iter_i != freeSpecies_.end(); ++spec_iter_i) {
-		const TString& specName_i = spec_iter_i->first;
-		Int_t j(0);
-		for (NumbMap::const_iterator spec_iter_j = freeSpecies_.begin(); spec_iter_j != freeSpecies_.end(); ++spec_iter_j) {
-			const TString& specName_j = spec_iter_j->first;
-			invMatrix(i,j) = 0.0;
-			for (Int_t iEvt(0); iEvt<nEvents_; ++iEvt) {
-				Double_t numerator = pdfTot_[iEvt][specName_i] * pdfTot_[iEvt][specName_j];
-				invMatrix(i,j) += numerator/denominator[iEvt];
+	};
+	LauParallel::forEachRange( nBlocks, nThreads_, 4, sumBlocks );
+
+	for (Int_t i(0); i < nFreeSpecies_; ++i) {
+		for (Int_t j(i); j < nFreeSpecies_; ++j) {
+			Double_t sum(0.0);
+			for (Int_t iBlock(0); iBlock < nBlocks; ++iBlock) {
+				sum += blockSums[ static_cast<std::size_t>(iBlock) * nElements + i*nFreeSpecies_ + j ];
 			}
-			++j;
+			invMatrix(i,j) = sum;
+			invMatrix(j,i) = sum;
 		}
-		++i;
 	}
 
 	// Check for a singular matrix
@@ -940,196 +1121,80 @@ Bool_t LauSPlot::calcCovMatrix()
 
 void LauSPlot::calcTotPDFValues(const TString& exclName)
 {
-	for (Int_t iEvt(0); iEvt<nEvents_; iEvt++) {
-
-		Bool_t needSignalSearch(kFALSE);
-
-		for (NumbMap::const_iterator spec_iter = fixdSpecies_.begin(); spec_iter != fixdSpecies_.end(); ++spec_iter) {
-			const TString& specName = spec_iter->first;
-
-			// if the signal is split we need to do a dedicated search
-			// for sigTM and sigSCF, so skip the signal here
-			if ( specName == "sig" && this->signalSplit() ) {
-				needSignalSearch = kTRUE;
-				continue;
-			}
+	this->calcTotPDFValues( exclName, nEvents_, discPdf_.data(), scfFrac_.data(), pdfTot_.data() );
+}
 
-			pdfTot_[iEvt][specName] = 1.0;
+void LauSPlot::streamTotPDFValues(const TString& exclName)
+{
+	auto process = [&]( const Int_t firstEvt, const Int_t nEvt, const Double_t* pdfValues, const Double_t* scfFracs )
+	{
+		this->calcTotPDFValues( exclName, nEvt, pdfValues, scfFracs, pdfTot_.data() + static_cast<std::size_t>(firstEvt) * nSpecies_ );
+	};
+	this->streamEvents( process );
+}
 
-			// loop through the 2D histo list
-			NameSet skipList;
-			for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
-				// if the entry doesn't refer to this
-				// species then skip on
-				if ( specName != twodim_iter->first ) {
-					continue;
-				}
+void LauSPlot::calcTotPDFValues(const TString& exclName, const Int_t nEvt, const Double_t* pdfValues, const Double_t* scfFracs, Double_t* totals) const
+{
+	// Work out once, for each species, which PDF values need to be
+	// multiplied together, then apply that to every event
+	std::vector< std::vector<Int_t> > columns(nSpecies_);
+	std::vector<Int_t> tmColumns, scfColumns;
+	Int_t sigIndex(-1);
 
-				// retrieve the two variable names
-				const TString& firstVarName = twodim_iter->second.first;
-				const TString& secondVarName = twodim_iter->second.second;
-				if ( firstVarName != exclName && secondVarName != exclName ) {
-					// if neither name is the one being excluded then...
-					// add them both to the skip list
-					skipList.insert( firstVarName );
-					skipList.insert( secondVarName );
-					// and multiply the total by the combined PDF value
-					TString varName = firstVarName + secondVarName;
-					pdfTot_[iEvt][specName] *= discPdf_[iEvt][specName][varName];
-				}
-			}
+	for (Int_t iSpec(0); iSpec < nSpecies_; ++iSpec) {
+		const TString& specName = speciesNames_[iSpec];
 
-			// loop through all the variables
-			for (NameSet::const_iterator var_iter = variableNames_.begin(); var_iter != variableNames_.end(); ++var_iter) {
-				const TString& varName = (*var_iter);
-				// if the variable isn't the one being excluded
-				if (exclName != varName) {
-					// and it's not involved in a 2D PDF
-					if ( skipList.find(varName) == skipList.end() ) {
-						// multiply the total by its PDF value
-						pdfTot_[iEvt][specName] *= discPdf_[iEvt][specName][varName];
-					}
-				}
-			}
+		// if the signal is split we need to treat
+		// sigTM and sigSCF separately
+		if ( specName == "sig" && this->signalSplit() ) {
+			sigIndex = iSpec;
+			this->pdfColumns( "sigTM", exclName, tmColumns );
+			this->pdfColumns( "sigSCF", exclName, scfColumns );
+			continue;
 		}
 
-		for (NumbMap::const_iterator spec_iter = freeSpecies_.begin(); spec_iter != freeSpecies_.end(); ++spec_iter) {
-			const TString& specName = spec_iter->first;
+		this->pdfColumns( specName, exclName, columns[iSpec] );
+	}
 
-			// if the signal is split we need to do a dedicated search
-			// for sigTM and sigSCF, so skip the signal here
-			if ( specName == "sig" && this->signalSplit() ) {
-				needSignalSearch = kTRUE;
-				continue;
-			}
+	const Bool_t applySCFFrac = ( exclName == "DP" || !this->scfDPSmear() );
 
-			pdfTot_[iEvt][specName] = 1.0;
+	auto calcTotals = [&]( const UInt_t /*iRange*/, const Int_t firstEvt, const Int_t lastEvt )
+	{
+		for (Int_t iEvt(firstEvt); iEvt < lastEvt; ++iEvt) {
+			const Double_t * evtPdf = pdfValues + static_cast<std::size_t>(iEvt) * nPdfValues_;
+			Double_t * evtTot = totals + static_cast<std::size_t>(iEvt) * nSpecies_;
 
-			// loop through the 2D histo list
-			NameSet skipList;
-			for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
-				// if the entry doesn't refer to this
-				// species then skip on
-				if ( specName != twodim_iter->first ) {
+			for (Int_t iSpec(0); iSpec < nSpecies_; ++iSpec) {
+				if ( iSpec == sigIndex ) {
 					continue;
 				}
-
-				// retrieve the two variable names
-				const TString& firstVarName = twodim_iter->second.first;
-				const TString& secondVarName = twodim_iter->second.second;
-				if ( firstVarName != exclName && secondVarName != exclName ) {
-					// if neither name is the one being excluded then...
-					// add them both to the skip list
-					skipList.insert( firstVarName );
-					skipList.insert( secondVarName );
-					// and multiply the total by the combined PDF value
-					TString varName = firstVarName + secondVarName;
-					pdfTot_[iEvt][specName] *= discPdf_[iEvt][specName][varName];
+				Double_t value(1.0);
+				for (std::vector<Int_t>::const_iterator col_iter = columns[iSpec].begin(); col_iter != columns[iSpec].end(); ++col_iter) {
+					value *= evtPdf[*col_iter];
 				}
+				evtTot[iSpec] = value;
 			}
 
-			// loop through all the variables
-			for (NameSet::const_iterator var_iter = variableNames_.begin(); var_iter != variableNames_.end(); ++var_iter) {
-				const TString& varName = (*var_iter);
-				// if the variable isn't the one being excluded
-				if (exclName != varName) {
-					// and it's not involved in a 2D PDF
-					if ( skipList.find(varName) == skipList.end() ) {
-						// multiply the total by its PDF value
-						pdfTot_[iEvt][specName] *= discPdf_[iEvt][specName][varName];
-					}
+			if ( sigIndex >= 0 ) {
+				Double_t tmPDFVal(1.0);
+				for (std::vector<Int_t>::const_iterator col_iter = tmColumns.begin(); col_iter != tmColumns.end(); ++col_iter) {
+					tmPDFVal *= evtPdf[*col_iter];
 				}
-			}
-		}
-
-		if ( needSignalSearch ) {
+				tmPDFVal *= (1.0 - scfFracs[iEvt]);
 
-			// loop through the 2D histo list
-			TString specName("sigTM");
-			Double_t tmPDFVal(1.0);
-			NameSet skipList;
-			for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
-				// if the entry doesn't refer to this
-				// species then skip on
-				if ( specName != twodim_iter->first ) {
-					continue;
+				Double_t scfPDFVal(1.0);
+				for (std::vector<Int_t>::const_iterator col_iter = scfColumns.begin(); col_iter != scfColumns.end(); ++col_iter) {
+					scfPDFVal *= evtPdf[*col_iter];
 				}
-
-				// retrieve the two variable names
-				const TString& firstVarName = twodim_iter->second.first;
-				const TString& secondVarName = twodim_iter->second.second;
-				if ( firstVarName != exclName && secondVarName != exclName ) {
-					// if neither name is the one being excluded then...
-					// add them both to the skip list
-					skipList.insert( firstVarName );
-					skipList.insert( secondVarName );
-					// and multiply the total by the combined PDF value
-					TString varName = firstVarName + secondVarName;
-					tmPDFVal *= discPdf_[iEvt][specName][varName];
+				if ( applySCFFrac ) {
+					scfPDFVal *= scfFracs[iEvt];
 				}
-			}
 
-			// loop through all the variables
-			for (NameSet::const_iterator var_iter = variableNames_.begin(); var_iter != variableNames_.end(); ++var_iter) {
-				const TString& varName = (*var_iter);
-				// if the variable isn't the one being excluded
-				if (exclName != varName) {
-					// and it's not involved in a 2D PDF
-					if ( skipList.find(varName) == skipList.end() ) {
-						// multiply the total by its PDF value
-						tmPDFVal *= discPdf_[iEvt][specName][varName];
-					}
-				}
-			}
-
-			tmPDFVal *= (1.0 - scfFrac_[iEvt]);
-
-
-			// loop through the 2D histo list
-			specName = "sigSCF";
-			Double_t scfPDFVal(1.0);
-			skipList.clear();
-			for ( TwoDMap::const_iterator twodim_iter = twodimPDFs_.begin(); twodim_iter != twodimPDFs_.end(); ++twodim_iter ) {
-				// if the entry doesn't refer to this
-				// species then skip on
-				if ( specName != twodim_iter->first ) {
-					continue;
-				}
-
-				// retrieve the two variable names
-				const TString& firstVarName = twodim_iter->second.first;
-				const TString& secondVarName = twodim_iter->second.second;
-				if ( firstVarName != exclName && secondVarName != exclName ) {
-					// if neither name is the one being excluded then...
-					// add them both to the skip list
-					skipList.insert( firstVarName );
-					skipList.insert( secondVarName );
-					// and multiply the total by the combined PDF value
-					TString varName = firstVarName + secondVarName;
-					scfPDFVal *= discPdf_[iEvt][specName][varName];
-				}
-			}
-
-			// loop through all the variables
-			for (NameSet::const_iterator var_iter = variableNames_.begin(); var_iter != variableNames_.end(); ++var_iter) {
-				const TString& varName = (*var_iter);
-				// if the variable isn't the one being excluded
-				if (exclName != varName) {
-					// and it's not involved in a 2D PDF
-					if ( skipList.find(varName) == skipList.end() ) {
-						// multiply the total by its PDF value
-						scfPDFVal *= discPdf_[iEvt][specName][varName];
-					}
-				}
-			}
-
-			if ( exclName == "DP" || !this->scfDPSmear() ) {
-				scfPDFVal *= scfFrac_[iEvt];
+				evtTot[sigIndex] = tmPDFVal + scfPDFVal;
 			}
-
-			pdfTot_[iEvt]["sig"] = tmPDFVal + scfPDFVal;
 		}
-	}
+	};
+	LauParallel::forEachRange( nEvt, nThreads_, 16384, calcTotals );
 }
 
 void LauSPlot::calcCNCoeffs(const TString& exclName, const Double_t *covmat)
@@ -1165,31 +1230,74 @@ void LauSPlot::calcSWeights(const TString& exclName, Double_t *covmat)
 	// while that in the numerator is only over the free species.
 	// Similarly the sWeights can only be calculated for the free species.
 
-	Double_t numerator(0.0), denominator(0.0);
-	for (Int_t iEvent = 0; iEvent < nEvents_; ++iEvent) {
-		denominator = 0.0;
-		for (NumbMap::const_iterator free_iter = freeSpecies_.begin(); free_iter != freeSpecies_.end(); ++free_iter) {
-			denominator += free_iter->second * pdfTot_[iEvent][free_iter->first];
-		}
-		for (NumbMap::const_iterator fixd_iter = fixdSpecies_.begin(); fixd_iter != fixdSpecies_.end(); ++fixd_iter) {
-			denominator += fixd_iter->second * pdfTot_[iEvent][fixd_iter->first];
+	const Int_t iExcl = this->exclIndex(exclName);
+
+	// Store the yields and the covariance matrix in flat arrays
+	std::vector<Double_t>& freeYields = exclFreeYields_[iExcl];
+	freeYields.clear();
+	for (NumbMap::const_iterator free_iter = freeSpecies_.begin(); free_iter != freeSpecies_.end(); ++free_iter) {
+		freeYields.push_back( free_iter->second );
+	}
+	std::vector<Double_t>& fixdYields = exclFixdYields_[iExcl];
+	fixdYields.clear();
+	for (NumbMap::const_iterator fixd_iter = fixdSpecies_.begin(); fixd_iter != fixdSpecies_.end(); ++fixd_iter) {
+		fixdYields.push_back( fixd_iter->second );
+	}
+	std::vector<Double_t>& cov = exclCovMat_[iExcl];
+	cov.resize( nFreeSpecies_ * nFreeSpecies_ );
+	for (Int_t species_n(0); species_n < nFreeSpecies_; ++species_n) {
+		for (Int_t species_j(0); species_j < nFreeSpecies_; ++species_j) {
+			if (covmat) {
+				cov[species_n*nFreeSpecies_+species_j] = covmat[species_n*nSpecies_+species_j];
+			} else {
+				cov[species_n*nFreeSpecies_+species_j] = covMat_(species_n,species_j);
+			}
 		}
-		Int_t species_n(0);
-		for (NumbMap::const_iterator iter_n = freeSpecies_.begin(); iter_n != freeSpecies_.end(); ++iter_n) {
-			numerator = 0.0;
-			Int_t species_j(0);
-			for (NumbMap::const_iterator iter_j = freeSpecies_.begin(); iter_j != freeSpecies_.end(); ++iter_j) {
-				if (covmat) {
-					numerator += covmat[species_n*nSpecies_+species_j] * pdfTot_[iEvent][iter_j->first];
-				} else {
-					numerator += covMat_(species_n,species_j) * pdfTot_[iEvent][iter_j->first];
+	}
+
+	// In streaming mode the weights are calculated as the branches are filled
+	if ( this->useStreaming() ) {
+		return;
+	}
+
+	this->calcEventWeights( iExcl, nEvents_, pdfTot_.data(), sWeights_.data() );
+}
+
+void LauSPlot::calcEventWeights(const Int_t iExcl, const Int_t nEvt, const Double_t* totals, Double_t* weights) const
+{
+	const std::size_t stride = excludeNames_.size() * nFreeSpecies_;
+
+	const std::vector<Double_t>& freeYields = exclFreeYields_[iExcl];
+	const std::vector<Double_t>& fixdYields = exclFixdYields_[iExcl];
+	const std::vector<Double_t>& cov = exclCovMat_[iExcl];
+
+	auto calcWeights = [&]( const UInt_t /*iRange*/, const Int_t firstEvt, const Int_t lastEvt )
+	{
+		std::vector<Double_t> freePdf(nFreeSpecies_);
+		for (Int_t iEvent(firstEvt); iEvent < lastEvt; ++iEvent) {
+			const Double_t * evtPdf = totals + static_cast<std::size_t>(iEvent) * nSpecies_;
+			Double_t * evtWeights = weights + iEvent * stride + iExcl * nFreeSpecies_;
+
+			Double_t denominator(0.0);
+			for (Int_t i(0); i < nFreeSpecies_; ++i) {
+				freePdf[i] = evtPdf[ freeIndices_[i] ];
+				denominator += freeYields[i] * freePdf[i];
+			}
+			for (Int_t i(0); i < nFixdSpecies_; ++i) {
+				denominator += fixdYields[i] * evtPdf[ fixdIndices_[i] ];
+			}
+
+			for (Int_t species_n(0); species_n < nFreeSpecies_; ++species_n) {
+				const Double_t * covRow = cov.data() + species_n*nFreeSpecies_;
+				Double_t numerator(0.0);
+				for (Int_t species_j(0); species_j < nFreeSpecies_; ++species_j) {
+					numerator += covRow[species_j] * freePdf[species_j];
 				}
-				++species_j;
+				evtWeights[species_n] = numerator/denominator;
 			}
-			sWeights_[iEvent][exclName][iter_n->first] = numerator/denominator;
-			++species_n;
 		}
-	}
+	};
+	LauParallel::forEachRange( nEvt, nThreads_, 16384, calcWeights );
 }
 
 void LauSPlot::fillCNBranches()
@@ -1212,7 +1320,6 @@ void LauSPlot::fillSWeightBranches()
 		cerr<<"ERROR in LauSPlot::fillSWeightBranches : No sWeights calculated, can't fill branches."<<endl;
 		return;
 	} else if (!this->definedSWeightBranches()) {
-		this->copyEventWeights(0);
 		this->defineSWeightBranches();
 	}
 
@@ -1222,16 +1329,48 @@ void LauSPlot::fillSWeightBranches()
 	}
 }
 
-void LauSPlot::copyEventWeights(Int_t iEvent)
+void LauSPlot::streamSWeightBranches()
 {
-	for (std::map<TString,NumbMap>::const_iterator excl_iter = sWeights_[iEvent].begin(); excl_iter != sWeights_[iEvent].end(); ++excl_iter) {
-		const TString& exclName = excl_iter->first;
-		const NumbMap& species = excl_iter->second;
-		for (NumbMap::const_iterator spec_iter = species.begin(); spec_iter != species.end(); ++spec_iter) {
-			const TString& specName = spec_iter->first;
-			sWeightsCurrent_[exclName][specName] = spec_iter->second;
-		}
+	if (!sweightTree_) {
+		cerr<<"ERROR in LauSPlot::streamSWeightBranches : Tree not created, cannot fill branches."<<endl;
+		return;
+	} else if (!this->definedSWeightBranches()) {
+		this->defineSWeightBranches();
 	}
+
+	const Int_t nExcl = excludeNames_.size();
+	const std::size_t stride = nExcl * nFreeSpecies_;
+
+	std::vector<Double_t> totals( static_cast<std::size_t>(chunkSize_) * nSpecies_ );
+	std::vector<Double_t> weights( static_cast<std::size_t>(chunkSize_) * stride );
+
+	// re-read the input, calculating the weights for every combination of excluded variables
+	auto process = [&]( const Int_t /*firstEvt*/, const Int_t nEvt, const Double_t* pdfValues, const Double_t* scfFracs )
+	{
+		for (Int_t iExcl(0); iExcl < nExcl; ++iExcl) {
+			this->calcTotPDFValues( excludeNames_[iExcl], nEvt, pdfValues, scfFracs, totals.data() );
+			this->calcEventWeights( iExcl, nEvt, totals.data(), weights.data() );
+		}
+	};
+
+	// and append them to the output tree
+	auto output = [&]( const Int_t /*firstEvt*/, const Int_t nEvt )
+	{
+		for (Int_t iEvent(0); iEvent < nEvt; ++iEvent) {
+			const Double_t * evtWeights = weights.data() + iEvent * stride;
+			std::copy( evtWeights, evtWeights + stride, sWeightsCurrent_.begin() );
+			sweightTree_->Fill();
+		}
+	};
+
+	this->streamEvents( process, output );
+}
+
+void LauSPlot::copyEventWeights(Int_t iEvent)
+{
+	const std::size_t stride = excludeNames_.size() * nFreeSpecies_;
+	const Double_t * weights = sWeights_.data() + iEvent * stride;
+	std::copy( weights, weights + stride, sWeightsCurrent_.begin() );
 }
 
 void LauSPlot::writeOutResults()
@@ -1273,18 +1412,18 @@ void Yields(Int_t &, Double_t *, Double_t &f, Double_t *x, Int_t /*iflag*/)
 
 	TVirtualFitter *fitter = TVirtualFitter::GetFitter();
 	LauSPlot* theModel = dynamic_cast<LauSPlot*>(fitter->GetObjectFit());
-	const std::vector<LauSPlot::NumbMap>& pdfTot = theModel->totalPdf();
+	const std::vector<Double_t>& pdfTot = theModel->totalPdfValues();
+	const std::size_t nSpecies = theModel->speciesNames().size();
 
 	Double_t ntot(0.0);
-	for (std::vector<LauSPlot::NumbMap>::const_iterator evt_iter = pdfTot.begin(); evt_iter != pdfTot.end(); ++evt_iter) {  // loop over events
-		const LauSPlot::NumbMap& species = (*evt_iter);
-		Int_t ispecies(0);
+	for (std::size_t ispecies(0); ispecies < nSpecies; ++ispecies) {
+		ntot += x[ispecies];
+	}
+
+	for (std::vector<Double_t>::const_iterator evt_iter = pdfTot.begin(); evt_iter != pdfTot.end(); evt_iter += nSpecies) {  // loop over events
 		Double_t lik(0.0);
-		ntot = 0.0;
-		for (LauSPlot::NumbMap::const_iterator spec_iter = species.begin(); spec_iter != species.end(); ++spec_iter) {  // loop over species
-			lik += x[ispecies] * spec_iter->second;
-			ntot += x[ispecies];
-			++ispecies;
+		for (std::size_t ispecies(0); ispecies < nSpecies; ++ispecies) {  // loop over species
+			lik += x[ispecies] * evt_iter[ispecies];
 		}
 		if (lik < 0.0) {
 			// make f the worst possible value to force MINUIT
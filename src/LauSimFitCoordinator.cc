@@ -27,9 +27,14 @@ Thomas Latham
 */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "TMath.h"
 #include "TMatrixD.h"
 #include "TMessage.h"
@@ -38,6 +43,7 @@ Thomas Latham
 #include "TObjString.h"
 #include "TServerSocket.h"
 #include "TSocket.h"
+#include "TROOT.h"
 #include "TSystem.h"
 
 #include "LauAbsFitter.hh"
@@ -47,6 +53,8 @@ Thomas Latham
 #include "LauParameter.hh"
 #include "LauParamFixed.hh"
 #include "LauSimFitCoordinator.hh"
+#include "LauSimFitProtocol.hh"
+#include "LauSimFitTask.hh"
 
 
 ClassImp(LauSimFitCoordinator)
@@ -57,6 +65,11 @@ LauSimFitCoordinator::LauSimFitCoordinator( UInt_t numTasks, UInt_t port ) :
 	reqPort_(port),
 	socketMonitor_(0),
 	messageFromTask_(0),
+	useSharedMemory_(kFALSE),
+	sharedMemoryInitialised_(kFALSE),
+	workGeneration_(0),
+	nWorkersDone_(0),
+	stopWorkers_(kFALSE),
 	fitNtuple_(0)
 {
 	messagesToTasks_.resize( nTasks_ );
@@ -69,10 +82,11 @@ LauSimFitCoordinator::~LauSimFitCoordinator()
 {
 	delete socketMonitor_; socketMonitor_ = 0;
 
+	// Stop the worker threads of any tasks running within this process
+	this->stopWorkers();
+
 	// Tell all tasks that they are finished and delete corresponding socket
-	TString msgStr("Finish");
-	TMessage message( kMESS_STRING );
-	message.WriteTString(msgStr);
+	TMessage message( LauSimFitProtocol::Finish );
 	for ( std::vector<TSocket*>::iterator iter = socketTasks_.begin(); iter != socketTasks_.end(); ++iter ) {
 		(*iter)->Send(message);
 		(*iter)->Close();
@@ -80,6 +94,15 @@ LauSimFitCoordinator::~LauSimFitCoordinator()
 	}
 	socketTasks_.clear();
 
+	// Release any shared memory segments
+	for ( UInt_t iTask(0); iTask < sharedSegments_.size(); ++iTask ) {
+		if ( sharedSegments_[iTask] != 0 ) {
+			munmap( sharedSegments_[iTask], sharedSegmentSizes_[iTask] );
+		}
+	}
+	sharedSegments_.clear();
+	sharedPar_.clear();
+
 	// Remove all fit parameters
 	for ( std::vector<LauParameter*>::iterator iter = params_.begin(); iter != params_.end(); ++iter ) {
 		delete *iter;
@@ -205,8 +228,8 @@ void LauSimFitCoordinator::getParametersFromTasksFirstTime()
 
 void LauSimFitCoordinator::getParametersFromTasks()
 {
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::getParametersFromTasks : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::getParametersFromTasks : Tasks not initialised." << std::endl;
 		return;
 	}
 
@@ -222,27 +245,9 @@ void LauSimFitCoordinator::getParametersFromTasks()
 
 void LauSimFitCoordinator::updateParametersFromTasks()
 {
-	TSocket* sActive(0);
-
-	// Construct a message, requesting the list of parameter names
-	TString msgStr = "Send Parameters";
-	TMessage message( kMESS_STRING );
-	message.WriteTString( msgStr );
-
 	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
-		// Send the message to the task
-		socketTasks_[iTask]->Send(message);
-
-		// Wait to receive the response and check that it has come from the task we just requested from
-		sActive = socketMonitor_->Select();
-		if ( sActive != socketTasks_[iTask] ) {
-			std::cerr << "ERROR in LauSimFitCoordinator::updateParametersFromTasks : Received message from a different task than expected!" << std::endl;
-			gSystem->Exit(1);
-		}
-
-		// Read the object and extract the parameter names
-		socketTasks_[iTask]->Recv( messageFromTask_ );
-		TObjArray * objarray = dynamic_cast<TObjArray*>( messageFromTask_->ReadObject( messageFromTask_->GetClass() ) );
+		// Request the parameters from the task
+		TObjArray * objarray = this->requestParameters( iTask );
 		if ( ! objarray ) {
 			std::cerr << "ERROR in LauSimFitCoordinator::updateParametersFromTasks : Error reading parameter names from task" << std::endl;
 			gSystem->Exit(1);
@@ -286,8 +291,10 @@ void LauSimFitCoordinator::updateParametersFromTasks()
 		}
 
 		delete objarray; objarray = 0;
-		delete messageFromTask_; messageFromTask_ = 0;
 	}
+
+	// The tasks have reset their parameters, so all values must be sent with the next evaluation
+	sendAllPars_.assign( nTasks_, kTRUE );
 }
 
 void LauSimFitCoordinator::getParametersFromTasksFirstTime()
@@ -296,28 +303,12 @@ void LauSimFitCoordinator::getParametersFromTasksFirstTime()
 	taskFreeIndices_.resize( nTasks_ );
 	vectorPar_.resize( nTasks_ );
 	vectorRes_.resize( nTasks_ );
-
-	TSocket* sActive(0);
-
-	// Construct a message, requesting the list of parameter names
-	TString msgStr = "Send Parameters";
-	TMessage message( kMESS_STRING );
-	message.WriteTString( msgStr );
+	lastSentPar_.resize( nTasks_ );
+	sendAllPars_.assign( nTasks_, kTRUE );
 
 	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
-		// Send the message to the task
-		socketTasks_[iTask]->Send(message);
-
-		// Wait to receive the response and check that it has come from the task we just requested from
-		sActive = socketMonitor_->Select();
-		if ( sActive != socketTasks_[iTask] ) {
-			std::cerr << "ERROR in LauSimFitCoordinator::getParametersFromTasksFirstTime : Received message from a different task than expected!" << std::endl;
-			gSystem->Exit(1);
-		}
-
-		// Read the object and extract the parameter names
-		socketTasks_[iTask]->Recv( messageFromTask_ );
-		TObjArray * objarray = dynamic_cast<TObjArray*>( messageFromTask_->ReadObject( messageFromTask_->GetClass() ) );
+		// Request the parameters from the task
+		TObjArray * objarray = this->requestParameters( iTask );
 		if ( ! objarray ) {
 			std::cerr << "ERROR in LauSimFitCoordinator::getParametersFromTasksFirstTime : Error reading parameters from task" << std::endl;
 			gSystem->Exit(1);
@@ -326,6 +317,7 @@ void LauSimFitCoordinator::getParametersFromTasksFirstTime()
 		const UInt_t nPars = objarray->GetEntries();
 
 		vectorPar_[iTask] = new Double_t[nPars];
+		lastSentPar_[iTask].assign( nPars, 0.0 );
 
 		for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
 			LauParameter* parameter = dynamic_cast<LauParameter*>( (*objarray)[iPar] );
@@ -361,7 +353,6 @@ void LauSimFitCoordinator::getParametersFromTasksFirstTime()
 		}
 
 		delete objarray; objarray = 0;
-		delete messageFromTask_; messageFromTask_ = 0;
 	}
 }
 
@@ -415,7 +406,167 @@ void LauSimFitCoordinator::checkParameter( const LauParameter* param, UInt_t ind
 
 void LauSimFitCoordinator::initialise()
 {
-	this->initSockets();
+	if ( localTasks_.empty() ) {
+		this->initSockets();
+	} else {
+		this->initLocalTasks();
+	}
+}
+
+void LauSimFitCoordinator::addLocalTask( LauSimFitTask* task, const TString& dataFileName, const TString& dataTreeName, const TString& histFileName, const TString& tableFileName )
+{
+	if ( task == 0 ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::addLocalTask : Supplied task pointer is null." << std::endl;
+		return;
+	}
+	if ( this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::addLocalTask : Tasks already initialised, cannot add another." << std::endl;
+		return;
+	}
+	if ( localTasks_.size() == nTasks_ ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::addLocalTask : Already have the expected number of tasks (" << nTasks_ << "), cannot add another." << std::endl;
+		return;
+	}
+
+	localTasks_.push_back( task );
+
+	LocalTaskFiles files;
+	files.dataFileName_ = dataFileName;
+	files.dataTreeName_ = dataTreeName;
+	files.histFileName_ = histFileName;
+	files.tableFileName_ = tableFileName;
+	localTaskFiles_.push_back( files );
+}
+
+void LauSimFitCoordinator::initLocalTasks()
+{
+	if ( ! workers_.empty() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::initLocalTasks : Tasks already initialised." << std::endl;
+		return;
+	}
+
+	if ( localTasks_.size() != nTasks_ ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::initLocalTasks : Expected " << nTasks_ << " tasks but only " << localTasks_.size() << " have been added." << std::endl;
+		gSystem->Exit(EXIT_FAILURE);
+	}
+
+	// Set up each of the tasks in turn
+	// (the model initialisation may use shared resources so is not done concurrently)
+	std::cout << "INFO in LauSimFitCoordinator::initLocalTasks : Initialising " << nTasks_ << " tasks within this process" << std::endl;
+	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+		LauSimFitTask* task = localTasks_[iTask];
+		const LocalTaskFiles& files = localTaskFiles_[iTask];
+
+		task->setTaskInfo( iTask, nTasks_, this->useAsymmFitErrors() );
+
+		Bool_t setupOK = task->setupTask( files.dataFileName_, files.dataTreeName_, files.histFileName_, files.tableFileName_ );
+		if ( ! setupOK ) {
+			std::cerr << "ERROR in LauSimFitCoordinator::initLocalTasks : Problem setting up task " << iTask << std::endl;
+			gSystem->Exit(EXIT_FAILURE);
+		}
+		std::cout << "                                     : Added task " << iTask << std::endl;
+	}
+
+	// Start one worker thread per task, in which its likelihood will be evaluated
+	ROOT::EnableThreadSafety();
+
+	stopWorkers_ = kFALSE;
+	workGeneration_ = 0;
+	workers_.reserve( nTasks_ );
+	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+		workers_.push_back( std::thread( &LauSimFitCoordinator::workerLoop, this, iTask ) );
+	}
+
+	std::cout << "                                     : Now start fit\n" << std::endl;
+}
+
+void LauSimFitCoordinator::stopWorkers()
+{
+	if ( workers_.empty() ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( workMutex_ );
+		stopWorkers_ = kTRUE;
+	}
+	workAvailable_.notify_all();
+
+	for ( std::vector<std::thread>::iterator iter = workers_.begin(); iter != workers_.end(); ++iter ) {
+		iter->join();
+	}
+	workers_.clear();
+}
+
+void LauSimFitCoordinator::workerLoop( const UInt_t iTask )
+{
+	ULong64_t lastGeneration(0);
+
+	while ( kTRUE ) {
+
+		// Wait until there is a new job to do (or we are told to stop)
+		std::unique_lock<std::mutex> lock( workMutex_ );
+		workAvailable_.wait( lock, [this,lastGeneration]{ return stopWorkers_ || workGeneration_ != lastGeneration; } );
+		if ( stopWorkers_ ) {
+			return;
+		}
+		lastGeneration = workGeneration_;
+		lock.unlock();
+
+		workerJob_( iTask );
+
+		// Report that we have finished
+		lock.lock();
+		++nWorkersDone_;
+		if ( nWorkersDone_ == nTasks_ ) {
+			workDone_.notify_one();
+		}
+	}
+}
+
+void LauSimFitCoordinator::runLocalTasks( const std::function<void(const UInt_t)>& job )
+{
+	std::unique_lock<std::mutex> lock( workMutex_ );
+	workerJob_ = job;
+	nWorkersDone_ = 0;
+	++workGeneration_;
+	workAvailable_.notify_all();
+
+	workDone_.wait( lock, [this]{ return nWorkersDone_ == nTasks_; } );
+}
+
+TObjArray* LauSimFitCoordinator::requestParameters( const UInt_t iTask )
+{
+	if ( ! localTasks_.empty() ) {
+		// Copy the parameters, as if they had been sent to us, so that the task retains ownership of its own
+		TObjArray taskPars;
+		localTasks_[iTask]->prepareInitialParArray( taskPars );
+
+		const Int_t nPars = taskPars.GetEntries();
+		TObjArray * objarray = new TObjArray( nPars );
+		for ( Int_t iPar(0); iPar < nPars; ++iPar ) {
+			objarray->Add( taskPars[iPar]->Clone() );
+		}
+		return objarray;
+	}
+
+	// Send a message to the task, requesting the list of parameters
+	TMessage message( LauSimFitProtocol::SendParameters );
+	socketTasks_[iTask]->Send(message);
+
+	// Wait to receive the response and check that it has come from the task we just requested from
+	TSocket* sActive = socketMonitor_->Select();
+	if ( sActive != socketTasks_[iTask] ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::requestParameters : Received message from a different task than expected!" << std::endl;
+		gSystem->Exit(1);
+	}
+
+	// Read the object containing the parameters
+	socketTasks_[iTask]->Recv( messageFromTask_ );
+	TObjArray * objarray = dynamic_cast<TObjArray*>( messageFromTask_->ReadObject( messageFromTask_->GetClass() ) );
+	delete messageFromTask_; messageFromTask_ = 0;
+
+	return objarray;
 }
 
 void LauSimFitCoordinator::runSimFit( const TString& fitNtupleFileName, const UInt_t nExp, const UInt_t firstExp, const Bool_t useAsymmErrors, const Bool_t doTwoStageFit )
@@ -495,16 +646,23 @@ void LauSimFitCoordinator::withinAsymErrorCalc(const Bool_t inAsymErrCalc)
 {
 	this->LauFitObject::withinAsymErrorCalc(inAsymErrCalc);
 
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::withinAsymErrorCalc : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::withinAsymErrorCalc : Tasks not initialised." << std::endl;
 		return;
 	}
 
 	// Construct a message, informing the tasks whether or not we are now within the asymmetric error calculation
-	TString msgStr("Asym Error Calc");
 	const Bool_t asymErrorCalc( this->withinAsymErrorCalc() );
-	TMessage message( kMESS_STRING );
-	message.WriteTString( msgStr );
+
+	// Tasks running within this process can be informed directly
+	if ( ! localTasks_.empty() ) {
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			localTasks_[iTask]->withinAsymErrorCalc( asymErrorCalc );
+		}
+		return;
+	}
+
+	TMessage message( LauSimFitProtocol::AsymErrorCalc );
 	message.WriteBool( asymErrorCalc );
 
 	// Send the message to the tasks
@@ -537,21 +695,21 @@ void LauSimFitCoordinator::withinAsymErrorCalc(const Bool_t inAsymErrCalc)
 
 Bool_t LauSimFitCoordinator::readData()
 {
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::readData : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::readData : Tasks not initialised." << std::endl;
 		return kFALSE;
 	}
 
 	// Construct a message, requesting to read the data for the given experiment
-	TString msgStr("Read Expt");
 	const UInt_t iExp( this->iExpt() );
-	TMessage message( kMESS_STRING );
-	message.WriteTString( msgStr );
+	TMessage message( LauSimFitProtocol::ReadExpt );
 	message.WriteUInt( iExp );
 
 	// Send the message to the tasks
-	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
-		socketTasks_[iTask]->Send(message);
+	if ( localTasks_.empty() ) {
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			socketTasks_[iTask]->Send(message);
+		}
 	}
 
 	TSocket* sActive(0);
@@ -559,15 +717,27 @@ Bool_t LauSimFitCoordinator::readData()
 	Bool_t ok(kTRUE);
 	while ( responsesReceived != nTasks_ ) {
 
-		// Get the next queued response
-		sActive = socketMonitor_->Select();
-
-		// Extract from the message the ID of the task and the number of events read
-		sActive->Recv( messageFromTask_ );
 		UInt_t iTask(0);
 		UInt_t nEvents(0);
-		messageFromTask_->ReadUInt( iTask );
-		messageFromTask_->ReadUInt( nEvents );
+
+		if ( ! localTasks_.empty() ) {
+
+			// Instruct the task directly
+			iTask = responsesReceived;
+			LauSimFitTask* task = localTasks_[iTask];
+			task->setCurrentExperiment( iExp );
+			nEvents = task->readExperimentData();
+
+		} else {
+
+			// Get the next queued response
+			sActive = socketMonitor_->Select();
+
+			// Extract from the message the ID of the task and the number of events read
+			sActive->Recv( messageFromTask_ );
+			messageFromTask_->ReadUInt( iTask );
+			messageFromTask_->ReadUInt( nEvents );
+		}
 
 		if ( nEvents <= 0 ) {
 			std::cerr << "ERROR in LauSimFitCoordinator::readData : Task " << iTask << " reports no events found for experiment " << iExp << std::endl;
@@ -584,19 +754,19 @@ Bool_t LauSimFitCoordinator::readData()
 
 Bool_t LauSimFitCoordinator::cacheInputData()
 {
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::cacheInputData : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::cacheInputData : Tasks not initialised." << std::endl;
 		return kFALSE;
 	}
 
 	// Construct a message, requesting it to read the data for the given experiment
-	TString msgStr("Cache");
-	TMessage message( kMESS_STRING );
-	message.WriteTString( msgStr );
+	TMessage message( LauSimFitProtocol::Cache );
 
-	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
-		// Send the message to the task
-		socketTasks_[iTask]->Send(message);
+	if ( localTasks_.empty() ) {
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			// Send the message to the task
+			socketTasks_[iTask]->Send(message);
+		}
 	}
 
 	TSocket* sActive(0);
@@ -604,15 +774,25 @@ Bool_t LauSimFitCoordinator::cacheInputData()
 	Bool_t allOK(kTRUE);
 	while ( responsesReceived != nTasks_ ) {
 
-		// Get the next queued response
-		sActive = socketMonitor_->Select();
-
-		// Extract from the message the ID of the task and the success/failure flag
-		sActive->Recv( messageFromTask_ );
 		UInt_t iTask(0);
 		Bool_t ok(kTRUE);
-		messageFromTask_->ReadUInt( iTask );
-		messageFromTask_->ReadBool( ok );
+
+		if ( ! localTasks_.empty() ) {
+
+			// Instruct the task directly
+			iTask = responsesReceived;
+			localTasks_[iTask]->cacheInputFitVars();
+
+		} else {
+
+			// Get the next queued response
+			sActive = socketMonitor_->Select();
+
+			// Extract from the message the ID of the task and the success/failure flag
+			sActive->Recv( messageFromTask_ );
+			messageFromTask_->ReadUInt( iTask );
+			messageFromTask_->ReadBool( ok );
+		}
 
 		if ( ! ok ) {
 			std::cerr << "ERROR in LauSimFitCoordinator::cacheInputData : Task " << iTask << " reports an error performing caching" << std::endl;
@@ -640,7 +820,11 @@ void LauSimFitCoordinator::fitExpt()
 
 	// Initialise the fitter
 	LauFitter::fitter().useAsymmFitErrors( this->useAsymmFitErrors() );
+	LauFitter::fitter().useBatchedGradient( this->useBatchedGradient() );
 	LauFitter::fitter().twoStageFit( this->twoStageFit() );
+
+	// The likelihood is gathered from the tasks over sockets, which cannot be shared with forked processes
+	LauFitter::fitter().minosProcesses( 1 );
 	LauFitter::fitter().initialise( this, params_ );
 
 	this->startNewFit( LauFitter::fitter().nParameters(), LauFitter::fitter().nFreeParameters() );
@@ -703,51 +887,66 @@ void LauSimFitCoordinator::setParsFromMinuit(Double_t* par, Int_t npar)
 
 Double_t LauSimFitCoordinator::getTotNegLogLikelihood()
 {
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::getTotNegLogLikelihood : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::getTotNegLogLikelihood : Tasks not initialised." << std::endl;
 		return 0.0;
 	}
 
-	// Send current values of the parameters to the tasks.
-	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+	if ( ! localTasks_.empty() ) {
+
+		// Tasks running within this process read the parameter values directly.
+		// Some parameters (e.g. resonance masses and widths) are shared between
+		// the tasks, so the values are set for all tasks before any evaluates.
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			const std::vector<UInt_t>& indices = taskIndices_[iTask];
+			const UInt_t nPars = indices.size();
+			const UInt_t nFreePars = taskFreeIndices_[iTask].size();
+			Double_t* values = vectorPar_[iTask];
+			for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+				values[iPar] = parValues_[ indices[iPar] ];
+			}
+			localTasks_[iTask]->setParsFromMinuit( values, nFreePars );
+		}
 
-		std::vector<UInt_t>& indices = taskIndices_[iTask];
-		std::vector<UInt_t>& freeIndices = taskFreeIndices_[iTask];
-		UInt_t nPars = indices.size();
-		UInt_t nFreePars = freeIndices.size();
-		for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
-			vectorPar_[iTask][iPar] = parValues_[ indices[iPar] ];
+		// Then the tasks evaluate concurrently
+		this->runLocalTasks( [this]( const UInt_t iTask ) {
+			vectorRes_[iTask] = localTasks_[iTask]->getTotNegLogLikelihood();
+		} );
+
+	} else {
+
+		// Set up the shared memory segments the first time through, if requested
+		if ( useSharedMemory_ && ! sharedMemoryInitialised_ ) {
+			this->initSharedMemory();
 		}
 
-		TMessage* message = messagesToTasks_[iTask];
-		message->Reset( kMESS_ANY );
-		message->WriteUInt( nPars );
-		message->WriteUInt( nFreePars );
-		message->WriteFastArray( vectorPar_[iTask], nPars );
+		// Send current values of the parameters to the tasks.
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			this->sendParameters( iTask );
+		}
 
-		socketTasks_[iTask]->Send(*message);
-	}
+		TSocket  *sActive(0);
+		UInt_t responsesReceived(0);
+		while ( responsesReceived != nTasks_ ) {
 
-	Double_t negLogLike(0.0);
-	TSocket  *sActive(0);
-	UInt_t responsesReceived(0);
-	Bool_t allOK(kTRUE);
-	while ( responsesReceived != nTasks_ ) {
+			sActive = socketMonitor_->Select();
+			sActive->Recv(messageFromTask_);	    
 
-		sActive = socketMonitor_->Select();
-		sActive->Recv(messageFromTask_);	    
+			messageFromTask_->ReadDouble( vectorRes_[responsesReceived] );
 
-		messageFromTask_->ReadDouble( vectorRes_[responsesReceived] );
+			++responsesReceived;
+		} 
+	}
 
-		Double_t& nLL = vectorRes_[responsesReceived];
+	Double_t negLogLike(0.0);
+	Bool_t allOK(kTRUE);
+	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+		const Double_t nLL = vectorRes_[iTask];
 		if ( nLL == 0.0 || TMath::IsNaN(nLL) || !TMath::Finite(nLL) ) {
 			allOK = kFALSE;
 		}
-
-		negLogLike += vectorRes_[responsesReceived];
-
-		++responsesReceived;
-	} 
+		negLogLike += nLL;
+	}
 
 	// Calculate any penalty terms from Gaussian constrained variables
 	const auto& multiDimCons = this->multiDimConstraints();
@@ -767,6 +966,246 @@ Double_t LauSimFitCoordinator::getTotNegLogLikelihood()
 	return negLogLike;
 }
 
+void LauSimFitCoordinator::getTotNegLogLikelihoods(const UInt_t nPoints, Double_t* pars, const Int_t npar, Double_t* negLogLikes)
+{
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::getTotNegLogLikelihoods : Tasks not initialised." << std::endl;
+		return;
+	}
+
+	const UInt_t nTotPars = this->nTotParams();
+
+	batchPar_.resize( nTasks_ );
+	batchRes_.resize( nTasks_ );
+	batchPenalty_.assign( nPoints, 0.0 );
+	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+		batchPar_[iTask].resize( nPoints * taskIndices_[iTask].size() );
+		batchRes_[iTask].assign( nPoints, 0.0 );
+	}
+
+	// Collect the values for each task and calculate the penalty terms for each point
+	const auto& multiDimCons = this->multiDimConstraints();
+	const Bool_t haveConstraints = ( ! conVars_.empty() || ! multiDimCons.empty() );
+	for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+		this->setParsFromMinuit( pars + iPoint*nTotPars, npar );
+		if ( haveConstraints ) {
+			batchPenalty_[iPoint] = this->getLogLikelihoodPenalty();
+		}
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			const std::vector<UInt_t>& indices = taskIndices_[iTask];
+			const UInt_t nPars = indices.size();
+			Double_t* values = batchPar_[iTask].data() + iPoint*nPars;
+			for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+				values[iPar] = parValues_[ indices[iPar] ];
+			}
+		}
+	}
+
+	if ( ! localTasks_.empty() ) {
+
+		// Tasks running within this process evaluate each point concurrently with one another,
+		// with the (possibly shared) parameter values set for all tasks before any evaluates
+		for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+			for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+				const UInt_t nPars = taskIndices_[iTask].size();
+				const UInt_t nFreePars = taskFreeIndices_[iTask].size();
+				localTasks_[iTask]->setParsFromMinuit( batchPar_[iTask].data() + iPoint*nPars, nFreePars );
+			}
+			this->runLocalTasks( [this,iPoint]( const UInt_t iTask ) {
+				batchRes_[iTask][iPoint] = localTasks_[iTask]->getTotNegLogLikelihood();
+			} );
+		}
+
+	} else {
+
+		// Send all the points to each task in a single message
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			const std::vector<Double_t>& values = batchPar_[iTask];
+
+			TMessage* message = messagesToTasks_[iTask];
+			message->Reset( LauSimFitProtocol::BatchParameters );
+			message->WriteUInt( taskFreeIndices_[iTask].size() );
+			message->WriteUInt( nPoints );
+			message->WriteBuf( &LauSimFitProtocol::byteOrderMark, sizeof(UInt_t) );
+			if ( ! values.empty() ) {
+				message->WriteBuf( values.data(), values.size()*sizeof(Double_t) );
+			}
+
+			socketTasks_[iTask]->Send(*message);
+		}
+
+		TSocket  *sActive(0);
+		UInt_t responsesReceived(0);
+		while ( responsesReceived != nTasks_ ) {
+
+			sActive = socketMonitor_->Select();
+			sActive->Recv(messageFromTask_);
+
+			UInt_t iTask(0);
+			UInt_t nResults(0);
+			messageFromTask_->ReadUInt( iTask );
+			messageFromTask_->ReadUInt( nResults );
+			if ( iTask >= nTasks_ || nResults != nPoints ) {
+				std::cerr << "ERROR in LauSimFitCoordinator::getTotNegLogLikelihoods : Unexpected response from task " << iTask << std::endl;
+				gSystem->Exit(EXIT_FAILURE);
+			}
+			messageFromTask_->ReadFastArray( batchRes_[iTask].data(), nPoints );
+
+			++responsesReceived;
+		}
+	}
+
+	// Combine the values from the tasks for each point
+	for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+		Double_t negLogLike(0.0);
+		Bool_t allOK(kTRUE);
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			const Double_t nLL = batchRes_[iTask][iPoint];
+			if ( nLL == 0.0 || TMath::IsNaN(nLL) || !TMath::Finite(nLL) ) {
+				allOK = kFALSE;
+			}
+			negLogLike += nLL;
+		}
+		negLogLike += batchPenalty_[iPoint];
+
+		const Double_t worstNegLogLike = -1.0*this->worstLogLike();
+		if ( ! allOK ) {
+			std::cerr << "WARNING in LauSimFitCoordinator::getTotNegLogLikelihoods : Strange NLL value returned by one or more tasks\n";
+			std::cerr << "                                                    : Returning worst NLL found so far to force MINUIT out of this region." << std::endl;
+			negLogLike = worstNegLogLike;
+		} else if ( negLogLike > worstNegLogLike ) {
+			this->worstLogLike( -negLogLike );
+		}
+
+		negLogLikes[iPoint] = negLogLike;
+	}
+}
+
+void LauSimFitCoordinator::sendParameters( const UInt_t iTask )
+{
+	const std::vector<UInt_t>& indices = taskIndices_[iTask];
+	const UInt_t nPars = indices.size();
+	const UInt_t nFreePars = taskFreeIndices_[iTask].size();
+
+	Double_t* values = vectorPar_[iTask];
+	for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+		values[iPar] = parValues_[ indices[iPar] ];
+	}
+
+	TMessage* message = messagesToTasks_[iTask];
+
+	if ( ! sharedPar_.empty() && sharedPar_[iTask] != 0 ) {
+		// The task reads the values directly from the shared memory
+		std::memcpy( sharedPar_[iTask], values, nPars*sizeof(Double_t) );
+
+		message->Reset( LauSimFitProtocol::SharedParameters );
+		message->WriteUInt( nFreePars );
+	} else {
+		// Only send those values that have changed since the last evaluation
+		std::vector<Double_t>& lastSent = lastSentPar_[iTask];
+		changedIndices_.clear();
+		changedValues_.clear();
+		for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+			if ( sendAllPars_[iTask] || values[iPar] != lastSent[iPar] ) {
+				changedIndices_.push_back( iPar );
+				changedValues_.push_back( values[iPar] );
+				lastSent[iPar] = values[iPar];
+			}
+		}
+		sendAllPars_[iTask] = kFALSE;
+
+		const UInt_t nChanged = changedIndices_.size();
+
+		message->Reset( LauSimFitProtocol::DeltaParameters );
+		message->WriteUInt( nFreePars );
+		message->WriteUInt( nChanged );
+		message->WriteBuf( &LauSimFitProtocol::byteOrderMark, sizeof(UInt_t) );
+		if ( nChanged > 0 ) {
+			message->WriteBuf( &changedIndices_[0], nChanged*sizeof(UInt_t) );
+			message->WriteBuf( &changedValues_[0], nChanged*sizeof(Double_t) );
+		}
+	}
+
+	socketTasks_[iTask]->Send(*message);
+}
+
+void LauSimFitCoordinator::initSharedMemory()
+{
+	sharedMemoryInitialised_ = kTRUE;
+
+	sharedPar_.assign( nTasks_, 0 );
+	sharedSegments_.assign( nTasks_, 0 );
+	sharedSegmentSizes_.assign( nTasks_, 0 );
+
+	const TString hostName( gSystem->HostName() );
+
+	TSocket* sActive(0);
+	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+
+		const UInt_t nPars = taskIndices_[iTask].size();
+		const ULong_t segmentSize = LauSimFitProtocol::sharedMemoryHeaderSize + nPars*sizeof(Double_t);
+
+		TString segmentName("/LauSimFit_");
+		segmentName += gSystem->GetPid();
+		segmentName += "_";
+		segmentName += iTask;
+
+		const Int_t fd = shm_open( segmentName.Data(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+		if ( fd < 0 ) {
+			std::cerr << "WARNING in LauSimFitCoordinator::initSharedMemory : Unable to create shared memory segment " << segmentName << ", task " << iTask << " will receive its parameters via messages" << std::endl;
+			continue;
+		}
+		void* segment(0);
+		if ( ftruncate( fd, segmentSize ) == 0 ) {
+			segment = mmap( 0, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		}
+		close( fd );
+		if ( segment == 0 || segment == MAP_FAILED ) {
+			std::cerr << "WARNING in LauSimFitCoordinator::initSharedMemory : Unable to map shared memory segment " << segmentName << ", task " << iTask << " will receive its parameters via messages" << std::endl;
+			shm_unlink( segmentName.Data() );
+			continue;
+		}
+
+		// Record the host name in the header so that the task can check it has attached to the correct segment
+		char* header = static_cast<char*>( segment );
+		std::memset( header, 0, LauSimFitProtocol::sharedMemoryHeaderSize );
+		std::strncpy( header, hostName.Data(), LauSimFitProtocol::sharedMemoryHeaderSize - 1 );
+
+		TMessage message( LauSimFitProtocol::AttachSharedMemory );
+		message.WriteTString( segmentName );
+		message.WriteTString( hostName );
+		message.WriteUInt( nPars );
+		socketTasks_[iTask]->Send(message);
+
+		// Wait to receive the response and check that it has come from the task we just requested from
+		sActive = socketMonitor_->Select();
+		if ( sActive != socketTasks_[iTask] ) {
+			std::cerr << "ERROR in LauSimFitCoordinator::initSharedMemory : Received message from a different task than expected!" << std::endl;
+			gSystem->Exit(EXIT_FAILURE);
+		}
+
+		UInt_t taskId(0);
+		Bool_t attached(kFALSE);
+		sActive->Recv( messageFromTask_ );
+		messageFromTask_->ReadUInt( taskId );
+		messageFromTask_->ReadBool( attached );
+		delete messageFromTask_; messageFromTask_ = 0;
+
+		// Both sides now hold a mapping (or never will), so the name can be removed
+		shm_unlink( segmentName.Data() );
+
+		if ( attached ) {
+			sharedSegments_[iTask] = segment;
+			sharedSegmentSizes_[iTask] = segmentSize;
+			sharedPar_[iTask] = reinterpret_cast<Double_t*>( header + LauSimFitProtocol::sharedMemoryHeaderSize );
+			std::cout << "INFO in LauSimFitCoordinator::initSharedMemory : Task " << iTask << " will receive its parameters via shared memory" << std::endl;
+		} else {
+			munmap( segment, segmentSize );
+			std::cout << "INFO in LauSimFitCoordinator::initSharedMemory : Task " << iTask << " could not attach to shared memory, it will receive its parameters via messages" << std::endl;
+		}
+	}
+}
+
 Double_t LauSimFitCoordinator::getLogLikelihoodPenalty()
 {
 	Double_t penalty{0.0};
@@ -849,8 +1288,8 @@ void LauSimFitCoordinator::addConParameters()
 
 Bool_t LauSimFitCoordinator::finalise()
 {
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::finalise : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::finalise : Tasks not initialised." << std::endl;
 		return kFALSE;
 	}
 
@@ -903,6 +1342,9 @@ Bool_t LauSimFitCoordinator::finalise()
 	// The array to hold the parameters
 	TObjArray array;
 
+	// The finalised parameters from any tasks running within this process
+	std::vector<TObjArray> localResults( localTasks_.size() );
+
 	// Send messages to all tasks containing the final parameters and fit status, NLL
 	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
 
@@ -919,6 +1361,19 @@ Bool_t LauSimFitCoordinator::finalise()
 		const Double_t EDM = this->edm();
 		TMatrixD& covMat = covMatrices_[iTask];
 
+		if ( ! localTasks_.empty() ) {
+			// Give the task its own copies of the parameters, as if they had been sent to it
+			TObjArray parsToTask( nPars );
+			parsToTask.SetOwner(kTRUE);
+			for ( UInt_t iPar(0); iPar < nPars; ++iPar ) {
+				parsToTask.Add( array[iPar]->Clone() );
+			}
+
+			LauAbsFitter::FitStatus fitStat { status, NLL, EDM };
+			localTasks_[iTask]->finaliseExperiment( fitStat, &parsToTask, &covMat, localResults[iTask] );
+			continue;
+		}
+
 		TMessage* message = messagesToTasks_[iTask];
 		message->Reset( kMESS_OBJECT );
 		message->WriteInt( status );
@@ -935,24 +1390,37 @@ Bool_t LauSimFitCoordinator::finalise()
 	Bool_t allOK(kTRUE);
 	while ( responsesReceived != nTasks_ ) {
 
-		// Get the next queued response
-		sActive = socketMonitor_->Select();
-
-		// Extract from the message the ID of the task and the number of events read
-		sActive->Recv( messageFromTask_ );
 		UInt_t iTask(0);
 		Bool_t ok(kTRUE);
-		messageFromTask_->ReadUInt( iTask );
-		messageFromTask_->ReadBool( ok );
+
+		if ( ! localTasks_.empty() ) {
+			iTask = responsesReceived;
+		} else {
+			// Get the next queued response
+			sActive = socketMonitor_->Select();
+
+			// Extract from the message the ID of the task and the number of events read
+			sActive->Recv( messageFromTask_ );
+			messageFromTask_->ReadUInt( iTask );
+			messageFromTask_->ReadBool( ok );
+		}
 
 		if ( ok ) {
-			TObjArray * objarray = dynamic_cast<TObjArray*>( messageFromTask_->ReadObject( messageFromTask_->GetClass() ) );
+			// The parameters from tasks within this process are their own, so we only read from them
+			TObjArray * objarray(0);
+			if ( ! localTasks_.empty() ) {
+				objarray = &localResults[iTask];
+			} else {
+				objarray = dynamic_cast<TObjArray*>( messageFromTask_->ReadObject( messageFromTask_->GetClass() ) );
+			}
 			if ( ! objarray ) {
 				std::cerr << "ERROR in LauSimFitCoordinator::finalise : Error reading finalised parameters from task" << std::endl;
 				allOK = kFALSE;
 			} else {
 				// We want to auto-delete the supplied parameters since we only copy their values in this case
-				objarray->SetOwner(kTRUE);
+				if ( localTasks_.empty() ) {
+					objarray->SetOwner(kTRUE);
+				}
 
 				const UInt_t nPars = objarray->GetEntries();
 				if ( nPars != taskIndices_[iTask].size() ) {
@@ -989,7 +1457,9 @@ Bool_t LauSimFitCoordinator::finalise()
 						vectorPar_[iTask][iPar] = parvalue;
 					}
 				}
-				delete objarray;
+				if ( localTasks_.empty() ) {
+					delete objarray;
+				}
 			}
 		} else {
 			std::cerr << "ERROR in LauSimFitCoordinator::finalise : Task " << iTask << " reports an error performing finalisation" << std::endl;
@@ -1017,15 +1487,21 @@ Bool_t LauSimFitCoordinator::finalise()
 
 Bool_t LauSimFitCoordinator::writeOutResults()
 {
-	if ( socketMonitor_ == 0 ) {
-		std::cerr << "ERROR in LauSimFitCoordinator::writeOutResults : Sockets not initialised." << std::endl;
+	if ( ! this->tasksInitialised() ) {
+		std::cerr << "ERROR in LauSimFitCoordinator::writeOutResults : Tasks not initialised." << std::endl;
 		return kFALSE;
 	}
 
 	// Construct a message, requesting to write out the fit results
-	TString msgStr("Write Results");
-	TMessage message( kMESS_STRING );
-	message.WriteTString( msgStr );
+	// Tasks running within this process can be instructed directly
+	if ( ! localTasks_.empty() ) {
+		for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
+			localTasks_[iTask]->writeOutAllFitResults();
+		}
+		return kTRUE;
+	}
+
+	TMessage message( LauSimFitProtocol::WriteResults );
 
 	// Send the message to the tasks
 	for ( UInt_t iTask(0); iTask<nTasks_; ++iTask ) {
@@ -27,16 +27,23 @@ Thomas Latham
 */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "TMatrixD.h"
 #include "TMessage.h"
 #include "TObjArray.h"
 #include "TObjString.h"
 #include "TSocket.h"
+#include "TString.h"
 #include "TSystem.h"
 
 #include "LauSimFitTask.hh"
+#include "LauSimFitProtocol.hh"
 #include "LauFitNtuple.hh"
 
 
@@ -49,6 +56,9 @@ LauSimFitTask::LauSimFitTask() :
 	taskId_(0),
 	nTasks_(0),
 	parValues_(0),
+	sharedSegment_(0),
+	sharedSegmentSize_(0),
+	sharedPar_(0),
 	fitNtuple_(0)
 {
 }
@@ -58,6 +68,9 @@ LauSimFitTask::~LauSimFitTask()
 	delete socketCoordinator_;
 	delete messageFromCoordinator_;
 	delete[] parValues_;
+	if ( sharedSegment_ != 0 ) {
+		munmap( sharedSegment_, sharedSegmentSize_ );
+	}
 	delete fitNtuple_;
 }
 
@@ -68,6 +81,21 @@ void LauSimFitTask::runTask(const TString& dataFileName, const TString& dataTree
 	// Establish the connection to the coordinator process
 	this->connectToCoordinator( addressCoordinator, portCoordinator );
 
+	// Initialise the fit model and verify the input data
+	Bool_t setupOK = this->setupTask( dataFileName, dataTreeName, histFileName, tableFileName );
+	if (!setupOK) {
+		return;
+	}
+
+	// Now process the various requests from the coordinator
+	this->processCoordinatorRequests();
+
+	std::cout << "INFO in LauSimFitTask::runTask : Fit task " << this->taskId() << " has finished successfully" << std::endl;
+}
+
+Bool_t LauSimFitTask::setupTask(const TString& dataFileName, const TString& dataTreeName,
+			       const TString& histFileName, const TString& tableFileName)
+{
 	// Initialise the fit model
 	this->initialise();
 
@@ -77,7 +105,7 @@ void LauSimFitTask::runTask(const TString& dataFileName, const TString& dataTree
 	// Print a warning if constraints on combinations of parameters have been specified
 	const auto& storeCon = this->formulaConstraints();
 	if ( ! storeCon.empty() ) {
-		std::cerr << "WARNING in LauSimFitTask::runTask : Constraints have been added but these will be ignored - they should have been added to the coordinator process" << std::endl;
+		std::cerr << "WARNING in LauSimFitTask::setupTask : Constraints have been added but these will be ignored - they should have been added to the coordinator process" << std::endl;
 	}
 
 	// Setup saving of fit results to ntuple/LaTeX table etc.
@@ -87,14 +115,18 @@ void LauSimFitTask::runTask(const TString& dataFileName, const TString& dataTree
 	// fit data tree that stores them for all events and experiments.
 	Bool_t dataOK = this->verifyFitData(dataFileName,dataTreeName);
 	if (!dataOK) {
-		std::cerr << "ERROR in LauSimFitTask::runTask : Problem caching the fit data." << std::endl;
-		return;
+		std::cerr << "ERROR in LauSimFitTask::setupTask : Problem caching the fit data." << std::endl;
+		return kFALSE;
 	}
 
-	// Now process the various requests from the coordinator
-	this->processCoordinatorRequests();
+	return kTRUE;
+}
 
-	std::cout << "INFO in LauSimFitTask::runTask : Fit task " << this->taskId() << " has finished successfully" << std::endl;
+void LauSimFitTask::setTaskInfo( const UInt_t taskId, const UInt_t nTasks, const Bool_t useAsymErrs )
+{
+	taskId_ = taskId;
+	nTasks_ = nTasks;
+	this->useAsymmFitErrors(useAsymErrs);
 }
 
 void LauSimFitTask::setupResultsOutputs( const TString& histFileName, const TString& /*tableFileName*/ )
@@ -102,7 +134,7 @@ void LauSimFitTask::setupResultsOutputs( const TString& histFileName, const TStr
 	// Create and setup the fit results ntuple
 	std::cout << "INFO in LauSimFitTask::setupResultsOutputs : Creating fit ntuple." << std::endl;
 	if (fitNtuple_ != 0) {delete fitNtuple_; fitNtuple_ = 0;}
-	fitNtuple_ = new LauFitNtuple(histFileName, this->useAsymmFitErrors());
+	fitNtuple_ = new LauFitNtuple(histFileName, this->useAsymmFitErrors(), this->appendFitResults());
 }
 
 void LauSimFitTask::connectToCoordinator( const TString& addressCoordinator, const UInt_t portCoordinator )
@@ -116,12 +148,13 @@ void LauSimFitTask::connectToCoordinator( const TString& addressCoordinator, con
 	socketCoordinator_ = new TSocket(addressCoordinator, portCoordinator);
 	socketCoordinator_->Recv( messageFromCoordinator_ );
 
-	messageFromCoordinator_->ReadUInt( taskId_ );
-	messageFromCoordinator_->ReadUInt( nTasks_ );
-
+	UInt_t taskId(0);
+	UInt_t nTasks(0);
 	Bool_t useAsymErrs(kFALSE);
+	messageFromCoordinator_->ReadUInt( taskId );
+	messageFromCoordinator_->ReadUInt( nTasks );
 	messageFromCoordinator_->ReadBool( useAsymErrs );
-	this->useAsymmFitErrors(useAsymErrs);
+	this->setTaskInfo( taskId, nTasks, useAsymErrs );
 
 	delete messageFromCoordinator_;
 	messageFromCoordinator_ = 0;
@@ -139,18 +172,82 @@ void LauSimFitTask::processCoordinatorRequests()
 
 	TMessage messageToCoordinator(kMESS_ANY);
 
-	while ( kTRUE ) {
+	Bool_t finished(kFALSE);
+	while ( ! finished ) {
 
 		socketCoordinator_->Recv( messageFromCoordinator_ );
 
-		if ( messageFromCoordinator_->What() == kMESS_STRING ) {
+		switch ( messageFromCoordinator_->What() ) {
+
+			case LauSimFitProtocol::DeltaParameters :
+			{
+				// Apply the changed parameter values and calculate the NLL
+				UInt_t nFreePars(0);
+				UInt_t nChanged(0);
+				messageFromCoordinator_->ReadUInt( nFreePars );
+				messageFromCoordinator_->ReadUInt( nChanged );
+
+				this->applyDeltaParameters( nChanged );
 
-			TString msgStr;
-			messageFromCoordinator_->ReadTString( msgStr );
+				this->setParsFromMinuit( parValues_, nFreePars );
 
-			std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: " << msgStr << std::endl;
+				Double_t negLogLike = this->getTotNegLogLikelihood();
 
-			if ( msgStr == "Send Parameters" ) {
+				messageToCoordinator.Reset( kMESS_ANY );
+				messageToCoordinator.WriteDouble( negLogLike );
+				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
+
+			case LauSimFitProtocol::SharedParameters :
+			{
+				// The parameter values are already in the shared memory, just calculate the NLL
+				UInt_t nFreePars(0);
+				messageFromCoordinator_->ReadUInt( nFreePars );
+
+				if ( sharedPar_ == 0 ) {
+					std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Parameters sent via shared memory but no segment is attached" << std::endl;
+					gSystem->Exit( EXIT_FAILURE );
+				}
+
+				this->setParsFromMinuit( sharedPar_, nFreePars );
+
+				Double_t negLogLike = this->getTotNegLogLikelihood();
+
+				messageToCoordinator.Reset( kMESS_ANY );
+				messageToCoordinator.WriteDouble( negLogLike );
+				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
+
+			case LauSimFitProtocol::BatchParameters :
+			{
+				// Calculate the NLL for each of several sets of parameter values
+				UInt_t nFreePars(0);
+				UInt_t nPoints(0);
+				messageFromCoordinator_->ReadUInt( nFreePars );
+				messageFromCoordinator_->ReadUInt( nPoints );
+
+				this->readBatchParameters( nPoints );
+
+				const UInt_t nPars = this->nTotParams();
+				batchRes_.resize( nPoints );
+				for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+					this->setParsFromMinuit( batchPar_.data() + iPoint*nPars, nFreePars );
+					batchRes_[iPoint] = this->getTotNegLogLikelihood();
+				}
+
+				messageToCoordinator.Reset( kMESS_ANY );
+				messageToCoordinator.WriteUInt( taskId_ );
+				messageToCoordinator.WriteUInt( nPoints );
+				messageToCoordinator.WriteFastArray( batchRes_.data(), nPoints );
+				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
+
+			case LauSimFitProtocol::SendParameters :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Send Parameters" << std::endl;
 
 				// Send the fit parameters
 
@@ -168,8 +265,12 @@ void LauSimFitTask::processCoordinatorRequests()
 				messageToCoordinator.Reset( kMESS_OBJECT );
 				messageToCoordinator.WriteObject( &array );
 				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
 
-			} else if ( msgStr == "Read Expt" ) {
+			case LauSimFitProtocol::ReadExpt :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Read Expt" << std::endl;
 
 				// Read the data for this experiment
 				UInt_t iExp(0);
@@ -186,8 +287,12 @@ void LauSimFitTask::processCoordinatorRequests()
 				messageToCoordinator.WriteUInt( taskId_ );
 				messageToCoordinator.WriteUInt( nEvents );
 				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
 
-			} else if ( msgStr == "Cache" ) {
+			case LauSimFitProtocol::Cache :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Cache" << std::endl;
 
 				// Perform the caching
 
@@ -197,8 +302,12 @@ void LauSimFitTask::processCoordinatorRequests()
 				messageToCoordinator.WriteUInt( taskId_ );
 				messageToCoordinator.WriteBool( kTRUE );
 				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
 
-			} else if ( msgStr == "Asym Error Calc" ) {
+			case LauSimFitProtocol::AsymErrorCalc :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Asym Error Calc" << std::endl;
 
 				Bool_t asymErrorCalc(kFALSE);
 				messageFromCoordinator_->ReadBool( asymErrorCalc );
@@ -208,8 +317,12 @@ void LauSimFitTask::processCoordinatorRequests()
 				messageToCoordinator.WriteUInt( taskId_ );
 				messageToCoordinator.WriteBool( asymErrorCalc );
 				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
 
-			} else if ( msgStr == "Write Results" ) {
+			case LauSimFitProtocol::WriteResults :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Write Results" << std::endl;
 
 				this->writeOutAllFitResults();
 
@@ -217,87 +330,207 @@ void LauSimFitTask::processCoordinatorRequests()
 				messageToCoordinator.WriteUInt( taskId_ );
 				messageToCoordinator.WriteBool( kTRUE );
 				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
 
-			} else if ( msgStr == "Finish" ) {
+			case LauSimFitProtocol::AttachSharedMemory :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Attach Shared Memory" << std::endl;
 
-				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Message from coordinator to finish" << std::endl;
-				break;
+				TString segmentName;
+				TString hostName;
+				UInt_t nPars(0);
+				messageFromCoordinator_->ReadTString( segmentName );
+				messageFromCoordinator_->ReadTString( hostName );
+				messageFromCoordinator_->ReadUInt( nPars );
 
-			} else {
+				const Bool_t attached = this->attachSharedMemory( segmentName, hostName, nPars );
 
-				std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Unexpected message from coordinator" << std::endl;
-				gSystem->Exit( EXIT_FAILURE );
+				messageToCoordinator.Reset( kMESS_ANY );
+				messageToCoordinator.WriteUInt( taskId_ );
+				messageToCoordinator.WriteBool( attached );
+				socketCoordinator_->Send( messageToCoordinator );
+				break;
+			}
 
+			case LauSimFitProtocol::Finish :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Message from coordinator to finish" << std::endl;
+				finished = kTRUE;
+				break;
 			}
 
-		} else if ( messageFromCoordinator_->What() == kMESS_OBJECT ) {
+			case kMESS_OBJECT :
+			{
+				std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Finalise" << std::endl;
+
+				Int_t status(0);
+				Double_t NLL(0.0);
+				Double_t EDM(0.0);
+				messageFromCoordinator_->ReadInt( status );
+				messageFromCoordinator_->ReadDouble( NLL );
+				messageFromCoordinator_->ReadDouble( EDM );
+
+				TObjArray * objarray = dynamic_cast<TObjArray*>( messageFromCoordinator_->ReadObject( messageFromCoordinator_->GetClass() ) );
+				if ( ! objarray ) {
+					std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Error reading parameters from coordinator" << std::endl;
+					gSystem->Exit( EXIT_FAILURE );
+				}
 
-			std::cout << "INFO in LauSimFitTask::processCoordinatorRequests : Received message from coordinator: Finalise" << std::endl;
+				TMatrixD * covMat = dynamic_cast<TMatrixD*>( messageFromCoordinator_->ReadObject( messageFromCoordinator_->GetClass() ) );
+				if ( ! covMat ) {
+					std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Error reading covariance matrix from coordinator" << std::endl;
+					gSystem->Exit( EXIT_FAILURE );
+				}
+
+				TObjArray array;
+				LauAbsFitter::FitStatus fitStat { status, NLL, EDM };
+				this->finaliseExperiment( fitStat, objarray, covMat, array );
 
-			Int_t status(0);
-			Double_t NLL(0.0);
-			Double_t EDM(0.0);
-			messageFromCoordinator_->ReadInt( status );
-			messageFromCoordinator_->ReadDouble( NLL );
-			messageFromCoordinator_->ReadDouble( EDM );
+				delete objarray; objarray = 0;
+				delete covMat; covMat = 0;
 
-			TObjArray * objarray = dynamic_cast<TObjArray*>( messageFromCoordinator_->ReadObject( messageFromCoordinator_->GetClass() ) );
-			if ( ! objarray ) {
-				std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Error reading parameters from coordinator" << std::endl;
-				gSystem->Exit( EXIT_FAILURE );
+				// Send the finalised parameters back to the coordinator
+				messageToCoordinator.Reset( kMESS_ANY );
+				messageToCoordinator.WriteUInt( taskId_ );
+				messageToCoordinator.WriteBool( kTRUE );
+				messageToCoordinator.WriteObject( &array );
+				socketCoordinator_->Send( messageToCoordinator );
+				break;
 			}
 
-			TMatrixD * covMat = dynamic_cast<TMatrixD*>( messageFromCoordinator_->ReadObject( messageFromCoordinator_->GetClass() ) );
-			if ( ! covMat ) {
-				std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Error reading covariance matrix from coordinator" << std::endl;
+			default :
+			{
+				std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Unexpected message type" << std::endl;
 				gSystem->Exit( EXIT_FAILURE );
 			}
+		}
 
-			TObjArray array;
-			LauAbsFitter::FitStatus fitStat { status, NLL, EDM };
-			this->finaliseExperiment( fitStat, objarray, covMat, array );
-
-			delete objarray; objarray = 0;
-			delete covMat; covMat = 0;
-
-			// Send the finalised parameters back to the coordinator
-			messageToCoordinator.Reset( kMESS_ANY );
-			messageToCoordinator.WriteUInt( taskId_ );
-			messageToCoordinator.WriteBool( kTRUE );
-			messageToCoordinator.WriteObject( &array );
-			socketCoordinator_->Send( messageToCoordinator );
+		delete messageFromCoordinator_;
+		messageFromCoordinator_ = 0;
+	}
+}
 
-		} else if ( messageFromCoordinator_->What() == kMESS_ANY ) {
+void LauSimFitTask::applyDeltaParameters( const UInt_t nChanged )
+{
+	// The raw data follow the current read position in the message buffer
+	// and are copied directly from there into the parameter values array
 
-			UInt_t nPars(0);
-			UInt_t nFreePars(0);
-			messageFromCoordinator_->ReadUInt( nPars );
-			messageFromCoordinator_->ReadUInt( nFreePars );
+	const UInt_t nPars = this->nTotParams();
 
-			if ( nPars != this->nTotParams() ) {
-				std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Unexpected number of parameters received from coordinator" << std::endl;
-				std::cerr << "                                               : Received " << nPars << " when expecting " << this->nTotParams() << std::endl;
-				gSystem->Exit( EXIT_FAILURE );
-			}
+	if ( parValues_ == 0 ) {
+		std::cerr << "ERROR in LauSimFitTask::applyDeltaParameters : Parameter values received before the parameters were sent to the coordinator" << std::endl;
+		gSystem->Exit( EXIT_FAILURE );
+	}
 
-			messageFromCoordinator_->ReadFastArray( parValues_, nPars );
+	const Int_t rawSize = sizeof(UInt_t) + nChanged * ( sizeof(UInt_t) + sizeof(Double_t) );
+	const Int_t offset = messageFromCoordinator_->Length();
+	if ( offset + rawSize > messageFromCoordinator_->BufferSize() ) {
+		std::cerr << "ERROR in LauSimFitTask::applyDeltaParameters : Message from coordinator is too short for " << nChanged << " parameter values" << std::endl;
+		gSystem->Exit( EXIT_FAILURE );
+	}
 
-			this->setParsFromMinuit( parValues_, nFreePars );
+	const char* raw = messageFromCoordinator_->Buffer() + offset;
 
-			Double_t negLogLike = this->getTotNegLogLikelihood();
+	UInt_t byteOrderMark(0);
+	std::memcpy( &byteOrderMark, raw, sizeof(UInt_t) );
+	if ( byteOrderMark != LauSimFitProtocol::byteOrderMark ) {
+		std::cerr << "ERROR in LauSimFitTask::applyDeltaParameters : Coordinator uses a different byte order to this task" << std::endl;
+		gSystem->Exit( EXIT_FAILURE );
+	}
+	raw += sizeof(UInt_t);
 
-			messageToCoordinator.Reset( kMESS_ANY );
-			messageToCoordinator.WriteDouble( negLogLike );   
-			socketCoordinator_->Send( messageToCoordinator );         
+	const char* rawValues = raw + nChanged * sizeof(UInt_t);
 
-		} else {
-			std::cerr << "ERROR in LauSimFitTask::processCoordinatorRequests : Unexpected message type" << std::endl;
+	for ( UInt_t i(0); i < nChanged; ++i ) {
+		UInt_t index(0);
+		std::memcpy( &index, raw + i*sizeof(UInt_t), sizeof(UInt_t) );
+		if ( index >= nPars ) {
+			std::cerr << "ERROR in LauSimFitTask::applyDeltaParameters : Parameter index " << index << " received from coordinator is out of range" << std::endl;
 			gSystem->Exit( EXIT_FAILURE );
 		}
+		std::memcpy( parValues_ + index, rawValues + i*sizeof(Double_t), sizeof(Double_t) );
+	}
+}
 
-		delete messageFromCoordinator_;
-		messageFromCoordinator_ = 0;
+void LauSimFitTask::readBatchParameters( const UInt_t nPoints )
+{
+	// The raw data follow the current read position in the message buffer
+
+	const UInt_t nValues = nPoints * this->nTotParams();
+
+	const Int_t rawSize = sizeof(UInt_t) + nValues * sizeof(Double_t);
+	const Int_t offset = messageFromCoordinator_->Length();
+	if ( offset + rawSize > messageFromCoordinator_->BufferSize() ) {
+		std::cerr << "ERROR in LauSimFitTask::readBatchParameters : Message from coordinator is too short for " << nPoints << " sets of parameter values" << std::endl;
+		gSystem->Exit( EXIT_FAILURE );
 	}
+
+	const char* raw = messageFromCoordinator_->Buffer() + offset;
+
+	UInt_t byteOrderMark(0);
+	std::memcpy( &byteOrderMark, raw, sizeof(UInt_t) );
+	if ( byteOrderMark != LauSimFitProtocol::byteOrderMark ) {
+		std::cerr << "ERROR in LauSimFitTask::readBatchParameters : Coordinator uses a different byte order to this task" << std::endl;
+		gSystem->Exit( EXIT_FAILURE );
+	}
+	raw += sizeof(UInt_t);
+
+	batchPar_.resize( nValues );
+	if ( nValues > 0 ) {
+		std::memcpy( batchPar_.data(), raw, nValues * sizeof(Double_t) );
+	}
+}
+
+Bool_t LauSimFitTask::attachSharedMemory( const TString& segmentName, const TString& hostName, const UInt_t nPars )
+{
+	// Release any previous segment
+	if ( sharedSegment_ != 0 ) {
+		munmap( sharedSegment_, sharedSegmentSize_ );
+		sharedSegment_ = 0;
+		sharedSegmentSize_ = 0;
+		sharedPar_ = 0;
+	}
+
+	// The segment can only be used if we are on the same host as the coordinator
+	if ( hostName != gSystem->HostName() ) {
+		std::cout << "INFO in LauSimFitTask::attachSharedMemory : Running on a different host to the coordinator, cannot use shared memory" << std::endl;
+		return kFALSE;
+	}
+
+	if ( nPars != this->nTotParams() ) {
+		std::cerr << "ERROR in LauSimFitTask::attachSharedMemory : Unexpected number of parameters received from coordinator" << std::endl;
+		std::cerr << "                                          : Received " << nPars << " when expecting " << this->nTotParams() << std::endl;
+		return kFALSE;
+	}
+
+	const Int_t fd = shm_open( segmentName.Data(), O_RDWR, 0 );
+	if ( fd < 0 ) {
+		std::cerr << "WARNING in LauSimFitTask::attachSharedMemory : Unable to open shared memory segment " << segmentName << std::endl;
+		return kFALSE;
+	}
+
+	const ULong_t segmentSize = LauSimFitProtocol::sharedMemoryHeaderSize + nPars*sizeof(Double_t);
+	void* segment = mmap( 0, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( segment == MAP_FAILED ) {
+		std::cerr << "WARNING in LauSimFitTask::attachSharedMemory : Unable to map shared memory segment " << segmentName << std::endl;
+		return kFALSE;
+	}
+
+	// Check that the segment really was created by the coordinator on this host
+	char* header = static_cast<char*>( segment );
+	if ( std::strncmp( header, hostName.Data(), LauSimFitProtocol::sharedMemoryHeaderSize - 1 ) != 0 ) {
+		std::cerr << "WARNING in LauSimFitTask::attachSharedMemory : Shared memory segment " << segmentName << " has an unexpected header" << std::endl;
+		munmap( segment, segmentSize );
+		return kFALSE;
+	}
+
+	sharedSegment_ = segment;
+	sharedSegmentSize_ = segmentSize;
+	sharedPar_ = reinterpret_cast<Double_t*>( header + LauSimFitProtocol::sharedMemoryHeaderSize );
+
+	return kTRUE;
 }
 
 void LauSimFitTask::writeOutAllFitResults()
@@ -26,6 +26,7 @@ Thomas Latham
   \brief File containing implementation of LauSimpleFitModel class.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -88,7 +89,13 @@ LauSimpleFitModel::LauSimpleFitModel(LauIsobarDynamics* sigModel) : LauAbsFitMod
 	sigExtraLike_(0.0),
 	scfExtraLike_(0.0),
 	sigTotalLike_(0.0),
-	scfTotalLike_(0.0)
+	scfTotalLike_(0.0),
+	genEvtNumHandle_(0),
+	genEvtWeightHandle_(0),
+	genEffHandle_(0),
+	genSigHandle_(0),
+	genTMSigHandle_(0),
+	genSCFSigHandle_(0)
 {
 }
 
@@ -99,6 +106,7 @@ LauSimpleFitModel::~LauSimpleFitModel()
 		delete (*iter);
 	}
 	delete scfFracHist_;
+	delete likeBinning_;
 }
 
 void LauSimpleFitModel::setupBkgndVectors()
@@ -200,6 +208,38 @@ void LauSimpleFitModel::splitSignalComponent( const Double_t scfFrac, const Bool
 	useSCFHist_ = kFALSE;
 }
 
+void LauSimpleFitModel::useBinnedLikelihood(const TH2* binning)
+{
+	if ( binning == 0 ) {
+		std::cerr << "ERROR in LauSimpleFitModel::useBinnedLikelihood : The binning histogram pointer is null." << std::endl;
+		return;
+	}
+
+	delete likeBinning_;
+	likeBinning_ = dynamic_cast<TH2*>( binning->Clone() );
+	likeBinning_->SetDirectory(0);
+}
+
+void LauSimpleFitModel::useBinnedLikelihood(const UInt_t nBinsX, const UInt_t nBinsY)
+{
+	if ( nBinsX == 0 || nBinsY == 0 ) {
+		std::cerr << "ERROR in LauSimpleFitModel::useBinnedLikelihood : The numbers of bins must be non-zero." << std::endl;
+		return;
+	}
+	if ( kinematics_ == 0 ) {
+		std::cerr << "ERROR in LauSimpleFitModel::useBinnedLikelihood : There is no signal DP model." << std::endl;
+		return;
+	}
+
+	delete likeBinning_;
+	if ( kinematics_->squareDP() ) {
+		likeBinning_ = new TH2D( "likeBinning", "", nBinsX, 0.0, 1.0, nBinsY, 0.0, 1.0 );
+	} else {
+		likeBinning_ = new TH2D( "likeBinning", "", nBinsX, kinematics_->getm13SqMin(), kinematics_->getm13SqMax(), nBinsY, kinematics_->getm23SqMin(), kinematics_->getm23SqMax() );
+	}
+	likeBinning_->SetDirectory(0);
+}
+
 void LauSimpleFitModel::setBkgndDPModel(const TString& bkgndClass, LauAbsBkgndDPModel* bkgndDPModel)
 {
 	if (bkgndDPModel == 0) {
@@ -413,13 +453,27 @@ void LauSimpleFitModel::initialiseDPModels()
 			(*iter)->initialise();
 		}
 	}
+
+	if ( likeBinning_ != 0 && ! sigDPModel_->usingBinnedLikelihood() ) {
+		// The binned likelihood only covers the signal DP PDF
+		if ( usingBkgnd_ || useSCF_ || ! signalPdfs_.empty() || this->doSFit() ) {
+			std::cerr << "ERROR in LauSimpleFitModel::initialiseDPModels : The binned likelihood can only be used for fits to signal in the DP alone." << std::endl;
+			std::cerr << "                                              : Using the unbinned likelihood." << std::endl;
+		} else {
+			sigDPModel_->setLikelihoodBinning( likeBinning_ );
+		}
+	}
 }
 
 void LauSimpleFitModel::recalculateNormalisation()
 {
 	//std::cout << "INFO in LauSimpleFitModel::recalculateNormalizationInDPModels : Recalc Norm in DP model" << std::endl;
 	sigDPModel_->recalculateNormalisation();
-	sigDPModel_->modifyDataTree();
+	// The binned likelihood only needs the bin integrals, which are
+	// updated along with the normalisation
+	if ( ! this->binnedLikelihood() ) {
+		sigDPModel_->modifyDataTree();
+	}
 }
 
 void LauSimpleFitModel::setSignalDPParameters()
@@ -681,6 +735,10 @@ void LauSimpleFitModel::finaliseFitResults(const TString& tablePrefixName)
 		meanEff_.value(sigDPModel_->getMeanEff().value());
 		dpRate_.value(sigDPModel_->getDPRate().value());
 
+		if ( this->binnedLikelihood() ) {
+			std::cout << "INFO in LauSimpleFitModel::finaliseFitResults : Estimated loss of log-likelihood due to the binning: " << sigDPModel_->calcBinningBias() << std::endl;
+		}
+
 		this->clearExtraVarVectors();
 		LauParameterList& extraVars = this->extraPars();
 
@@ -908,13 +966,13 @@ Bool_t LauSimpleFitModel::genExpt()
 	Bool_t genOK(kTRUE);
 	Int_t evtNum(0);
 
+	// Each experiment is generated from its own blocks of signal candidates
+	sigDPModel_->clearGenQueue();
+
 	const UInt_t nBkgnds = this->nBkgndClasses();
 	std::vector<TString> bkgndClassNames(nBkgnds);
-	std::vector<TString> bkgndClassNamesGen(nBkgnds);
 	for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
-		TString name( this->bkgndClassName(iBkgnd) );
-		bkgndClassNames[iBkgnd] = name;
-		bkgndClassNamesGen[iBkgnd] = "gen"+name;
+		bkgndClassNames[iBkgnd] = this->bkgndClassName(iBkgnd);
 	}
 
 	const Bool_t storeSCFTruthInfo = ( useSCF_ || ( this->enableEmbedding() && signalTree_ != 0 && signalTree_->haveBranch("mcMatch") ) );
@@ -928,22 +986,22 @@ Bool_t LauSimpleFitModel::genExpt()
 
 		for (Int_t iEvt(0); iEvt<nEvtsGen; ++iEvt) {
 
-			this->setGenNtupleDoubleBranchValue( "evtWeight", evtWeight );
+			this->setGenNtupleDoubleBranchValue( genEvtWeightHandle_, evtWeight );
 			// Add efficiency information
-			this->setGenNtupleDoubleBranchValue( "efficiency", 1 );
+			this->setGenNtupleDoubleBranchValue( genEffHandle_, 1 );
 
 			if (type == "signal") {
-				this->setGenNtupleIntegerBranchValue("genSig",1);
+				this->setGenNtupleIntegerBranchValue(genSigHandle_,1);
 				for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
-					this->setGenNtupleIntegerBranchValue( bkgndClassNamesGen[iBkgnd], 0 );
+					this->setGenNtupleIntegerBranchValue( genBkgndHandles_[iBkgnd], 0 );
 				}
 				genOK = this->generateSignalEvent();
-				this->setGenNtupleDoubleBranchValue( "efficiency", sigDPModel_->getEvtEff() );
+				this->setGenNtupleDoubleBranchValue( genEffHandle_, sigDPModel_->getEvtEff() );
 			} else {
-				this->setGenNtupleIntegerBranchValue("genSig",0);
+				this->setGenNtupleIntegerBranchValue(genSigHandle_,0);
 				if ( storeSCFTruthInfo ) {
-					this->setGenNtupleIntegerBranchValue("genTMSig",0);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 				}
 				UInt_t bkgndID(0);
 				for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
@@ -952,7 +1010,7 @@ Bool_t LauSimpleFitModel::genExpt()
 						gen = 1;
 						bkgndID = iBkgnd;
 					}
-					this->setGenNtupleIntegerBranchValue( bkgndClassNamesGen[iBkgnd], gen );
+					this->setGenNtupleIntegerBranchValue( genBkgndHandles_[iBkgnd], gen );
 				}
 				genOK = this->generateBkgndEvent(bkgndID);
 			}
@@ -968,7 +1026,7 @@ Bool_t LauSimpleFitModel::genExpt()
 			}
 
 			// Store the event number (within this experiment)
-			this->setGenNtupleIntegerBranchValue("iEvtWithinExpt",evtNum);
+			this->setGenNtupleIntegerBranchValue(genEvtNumHandle_,evtNum);
 			// and then increment it
 			++evtNum;
 
@@ -1050,12 +1108,12 @@ Bool_t LauSimpleFitModel::generateSignalEvent()
 			if (signalTree_->haveBranch("mcMatch")) {
 				Int_t match = static_cast<Int_t>(signalTree_->getValue("mcMatch"));
 				if (match) {
-					this->setGenNtupleIntegerBranchValue("genTMSig",1);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 					genSCF = kFALSE;
 				} else {
-					this->setGenNtupleIntegerBranchValue("genTMSig",0);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 					genSCF = kTRUE;
 				}
 			}
@@ -1069,12 +1127,12 @@ Bool_t LauSimpleFitModel::generateSignalEvent()
 					frac = scfFrac_.genValue();
 				}
 				if ( frac < LauRandom::randomFun()->Rndm() ) {
-					this->setGenNtupleIntegerBranchValue("genTMSig",1);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 					genSCF = kFALSE;
 				} else {
-					this->setGenNtupleIntegerBranchValue("genTMSig",0);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 					genSCF = kTRUE;
 
 					// Optionally smear the DP position
@@ -1117,24 +1175,24 @@ Bool_t LauSimpleFitModel::generateSignalEvent()
 			if (signalTree_->haveBranch("mcMatch")) {
 				Int_t match = static_cast<Int_t>(signalTree_->getValue("mcMatch"));
 				if (match) {
-					this->setGenNtupleIntegerBranchValue("genTMSig",1);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 					genSCF = kFALSE;
 				} else {
-					this->setGenNtupleIntegerBranchValue("genTMSig",0);
-					this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+					this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+					this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 					genSCF = kTRUE;
 				}
 			}
 		} else if ( useSCF_ ) {
 			Double_t frac = scfFrac_.genValue();
 			if ( frac < LauRandom::randomFun()->Rndm() ) {
-				this->setGenNtupleIntegerBranchValue("genTMSig",1);
-				this->setGenNtupleIntegerBranchValue("genSCFSig",0);
+				this->setGenNtupleIntegerBranchValue(genTMSigHandle_,1);
+				this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,0);
 				genSCF = kFALSE;
 			} else {
-				this->setGenNtupleIntegerBranchValue("genTMSig",0);
-				this->setGenNtupleIntegerBranchValue("genSCFSig",1);
+				this->setGenNtupleIntegerBranchValue(genTMSigHandle_,0);
+				this->setGenNtupleIntegerBranchValue(genSCFSigHandle_,1);
 				genSCF = kTRUE;
 			}
 		}
@@ -1142,12 +1200,12 @@ Bool_t LauSimpleFitModel::generateSignalEvent()
 	if (genOK) {
 		if ( useSCF_ ) {
 			if ( genSCF ) {
-				this->generateExtraPdfValues(&scfPdfs_, signalTree_);
+				genOK = this->generateExtraPdfValues(&scfPdfs_, signalTree_);
 			} else {
-				this->generateExtraPdfValues(&signalPdfs_, signalTree_);
+				genOK = this->generateExtraPdfValues(&signalPdfs_, signalTree_);
 			}
 		} else {
-			this->generateExtraPdfValues(&signalPdfs_, signalTree_);
+			genOK = this->generateExtraPdfValues(&signalPdfs_, signalTree_);
 		}
 	}
 	// Check for problems with the embedding
@@ -1185,7 +1243,7 @@ Bool_t LauSimpleFitModel::generateBkgndEvent(UInt_t bkgndID)
 		}
 	}
 	if (genOK) {
-		this->generateExtraPdfValues(extraPdfs, embeddedData);
+		genOK = this->generateExtraPdfValues(extraPdfs, embeddedData);
 	}
 	// Check for problems with the embedding
 	if (embeddedData && (embeddedData->nEvents() == embeddedData->nUsedEvents())) {
@@ -1234,28 +1292,59 @@ void LauSimpleFitModel::setupGenNtupleBranches()
 			}
 		}
 	}
+
+	// Now that all the branches exist, get the handles to those set for every event
+	genEvtNumHandle_ = this->genNtupleIntegerBranchHandle("iEvtWithinExpt");
+	genEvtWeightHandle_ = this->genNtupleDoubleBranchHandle("evtWeight");
+	genEffHandle_ = this->genNtupleDoubleBranchHandle("efficiency");
+	genSigHandle_ = this->genNtupleIntegerBranchHandle("genSig");
+	genTMSigHandle_ = 0;
+	genSCFSigHandle_ = 0;
+	if ( useSCF_ || ( this->enableEmbedding() && signalTree_ != 0 && signalTree_->haveBranch("mcMatch") ) ) {
+		genTMSigHandle_ = this->genNtupleIntegerBranchHandle("genTMSig");
+		genSCFSigHandle_ = this->genNtupleIntegerBranchHandle("genSCFSig");
+	}
+	genBkgndHandles_.resize( nBkgnds );
+	for ( UInt_t iBkgnd(0); iBkgnd < nBkgnds; ++iBkgnd ) {
+		TString name( this->bkgndClassName(iBkgnd) );
+		name.Prepend("gen");
+		genBkgndHandles_[iBkgnd] = this->genNtupleIntegerBranchHandle(name);
+	}
+	genDPHandles_.assign( 11, 0 );
+	if (this->useDP() == kTRUE) {
+		const char* dpNames[9] = { "m12", "m23", "m13", "m12Sq", "m23Sq", "m13Sq", "cosHel12", "cosHel23", "cosHel13" };
+		for ( UInt_t i(0); i < 9; ++i ) {
+			genDPHandles_[i] = this->genNtupleDoubleBranchHandle( dpNames[i] );
+		}
+		if ( kinematics_->squareDP() ) {
+			genDPHandles_[9] = this->genNtupleDoubleBranchHandle("mPrime");
+			genDPHandles_[10] = this->genNtupleDoubleBranchHandle("thPrime");
+		}
+	}
 }
 
 void LauSimpleFitModel::setDPBranchValues()
 {
 	// Store all the DP information
-	this->setGenNtupleDoubleBranchValue("m12", kinematics_->getm12());
-	this->setGenNtupleDoubleBranchValue("m23", kinematics_->getm23());
-	this->setGenNtupleDoubleBranchValue("m13", kinematics_->getm13());
-	this->setGenNtupleDoubleBranchValue("m12Sq", kinematics_->getm12Sq());
-	this->setGenNtupleDoubleBranchValue("m23Sq", kinematics_->getm23Sq());
-	this->setGenNtupleDoubleBranchValue("m13Sq", kinematics_->getm13Sq());
-	this->setGenNtupleDoubleBranchValue("cosHel12", kinematics_->getc12());
-	this->setGenNtupleDoubleBranchValue("cosHel23", kinematics_->getc23());
-	this->setGenNtupleDoubleBranchValue("cosHel13", kinematics_->getc13());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[0], kinematics_->getm12());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[1], kinematics_->getm23());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[2], kinematics_->getm13());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[3], kinematics_->getm12Sq());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[4], kinematics_->getm23Sq());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[5], kinematics_->getm13Sq());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[6], kinematics_->getc12());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[7], kinematics_->getc23());
+	this->setGenNtupleDoubleBranchValue(genDPHandles_[8], kinematics_->getc13());
 	if (kinematics_->squareDP()) {
-		this->setGenNtupleDoubleBranchValue("mPrime", kinematics_->getmPrime());
-		this->setGenNtupleDoubleBranchValue("thPrime", kinematics_->getThetaPrime());
+		this->setGenNtupleDoubleBranchValue(genDPHandles_[9], kinematics_->getmPrime());
+		this->setGenNtupleDoubleBranchValue(genDPHandles_[10], kinematics_->getThetaPrime());
 	}
 }
 
-void LauSimpleFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData)
+Bool_t LauSimpleFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbeddedData* embeddedData)
 {
+	Bool_t genOK(kTRUE);
+
 	// Generate from the extra PDFs
 	if (extraPdfs) {
 		for (LauPdfList::iterator pdf_iter = extraPdfs->begin(); pdf_iter != extraPdfs->end(); ++pdf_iter) {
@@ -1264,6 +1353,10 @@ void LauSimpleFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbedde
 				genValues = embeddedData->getValues( (*pdf_iter)->varNames() );
 			} else {
 				genValues = (*pdf_iter)->generate(kinematics_);
+				// If the tabulated envelope was exceeded the generation needs to be restarted
+				if ( ! (*pdf_iter)->checkGenTable() ) {
+					genOK = kFALSE;
+				}
 			}
 			for ( LauFitData::const_iterator var_iter = genValues.begin(); var_iter != genValues.end(); ++var_iter ) {
 				TString varName = var_iter->first;
@@ -1274,6 +1367,7 @@ void LauSimpleFitModel::generateExtraPdfValues(LauPdfList* extraPdfs, LauEmbedde
 			}
 		}
 	}
+	return genOK;
 }
 
 void LauSimpleFitModel::propagateParUpdates()
@@ -1332,7 +1426,12 @@ void LauSimpleFitModel::cacheInputFitVars()
 		if ( scfMap_ != 0 ) {
 			this->appendBinCentres( inputFitData );
 		}
-		sigDPModel_->fillDataTree(*inputFitData);
+		// The binned likelihood does not need the per-event amplitudes
+		if ( sigDPModel_->usingBinnedLikelihood() ) {
+			sigDPModel_->fillBinnedData(*inputFitData);
+		} else {
+			sigDPModel_->fillDataTree(*inputFitData);
+		}
 
 		if (usingBkgnd_ == kTRUE) {
 			for (LauBkgndDPModelList::iterator iter = bkgndDPModels_.begin(); iter != bkgndDPModels_.end(); ++iter) {
@@ -1456,6 +1555,35 @@ Double_t LauSimpleFitModel::getTotEvtLikelihood(UInt_t iEvt)
 	return likelihood;
 }
 
+Bool_t LauSimpleFitModel::binnedLikelihood() const
+{
+	return ( this->useDP() && sigDPModel_->usingBinnedLikelihood() );
+}
+
+Double_t LauSimpleFitModel::getBinnedLogLikelihood()
+{
+	const Double_t worstLL = this->worstLogLike();
+
+	Double_t dpLogLike(0.0);
+	const Double_t nSig = signalEvents_->unblindValue();
+	if ( ! sigDPModel_->calcBinnedLogLikelihood( dpLogLike ) || ! ( nSig > 0.0 ) ) {
+		std::cerr << "WARNING in LauSimpleFitModel::getBinnedLogLikelihood : Strange likelihood value for an occupied bin." << std::endl;
+		std::cerr << "                                                     : Returning worst NLL found so far to force MINUIT out of this region." << std::endl;
+		this->printVarsInfo();
+		return worstLL;
+	}
+
+	// Each event's likelihood is the signal yield multiplied by the DP likelihood,
+	// only those events in the bins contribute to the DP likelihood
+	const Double_t logLike = dpLogLike + sigDPModel_->getBinnedNEvents() * TMath::Log( nSig );
+
+	if ( logLike < worstLL ) {
+		this->worstLogLike( logLike );
+	}
+
+	return logLike;
+}
+
 Double_t LauSimpleFitModel::getEventSum() const
 {
 	Double_t eventSum(0.0);
@@ -1918,6 +2046,11 @@ void LauSimpleFitModel::storePerEvtLlhds()
 		sigDPModel_->fillDataTree(*inputFitData);
 	}
 
+	// nor will they have been cached if using the binned likelihood
+	if ( this->binnedLikelihood() ) {
+		sigDPModel_->fillDataTree(*inputFitData);
+	}
+
 	UInt_t evtsPerExpt(this->eventsPerExpt());
 
 	for (UInt_t iEvt = 0; iEvt < evtsPerExpt; ++iEvt) {
@@ -2077,6 +2210,100 @@ std::map<TString, Double_t> LauSimpleFitModel::getDPLikelihoods(const Double_t m
 	return likelihoods;
 }
 
+std::map< TString, std::vector<LauComplex> > LauSimpleFitModel::getDPAmps(const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq)
+{
+	// Initialise the DP model, if not already done
+	if ( coeffs_.empty() ) {
+		this->updateCoeffs();
+		this->initialiseDPModels();
+	}
+
+	std::map< TString, std::vector<LauComplex> > amps;
+
+	if ( m13Sq.size() != m23Sq.size() ) {
+		std::cerr << "ERROR in LauSimpleFitModel::getDPAmps : Different numbers of m13Sq and m23Sq values supplied." << std::endl;
+		return amps;
+	}
+
+	const UInt_t nPoints = m13Sq.size();
+	const UInt_t nAmp = sigDPModel_->getnCohAmp();
+
+	std::vector<Double_t> likelihoods( nPoints );
+	std::vector<LauComplex> resAmps( nPoints*nAmp );
+	std::vector<LauComplex>& totAmps = amps["signal"];
+	totAmps.resize( nPoints );
+
+	sigDPModel_->calcDPValues( nPoints, m13Sq.data(), m23Sq.data(), likelihoods.data(), totAmps.data(), resAmps.data() );
+
+	const LauIsobarDynamics* sigModel = sigDPModel_;
+	for ( UInt_t iAmp(0); iAmp < nAmp; ++iAmp ) {
+		std::vector<LauComplex>& compAmps = amps[ "signal_" + sigModel->getResonance(iAmp)->getResonanceName() ];
+		compAmps.resize( nPoints );
+		for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+			compAmps[iPoint] = resAmps[ iPoint*nAmp + iAmp ];
+		}
+	}
+
+	return amps;
+}
+
+std::map< TString, std::vector<Double_t> > LauSimpleFitModel::getDPLikelihoods(const std::vector<Double_t>& m13Sq, const std::vector<Double_t>& m23Sq)
+{
+	// Initialise the DP model, if not already done
+	if ( coeffs_.empty() ) {
+		this->updateCoeffs();
+		this->initialiseDPModels();
+	}
+
+	std::map< TString, std::vector<Double_t> > likelihoods;
+
+	if ( m13Sq.size() != m23Sq.size() ) {
+		std::cerr << "ERROR in LauSimpleFitModel::getDPLikelihoods : Different numbers of m13Sq and m23Sq values supplied." << std::endl;
+		return likelihoods;
+	}
+
+	const UInt_t nPoints = m13Sq.size();
+
+	// Create all the output arrays first, so that they can be filled concurrently
+	std::vector<LauWeightingTask> tasks;
+
+	std::vector<Double_t>& sigLikes = likelihoods["signal"];
+	sigLikes.resize( nPoints );
+	tasks.push_back( LauWeightingTask( kinematics_, [this, &m13Sq, &m23Sq, &sigLikes, nPoints]()
+	{
+		sigDPModel_->calcDPValues( nPoints, m13Sq.data(), m23Sq.data(), sigLikes.data() );
+	} ) );
+
+	// TODO - SCF signal
+	static bool warningIssued { false };
+	if ( useSCF_ && ! warningIssued ) {
+		warningIssued = true;
+		std::cerr << "WARNING in LauSimpleFitModel::getDPLikelihoods : calculation of SCF likelihoods not currently implemented in this function\n";
+		std::cerr << "                                               : signal likelihood will just be the truth-matched value";
+		std::cerr << std::endl;
+	}
+
+	if ( usingBkgnd_ ) {
+		const UInt_t nBkgnds { this->nBkgndClasses() };
+		for ( UInt_t bkgndID( 0 ); bkgndID < nBkgnds; ++bkgndID ) {
+			LauAbsBkgndDPModel* bkgndModel = bkgndDPModels_[bkgndID];
+			std::vector<Double_t>& bkgndLikes = likelihoods[ this->bkgndClassName( bkgndID ) ];
+			bkgndLikes.resize( nPoints );
+			tasks.push_back( LauWeightingTask( bkgndModel->getKinematics(), [bkgndModel, &m13Sq, &m23Sq, &bkgndLikes, nPoints]()
+			{
+				const LauKinematics* kinematics = bkgndModel->getKinematics();
+				for ( UInt_t iPoint(0); iPoint < nPoints; ++iPoint ) {
+					bkgndLikes[iPoint] = kinematics->withinDPLimits( m13Sq[iPoint], m23Sq[iPoint] ) ? bkgndModel->getLikelihood( m13Sq[iPoint], m23Sq[iPoint] ) : 0.0;
+				}
+			} ) );
+		}
+	}
+
+	this->runWeightingTasks( tasks );
+
+	return likelihoods;
+}
+
 void LauSimpleFitModel::embedSignal(const TString& fileName, const TString& treeName,
 		Bool_t reuseEventsWithinEnsemble, Bool_t reuseEventsWithinExperiment,
 		Bool_t useReweighting)
@@ -2170,6 +2397,8 @@ void LauSimpleFitModel::weightEvents( const TString& dataFileName, const TString
 	const Ssiz_t index { weightsFileName.Last( '.' ) };
 	weightsFileName.Insert( index, "_DPweights" );
 
+	const UInt_t nVariants { static_cast<UInt_t>( weightVariantModels_.size() ) };
+
 	LauGenNtuple weightsTuple{ weightsFileName, dataTreeName };
 	weightsTuple.addIntegerBranch( "iExpt" );
 	weightsTuple.addIntegerBranch( "iEvtWithinExpt" );
@@ -2177,6 +2406,32 @@ void LauSimpleFitModel::weightEvents( const TString& dataFileName, const TString
 	if ( squareDP ) {
 		weightsTuple.addDoubleBranch( "sqDPJacobian" );
 	}
+	for ( UInt_t iVariant{0}; iVariant < nVariants; ++iVariant ) {
+		weightsTuple.addDoubleBranch( "dpModelWeight_" + weightVariantNames_[iVariant] );
+	}
+
+	const LauGenNtuple::IntegerBranchHandle exptHandle { weightsTuple.integerBranchHandle( "iExpt" ) };
+	const LauGenNtuple::IntegerBranchHandle evtHandle { weightsTuple.integerBranchHandle( "iEvtWithinExpt" ) };
+	const LauGenNtuple::DoubleBranchHandle weightHandle { weightsTuple.doubleBranchHandle( "dpModelWeight" ) };
+	const LauGenNtuple::DoubleBranchHandle jacobianHandle { squareDP ? weightsTuple.doubleBranchHandle( "sqDPJacobian" ) : nullptr };
+	std::vector<LauGenNtuple::DoubleBranchHandle> variantHandles( nVariants );
+	for ( UInt_t iVariant{0}; iVariant < nVariants; ++iVariant ) {
+		variantHandles[iVariant] = weightsTuple.doubleBranchHandle( "dpModelWeight_" + weightVariantNames_[iVariant] );
+	}
+
+	// Write out each chunk in the background while the next one is weighted
+	const UInt_t chunkSize { this->weightingChunkSize() };
+	weightsTuple.asyncFill( chunkSize );
+
+	// The nominal model is weighted first, followed by the variants
+	std::vector<LauIsobarDynamics*> models { sigDPModel_ };
+	models.insert( models.end(), weightVariantModels_.begin(), weightVariantModels_.end() );
+	const UInt_t nModels { static_cast<UInt_t>( models.size() ) };
+
+	const std::vector<TString> columnNames { "m13Sq_MC", "m23Sq_MC" };
+	std::vector< std::vector<Double_t> > columns;
+	std::vector< std::vector<Double_t> > weights( nModels );
+	std::vector<Double_t> jacobians;
 
 	const UInt_t nExpmt { this->nExpt() };
 	const UInt_t firstExpmt { this->firstExpt() };
@@ -2190,38 +2445,42 @@ void LauSimpleFitModel::weightEvents( const TString& dataFileName, const TString
 			continue;
 		}
 
-		weightsTuple.setIntegerBranchValue( "iExpt", iExpmt );
-
-		// Calculate and store the weights for the events in this experiment
-		for ( UInt_t iEvent{0}; iEvent < nEvents; ++iEvent ) {
+		weightsTuple.setIntegerBranchValue( exptHandle, iExpmt );
 
-			weightsTuple.setIntegerBranchValue( "iEvtWithinExpt", iEvent );
+		// Calculate and store the weights for the events in this experiment, a chunk at a time
+		for ( UInt_t firstEvent{0}; firstEvent < nEvents; firstEvent += chunkSize ) {
 
-			const LauFitData& evtData { inputFitData->getData( iEvent ) };
+			const UInt_t nChunkEvents { std::min( chunkSize, nEvents - firstEvent ) };
 
-			const Double_t m13Sq_MC { evtData.at( "m13Sq_MC" ) };
-			const Double_t m23Sq_MC { evtData.at( "m23Sq_MC" ) };
+			this->readDataColumns( columnNames, firstEvent, nChunkEvents, columns );
+			const Double_t* m13Sq_MC { columns[0].data() };
+			const Double_t* m23Sq_MC { columns[1].data() };
 
-			Double_t dpModelWeight{0.0};
-			Double_t jacobian{1.0};
+			jacobians.resize( nChunkEvents );
 
-			if ( kinematics_->withinDPLimits( m13Sq_MC, m23Sq_MC ) ) {
-
-				kinematics_->updateKinematics( m13Sq_MC, m23Sq_MC );
-				dpModelWeight = sigDPModel_->getEventWeight();
+			std::vector<LauWeightingTask> tasks;
+			for ( UInt_t iModel{0}; iModel < nModels; ++iModel ) {
+				weights[iModel].resize( nChunkEvents );
+				LauIsobarDynamics* model { models[iModel] };
+				Double_t* modelWeights { weights[iModel].data() };
+				Double_t* modelJacobians { ( iModel == 0 && squareDP ) ? jacobians.data() : nullptr };
+				tasks.push_back( std::make_pair( model->getKinematics(), [=]() {
+					model->calcEventWeights( nChunkEvents, m13Sq_MC, m23Sq_MC, modelWeights, modelJacobians );
+				} ) );
+			}
+			this->runWeightingTasks( tasks );
 
+			for ( UInt_t iEvent{0}; iEvent < nChunkEvents; ++iEvent ) {
+				weightsTuple.setIntegerBranchValue( evtHandle, firstEvent + iEvent );
+				weightsTuple.setDoubleBranchValue( weightHandle, weights[0][iEvent] / sigDPModel_->getDPNorm() );
 				if ( squareDP ) {
-					jacobian = kinematics_->calcSqDPJacobian();
+					weightsTuple.setDoubleBranchValue( jacobianHandle, jacobians[iEvent] );
 				}
-
-				dpModelWeight /= sigDPModel_->getDPNorm();
-			}
-
-			weightsTuple.setDoubleBranchValue( "dpModelWeight", dpModelWeight );
-			if ( squareDP ) {
-				weightsTuple.setDoubleBranchValue( "sqDPJacobian", jacobian );
+				for ( UInt_t iVariant{0}; iVariant < nVariants; ++iVariant ) {
+					weightsTuple.setDoubleBranchValue( variantHandles[iVariant], weights[iVariant+1][iEvent] / weightVariantModels_[iVariant]->getDPNorm() );
+				}
+				weightsTuple.fillBranches();
 			}
-			weightsTuple.fillBranches();
 		}
 
 	}
@@ -2231,6 +2490,27 @@ void LauSimpleFitModel::weightEvents( const TString& dataFileName, const TString
 	weightsTuple.writeOutGenResults();
 }
 
+void LauSimpleFitModel::addWeightVariant(const TString& name, LauIsobarDynamics* dpModel, const std::vector<LauComplex>& coeffs)
+{
+	if ( dpModel == 0 ) {
+		std::cerr << "ERROR in LauSimpleFitModel::addWeightVariant : The DP model of variant \"" << name << "\" is null." << std::endl;
+		return;
+	}
+	if ( std::find( weightVariantNames_.begin(), weightVariantNames_.end(), name ) != weightVariantNames_.end() ) {
+		std::cerr << "ERROR in LauSimpleFitModel::addWeightVariant : A variant called \"" << name << "\" has already been added." << std::endl;
+		return;
+	}
+	if ( coeffs.size() != dpModel->getnTotAmp() ) {
+		std::cerr << "ERROR in LauSimpleFitModel::addWeightVariant : Expected " << dpModel->getnTotAmp() << " coefficients for variant \"" << name << "\" but got " << coeffs.size() << "." << std::endl;
+		return;
+	}
+
+	dpModel->initialise( coeffs );
+
+	weightVariantNames_.push_back( name );
+	weightVariantModels_.push_back( dpModel );
+}
+
 void LauSimpleFitModel::savePDFPlots(const TString& label)
 {
    savePDFPlotsWave(label, 0);
@@ -2261,6 +2541,25 @@ void LauSimpleFitModel::savePDFPlots(const TString& label)
    delta13 = (maxs13 - mins13)/n13;
    delta23 = (maxs23 - mins23)/n23;
    UInt_t nAmp = sigDPModel_->getnCohAmp();
+
+   // Evaluate the model at all of the points in one go
+   std::vector<Double_t> pointsS13, pointsS23;
+   for (Int_t i=0; i<n13; i++) {
+	s13 = mins13 + i*delta13;
+	for (Int_t j=0; j<n23; j++) {
+		s23 = mins23 + j*delta23;
+		if (sigDPModel_->getKinematics()->withinDPLimits2(s23, s13)) {
+			pointsS13.push_back(s13);
+			pointsS23.push_back(s23);
+		}
+	}
+   }
+   const UInt_t nPoints = pointsS13.size();
+   std::vector<Double_t> likelihoods( nPoints );
+   std::vector<LauComplex> totAmps( nPoints );
+   std::vector<LauComplex> resAmps( nPoints * nAmp );
+   sigDPModel_->calcDPValues( nPoints, pointsS13.data(), pointsS23.data(), likelihoods.data(), totAmps.data(), resAmps.data() );
+
    for (UInt_t resID = 0; resID <= nAmp; ++resID)
    {
 	TGraph2D *dt = new TGraph2D();
@@ -2282,45 +2581,26 @@ void LauSimpleFitModel::savePDFPlots(const TString& label)
 	dt->SetName(resName+label);
 	dt->SetTitle(resName+" ("+label+")");
 	Int_t count=0;
-	for (Int_t i=0; i<n13; i++) {
-		s13 = mins13 + i*delta13;
-		for (Int_t j=0; j<n23; j++) {
-			s23 = mins23 + j*delta23;
-			if (sigDPModel_->getKinematics()->withinDPLimits2(s23, s13))
-			{
-				//if (s13 > 4) continue;
-				sigDPModel_->calcLikelihoodInfo(s13, s23);
-				LauComplex chAmp = sigDPModel_->getEvtDPAmp();
-				if (resID != nAmp){
-					chAmp = sigDPModel_->getFullAmplitude(resID);
-				}
-				chPdf = chAmp.abs2();
-				//if ((z > 0.04)||(z < -0.03)) continue;
-				//z = TMath::Log(z);
-				if (sigDPModel_->getDaughters()->gotSymmetricalDP()){
-					Double_t sLow = s13;
-					Double_t sHigh = s23;
-					if (sLow>sHigh) {
-						continue;
-						//sLow = s23;
-						//sHigh = s13;
-					}
-
-					//if (sLow > 3.5) continue;
-					//if (i<10) std::cout << "SymmetricalDP" << std::endl;
-					//if (z>0.02) z = 0.02;
-					//if (z<-0.02) z = -0.02;
-
-					dt->SetPoint(count,sHigh,sLow,chPdf);
-					count++;
-				}
-				else {
-					dt->SetPoint(count,s13,s23,chPdf);
-					count++;
-
-				}
-
+	for (UInt_t iPoint=0; iPoint<nPoints; iPoint++) {
+		s13 = pointsS13[iPoint];
+		s23 = pointsS23[iPoint];
+		LauComplex chAmp = totAmps[iPoint];
+		if (resID != nAmp){
+			chAmp = resAmps[iPoint*nAmp + resID];
+		}
+		chPdf = chAmp.abs2();
+		if (sigDPModel_->getDaughters()->gotSymmetricalDP()){
+			Double_t sLow = s13;
+			Double_t sHigh = s23;
+			if (sLow>sHigh) {
+				continue;
 			}
+			dt->SetPoint(count,sHigh,sLow,chPdf);
+			count++;
+		}
+		else {
+			dt->SetPoint(count,s13,s23,chPdf);
+			count++;
 		}
 	}
    	gStyle->SetPalette(1);
@@ -2368,48 +2648,59 @@ void LauSimpleFitModel::savePDFPlotsWave(const TString& label, const Int_t& spin
 	delta23 = (maxs23 - mins23)/n23;
 	UInt_t nAmp = sigDPModel_->getnCohAmp();
 
-	Int_t count=0;
+	// Find the components with this spin
+	std::vector<UInt_t> waveResIDs;
+	for (UInt_t resID = 0; resID < nAmp; ++resID)
+	{
+		const LauIsobarDynamics* model = sigDPModel_;
+		const LauAbsResonance* resonance = model->getResonance(resID);
+		Int_t spin_res = resonance->getSpin();
+		if (spin != spin_res) continue;
+		waveResIDs.push_back(resID);
+	}
+
+	// Evaluate the model at all of the points in one go
+	std::vector<Double_t> pointsS13, pointsS23;
 	for (Int_t i=0; i<n13; i++) {
 		s13 = mins13 + i*delta13;
 		for (Int_t j=0; j<n23; j++) {
 			s23 = mins23 + j*delta23;
-			if (sigDPModel_->getKinematics()->withinDPLimits2(s23, s13))
-			{
-				//if (s13 > 4) continue;
-				LauComplex chAmp(0,0);
-				Bool_t noWaveRes = kTRUE;
-				sigDPModel_->calcLikelihoodInfo(s13, s23);
-				for (UInt_t resID = 0; resID < nAmp; ++resID)
-				{
-					const LauIsobarDynamics* model = sigDPModel_;
-					const LauAbsResonance* resonance = model->getResonance(resID);
-					Int_t spin_res = resonance->getSpin();
-					if (spin != spin_res) continue;
-					noWaveRes = kFALSE;
-					chAmp += sigDPModel_->getFullAmplitude(resID);
-				}
-
-				if (noWaveRes) return;
+			if (sigDPModel_->getKinematics()->withinDPLimits2(s23, s13)) {
+				pointsS13.push_back(s13);
+				pointsS23.push_back(s23);
+			}
+		}
+	}
+	const UInt_t nPoints = pointsS13.size();
 
-				chPdf = chAmp.abs2();
-				if (sigDPModel_->getDaughters()->gotSymmetricalDP()){
-					Double_t sLow = s13;
-					Double_t sHigh = s23;
-					if (sLow>sHigh) {
-						continue;
-						//sLow = s23;
-						//sHigh = s13;
-					}
-					dt->SetPoint(count,sHigh,sLow,chPdf);
-					count++;
-				}
-				else {
-					dt->SetPoint(count,s13,s23,chPdf);
-					count++;
+	if (waveResIDs.empty() && nPoints > 0) return;
 
-				}
+	std::vector<Double_t> likelihoods( nPoints );
+	std::vector<LauComplex> resAmps( nPoints * nAmp );
+	sigDPModel_->calcDPValues( nPoints, pointsS13.data(), pointsS23.data(), likelihoods.data(), 0, resAmps.data() );
 
-			}
+	Int_t count=0;
+	for (UInt_t iPoint=0; iPoint<nPoints; iPoint++) {
+		s13 = pointsS13[iPoint];
+		s23 = pointsS23[iPoint];
+		LauComplex chAmp(0,0);
+		for (std::vector<UInt_t>::const_iterator iter = waveResIDs.begin(); iter != waveResIDs.end(); ++iter)
+		{
+			chAmp += resAmps[iPoint*nAmp + (*iter)];
+		}
+		chPdf = chAmp.abs2();
+		if (sigDPModel_->getDaughters()->gotSymmetricalDP()){
+			Double_t sLow = s13;
+			Double_t sHigh = s23;
+			if (sLow>sHigh) {
+				continue;
+			}
+			dt->SetPoint(count,sHigh,sLow,chPdf);
+			count++;
+		}
+		else {
+			dt->SetPoint(count,s13,s23,chPdf);
+			count++;
 		}
 	}
 	gStyle->SetPalette(1);
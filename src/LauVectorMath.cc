@@ -0,0 +1,106 @@
+
+/*
+Copyright 2026 University of Warwick
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/*
+Laura++ package authors:
+John Back
+Paul Harrison
+Thomas Latham
+*/
+
+/*! \file LauVectorMath.cc
+    \brief File containing implementation of LauVectorMath methods.
+*/
+
+#include <cstring>
+#include <limits>
+
+#include "LauVectorMath.hh"
+
+void LauVectorMath::exp(const UInt_t nValues, const Double_t* input, Double_t* output)
+{
+	// Range reduction: x = k*ln(2) + r, with |r| <= ln(2)/2, such that exp(x) = 2^k * exp(r).
+	// exp(r) is then given by its Taylor series, which converges to full double precision by 13th order.
+	// The rounding to the nearest integer uses the usual trick of adding and subtracting 1.5*2^52,
+	// after which the integer is held in the lowest mantissa bits and so 2^k can be constructed directly.
+	// Since k can be as large as 1024, 2^k is applied in two halves to avoid overflowing the exponent.
+	// N.B. the loop only vectorises if the compiler may ignore floating-point exceptions in the comparisons,
+	// see the compilation flags for this file in src/CMakeLists.txt
+
+	const Double_t log2e = 1.4426950408889634074;
+	const Double_t ln2Hi = 6.93147180369123816490e-01;
+	const Double_t ln2Lo = 1.90821492927058770002e-10;
+	const Double_t shifter = 6755399441055744.0;
+	const Double_t maxArg = 709.782712893384;
+	const Double_t minArg = -708.39;
+	const Double_t inf = std::numeric_limits<Double_t>::infinity();
+
+	ULong64_t shifterBits(0);
+	std::memcpy( &shifterBits, &shifter, sizeof(shifterBits) );
+
+	for ( UInt_t i(0); i < nValues; ++i ) {
+
+		const Double_t x = input[i];
+		Double_t xc = x > maxArg ? maxArg : x;
+		xc = xc < minArg ? minArg : xc;
+
+		const Double_t t = xc * log2e + shifter;
+		const Double_t k = t - shifter;
+		const Double_t r = ( xc - k * ln2Hi ) - k * ln2Lo;
+
+		Double_t p = 1.0/6227020800.0;
+		p = p * r + 1.0/479001600.0;
+		p = p * r + 1.0/39916800.0;
+		p = p * r + 1.0/3628800.0;
+		p = p * r + 1.0/362880.0;
+		p = p * r + 1.0/40320.0;
+		p = p * r + 1.0/5040.0;
+		p = p * r + 1.0/720.0;
+		p = p * r + 1.0/120.0;
+		p = p * r + 1.0/24.0;
+		p = p * r + 1.0/6.0;
+		p = p * r + 0.5;
+		p = p * r + 1.0;
+		p = p * r + 1.0;
+
+		const Double_t t1 = k * 0.5 + shifter;
+		const Double_t t2 = ( k - ( t1 - shifter ) ) + shifter;
+
+		ULong64_t bits1(0), bits2(0);
+		std::memcpy( &bits1, &t1, sizeof(bits1) );
+		std::memcpy( &bits2, &t2, sizeof(bits2) );
+		bits1 = ( bits1 - shifterBits + 1023 ) << 52;
+		bits2 = ( bits2 - shifterBits + 1023 ) << 52;
+
+		Double_t scale1(0.0), scale2(0.0);
+		std::memcpy( &scale1, &bits1, sizeof(scale1) );
+		std::memcpy( &scale2, &bits2, sizeof(scale2) );
+
+		Double_t result = p * scale1 * scale2;
+		result = x < minArg ? 0.0 : result;
+		result = x > maxArg ? inf : result;
+		result = x != x ? x : result;
+		output[i] = result;
+	}
+}
+
+void LauVectorMath::scale(const UInt_t nValues, const Double_t factor, Double_t* values)
+{
+	for ( UInt_t i(0); i < nValues; ++i ) {
+		values[i] *= factor;
+	}
+}